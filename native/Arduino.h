@@ -0,0 +1,128 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/* ======================================================================
+   HOST SHIM: Just enough of the Arduino core for [env:native]
+   ====================================================================== */
+// Only on the include path for the native environment. Language level pieces (types, macros, Print) live here, anything
+// that touches hardware or time is forwarded to the native HAL backend in src/halNative.cpp, so libraries such as PID_v1
+// and ptScheduler see the simulated clock too.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define PI 3.1415926535897932384626433832795
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define F(text) text
+
+/* ======================================================================
+   CLASS: Print, formatting as the Arduino core does it
+   ====================================================================== */
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size-- > 0) {
+      written += write(*buffer++);
+    }
+    return written;
+  }
+  size_t write(const char *text) { return write(reinterpret_cast<const uint8_t *>(text), strlen(text)); }
+
+  size_t print(const char *text) { return write(text); }
+  size_t print(char value) { return write(static_cast<uint8_t>(value)); }
+  size_t print(unsigned char value, int base = DEC) { return print(static_cast<unsigned long>(value), base); }
+  size_t print(int value, int base = DEC) { return print(static_cast<long>(value), base); }
+  size_t print(unsigned int value, int base = DEC) { return print(static_cast<unsigned long>(value), base); }
+  size_t print(long value, int base = DEC) { return (base == DEC) ? printFormatted("%ld", value) : print(static_cast<unsigned long>(value), base); }
+  size_t print(unsigned long value, int base = DEC) { return printFormatted((base == HEX) ? "%lX" : "%lu", value); }
+  size_t print(double value, int digits = 2) { return printFormatted("%.*f", digits, value); }
+
+  template <typename T>
+  size_t println(T value) { return print(value) + println(); }
+  template <typename T>
+  size_t println(T value, int format) { return print(value, format) + println(); }
+  size_t println() { return write("\r\n"); }
+
+private:
+  template <typename... Arguments>
+  size_t printFormatted(const char *format, Arguments... arguments) {
+    char buffer[40];
+    snprintf(buffer, sizeof(buffer), format, arguments...);
+    return write(buffer);
+  }
+};
+
+/* ======================================================================
+   CLASS: Serial ports (Serial is stdout, Serial1 is the HAL UART)
+   ====================================================================== */
+class HardwareSerial : public Print {
+public:
+  explicit HardwareSerial(bool isMasterUart) : masterUart(isMasterUart) {}
+  void begin(unsigned long) {}
+  int available();
+  int availableForWrite() { return 1024; }
+  int peek();
+  int read();
+  void flush() {}
+  size_t write(uint8_t value) override;
+  using Print::write;
+  operator bool() { return true; }
+
+private:
+  bool masterUart;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: Forwarded to the native HAL backend
+   ====================================================================== */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+int analogRead(uint8_t);
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+long map(long, long, long, long, long);
+void noInterrupts();
+void interrupts();
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef NATIVE_CLIENT_H
+#define NATIVE_CLIENT_H
+
+#include "IPAddress.h"
+#include "Stream.h"
+
+/* ======================================================================
+   CLASS: Client, the network connection interface libraries such as PubSubClient are written against
+   ====================================================================== */
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress, uint16_t) = 0;
+  virtual int connect(const char *, uint16_t) = 0;
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t *, size_t) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t *, size_t) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   CLASS: IPv4 address, as the Arduino core stores it
+   ====================================================================== */
+class IPAddress {
+public:
+  IPAddress() : IPAddress(0, 0, 0, 0) {}
+  IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth) : bytes{first, second, third, fourth} {}
+  explicit IPAddress(const uint8_t *address) : IPAddress(address[0], address[1], address[2], address[3]) {}
+
+  uint8_t operator[](int index) const { return bytes[index]; }
+  uint8_t &operator[](int index) { return bytes[index]; }
+  bool operator==(const IPAddress &other) const { return memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+
+private:
+  uint8_t bytes[4];
+};
+
+#endif
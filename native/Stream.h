@@ -0,0 +1,16 @@
+#ifndef NATIVE_STREAM_H
+#define NATIVE_STREAM_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   CLASS: Stream, a Print that can also be read
+   ====================================================================== */
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef NATIVE_WIFIS3_H
+#define NATIVE_WIFIS3_H
+
+#include "Client.h"
+
+/* ======================================================================
+   CLASS: WiFi client with no network behind it
+   ====================================================================== */
+// Lets the MQTT connection state machine build for the host. Nothing answers, tests give it a fake broker to talk to
+// with setMqttTransport().
+class WiFiClient : public Client {
+public:
+  void setConnectionTimeout(int) {}
+  int connect(IPAddress, uint16_t) override { return 0; }
+  int connect(const char *, uint16_t) override { return 0; }
+  size_t write(uint8_t) override { return 0; }
+  size_t write(const uint8_t *, size_t) override { return 0; }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int read(uint8_t *, size_t) override { return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+  void stop() override {}
+  uint8_t connected() override { return 0; }
+  operator bool() override { return false; }
+};
+
+#endif
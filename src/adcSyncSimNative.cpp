@@ -0,0 +1,124 @@
+#ifdef HAL_NATIVE
+
+#include "boostController.h"
+#include "cytronMotorDriver.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "logBuffer.h"
+#include "platformTraits.h"
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+// Switching noise on the sensor lines, in ADC counts. Ringing is the peak straight after an edge (it decays over a few
+// us, see halNative.cpp), white noise is what the sensor and ADC have with the motor off, about the same as the plant
+// model's. Set these from a scope capture of A0 with the motor holding the valve to check the result for a particular car.
+const float ringingCounts = 12.0;
+const float whiteNoiseCounts = 0.8;
+
+const int sensorValueRaw = 512;
+const int readsPerPoint = 4000;
+const int maximumSamples = 20;
+const float motorDutiesPercent[] = {10, 30, 50, 70, 90};
+const int motorDutyCount = sizeof(motorDutiesPercent) / sizeof(motorDutiesPercent[0]);
+
+/* ======================================================================
+   FUNCTION: Deviation of one averaged reading, worst over the motor duties
+   ====================================================================== */
+double measureNoiseFloor(bool synced, int samples) {
+  double worst = 0;
+  for (int d = 0; d < motorDutyCount; d++) {
+    halPwmWrite(MOTOR_PWM_PIN, motorDutiesPercent[d]);
+    double total = 0, totalSquares = 0;
+    for (int i = 0; i < readsPerPoint; i++) {
+      int reading = synced ? getPwmSyncedAnaloguePinReading(boostValvePositionSignalPin, MOTOR_PWM_PIN, samples)
+                           : getAveragedAnaloguePinReading(boostValvePositionSignalPin, samples, 0);
+      total += reading;
+      totalSquares += static_cast<double>(reading) * reading;
+    }
+    double mean = total / readsPerPoint;
+    worst = max(worst, sqrt(max(0.0, totalSquares / readsPerPoint - mean * mean)));
+  }
+  return worst;
+}
+
+/* ======================================================================
+   FUNCTION: Wait for the quiet point per control tick, under the target's budget
+   ====================================================================== */
+// The tick's two synchronised sensors, valve position then manifold pressure. The wait is spread over the tick's reads
+// as halNative.cpp models it, so the mean and worst here are what the budget has to cover.
+void reportTickWait(unsigned long budgetMicros) {
+  halNativeSetAdc(manifoldTmapSensorPressureSignalPin, sensorValueRaw);
+  printf("duty  wait mean  wait max  budget used up  valve noise (counts)\n");
+  for (int d = 0; d < motorDutyCount; d++) {
+    halPwmWrite(MOTOR_PWM_PIN, motorDutiesPercent[d]);
+    double totalWait = 0, total = 0, totalSquares = 0;
+    unsigned long maximumWait = 0;
+    int budgetSpentTicks = 0;
+    for (int i = 0; i < readsPerPoint; i++) {
+      halAdcStartSyncBudget(budgetMicros);
+      int reading = getPwmSyncedAnaloguePinReading(boostValvePositionSignalPin, MOTOR_PWM_PIN, TargetPlatform::controlTickPwmSyncedSamples);
+      getPwmSyncedAnaloguePinReading(manifoldTmapSensorPressureSignalPin, MOTOR_PWM_PIN, TargetPlatform::controlTickPwmSyncedSamples);
+      unsigned long wait = halAdcSyncWaitMicros();
+      totalWait += wait;
+      maximumWait = max(maximumWait, wait);
+      budgetSpentTicks += (wait >= budgetMicros) ? 1 : 0;
+      total += reading;
+      totalSquares += static_cast<double>(reading) * reading;
+    }
+    double mean = total / readsPerPoint;
+    printf("%3.0f%%  %7.1fus  %6luus  %13.1f%%  %.3f\n", motorDutiesPercent[d], totalWait / readsPerPoint, maximumWait,
+           100.0 * budgetSpentTicks / readsPerPoint, sqrt(max(0.0, totalSquares / readsPerPoint - mean * mean)));
+  }
+  halAdcStartSyncBudget(0xFFFFFFFF);
+}
+
+/* ======================================================================
+   MAIN: Host entry point for [env:native_adc_sync_sim]
+   ====================================================================== */
+// Noise floor of the valve position reading against samples per read, taken at arbitrary points in the motor's PWM
+// period (getAveragedAnaloguePinReading()) and at its quiet point (getPwmSyncedAnaloguePinReading()). Then the fewest
+// synchronised samples that match what the control tick gets today, and how long the tick spends waiting for them.
+int main() {
+  initLogBuffer();
+  initCytronMotorDriver(); // Motor PWM at 25kHz
+  halNativeSetAdc(boostValvePositionSignalPin, sensorValueRaw);
+  halNativeSetSwitchingNoise(ringingCounts, whiteNoiseCounts);
+
+  printf("Valve position noise floor (worst standard deviation over %d motor duties, counts)\n", motorDutyCount);
+  printf("samples  arbitrary  synchronised\n");
+  double arbitraryFloor[maximumSamples + 1], syncedFloor[maximumSamples + 1];
+  for (int samples = 1; samples <= maximumSamples; samples++) {
+    arbitraryFloor[samples] = measureNoiseFloor(false, samples);
+    syncedFloor[samples] = measureNoiseFloor(true, samples);
+    printf("%7d  %9.3f  %12.3f\n", samples, arbitraryFloor[samples], syncedFloor[samples]);
+  }
+
+  const int arbitrarySamples = TargetPlatform::controlTickAnalogueSamples;
+  const int syncedSamples = TargetPlatform::controlTickPwmSyncedSamples;
+  int neededSamples = 1;
+  while (neededSamples < maximumSamples && syncedFloor[neededSamples] > arbitraryFloor[arbitrarySamples]) {
+    neededSamples++;
+  }
+  printf("%d arbitrary samples per read give %.3f counts, %d synchronised match it, the control tick takes %d (%.3f counts)\n", arbitrarySamples,
+         arbitraryFloor[arbitrarySamples], neededSamples, syncedSamples, syncedFloor[syncedSamples]);
+
+  printf("\nPWM sync wait per control tick, no budget\n");
+  reportTickWait(0xFFFFFFFF);
+  printf("\nPWM sync wait per control tick, %luus budget\n", TargetPlatform::controlTickAdcSyncBudgetMicros);
+  reportTickWait(TargetPlatform::controlTickAdcSyncBudgetMicros);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "atmosphericBaseline.h"
+#include "globalHelpers.h"
+#include "hal.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+// Windows where the sensors read atmospheric. The master's values have to be fresh, and the window has to have been open
+// for the settle time so the manifold has bled down after a pull.
+const int atmosphericIdleMaximumRpm = 1100;
+const unsigned long atmosphericMasterMaximumAgeMillis = 500;
+const unsigned long atmosphericSettleMillis = 1000;
+
+// Called every 200ms, so ~20s to follow a change. Climbing or descending a pass moves the reading ~1kPa per 100m, far
+// slower than that.
+const float atmosphericFilterFactor = 0.01;
+
+// Plausibility. Each sample has to be close to the current baseline (a reading further out is flow through the filter or
+// a fault, not altitude), absolute pressure has to be somewhere a car can drive, and the total drift since boot is capped
+// at about 2500m of climb. The manifold sensor's reading against the intake's can only move by a few counts.
+const float atmosphericMaximumStepKpa = 3.0;
+const float atmosphericMinimumKpa = 65.0;
+const float atmosphericMaximumKpa = 110.0;
+const float atmosphericMaximumDriftKpa = 30.0;
+const float atmosphericMaximumSensorBiasDriftRaw = 10.0;
+
+float atmosphericBootIntakeRaw, atmosphericBootSensorBiasRaw;
+float atmosphericIntakeRaw;     // Intake sensor raw at atmospheric, filtered
+float atmosphericSensorBiasRaw; // Manifold sensor raw less intake sensor raw, both at atmospheric
+unsigned long atmosphericUpdatedMillis = 0;
+unsigned long atmosphericUpdates = 0;
+unsigned long atmosphericRejected = 0;
+AtmosphericWindow atmosphericOpenWindow = ATMOSPHERIC_WINDOW_NONE;
+unsigned long atmosphericWindowOpenedMillis = 0;
+bool atmosphericWindowSettled = false;
+int atmosphericAppliedManifoldOffsetRaw = 0;
+
+/* ======================================================================
+   FUNCTION: Start from the readings taken in setup()
+   ====================================================================== */
+void initAtmosphericBaseline(float manifoldOffsetRaw, float intakeOffsetRaw) {
+  atmosphericBootIntakeRaw = intakeOffsetRaw;
+  atmosphericBootSensorBiasRaw = manifoldOffsetRaw - intakeOffsetRaw;
+  atmosphericIntakeRaw = atmosphericBootIntakeRaw;
+  atmosphericSensorBiasRaw = atmosphericBootSensorBiasRaw;
+  atmosphericUpdatedMillis = halMillis();
+  atmosphericAppliedManifoldOffsetRaw = lroundf(manifoldOffsetRaw);
+}
+
+/* ======================================================================
+   FUNCTION: Which window, if any, the car is in
+   ====================================================================== */
+AtmosphericWindow detectAtmosphericWindow(int rpm, bool clutchPressed, double targetKpa, unsigned long masterInputAgeMillis) {
+  if (masterInputAgeMillis > atmosphericMasterMaximumAgeMillis || targetKpa != 0.0) {
+    return ATMOSPHERIC_WINDOW_NONE;
+  }
+  if (rpm == 0) {
+    return ATMOSPHERIC_WINDOW_ENGINE_OFF;
+  }
+  if (rpm <= atmosphericIdleMaximumRpm) {
+    return ATMOSPHERIC_WINDOW_IDLE;
+  }
+  return clutchPressed ? ATMOSPHERIC_WINDOW_NO_BOOST : ATMOSPHERIC_WINDOW_NONE;
+}
+
+/* ======================================================================
+   FUNCTION: Take one pair of readings, returns true when the manifold offset for the control tick has changed
+   ====================================================================== */
+// Background only, every 200ms with the latest raw readings from the control tick. The offset handed to the tick is in
+// whole raw counts, so it only changes once the baseline has moved by one (~0.3kPa).
+bool updateAtmosphericBaseline(int manifoldRaw, int intakeRaw, bool intakePlausible, int rpm, bool clutchPressed, double targetKpa,
+                               unsigned long masterInputAgeMillis) {
+  AtmosphericWindow window = detectAtmosphericWindow(rpm, clutchPressed, targetKpa, masterInputAgeMillis);
+  if (window != atmosphericOpenWindow) {
+    atmosphericOpenWindow = window;
+    atmosphericWindowOpenedMillis = halMillis();
+    atmosphericWindowSettled = false;
+  }
+  if (window == ATMOSPHERIC_WINDOW_NONE || !intakePlausible) {
+    return false;
+  }
+  if (!atmosphericWindowSettled) {
+    atmosphericWindowSettled = (halMillis() - atmosphericWindowOpenedMillis >= atmosphericSettleMillis);
+    return false;
+  }
+
+  float intakeKpa = calculateBosch3BarKpaFromRaw(intakeRaw);
+  float baselineKpa = calculateBosch3BarKpaFromRaw(atmosphericIntakeRaw);
+  float driftKpa = intakeKpa - calculateBosch3BarKpaFromRaw(atmosphericBootIntakeRaw);
+  float sensorBiasRaw = manifoldRaw - intakeRaw;
+  bool biasPlausible = fabs(sensorBiasRaw - atmosphericBootSensorBiasRaw) <= atmosphericMaximumSensorBiasDriftRaw;
+  if (fabs(intakeKpa - baselineKpa) > atmosphericMaximumStepKpa || intakeKpa < atmosphericMinimumKpa || intakeKpa > atmosphericMaximumKpa ||
+      fabs(driftKpa) > atmosphericMaximumDriftKpa || (window == ATMOSPHERIC_WINDOW_ENGINE_OFF && !biasPlausible)) {
+    atmosphericRejected++;
+    return false;
+  }
+
+  atmosphericIntakeRaw += (intakeRaw - atmosphericIntakeRaw) * atmosphericFilterFactor;
+  if (window == ATMOSPHERIC_WINDOW_ENGINE_OFF) {
+    atmosphericSensorBiasRaw += (sensorBiasRaw - atmosphericSensorBiasRaw) * atmosphericFilterFactor;
+  }
+  atmosphericUpdatedMillis = halMillis();
+  atmosphericUpdates++;
+
+  int manifoldOffsetRaw = lroundf(atmosphericIntakeRaw + atmosphericSensorBiasRaw);
+  if (manifoldOffsetRaw == atmosphericAppliedManifoldOffsetRaw) {
+    return false;
+  }
+  atmosphericAppliedManifoldOffsetRaw = manifoldOffsetRaw;
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Current baseline, for the rest of loop() and telemetry
+   ====================================================================== */
+void getAtmosphericBaseline(AtmosphericBaseline *baseline) {
+  baseline->manifoldOffsetRaw = atmosphericIntakeRaw + atmosphericSensorBiasRaw;
+  baseline->intakeOffsetRaw = atmosphericIntakeRaw;
+  baseline->atmosphericKpa = calculateBosch3BarKpaFromRaw(atmosphericIntakeRaw);
+  baseline->driftKpa = baseline->atmosphericKpa - calculateBosch3BarKpaFromRaw(atmosphericBootIntakeRaw);
+  baseline->ageMillis = halMillis() - atmosphericUpdatedMillis;
+  baseline->updates = atmosphericUpdates;
+  baseline->rejected = atmosphericRejected;
+  baseline->window = atmosphericWindowSettled ? atmosphericOpenWindow : ATMOSPHERIC_WINDOW_NONE;
+}
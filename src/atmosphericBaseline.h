@@ -0,0 +1,37 @@
+#ifndef ATMOSPHERICBASELINE_H
+#define ATMOSPHERICBASELINE_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   ENUMS: Why the sensors can be taken as reading atmospheric right now
+   ====================================================================== */
+enum AtmosphericWindow {
+  ATMOSPHERIC_WINDOW_NONE,
+  ATMOSPHERIC_WINDOW_ENGINE_OFF, // Both sensors, so the manifold sensor's reading against the intake's is learned too
+  ATMOSPHERIC_WINDOW_IDLE,       // Intake sensor only, the manifold is in vacuum
+  ATMOSPHERIC_WINDOW_NO_BOOST    // Clutch in with a 0kPa target, off throttle so next to no flow through the filter
+};
+
+/* ======================================================================
+   STRUCTURES: Current baseline and how it was arrived at
+   ====================================================================== */
+struct AtmosphericBaseline {
+  float manifoldOffsetRaw;  // Manifold sensor raw at atmospheric, what the control tick works gauge pressure from
+  float intakeOffsetRaw;    // Intake sensor raw at atmospheric
+  float atmosphericKpa;     // Absolute, from the intake sensor
+  float driftKpa;           // Since the boot calibration
+  unsigned long ageMillis;  // Since the last accepted sample, since boot until the first
+  unsigned long updates;    // Accepted samples
+  unsigned long rejected;   // Samples taken in a window but outside the plausibility limits
+  AtmosphericWindow window; // Open right now, NONE until it has been open long enough to settle
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void initAtmosphericBaseline(float, float);
+bool updateAtmosphericBaseline(int, int, bool, int, bool, double, unsigned long);
+void getAtmosphericBaseline(AtmosphericBaseline *);
+
+#endif
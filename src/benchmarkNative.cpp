@@ -0,0 +1,44 @@
+#ifdef HAL_NATIVE
+
+#include "benchmarks.h"
+#include "cytronMotorDriver.h"
+#include "logBuffer.h"
+#include <chrono>
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+/* ======================================================================
+   FUNCTION: Host counter and output for the shared runner
+   ====================================================================== */
+// Nanoseconds truncated to 32 bits, wraps every ~4s which the runner's deltas don't care about
+uint32_t readBenchmarkNanos() {
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void printBenchmarkLine(const char *line) {
+  printf("%s\n", line);
+}
+
+/* ======================================================================
+   MAIN: Host entry point for [env:native_bench]
+   ====================================================================== */
+// Runs on the simulated HAL clock, so PID::Compute sees its SampleTime elapse without actually sleeping. Save the output
+// and compare it with tools/benchmarkCompare.py.
+int main() {
+  initLogBuffer();
+  initCytronMotorDriver();
+  const BenchmarkPlatform platform = {"native", "ns", 1000000000UL, readBenchmarkNanos, printBenchmarkLine};
+  runBenchmarks(&platform);
+  return 0;
+}
+
+#endif
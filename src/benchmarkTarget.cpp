@@ -0,0 +1,58 @@
+#ifdef BENCHMARK_TARGET
+
+#include "benchmarks.h"
+#include "cytronMotorDriver.h"
+#include "logBuffer.h"
+#include "platformTraits.h"
+#include "taskProfiler.h"
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+// No DWT on the Mega, there the profiler counts cycles from micros() so results step in 64 cycle increments
+#if defined(ARDUINO_ARCH_AVR)
+#define BENCHMARK_CORE_CLOCK_HZ F_CPU
+#else
+#define BENCHMARK_CORE_CLOCK_HZ SystemCoreClock
+#endif
+
+/* ======================================================================
+   FUNCTION: DWT counter and serial output for the shared runner
+   ====================================================================== */
+uint32_t readBenchmarkCycles() {
+  return profilerGetCycles();
+}
+
+void printBenchmarkLine(const char *line) {
+  Serial.println(line);
+}
+
+/* ======================================================================
+   SETUP: Board entry point for [env:uno_r4_wifi_bench] and [env:megaatmega2560_bench]
+   ====================================================================== */
+// Replaces main.cpp entirely, so the control tick, WiFi and MQTT are not running while we measure. The motor driver is
+// set up so setCytronSpeedAndDirection() drives real pins, it is only ever asked for 0%.
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+  }
+  initTaskProfiler();
+  initLogBuffer();
+  initCytronMotorDriver();
+
+  const BenchmarkPlatform platform = {TargetPlatform::name, "cycles", BENCHMARK_CORE_CLOCK_HZ, readBenchmarkCycles, printBenchmarkLine};
+  runBenchmarks(&platform);
+}
+
+void loop() {
+}
+
+#endif
@@ -0,0 +1,299 @@
+#include "benchmarks.h"
+#include "boostController.h"
+#include "boostValveControl.h"
+#include "controlNumeric.h"
+#include "cytronMotorDriver.h"
+#include "globalHelpers.h"
+#include "hal.h"
+#include "platformTraits.h"
+#include "serialCommunications.h"
+#include "serialMessageProcessing.h"
+#include <PID_v1.h>
+
+#if PLATFORM_HAS_NETWORK
+#include "mqttMetricSchema.h"
+#endif
+
+/* ======================================================================
+   STRUCTURES: A benchmark definition
+   ====================================================================== */
+struct Benchmark {
+  const char *name;
+  int perTick;      // Calls per control tick, for the budget check in tools/benchmarkCompare.py
+  int batch;        // Operations per timed sample, 1 when prepare has to run before every operation
+  void (*prepare)(); // Optional, run untimed before each sample
+  void (*run)();
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int benchmarkWarmupSamples = 4;
+const int benchmarkSamples = 31; // Odd, so the median is a real sample
+const unsigned long benchmarkBudgetUs = 1000000.0 / TargetPlatform::controlTickFrequencyHz; // One control tick
+
+// Results land in volatiles so the compiler can't drop the work being timed
+volatile float benchmarkSinkFloat;
+volatile int benchmarkSinkInt;
+volatile int benchmarkInputRaw = 512;
+
+int benchmarkValveRaw = 540, benchmarkValveMinimum = 210, benchmarkValveMaximum = 830;
+double benchmarkPidInput = 30.0, benchmarkPidOutput = 0.0, benchmarkPidSetpoint = 45.0;
+PID benchmarkPidIdle(&benchmarkPidInput, &benchmarkPidOutput, &benchmarkPidSetpoint, 9.0, 3.3, 1.3, REVERSE);
+PID benchmarkPidFull(&benchmarkPidInput, &benchmarkPidOutput, &benchmarkPidSetpoint, 9.0, 3.3, 1.3, REVERSE);
+
+// The same again in whichever number type the control core is built with (see controlNumeric.h)
+ControlNumeric::Value benchmarkControlPidInput = ControlNumeric::fromInt(30), benchmarkControlPidOutput = 0,
+                      benchmarkControlPidSetpoint = ControlNumeric::fromInt(45);
+ControlNumeric::Pid benchmarkControlPidIdle(&benchmarkControlPidInput, &benchmarkControlPidOutput, &benchmarkControlPidSetpoint, 9.0, 3.3, 1.3, REVERSE);
+ControlNumeric::Pid benchmarkControlPidFull(&benchmarkControlPidInput, &benchmarkControlPidOutput, &benchmarkControlPidSetpoint, 9.0, 3.3, 1.3, REVERSE);
+volatile ControlNumeric::Value benchmarkSinkControl;
+
+// Whole boost channels on the primary channel's sensors but without a motor, so stepping them never moves the valve
+const BoostChannelPins benchmarkChannelPins = {boostValvePositionSignalPin, manifoldTmapSensorPressureSignalPin, intakeTmapSensorPressureSignalPin, nullptr};
+const int benchmarkChannelCount = 4;
+BoostChannel benchmarkChannels[benchmarkChannelCount] = {{&benchmarkChannelPins}, {&benchmarkChannelPins}, {&benchmarkChannelPins}, {&benchmarkChannelPins}};
+ControlInputs benchmarkChannelInputs[benchmarkChannelCount];
+ControlOutputs benchmarkChannelOutputs[benchmarkChannelCount];
+
+// Shadow mode on and under pressure control, its most expensive path
+ShadowController benchmarkShadowController;
+ControlInputs benchmarkShadowInputs;
+ShadowStretch benchmarkShadowStretch;
+
+const char benchmarkCommandId1Message[] = "<1,87.50,3520,4,0,21>";
+char benchmarkMessage[sizeof(benchmarkCommandId1Message)];
+float benchmarkSpeed;
+int benchmarkRpm, benchmarkGear;
+bool benchmarkClutchPressed;
+
+#if PLATFORM_HAS_NETWORK
+char benchmarkPayload[256];
+float benchmarkPressures[] = {45.0f, 43.87f};
+#endif
+
+/* ======================================================================
+   FUNCTION: Benchmark bodies
+   ====================================================================== */
+void benchmarkNothing() {
+}
+
+void benchmarkBoschKpa() {
+  benchmarkSinkFloat = calculateBosch3BarKpaFromRaw(benchmarkInputRaw);
+}
+
+void benchmarkValveOpenPercentage() {
+  benchmarkSinkFloat = getBoostValveOpenPercentage(&benchmarkValveRaw, &benchmarkValveMinimum, &benchmarkValveMaximum);
+}
+
+// Called again inside its SampleTime, so only the time check. The control tick's PIDs compute every tick, see full
+void benchmarkPidComputeIdle() {
+  benchmarkSinkInt = benchmarkPidIdle.Compute();
+}
+
+// Waits out the 1ms SampleTime first, so every timed call does the full calculation
+void prepareBenchmarkPidComputeFull() {
+  halDelayMicros(1100);
+}
+
+void benchmarkPidComputeFull() {
+  benchmarkSinkInt = benchmarkPidFull.Compute();
+}
+
+void benchmarkControlKpa() {
+  benchmarkSinkControl = ControlNumeric::kpaFromRaw(benchmarkInputRaw);
+}
+
+void benchmarkControlOpenPercentage() {
+  benchmarkSinkControl = ControlNumeric::openPercentage(&benchmarkValveRaw, &benchmarkValveMinimum, &benchmarkValveMaximum);
+}
+
+void benchmarkControlPidComputeIdle() {
+  benchmarkSinkInt = benchmarkControlPidIdle.Compute();
+}
+
+void benchmarkControlPidComputeFull() {
+  benchmarkSinkInt = benchmarkControlPidFull.Compute();
+}
+
+// One sensor's worth of the control tick's ADC reads, usually the largest part of the tick on the board
+void benchmarkTickAnalogueRead() {
+  benchmarkSinkInt = getAveragedAnaloguePinReading(boostValvePositionSignalPin, TargetPlatform::controlTickAnalogueSamples, 0);
+}
+
+void benchmarkTickIntakeAnalogueRead() {
+  benchmarkSinkInt = getAveragedAnaloguePinReading(intakeTmapSensorPressureSignalPin, TargetPlatform::controlTickIntakeSamples, 0);
+}
+
+// One channel's whole step, sensor reads included. The difference between these two is the cost of each extra channel.
+void benchmarkBoostChannelsOne() {
+  runBoostChannels(benchmarkChannels, 1, benchmarkChannelInputs, benchmarkChannelOutputs);
+}
+
+void benchmarkBoostChannelsAll() {
+  runBoostChannels(benchmarkChannels, benchmarkChannelCount, benchmarkChannelInputs, benchmarkChannelOutputs);
+}
+
+// Model, metrics and the candidate PID's time check, what shadow mode adds to each channel's tick
+void benchmarkShadowControllerStep() {
+  benchmarkSinkInt = benchmarkShadowController.step(&benchmarkShadowInputs, true, benchmarkControlPidSetpoint, benchmarkControlPidInput,
+                                                    ControlNumeric::fromInt(50), 0, &benchmarkShadowStretch);
+}
+
+void benchmarkChecksumValid() {
+  benchmarkSinkInt = serialIsChecksumValid(benchmarkCommandId1Message);
+}
+
+// strtok writes into the message, so each call gets a fresh copy
+void prepareBenchmarkCommandId1() {
+  memcpy(benchmarkMessage, benchmarkCommandId1Message, sizeof(benchmarkMessage));
+}
+
+void benchmarkCommandId1() {
+  serialProcessCommandId1(benchmarkMessage, &benchmarkSpeed, &benchmarkRpm, &benchmarkGear, &benchmarkClutchPressed);
+}
+
+#if PLATFORM_HAS_NETWORK
+// Serialisation only, what publishMqttMetrics() spends before handing the payload to the network
+void benchmarkMetricsSerialize() {
+  MetricGroup group = metricGroup(pressuresMetricSchema, benchmarkPressures);
+  benchmarkSinkInt = serializeMqttMetricGroups(benchmarkPayload, sizeof(benchmarkPayload), &group, 1, false);
+}
+#endif
+
+// 0% only, so running this on the car never moves the valve
+void benchmarkCytronOutput() {
+  setCytronSpeedAndDirection(0.0);
+}
+
+// The floating point entries stay as a reference on every target, the tick budget is made up from the ControlNumeric ones
+const Benchmark benchmarkDefinitions[] = {
+    {"calculateBosch3BarKpaFromRaw", 0, 64, nullptr, benchmarkBoschKpa},
+    {"getBoostValveOpenPercentage", 0, 64, nullptr, benchmarkValveOpenPercentage},
+    {"PID::Compute idle", 0, 64, nullptr, benchmarkPidComputeIdle},
+    {"PID::Compute full", 0, 1, prepareBenchmarkPidComputeFull, benchmarkPidComputeFull},
+    {"ControlNumeric::kpaFromRaw", 2, 64, nullptr, benchmarkControlKpa},
+    {"ControlNumeric::openPercentage", 1, 64, nullptr, benchmarkControlOpenPercentage},
+    {"ControlPid::Compute idle", 0, 64, nullptr, benchmarkControlPidComputeIdle},
+    {"ControlPid::Compute full", 1, 1, prepareBenchmarkPidComputeFull, benchmarkControlPidComputeFull},
+    {"tickAnalogueRead", 2, 4, nullptr, benchmarkTickAnalogueRead},
+    {"tickIntakeAnalogueRead", 1, 4, nullptr, benchmarkTickIntakeAnalogueRead},
+    {"runBoostChannels x1", 0, 4, nullptr, benchmarkBoostChannelsOne}, // Made up of the entries above, so not counted again
+    {"runBoostChannels x4", 0, 1, nullptr, benchmarkBoostChannelsAll},
+    {"ShadowController::step", 1, 1, prepareBenchmarkPidComputeFull, benchmarkShadowControllerStep}, // Only while shadow mode is enabled
+    {"serialIsChecksumValid", 0, 16, nullptr, benchmarkChecksumValid},
+    {"serialProcessCommandId1", 0, 1, prepareBenchmarkCommandId1, benchmarkCommandId1},
+#if PLATFORM_HAS_NETWORK
+    {"serializeMqttMetricGroups", 0, 16, nullptr, benchmarkMetricsSerialize},
+#endif
+    {"setCytronSpeedAndDirection", 1, 64, nullptr, benchmarkCytronOutput}};
+
+/* ======================================================================
+   FUNCTION: Time one sample of a benchmark, per operation
+   ====================================================================== */
+float timeBenchmarkSample(const BenchmarkPlatform *platform, const Benchmark *benchmark, void (*run)()) {
+  if (benchmark->prepare != nullptr) {
+    benchmark->prepare();
+  }
+  uint32_t start = platform->readCounter();
+  for (int i = 0; i < benchmark->batch; i++) {
+    run();
+  }
+  uint32_t elapsed = platform->readCounter() - start;
+  return static_cast<float>(elapsed) / benchmark->batch;
+}
+
+/* ======================================================================
+   FUNCTION: Run one benchmark, less the cost of the timing loop itself
+   ====================================================================== */
+void runBenchmark(const BenchmarkPlatform *platform, const Benchmark *benchmark, BenchmarkResult *result) {
+  static float samples[benchmarkSamples];
+
+  // Same loop around an empty body, the cheapest sample is taken as pure overhead
+  float overhead = 0.0f;
+  for (int i = 0; i < benchmarkSamples; i++) {
+    float sample = timeBenchmarkSample(platform, benchmark, benchmarkNothing);
+    overhead = (i == 0) ? sample : min(overhead, sample);
+  }
+
+  for (int i = 0; i < benchmarkWarmupSamples; i++) {
+    timeBenchmarkSample(platform, benchmark, benchmark->run);
+  }
+
+  float total = 0.0f;
+  for (int i = 0; i < benchmarkSamples; i++) {
+    samples[i] = max(0.0f, timeBenchmarkSample(platform, benchmark, benchmark->run) - overhead);
+    total += samples[i];
+  }
+
+  // Insertion sort, only 31 samples
+  for (int i = 1; i < benchmarkSamples; i++) {
+    float sample = samples[i];
+    int j = i - 1;
+    for (; j >= 0 && samples[j] > sample; j--) {
+      samples[j + 1] = samples[j];
+    }
+    samples[j + 1] = sample;
+  }
+
+  result->name = benchmark->name;
+  result->perTick = benchmark->perTick;
+  result->operations = static_cast<unsigned long>(benchmarkSamples) * benchmark->batch;
+  result->minimum = samples[0];
+  result->median = samples[benchmarkSamples / 2];
+  result->mean = total / benchmarkSamples;
+  result->maximum = samples[benchmarkSamples - 1];
+  float variance = 0.0f;
+  for (int i = 0; i < benchmarkSamples; i++) {
+    variance += (samples[i] - result->mean) * (samples[i] - result->mean);
+  }
+  result->standardDeviation = sqrtf(variance / benchmarkSamples);
+}
+
+/* ======================================================================
+   FUNCTION: Run every benchmark and print the results as JSON
+   ====================================================================== */
+// One result per line so the board's output can be captured straight from the serial monitor
+void runBenchmarks(const BenchmarkPlatform *platform) {
+  char line[192];
+  benchmarkPidIdle.SetMode(AUTOMATIC); // PID_v1 starts in MANUAL, where Compute() returns straight away
+  benchmarkPidFull.SetMode(AUTOMATIC);
+  benchmarkPidFull.SetSampleTime(1);
+  benchmarkControlPidIdle.SetMode(AUTOMATIC);
+  benchmarkControlPidFull.SetMode(AUTOMATIC);
+  benchmarkControlPidFull.SetSampleTime(1);
+  for (int i = 0; i < benchmarkChannelCount; i++) {
+    benchmarkChannels[i].begin(benchmarkValveMinimum, benchmarkValveMaximum, 190.0f, &benchmarkChannelInputs[i]);
+    benchmarkChannelInputs[i].targetBoostKpa = 45.0;
+    convertControlInputs(&benchmarkChannelInputs[i]);
+  }
+  benchmarkShadowController.begin(-60.0, 40.0, 1);
+  benchmarkShadowInputs = benchmarkChannelInputs[0];
+  benchmarkShadowInputs.shadowCandidate.enabled = true;
+  benchmarkShadowInputs.shadowCandidate.pressureKp = 12.0;
+  benchmarkShadowInputs.shadowCandidate.pressureKi = 3.0;
+  benchmarkShadowInputs.shadowCandidate.pressureKd = 1.0;
+  convertControlInputs(&benchmarkShadowInputs);
+
+  snprintf(line, sizeof(line), "{\"platform\":\"%s\",\"unit\":\"%s\",\"counterHz\":%lu,\"budgetUs\":%lu,\"results\":[", platform->name, platform->unit,
+           platform->counterHz, benchmarkBudgetUs);
+  platform->print(line);
+
+  const int benchmarkCount = sizeof(benchmarkDefinitions) / sizeof(benchmarkDefinitions[0]);
+  for (int i = 0; i < benchmarkCount; i++) {
+    BenchmarkResult result;
+    runBenchmark(platform, &benchmarkDefinitions[i], &result);
+
+    // Fixed point rather than %f, which the board's printf doesn't do by default
+    int length = snprintf(line, sizeof(line), "  {\"name\":\"%s\",\"perTick\":%d,\"operations\":%lu", result.name, result.perTick, result.operations);
+    const char *keys[] = {"min", "median", "mean", "max", "stddev"};
+    float values[] = {result.minimum, result.median, result.mean, result.maximum, result.standardDeviation};
+    for (int k = 0; k < 5; k++) {
+      long scaled = lroundf(values[k] * 10.0f);
+      length += snprintf(&line[length], sizeof(line) - length, ",\"%s\":%ld.%ld", keys[k], scaled / 10, scaled % 10);
+    }
+    snprintf(&line[length], sizeof(line) - length, "}%s", (i < benchmarkCount - 1) ? "," : "");
+    platform->print(line);
+  }
+  platform->print("]}");
+}
@@ -0,0 +1,38 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: How to time and report, supplied by each runner
+   ====================================================================== */
+// The same benchmark definitions run natively (benchmarkNative.cpp, nanoseconds) and on the board
+// (benchmarkTarget.cpp, DWT cycles)
+struct BenchmarkPlatform {
+  const char *name;
+  const char *unit;
+  unsigned long counterHz;     // Counter ticks per second, used by tools/benchmarkCompare.py to convert to time
+  uint32_t (*readCounter)();   // Free running, wraps at 32 bits
+  void (*print)(const char *); // Results go out a line at a time
+};
+
+/* ======================================================================
+   STRUCTURES: Per benchmark statistics, per operation in counter ticks
+   ====================================================================== */
+struct BenchmarkResult {
+  const char *name;
+  int perTick; // How many times the control tick runs this, 0 for background only
+  unsigned long operations;
+  float minimum;
+  float median;
+  float mean;
+  float maximum;
+  float standardDeviation;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void runBenchmarks(const BenchmarkPlatform *);
+
+#endif
@@ -0,0 +1,186 @@
+#include "blackboxRecorder.h"
+#include "hal.h"
+#include "logBuffer.h"
+#include "platformTraits.h"
+
+#if PLATFORM_HAS_NETWORK
+#include "mqttPublish.h"
+#endif
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int blackboxRecordEveryTicks = 2; // Every other control tick, 500Hz on the R4 and 250Hz on the Mega
+const long blackboxRecordPeriodMicros = lround(blackboxRecordEveryTicks * 1000000.0 / TargetPlatform::controlTickFrequencyHz);
+const int blackboxDumpRecordsPerLine = 16; // 16 records per #B line, 256 hex characters
+const int blackboxDumpLinesPerService = 1; // Per call to serviceBlackboxDump, keeps the background loop responsive
+const byte blackboxTriggerManual = 0xFF;   // Trigger code used when no fault code applies
+
+uint64_t blackboxRecords[BLACKBOX_RECORDS];
+int blackboxNextIndex = 0;
+bool blackboxWrapped = false;
+int blackboxPostTriggerRecords = BLACKBOX_RECORDS / 3; // Two thirds before the trigger, one third after
+int blackboxPostTriggerRemaining;
+int blackboxTickCount = 0;
+unsigned long blackboxPreviousFaultBitmask = 0;
+
+volatile BlackboxState blackboxState = BLACKBOX_RECORDING;
+volatile byte blackboxTriggerCode;
+volatile unsigned long blackboxTriggerMillis;
+volatile bool blackboxTriggerRequested = false;
+
+// Dump progress, only touched in the background once frozen
+bool blackboxDumpInProgress = false;
+BlackboxDumpTarget blackboxDumpTarget = BLACKBOX_DUMP_SERIAL;
+int blackboxDumpPosition = -1; // -1 means header still to send
+
+/* ======================================================================
+   FUNCTION: Set the post trigger window, only takes effect while recording
+   ====================================================================== */
+void setBlackboxPostTriggerRecords(int records) {
+  if (blackboxState == BLACKBOX_RECORDING) {
+    blackboxPostTriggerRecords = constrain(records, 0, BLACKBOX_RECORDS - 1);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Pack a sample into 64 bits (layout is decoded by tools/blackboxDecode.py)
+   ====================================================================== */
+// Bits  0-7  target kPa, 0.5kPa steps        Bits 38-45 motor command, signed %
+// Bits  8-19 actual kPa gauge, signed 0.125   Bits 46-47 control mode
+// Bits 20-29 valve position raw               Bits 48-57 RPM, 8rpm steps
+// Bits 30-37 valve open, 0.5% steps           Bits 58-60 gear, bit 61 clutch, bit 62 critical alarm
+uint64_t packBlackboxSample(const BlackboxSample *sample) {
+  uint64_t packed = 0;
+  packed |= static_cast<uint64_t>(constrain((sample->targetKpaQ8 + 64) >> 7, 0L, 255L));
+  packed |= static_cast<uint64_t>(constrain((sample->actualKpaQ8 + 16) >> 5, -2048L, 2047L) & 0xFFF) << 8;
+  packed |= static_cast<uint64_t>(constrain(sample->valveRaw, 0, 1023)) << 20;
+  packed |= static_cast<uint64_t>(constrain((sample->valveOpenPercentageQ8 + 64) >> 7, 0L, 255L)) << 30;
+  packed |= static_cast<uint64_t>(constrain((sample->motorCommandQ8 + 128) >> 8, -128L, 127L) & 0xFF) << 38;
+  packed |= static_cast<uint64_t>(sample->controlMode & 0x03) << 46;
+  packed |= static_cast<uint64_t>(constrain(sample->rpm / 8, 0, 1023)) << 48;
+  packed |= static_cast<uint64_t>(constrain(sample->gear, 0, 7)) << 58;
+  packed |= static_cast<uint64_t>(sample->clutchPressed ? 1 : 0) << 61;
+  packed |= static_cast<uint64_t>(sample->alarmCritical ? 1 : 0) << 62;
+  return packed;
+}
+
+/* ======================================================================
+   FUNCTION: Record a sample, called from the control tick every tick
+   ====================================================================== */
+// Freezes automatically once the post trigger window has been recorded after a new critical fault. Warnings (serial
+// quality, tick overrun, heap allocation and the like) come and go too often and would freeze the ring when nothing
+// happened to the valve, so the caller passes the critical faults only (getCriticalFaultBitmask()).
+void blackboxRecordSample(const BlackboxSample *sample, unsigned long criticalFaultBitmask) {
+  // Trigger on any critical fault bit that wasn't set last tick, or a manual trigger from the background
+  unsigned long newFaults = criticalFaultBitmask & ~blackboxPreviousFaultBitmask;
+  blackboxPreviousFaultBitmask = criticalFaultBitmask;
+  if (blackboxState == BLACKBOX_FROZEN) {
+    return;
+  }
+
+  if (blackboxState == BLACKBOX_RECORDING && (newFaults != 0 || blackboxTriggerRequested)) {
+    blackboxTriggerCode = (newFaults != 0) ? __builtin_ctzl(newFaults) : blackboxTriggerManual;
+    blackboxTriggerMillis = halMillis();
+    blackboxPostTriggerRemaining = blackboxPostTriggerRecords;
+    blackboxTriggerRequested = false;
+    blackboxState = BLACKBOX_TRIGGERED;
+  }
+
+  if (++blackboxTickCount < blackboxRecordEveryTicks) {
+    return;
+  }
+  blackboxTickCount = 0;
+
+  blackboxRecords[blackboxNextIndex] = packBlackboxSample(sample);
+  blackboxNextIndex = (blackboxNextIndex + 1) % BLACKBOX_RECORDS;
+  if (blackboxNextIndex == 0) {
+    blackboxWrapped = true;
+  }
+
+  if (blackboxState == BLACKBOX_TRIGGERED && --blackboxPostTriggerRemaining <= 0) {
+    blackboxState = BLACKBOX_FROZEN;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Manually trigger a capture (actioned on the next control tick)
+   ====================================================================== */
+void triggerBlackbox() {
+  blackboxTriggerRequested = true;
+}
+
+BlackboxState getBlackboxState() {
+  return blackboxState;
+}
+
+/* ======================================================================
+   FUNCTION: Send a line of the dump to serial or MQTT
+   ====================================================================== */
+bool sendBlackboxDumpLine(const char *line) {
+#if PLATFORM_HAS_NETWORK
+  if (blackboxDumpTarget == BLACKBOX_DUMP_MQTT) {
+    return publishMqttText("blackbox", line);
+  }
+#endif
+  if (getSerialWriteRoom() < static_cast<int>(strlen(line)) + 2) {
+    return false; // Try again next loop rather than block
+  }
+  spendSerialWriteRoom(Serial.println(line));
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Once frozen, stream the buffer a line at a time then start recording again
+   ====================================================================== */
+// Format is #BH,<trigger ms>,<trigger code>,<record period us>,<record count>,<post trigger records>, then #B<hex> lines of packed records
+// oldest first, then #BE. Decode with tools/blackboxDecode.py.
+void serviceBlackboxDump(BlackboxDumpTarget target) {
+  static char line[8 + blackboxDumpRecordsPerLine * 16];
+
+  if (blackboxState != BLACKBOX_FROZEN) {
+    return;
+  }
+  if (!blackboxDumpInProgress) {
+    blackboxDumpTarget = target;
+    blackboxDumpPosition = -1;
+    blackboxDumpInProgress = true;
+  }
+
+  int recordCount = blackboxWrapped ? BLACKBOX_RECORDS : blackboxNextIndex;
+  int oldestIndex = blackboxWrapped ? blackboxNextIndex : 0;
+
+  for (int lines = 0; lines < blackboxDumpLinesPerService; lines++) {
+    if (blackboxDumpPosition < 0) {
+      snprintf(line, sizeof(line), "#BH,%lu,%u,%d,%d,%d", blackboxTriggerMillis, blackboxTriggerCode, static_cast<int>(blackboxRecordPeriodMicros), recordCount, blackboxPostTriggerRecords);
+      if (!sendBlackboxDumpLine(line)) {
+        return;
+      }
+      blackboxDumpPosition = 0;
+      continue;
+    }
+
+    if (blackboxDumpPosition >= recordCount) {
+      if (!sendBlackboxDumpLine("#BE")) {
+        return;
+      }
+      // Dump complete, start recording afresh
+      blackboxDumpInProgress = false;
+      blackboxNextIndex = 0;
+      blackboxWrapped = false;
+      blackboxState = BLACKBOX_RECORDING;
+      return;
+    }
+
+    int length = snprintf(line, sizeof(line), "#B");
+    int lineRecords = min(blackboxDumpRecordsPerLine, recordCount - blackboxDumpPosition);
+    for (int i = 0; i < lineRecords; i++) {
+      uint64_t packed = blackboxRecords[(oldestIndex + blackboxDumpPosition + i) % BLACKBOX_RECORDS];
+      length += snprintf(&line[length], sizeof(line) - length, "%08lX%08lX", static_cast<unsigned long>(packed >> 32), static_cast<unsigned long>(packed & 0xFFFFFFFF));
+    }
+    if (!sendBlackboxDumpLine(line)) {
+      return;
+    }
+    blackboxDumpPosition += lineRecords;
+  }
+}
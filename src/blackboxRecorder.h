@@ -0,0 +1,54 @@
+#ifndef BLACKBOXRECORDER_H
+#define BLACKBOXRECORDER_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   DEFINES: Blackbox size (8 bytes per record)
+   ====================================================================== */
+#ifndef BLACKBOX_RECORDS
+#define BLACKBOX_RECORDS 1536 // 12kB, a little over 3s at 500Hz
+#endif
+
+/* ======================================================================
+   ENUMS: Recorder state and dump destination
+   ====================================================================== */
+enum BlackboxState {
+  BLACKBOX_RECORDING, // Continuously overwriting the oldest record
+  BLACKBOX_TRIGGERED, // A critical fault was raised, still recording the post trigger window
+  BLACKBOX_FROZEN     // Buffer holds the pre and post trigger window, dumped then recording restarts
+};
+
+enum BlackboxDumpTarget {
+  BLACKBOX_DUMP_SERIAL,
+  BLACKBOX_DUMP_MQTT
+};
+
+/* ======================================================================
+   STRUCTURES: One control tick worth of state, unpacked
+   ====================================================================== */
+// Numbers are Q8 (value x 256, see ControlNumeric::toQ8) so the tick can fill and pack a sample with integer maths only
+struct BlackboxSample {
+  int32_t targetKpaQ8;
+  int32_t actualKpaQ8;
+  int valveRaw;
+  int32_t valveOpenPercentageQ8;
+  int32_t motorCommandQ8;
+  byte controlMode;
+  int rpm;
+  int gear;
+  bool clutchPressed;
+  bool alarmCritical;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void setBlackboxPostTriggerRecords(int);
+void blackboxRecordSample(const BlackboxSample *, unsigned long);
+void triggerBlackbox();
+BlackboxState getBlackboxState();
+void serviceBlackboxDump(BlackboxDumpTarget);
+uint64_t packBlackboxSample(const BlackboxSample *);
+
+#endif
@@ -0,0 +1,490 @@
+#include "boostController.h"
+#include "controlNumeric.h"
+#include "cytronMotorDriver.h"
+#include "globalHelpers.h"
+
+/* ======================================================================
+   VARIABLES: PID Tuning parameters for valve motor control
+   ====================================================================== */
+// Pressure gains are where every channel starts, changed from then on through ControlInputs
+const double defaultPressureKp = 9.0; // Proportional term
+const double defaultPressureKi = 3.3; // Integral term
+const double defaultPressureKd = 1.3; // Derivative term
+
+const double PositionKp = 2.5; // Proportional term
+const double PositionKi = 5.0; // Integral term
+const double PositionKd = 0.0; // Derivative term
+
+const int maximumReverseMotorSpeed = -60; // This is also hard coded in the setBoostValveTravelLimits function. This is closing the valve against the spring.
+const int maximumForwardMotorSpeed = 40;  // This is also hard coded in the setBoostValveTravelLimits function This is opening the valve with the spring.
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+typedef ControlNumeric::Value ControlValue; // double on the R4, Q16.16 on the Mega, see controlNumeric.h
+
+// Compressor pressure ratio protection. The target is held to whatever manifold pressure gives the ceiling ratio, less
+// however far the ratio is set to climb over the lookahead when that climb would take it through the ceiling.
+const ControlValue pressureRatioLookaheadSeconds = ControlNumeric::fromDouble(0.2);
+const ControlValue pressureRatioFilterFactor = ControlNumeric::fromDouble(0.125);     // Per tick, ~8 tick time constant
+const ControlValue pressureRatioRateFilterFactor = ControlNumeric::fromDouble(0.03125); // Per tick, ~32 tick time constant
+const ControlValue intakePressureMinimumPlausibleKpa = ControlNumeric::fromInt(50);  // Open circuit or shorted sensor reads well outside these
+const ControlValue intakePressureMaximumPlausibleKpa = ControlNumeric::fromInt(130); // The intake never sees boost
+const ControlValue controlTickFrequency = ControlNumeric::fromDouble(TargetPlatform::controlTickFrequencyHz);
+
+// Both PIDs compute every tick rather than at PID_v1's default 100ms. The gains are per second so they carry over, but
+// derivative on measurement over one tick turns a single count of ADC noise into a full scale motor kick. The pressure
+// PID works from the manifold reading through a ~40ms low pass instead, short against the manifold's own ~100ms lag.
+const int pidSampleTimeMillis = 1000 / TargetPlatform::controlTickFrequencyHz;
+const ControlValue pressurePidInputFilterFactor = ControlNumeric::fromDouble(1.0 / (0.04 * TargetPlatform::controlTickFrequencyHz)); // Per tick
+
+// Overboost protection, evaluated every tick. The limit is the target plus the allowance for its band, and the valve is
+// driven fully open as soon as the manifold pressure plus its filtered rate of rise over the lookahead would cross it.
+// Protection releases once the pressure is back under the target and the prediction under the limit less the hysteresis.
+// Over the limit for longer than the band's dwell counts as an overboost event for the fault manager. Bands are searched in order, the last
+// catches everything above. Change the table to suit, at startup only (the tick reads it).
+struct OverboostBand {
+  ControlValue targetUpToKpa;
+  ControlValue allowanceKpa;  // Above the target, absolute rather than a multiple so a 0kPa target isn't tripped by noise
+  ControlValue hysteresisKpa; // Prediction below the limit by this before fast open releases
+  unsigned int dwellMillis;   // Over the limit this long, less half the time back under, is an overboost event
+  unsigned int dwellTicks;    // Worked out from dwellMillis at startup
+};
+
+OverboostBand overboostBands[] = {
+    {ControlNumeric::fromInt(5), ControlNumeric::fromInt(15), ControlNumeric::fromInt(5), 1000, 0}, // Target of 0, valve already heading open
+    {ControlNumeric::fromInt(35), ControlNumeric::fromInt(8), ControlNumeric::fromInt(3), 500, 0},
+    {ControlNumeric::fromInt(1000), ControlNumeric::fromInt(6), ControlNumeric::fromInt(2), 250, 0}};
+const int overboostBandCount = sizeof(overboostBands) / sizeof(overboostBands[0]);
+
+const ControlValue overboostLookaheadSeconds = ControlNumeric::fromDouble(0.25); // Well past the fast open latency, ~75ms in the plant model
+const int overboostFastOpenMotorSpeed = 100; // With the spring, beyond the PIDs' limit so the valve opens in half the time
+const ControlValue overboostPressureFilterFactor = ControlNumeric::fromDouble(0.125); // Per tick, ~8 tick time constant
+const ControlValue overboostRateFilterFactor = ControlNumeric::fromDouble(0.0625);    // Per tick, ~16 tick time constant
+const ControlValue overboostReferenceFallPerTick = ControlNumeric::fromDouble(100.0 / TargetPlatform::controlTickFrequencyHz); // 100kPa/s
+const ControlValue overboostValveOpenedPercentage = ControlNumeric::fromInt(25); // Fast open latency is to the valve opening this much further
+const unsigned long controlTickPeriodMicros = lround(1000000.0 / TargetPlatform::controlTickFrequencyHz);
+
+// Driving event pre-positioning. While the pressure PID holds the target, the motor effort it settles on (against the
+// spring) is learned per gear. A driving event comes with its new target straight away, the valve is started flat out
+// on that tick rather than at the position PID's next sample, and the pressure PID's integral is preloaded with the
+// gear's learned effort when it takes over instead of whatever it was left with last time.
+const ControlValue holdingBandKpa = ControlNumeric::fromInt(2);                  // Within this of target counts as holding
+const ControlValue holdingLearnFactor = ControlNumeric::fromDouble(1.0 / 256.0); // Per tick
+const unsigned int holdingTrustTicks = lround(0.5 * TargetPlatform::controlTickFrequencyHz); // Held this long before it is used
+
+const ControlValue valvePositionToPressureControlTransitionFactor = ControlNumeric::fromDouble(0.8);
+
+// The valve the board has today, what initBoostController() and runBoostController() drive
+BoostChannel primaryBoostChannel(&primaryBoostChannelPins);
+
+/* ======================================================================
+   FUNCTION: Set up a channel's PIDs against its own state
+   ====================================================================== */
+BoostChannel::BoostChannel(const BoostChannelPins *channelPins)
+    : pins(*channelPins),
+      boostValvePressurePID(&pressurePidInputKpa, &currentBoostValveMotorSpeed, &currentControlTargetBoostKpa, defaultPressureKp, defaultPressureKi,
+                            defaultPressureKd, REVERSE),
+      boostValvePositionPID(&currentBoostValveOpenPercentage, &currentBoostValveMotorSpeed, &currentTargetBoostValveOpenPercentage, PositionKp, PositionKi,
+                            PositionKd, DIRECT) {
+}
+
+/* ======================================================================
+   FUNCTION: Take the startup calibration and hand back the starting inputs
+   ====================================================================== */
+void BoostChannel::begin(int valveMinimumRaw, int valveMaximumRaw, float manifoldOffsetRaw, ControlInputs *inputs) {
+  valveTravelMinimumRaw = valveMinimumRaw;
+  valveTravelMaximumRaw = valveMaximumRaw;
+  setManifoldAtmosphericOffset(lroundf(manifoldOffsetRaw));
+  currentIntakePressureAbsoluteKpa = manifoldAtmosphericKpa;
+
+  for (int i = 0; i < overboostBandCount; i++) {
+    overboostBands[i].dwellTicks = static_cast<unsigned long>(overboostBands[i].dwellMillis) * 1000 / controlTickPeriodMicros;
+  }
+  overboostProtectionActive = false;
+  overboostDetected = false;
+  overboostDwellCount = 0;
+  overboostFastOpenTimed = true;
+  for (int gear = 0; gear <= holdingGearCount; gear++) {
+    holdingMotorSpeedByGear[gear] = 0;
+    holdingTicksByGear[gear] = 0;
+  }
+  pressurePidPreloadPending = false;
+  pressurePidPreloaded = false;
+
+  // Initialize the PID controller and set the motor speed limits
+  boostValvePressurePID.SetMode(AUTOMATIC);
+  boostValvePressurePID.SetOutputLimits(maximumReverseMotorSpeed, maximumForwardMotorSpeed);
+  boostValvePressurePID.SetSampleTime(pidSampleTimeMillis);
+
+  boostValvePositionPID.SetMode(AUTOMATIC);
+  boostValvePositionPID.SetOutputLimits(maximumReverseMotorSpeed, maximumForwardMotorSpeed);
+  boostValvePositionPID.SetSampleTime(pidSampleTimeMillis);
+
+  shadowController.begin(maximumReverseMotorSpeed, maximumForwardMotorSpeed, pidSampleTimeMillis);
+
+  inputs->pressureKp = defaultPressureKp;
+  inputs->pressureKi = defaultPressureKi;
+  inputs->pressureKd = defaultPressureKd;
+  inputs->manifoldAtmosphericOffsetRaw = manifoldAtmosphericOffsetRaw;
+  inputs->shadowCandidate.pressureKp = defaultPressureKp; // Shadow starts off with the live gains, but disabled
+  inputs->shadowCandidate.pressureKi = defaultPressureKi;
+  inputs->shadowCandidate.pressureKd = defaultPressureKd;
+  convertControlInputs(inputs);
+  pressureTunings = inputs->pressureTunings;
+  ControlNumeric::setTunings(&boostValvePressurePID, &pressureTunings);
+}
+
+/* ======================================================================
+   FUNCTION: Atmospheric reference the manifold's gauge pressure is worked out from
+   ====================================================================== */
+void BoostChannel::setManifoldAtmosphericOffset(int offsetRaw) {
+  manifoldAtmosphericOffsetRaw = offsetRaw;
+  manifoldAtmosphericKpa = ControlNumeric::kpaFromRaw(manifoldAtmosphericOffsetRaw);
+  manifoldGaugeToAbsoluteKpa = manifoldAtmosphericKpa - ControlNumeric::kpaFromRaw(0);
+}
+
+/* ======================================================================
+   FUNCTION: Averaged reading of a sensor that picks up the motor's switching noise
+   ====================================================================== */
+// Valve position and manifold pressure, each conversion started at the quiet point of the channel's motor PWM
+int BoostChannel::readMotorNoiseSensitivePin(byte pin) {
+  if (pins.motor == nullptr) {
+    return getAveragedAnaloguePinReading(pin, TargetPlatform::controlTickAnalogueSamples, 0);
+  }
+  return getPwmSyncedAnaloguePinReading(pin, pins.motor->pwmPin, TargetPlatform::controlTickPwmSyncedSamples);
+}
+
+/* ======================================================================
+   FUNCTION: Compressor pressure ratio, its trend, and the target it allows
+   ====================================================================== */
+// Returns the target to drive to, the requested one unless the ratio ceiling (or the ratio heading for it) says lower.
+// Never below 0, where the controller simply opens the valve.
+ControlValue BoostChannel::limitTargetByPressureRatio(ControlValue requestedTargetKpa) {
+  ControlValue intakeKpa = intakePressurePlausible ? currentIntakePressureAbsoluteKpa : manifoldAtmosphericKpa;
+  ControlValue manifoldAbsoluteKpa = currentManifoldPressureGaugeKpa + manifoldGaugeToAbsoluteKpa;
+
+  ControlValue ratio = ControlNumeric::divide(manifoldAbsoluteKpa, intakeKpa);
+  ControlValue previousRatio = currentPressureRatio;
+  currentPressureRatio += ControlNumeric::multiply(ratio - currentPressureRatio, pressureRatioFilterFactor);
+  ControlValue rate = ControlNumeric::multiply(currentPressureRatio - previousRatio, controlTickFrequency);
+  currentPressureRatioRate += ControlNumeric::multiply(rate - currentPressureRatioRate, pressureRatioRateFilterFactor);
+
+  // Heading through the ceiling within the lookahead, hold the target back by the climb still to come
+  ControlValue allowedRatio = currentPressureRatioCeiling;
+  ControlValue lookaheadClimb = ControlNumeric::multiply(currentPressureRatioRate, pressureRatioLookaheadSeconds);
+  if (lookaheadClimb > 0 && currentPressureRatio + lookaheadClimb > currentPressureRatioCeiling) {
+    allowedRatio -= lookaheadClimb;
+  }
+  ControlValue allowedTargetKpa = ControlNumeric::multiply(allowedRatio, intakeKpa) - manifoldGaugeToAbsoluteKpa;
+  if (allowedTargetKpa < 0) {
+    allowedTargetKpa = 0;
+  }
+
+  pressureRatioLimitActive = (requestedTargetKpa > allowedTargetKpa);
+  return pressureRatioLimitActive ? allowedTargetKpa : requestedTargetKpa;
+}
+
+/* ======================================================================
+   FUNCTION: Overboost limit, prediction and fast open, returns true while the valve is being forced open
+   ====================================================================== */
+// Constant time, a band lookup over a three entry table and a handful of multiplies. The reference the limit is worked
+// from jumps up with the target but falls at 100kPa/s, so the pressure left over when the target drops (a gear change, the
+// clutch going in) has time to blow off before it counts against the lower limit.
+bool BoostChannel::updateOverboostProtection(int gear) {
+  ControlValue previousFilteredKpa = overboostFilteredPressureKpa;
+  overboostFilteredPressureKpa += ControlNumeric::multiply(currentManifoldPressureGaugeKpa - overboostFilteredPressureKpa, overboostPressureFilterFactor);
+  ControlValue rate = ControlNumeric::multiply(overboostFilteredPressureKpa - previousFilteredKpa, controlTickFrequency);
+  overboostPressureRate += ControlNumeric::multiply(rate - overboostPressureRate, overboostRateFilterFactor);
+
+  // Against the requested target, the pressure ratio limit pulling the target down is not an overboost
+  if (currentTargetBoostKpa >= overboostReferenceKpa - overboostReferenceFallPerTick) {
+    overboostReferenceKpa = currentTargetBoostKpa;
+  } else {
+    overboostReferenceKpa -= overboostReferenceFallPerTick;
+  }
+
+  const OverboostBand *band = &overboostBands[overboostBandCount - 1];
+  for (int i = 0; i < overboostBandCount - 1; i++) {
+    if (overboostReferenceKpa <= overboostBands[i].targetUpToKpa) {
+      band = &overboostBands[i];
+      break;
+    }
+  }
+  overboostLimitKpa = overboostReferenceKpa + band->allowanceKpa;
+
+  ControlValue predictedKpa = currentManifoldPressureGaugeKpa;
+  if (overboostPressureRate > 0) {
+    predictedKpa += ControlNumeric::multiply(overboostPressureRate, overboostLookaheadSeconds);
+  }
+
+  // Fast open on the prediction. Only armed above the target, below it a fast rise is just the valve closing to spool up
+  // and the pressure PID will ease it off. Held until the reading is back under the target and the prediction under the
+  // limit less the hysteresis, so it can't let go while the pressure is still on its way down from the peak.
+  if (!overboostProtectionActive && currentManifoldPressureGaugeKpa > overboostReferenceKpa && predictedKpa > overboostLimitKpa) {
+    overboostProtectionActive = true;
+    overboostTicksSinceFastOpen = 0;
+    overboostFastOpenTimed = false;
+    overboostOpenedAtPercentage = currentBoostValveOpenPercentage + overboostValveOpenedPercentage;
+    if (overboostOpenedAtPercentage > ControlNumeric::fromInt(100)) {
+      overboostOpenedAtPercentage = ControlNumeric::fromInt(100);
+    }
+    overboostReleaseMotorSpeed = currentBoostValveMotorSpeed;
+  } else if (overboostProtectionActive && currentManifoldPressureGaugeKpa < overboostReferenceKpa && predictedKpa < overboostLimitKpa - band->hysteresisKpa) {
+    overboostProtectionActive = false;
+    // Hand back bumplessly. Both PIDs start from the effort that holds this gear's target if it has been learned, or the
+    // one the PIDs were giving when the fast open fired, with the current reading so the derivative doesn't kick
+    if (gear >= 1 && gear <= holdingGearCount && holdingTicksByGear[gear] >= holdingTrustTicks) {
+      overboostReleaseMotorSpeed = holdingMotorSpeedByGear[gear];
+    }
+    currentBoostValveMotorSpeed = overboostReleaseMotorSpeed;
+    boostValvePressurePID.SetMode(MANUAL);
+    boostValvePressurePID.SetMode(AUTOMATIC);
+    boostValvePositionPID.SetMode(MANUAL);
+    boostValvePositionPID.SetMode(AUTOMATIC);
+  }
+
+  // Detection to valve open latency, for the last trigger
+  if (!overboostFastOpenTimed) {
+    overboostTicksSinceFastOpen++;
+    if (currentBoostValveOpenPercentage >= overboostOpenedAtPercentage) {
+      overboostOpenLatencyTicks = overboostTicksSinceFastOpen;
+      overboostFastOpenTimed = true;
+    }
+  }
+
+  // Over the limit for longer than the dwell is an event for the fault manager. Ticks over fill the count by two and
+  // ticks under drain it by one, so pressure hovering around the limit still adds up while a brief spike well apart
+  // from the next one doesn't.
+  unsigned int dwellFullCount = 2 * band->dwellTicks;
+  if (currentManifoldPressureGaugeKpa > overboostLimitKpa) {
+    overboostDwellCount = min(overboostDwellCount + 2, dwellFullCount);
+    if (overboostDwellCount >= dwellFullCount && !overboostDetected) {
+      overboostDetected = true;
+      overboostEventCount++;
+    }
+  } else if (overboostDwellCount > 0) {
+    overboostDwellCount--;
+  } else if (currentManifoldPressureGaugeKpa < overboostLimitKpa - band->hysteresisKpa) {
+    overboostDetected = false;
+  }
+
+  return overboostProtectionActive;
+}
+
+/* ======================================================================
+   FUNCTION: Start the valve for a target that came with a driving event
+   ====================================================================== */
+// Still short of the point the pressure PID takes over, the position PID is headed for fully closed anyway, so the motor
+// goes flat out from this tick and the PID carries on from there at its next sample. The pressure PID is preloaded later,
+// at the handover, so its derivative starts from the pressure at that point.
+void BoostChannel::prepositionForDrivingEvent(int gear) {
+  pressurePidPreloaded = false;
+  pressurePidPreloadPending = (gear >= 1 && gear <= holdingGearCount && holdingTicksByGear[gear] >= holdingTrustTicks);
+  if (pressurePidPreloadPending) {
+    pressurePidPreloadMotorSpeed = holdingMotorSpeedByGear[gear];
+  }
+
+  if (currentControlTargetBoostKpa > 0 && currentManifoldPressureGaugeKpa < ControlNumeric::multiply(currentControlTargetBoostKpa, valvePositionToPressureControlTransitionFactor)) {
+    currentBoostValveMotorSpeed = ControlNumeric::fromInt(maximumReverseMotorSpeed);
+    boostValvePositionPID.SetMode(MANUAL);
+    boostValvePositionPID.SetMode(AUTOMATIC);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Learn the motor effort that holds the target in this gear
+   ====================================================================== */
+void BoostChannel::learnHoldingMotorSpeed(int gear) {
+  ControlValue error = currentManifoldPressureGaugeKpa - currentControlTargetBoostKpa;
+  if (gear < 1 || gear > holdingGearCount || error > holdingBandKpa || error < -holdingBandKpa) {
+    return;
+  }
+  if (holdingTicksByGear[gear] == 0) {
+    holdingMotorSpeedByGear[gear] = currentBoostValveMotorSpeed;
+  } else {
+    holdingMotorSpeedByGear[gear] += ControlNumeric::multiply(currentBoostValveMotorSpeed - holdingMotorSpeedByGear[gear], holdingLearnFactor);
+  }
+  if (holdingTicksByGear[gear] < holdingTrustTicks) {
+    holdingTicksByGear[gear]++;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: One control step, sensor sample -> PID -> motor output
+   ====================================================================== */
+// Called from the control tick interrupt on the board and from the replay runner on the host, so it must not print,
+// allocate or block. Sensors are read through the HAL, so a replay only has to set the ADC inputs.
+void BoostChannel::step(const ControlInputs *inputs, ControlOutputs *outputs) {
+  currentTargetBoostKpa = inputs->targetBoostKpaValue;
+  currentPressureRatioCeiling = inputs->pressureRatioCeilingValue;
+
+  // Apply any tuning change at the tick boundary so the PID never computes with a half updated set of gains
+  if (controlInputChanged(&inputs->pressureTunings, &pressureTunings)) {
+    pressureTunings = inputs->pressureTunings;
+    ControlNumeric::setTunings(&boostValvePressurePID, &pressureTunings);
+  }
+  if (inputs->manifoldAtmosphericOffsetRaw != manifoldAtmosphericOffsetRaw) {
+    setManifoldAtmosphericOffset(inputs->manifoldAtmosphericOffsetRaw);
+  }
+
+  // Get the current boost valve blade position as a raw reading and update percentage
+  currentBoostValvePositionReadingRaw = readMotorNoiseSensitivePin(pins.valvePositionPin);
+  currentBoostValveOpenPercentage = ControlNumeric::openPercentage(&currentBoostValvePositionReadingRaw, &valveTravelMinimumRaw, &valveTravelMaximumRaw);
+
+  // Get the current manifold pressure as raw sensor reading (0-1023) and convert to kPa gauge
+  currentManifoldPressureAbsoluteRaw = readMotorNoiseSensitivePin(pins.manifoldPressurePin);
+  currentManifoldPressureGaugeKpa = ControlNumeric::kpaFromRaw(currentManifoldPressureAbsoluteRaw - manifoldAtmosphericOffsetRaw);
+  pressurePidInputKpa += ControlNumeric::multiply(currentManifoldPressureGaugeKpa - pressurePidInputKpa, pressurePidInputFilterFactor);
+
+  // Intake pressure (before the supercharger) as absolute kPa, and the compressor pressure ratio from it
+  currentIntakePressureAbsoluteRaw = getAveragedAnaloguePinReading(pins.intakePressurePin, TargetPlatform::controlTickIntakeSamples, 0);
+  currentIntakePressureAbsoluteKpa = ControlNumeric::kpaFromRaw(currentIntakePressureAbsoluteRaw);
+  intakePressurePlausible = (currentIntakePressureAbsoluteKpa >= intakePressureMinimumPlausibleKpa && currentIntakePressureAbsoluteKpa <= intakePressureMaximumPlausibleKpa);
+  currentControlTargetBoostKpa = limitTargetByPressureRatio(currentTargetBoostKpa);
+  bool forceValveOpen = updateOverboostProtection(inputs->vehicleGear);
+
+  // A driving event came with this target, get the valve going for it now
+  if (inputs->prepositionSequence != appliedPrepositionSequence) {
+    appliedPrepositionSequence = inputs->prepositionSequence;
+    if (!inputs->alarmCritical && !forceValveOpen) {
+      prepositionForDrivingEvent(inputs->vehicleGear);
+    }
+  }
+
+  // Update PID valve control to drive to target boost or position as needed
+  // If critical alarm is set, stop the motor and let the return spring open the valve to 'fail safe'
+  ControlMode controlMode = CONTROL_MODE_POSITION;
+  if (inputs->alarmCritical) {
+    controlMode = CONTROL_MODE_FAIL_SAFE;
+    ControlNumeric::driveMotor(pins.motor, 0);
+  } else if (forceValveOpen) {
+    // Flat out with the spring, then let the spring hold it once it's at the open stop
+    controlMode = CONTROL_MODE_OVERBOOST_OPEN;
+    currentTargetBoostValveOpenPercentage = ControlNumeric::fromInt(100);
+    currentBoostValveMotorSpeed = (currentBoostValvePositionReadingRaw >= valveTravelMaximumRaw) ? 0 : ControlNumeric::fromInt(overboostFastOpenMotorSpeed);
+    ControlNumeric::driveMotor(pins.motor, currentBoostValveMotorSpeed);
+  } else if (currentControlTargetBoostKpa == 0) {
+    currentTargetBoostValveOpenPercentage = ControlNumeric::fromInt(100);
+    pressurePidPreloadPending = false; // The event's target has gone again (clutch back in) before pressure control took over
+    if (usingPressureControl) {
+      usingPositionControl = true;
+      usingPressureControl = false;
+    }
+    driveBoostValveToTargetByOpenPercentagePid<ControlNumeric>(pins.motor, &boostValvePositionPID, &currentBoostValveOpenPercentage, &currentBoostValveMotorSpeed, &currentTargetBoostValveOpenPercentage);
+  } else if (currentControlTargetBoostKpa > 0) {
+    if (currentManifoldPressureGaugeKpa < ControlNumeric::multiply(currentControlTargetBoostKpa, valvePositionToPressureControlTransitionFactor)) {
+      currentTargetBoostValveOpenPercentage = 0;
+      if (usingPressureControl) {
+        usingPositionControl = true;
+        usingPressureControl = false;
+      }
+      driveBoostValveToTargetByOpenPercentagePid<ControlNumeric>(pins.motor, &boostValvePositionPID, &currentBoostValveOpenPercentage, &currentBoostValveMotorSpeed, &currentTargetBoostValveOpenPercentage);
+    } else {
+      controlMode = CONTROL_MODE_PRESSURE;
+      if (usingPositionControl) {
+        usingPositionControl = false;
+        usingPressureControl = true;
+      }
+      if (pressurePidPreloadPending) {
+        // First pressure control since a driving event, the integral starts from the effort that held this gear's target
+        currentBoostValveMotorSpeed = pressurePidPreloadMotorSpeed;
+        boostValvePressurePID.SetMode(MANUAL);
+        boostValvePressurePID.SetMode(AUTOMATIC);
+        pressurePidPreloadPending = false;
+        pressurePidPreloaded = true;
+      }
+      driveBoostValveToTargetByPressurePid<ControlNumeric>(pins.motor, &boostValvePressurePID, &currentBoostValveMotorSpeed, &valveTravelMinimumRaw, &valveTravelMaximumRaw, &currentBoostValvePositionReadingRaw);
+      learnHoldingMotorSpeed(inputs->vehicleGear);
+    }
+  }
+
+  // Step response metrics, the record is only written on the tick an event completes
+  updateBoostEventTracker(&boostEventTracker, inputs, currentTargetBoostKpa, currentControlTargetBoostKpa, currentManifoldPressureGaugeKpa, &outputs->lastBoostEvent);
+
+  // Candidate gains against the model, the stretch is likewise only written on the tick one completes
+  shadowController.step(inputs, controlMode == CONTROL_MODE_PRESSURE, currentControlTargetBoostKpa, currentManifoldPressureGaugeKpa,
+                        currentBoostValveOpenPercentage, currentBoostValveMotorSpeed, &outputs->lastShadowStretch);
+
+  outputs->manifoldPressureGaugeKpa = currentManifoldPressureGaugeKpa;
+  outputs->intakePressureAbsoluteKpa = intakePressurePlausible ? currentIntakePressureAbsoluteKpa : manifoldAtmosphericKpa;
+  outputs->pressureRatio = currentPressureRatio;
+  outputs->pressureRatioRatePerSecond = currentPressureRatioRate;
+  outputs->targetBoostKpa = currentTargetBoostKpa;
+  outputs->controlTargetBoostKpa = currentControlTargetBoostKpa;
+  outputs->boostValveOpenPercentage = currentBoostValveOpenPercentage;
+  outputs->targetBoostValveOpenPercentage = currentTargetBoostValveOpenPercentage;
+  outputs->boostValveMotorSpeed = currentBoostValveMotorSpeed;
+  outputs->boostValvePositionReadingRaw = currentBoostValvePositionReadingRaw;
+  outputs->manifoldPressureAbsoluteRaw = currentManifoldPressureAbsoluteRaw;
+  outputs->intakePressureAbsoluteRaw = currentIntakePressureAbsoluteRaw;
+  outputs->intakePressurePlausible = intakePressurePlausible;
+  outputs->pressureRatioLimitActive = pressureRatioLimitActive;
+  outputs->usingPressureControl = usingPressureControl;
+  outputs->controlMode = controlMode;
+  outputs->manifoldPressureRatePerSecond = overboostPressureRate;
+  outputs->overboostLimitKpa = overboostLimitKpa;
+  outputs->overboostProtectionActive = overboostProtectionActive;
+  outputs->overboostDetected = overboostDetected;
+  outputs->overboostEventCount = overboostEventCount;
+  outputs->overboostOpenLatencyTicks = overboostOpenLatencyTicks;
+  outputs->appliedCommandSequence = inputs->commandSequence;
+  bool holdingLearned = (inputs->vehicleGear >= 1 && inputs->vehicleGear <= holdingGearCount && holdingTicksByGear[inputs->vehicleGear] >= holdingTrustTicks);
+  outputs->holdingMotorSpeed = holdingLearned ? holdingMotorSpeedByGear[inputs->vehicleGear] : 0;
+  outputs->pressurePidPreloaded = pressurePidPreloaded;
+  outputs->boostEventCount = boostEventTracker.completedCount;
+  outputs->shadowStretchCount = shadowController.getCompletedStretches();
+}
+
+/* ======================================================================
+   FUNCTION: Convert the target and gains for the tick, background only
+   ====================================================================== */
+// Call after changing any of the doubles in the inputs and before publishing them, the tick only reads the converted copies
+void convertControlInputs(ControlInputs *inputs) {
+  inputs->targetBoostKpaValue = ControlNumeric::fromDouble(inputs->targetBoostKpa);
+  inputs->pressureRatioCeilingValue = ControlNumeric::fromDouble(inputs->pressureRatioCeiling);
+  inputs->pressureTunings = ControlNumeric::scaleTunings(inputs->pressureKp, inputs->pressureKi, inputs->pressureKd, pidSampleTimeMillis);
+  ShadowCandidate *candidate = &inputs->shadowCandidate;
+  candidate->tunings = ControlNumeric::scaleTunings(candidate->pressureKp, candidate->pressureKi, candidate->pressureKd, pidSampleTimeMillis);
+}
+
+/* ======================================================================
+   FUNCTION: Convert a tick's outputs to engineering units, background only
+   ====================================================================== */
+void convertControlOutputs(const ControlOutputs *outputs, ControlReadings *readings) {
+  readings->manifoldPressureGaugeKpa = ControlNumeric::toDouble(outputs->manifoldPressureGaugeKpa);
+  readings->intakePressureAbsoluteKpa = ControlNumeric::toDouble(outputs->intakePressureAbsoluteKpa);
+  readings->pressureRatio = ControlNumeric::toDouble(outputs->pressureRatio);
+  readings->pressureRatioRatePerSecond = ControlNumeric::toDouble(outputs->pressureRatioRatePerSecond);
+  readings->manifoldPressureRatePerSecond = ControlNumeric::toDouble(outputs->manifoldPressureRatePerSecond);
+  readings->overboostLimitKpa = ControlNumeric::toDouble(outputs->overboostLimitKpa);
+  readings->overboostOpenLatencyMillis = outputs->overboostOpenLatencyTicks * controlTickPeriodMicros / 1000.0;
+  readings->targetBoostKpa = ControlNumeric::toDouble(outputs->targetBoostKpa);
+  readings->controlTargetBoostKpa = ControlNumeric::toDouble(outputs->controlTargetBoostKpa);
+  readings->boostValveOpenPercentage = ControlNumeric::toDouble(outputs->boostValveOpenPercentage);
+  readings->targetBoostValveOpenPercentage = ControlNumeric::toDouble(outputs->targetBoostValveOpenPercentage);
+  readings->boostValveMotorSpeed = ControlNumeric::toDouble(outputs->boostValveMotorSpeed);
+  readings->holdingMotorSpeed = ControlNumeric::toDouble(outputs->holdingMotorSpeed);
+}
+
+/* ======================================================================
+   FUNCTION: Step every channel once, one set of inputs and outputs each
+   ====================================================================== */
+// In order, each channel reads its own sensors just before it drives its own valve. The tick cost grows by one channel's
+// worth per channel (see the runBoostChannels benchmarks).
+void runBoostChannels(BoostChannel *channels, int channelCount, const ControlInputs *inputs, ControlOutputs *outputs) {
+  for (int i = 0; i < channelCount; i++) {
+    channels[i].step(&inputs[i], &outputs[i]);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Single valve entry points, for the primary channel
+   ====================================================================== */
+void initBoostController(int valveMinimumRaw, int valveMaximumRaw, float manifoldOffsetRaw, ControlInputs *inputs) {
+  primaryBoostChannel.begin(valveMinimumRaw, valveMaximumRaw, manifoldOffsetRaw, inputs);
+}
+
+void runBoostController(const ControlInputs *inputs, ControlOutputs *outputs) {
+  primaryBoostChannel.step(inputs, outputs);
+}
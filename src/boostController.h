@@ -0,0 +1,204 @@
+#ifndef BOOSTCONTROLLER_H
+#define BOOSTCONTROLLER_H
+
+#include "boostEventMetrics.h"
+#include "boostValveControl.h"
+#include "controlNumeric.h"
+#include "shadowController.h"
+#include <Arduino.h>
+
+/* ======================================================================
+   VARIABLES: Pin constants for the sensors read every control tick
+   ====================================================================== */
+const byte boostValvePositionSignalPin = A0;
+const byte manifoldTmapSensorPressureSignalPin = A1;
+const byte intakeTmapSensorPressureSignalPin = A2; // Before the supercharger, for the compressor pressure ratio
+
+/* ======================================================================
+   STRUCTURES: Sensors and motor belonging to one boost channel
+   ====================================================================== */
+struct BoostChannelPins {
+  byte valvePositionPin;
+  byte manifoldPressurePin;
+  byte intakePressurePin;
+  const CytronMotor *motor; // nullptr works the output out without driving anything
+};
+
+const BoostChannelPins primaryBoostChannelPins = {boostValvePositionSignalPin, manifoldTmapSensorPressureSignalPin, intakeTmapSensorPressureSignalPin,
+                                                  &primaryCytronMotor};
+
+/* ======================================================================
+   STRUCTURES: State handed between the control tick and the background loop
+   ====================================================================== */
+// Everything the controller writes is owned by the control tick. The background only ever sees it via ControlOutputs,
+// and only ever changes what the tick does via ControlInputs. Each direction has exactly one writer.
+struct ControlInputs {
+  double targetBoostKpa = 0.0;
+  double pressureKp, pressureKi, pressureKd;
+  double pressureRatioCeiling = 2.0; // Manifold over intake absolute pressure the target is held under
+  bool alarmCritical = false;
+  int vehicleRpm = 0; // Master values are only needed by the tick for the blackbox
+  int vehicleGear = 0;
+  bool clutchPressed = true;
+  unsigned long commandSequence = 0; // Bumped for each remote command so the tick can confirm it has taken it on
+  unsigned long prepositionSequence = 0; // Bumped on a driving event (drivingEvents.h) along with the new target
+  ShadowCandidate shadowCandidate;       // Pressure PID gains being scored in shadow mode (shadowController.h)
+  int manifoldAtmosphericOffsetRaw = 0;  // Re-baselined from the background while the car is off boost (atmosphericBaseline.h)
+
+  // What the tick works from, filled in from the doubles above by convertControlInputs() before each publish
+  ControlNumeric::Value targetBoostKpaValue = 0;
+  ControlNumeric::Value pressureRatioCeilingValue = 0;
+  ControlNumeric::Tunings pressureTunings = ControlNumeric::Tunings();
+};
+
+// Numbers are left as the control core's ControlNumeric::Value so the tick never converts them, the background does that
+// with convertControlOutputs() into ControlReadings.
+struct ControlOutputs {
+  typedef ControlNumeric::Value Value;
+  Value manifoldPressureGaugeKpa;
+  Value intakePressureAbsoluteKpa;     // Boot atmospheric stands in while intakePressurePlausible is false
+  Value pressureRatio;                 // Compressor pressure ratio, manifold over intake absolute
+  Value pressureRatioRatePerSecond;    // Filtered
+  Value manifoldPressureRatePerSecond; // Filtered, kPa/s, what overboost protection predicts with
+  Value overboostLimitKpa;
+  unsigned long overboostOpenLatencyTicks; // Fast open trigger to the valve being 25% further open (or fully open), last trigger
+  Value targetBoostKpa;                    // As requested
+  Value controlTargetBoostKpa;             // What the valve is actually being driven to, after the pressure ratio limit
+  Value boostValveOpenPercentage;
+  Value targetBoostValveOpenPercentage;
+  Value boostValveMotorSpeed;
+  int boostValvePositionReadingRaw;
+  int manifoldPressureAbsoluteRaw;
+  int intakePressureAbsoluteRaw;
+  bool intakePressurePlausible;
+  bool pressureRatioLimitActive;
+  bool overboostProtectionActive; // Valve being forced open because the limit is about to be crossed
+  bool overboostDetected;         // Over the limit for longer than the dwell, until back under less the hysteresis
+  unsigned long overboostEventCount;
+  bool usingPressureControl;
+  ControlMode controlMode;
+  unsigned long appliedCommandSequence;
+  Value holdingMotorSpeed;       // Learned pressure PID output holding target in the current gear, 0 until learned
+  bool pressurePidPreloaded;     // Pressure PID took the learned holding effort at its last handover from position control
+  unsigned long boostEventCount; // Completed boost events, lastBoostEvent is the latest
+  BoostEventResult lastBoostEvent;
+  unsigned long shadowStretchCount; // Completed shadow stretches, lastShadowStretch is the latest
+  ShadowStretch lastShadowStretch;
+};
+
+// The numbers in ControlOutputs in engineering units, for logging, telemetry and the fault checks
+struct ControlReadings {
+  double manifoldPressureGaugeKpa;
+  double intakePressureAbsoluteKpa;
+  double pressureRatio;
+  double pressureRatioRatePerSecond;
+  double manifoldPressureRatePerSecond;
+  double overboostLimitKpa;
+  double overboostOpenLatencyMillis;
+  double targetBoostKpa;
+  double controlTargetBoostKpa;
+  double boostValveOpenPercentage;
+  double targetBoostValveOpenPercentage;
+  double boostValveMotorSpeed;
+  double holdingMotorSpeed;
+};
+
+/* ======================================================================
+   CLASS: One valve with its own sensors, calibration, PID pair, motor and fault state
+   ====================================================================== */
+// Everything a channel touches from the control tick is in here, so a second supercharger or a bypass valve is another
+// instance rather than another copy of the code. The PIDs point at the channel's own members, so a channel can't be
+// copied or moved once constructed. All of the maths is ControlNumeric, integer only in the fixed point build.
+class BoostChannel {
+public:
+  BoostChannel(const BoostChannelPins *);
+  BoostChannel(const BoostChannel &) = delete;
+  BoostChannel &operator=(const BoostChannel &) = delete;
+  void begin(int, int, float, ControlInputs *);
+  void step(const ControlInputs *, ControlOutputs *);
+
+private:
+  typedef ControlNumeric::Value Value;
+  static const int holdingGearCount = 6;
+
+  Value limitTargetByPressureRatio(Value);
+  bool updateOverboostProtection(int);
+  void prepositionForDrivingEvent(int);
+  void learnHoldingMotorSpeed(int);
+  void setManifoldAtmosphericOffset(int);
+  int readMotorNoiseSensitivePin(byte);
+
+  BoostChannelPins pins;
+
+  // Calibrated once at startup, before the control tick is running. The atmospheric offset is then followed from the
+  // background and taken on at a tick boundary like the gains.
+  int valveTravelMinimumRaw = 0, valveTravelMaximumRaw = 0;
+  int manifoldAtmosphericOffsetRaw = 0;
+  Value manifoldAtmosphericKpa = 0;     // Absolute, also stands in for the intake if its sensor is implausible
+  Value manifoldGaugeToAbsoluteKpa = 0; // Added to a gauge reading to get absolute
+
+  // Current gains, changed only at a tick boundary
+  ControlNumeric::Tunings pressureTunings;
+
+  // Sensors, targets and motor, only touched from the control tick
+  int currentManifoldPressureAbsoluteRaw = 0;
+  Value currentManifoldPressureGaugeKpa = 0;
+  Value pressurePidInputKpa = 0;
+  int currentIntakePressureAbsoluteRaw = 0;
+  Value currentIntakePressureAbsoluteKpa = 0;
+  bool intakePressurePlausible = false;
+  Value currentPressureRatio = ControlNumeric::fromInt(1);
+  Value currentPressureRatioRate = 0; // Per second
+  Value currentPressureRatioCeiling = 0;
+  bool pressureRatioLimitActive = false;
+  int currentBoostValvePositionReadingRaw = 0;
+  Value currentBoostValveMotorSpeed = 0;
+  Value currentBoostValveOpenPercentage = 0;
+  Value currentTargetBoostValveOpenPercentage = ControlNumeric::fromInt(100);
+  Value currentTargetBoostKpa = 0;
+  Value currentControlTargetBoostKpa = 0; // After the pressure ratio limit, the pressure PID's setpoint
+  bool usingPressureControl = false, usingPositionControl = false;
+
+  // Overboost protection
+  Value overboostFilteredPressureKpa = 0;
+  Value overboostPressureRate = 0; // kPa per second
+  Value overboostReferenceKpa = 0; // Target the limit is worked from, follows a falling target down at a limited rate
+  Value overboostLimitKpa = 0;
+  bool overboostProtectionActive = false;
+  bool overboostDetected = false;
+  unsigned int overboostDwellCount = 0; // Two per tick over the limit, less one per tick under
+  unsigned long overboostEventCount = 0;
+  unsigned long overboostTicksSinceFastOpen = 0;
+  bool overboostFastOpenTimed = true; // Valve has opened since the last trigger
+  Value overboostOpenedAtPercentage = 0;
+  unsigned long overboostOpenLatencyTicks = 0;
+  Value overboostReleaseMotorSpeed = 0; // What the PIDs restart from when protection releases
+
+  // Driving event pre-positioning
+  Value holdingMotorSpeedByGear[holdingGearCount + 1]; // Indexed by gear, neutral unused
+  unsigned int holdingTicksByGear[holdingGearCount + 1];
+  unsigned long appliedPrepositionSequence = 0;
+  bool pressurePidPreloadPending = false;
+  bool pressurePidPreloaded = false;
+  Value pressurePidPreloadMotorSpeed = 0;
+
+  // Step response of the current boost event (boostEventMetrics.h)
+  BoostEventTracker boostEventTracker;
+
+  // Candidate pressure PID gains run against a model of the valve (shadowController.h)
+  ShadowController shadowController;
+
+  ControlNumeric::Pid boostValvePressurePID;
+  ControlNumeric::Pid boostValvePositionPID;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void runBoostChannels(BoostChannel *, int, const ControlInputs *, ControlOutputs *);
+void initBoostController(int, int, float, ControlInputs *);
+void convertControlInputs(ControlInputs *);
+void runBoostController(const ControlInputs *, ControlOutputs *);
+void convertControlOutputs(const ControlOutputs *, ControlReadings *);
+
+#endif
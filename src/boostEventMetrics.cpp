@@ -0,0 +1,233 @@
+#include "boostEventMetrics.h"
+#include "boostController.h"
+#include "hal.h"
+#include "platformTraits.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+typedef ControlNumeric::Value ControlValue;
+
+// A boost event starts when the requested target steps up by at least this much and the manifold is at least this far
+// under it. It is then followed for a fixed window, and abandoned (not recorded) if the target steps again, drops back
+// by as much or goes to 0 before the window is up.
+const ControlValue boostEventStepKpa = ControlNumeric::fromInt(5);
+const ControlValue boostEventSettlingBandKpa = ControlNumeric::fromInt(2); // Same band driving events learn the holding effort in
+const ControlValue boostEventTenPercent = ControlNumeric::fromDouble(0.1);
+const ControlValue boostEventNinetyPercent = ControlNumeric::fromDouble(0.9);
+const unsigned int boostEventWindowTicks = lround(2.0 * TargetPlatform::controlTickFrequencyHz);
+const unsigned int boostEventSteadyTicks = lround(0.5 * TargetPlatform::controlTickFrequencyHz); // Last part of the window
+const ControlValue boostEventTickSeconds = ControlNumeric::fromDouble(1.0 / TargetPlatform::controlTickFrequencyHz);
+const ControlValue boostEventSteadyWeight = ControlNumeric::fromDouble(1.0 / boostEventSteadyTicks); // Sums straight to the mean
+const float boostEventMillisPerTick = 1000.0 / TargetPlatform::controlTickFrequencyHz;
+const int boostEventMaxRpmBand = 9;
+
+// Completed events, background only
+BoostEventRecord boostEvents[BOOST_EVENT_RECORDS];
+int boostEventNextIndex = 0;
+int boostEventStoredCount = 0;
+unsigned long boostEventPublishedSequence = 0;
+
+/* ======================================================================
+   FUNCTION: Start following a step in target
+   ====================================================================== */
+void startBoostEvent(BoostEventTracker *tracker, const ControlInputs *inputs, ControlValue controlTargetKpa, ControlValue actualKpa) {
+  ControlValue stepKpa = controlTargetKpa - actualKpa;
+  tracker->active = (stepKpa >= boostEventStepKpa);
+  if (!tracker->active) {
+    return;
+  }
+  tracker->ticks = 0;
+  tracker->startMillis = halMillis();
+  tracker->gear = constrain(inputs->vehicleGear, 0, 255);
+  tracker->rpmBand = constrain(inputs->vehicleRpm / 1000, 0, boostEventMaxRpmBand);
+  tracker->pressureKp = inputs->pressureKp;
+  tracker->pressureKi = inputs->pressureKi;
+  tracker->pressureKd = inputs->pressureKd;
+  tracker->startKpa = actualKpa;
+  tracker->targetKpa = controlTargetKpa;
+  tracker->tenPercentKpa = actualKpa + ControlNumeric::multiply(stepKpa, boostEventTenPercent);
+  tracker->ninetyPercentKpa = actualKpa + ControlNumeric::multiply(stepKpa, boostEventNinetyPercent);
+  tracker->tenPercentTick = 0;
+  tracker->ninetyPercentTick = 0;
+  tracker->peakOverKpa = 0;
+  tracker->lastOutsideBandTick = 0;
+  tracker->steadyStateErrorKpa = 0;
+  tracker->integralAbsoluteError = 0;
+}
+
+/* ======================================================================
+   FUNCTION: Hand over a completed event
+   ====================================================================== */
+void completeBoostEvent(BoostEventTracker *tracker, BoostEventResult *result) {
+  tracker->active = false;
+  tracker->completedCount++;
+
+  result->sequence = tracker->completedCount;
+  result->startMillis = tracker->startMillis;
+  result->gear = tracker->gear;
+  result->rpmBand = tracker->rpmBand;
+  result->tenPercentTick = tracker->tenPercentTick;
+  result->ninetyPercentTick = tracker->ninetyPercentTick;
+  result->lastOutsideBandTick = tracker->lastOutsideBandTick;
+  result->pressureKp = tracker->pressureKp;
+  result->pressureKi = tracker->pressureKi;
+  result->pressureKd = tracker->pressureKd;
+  result->startKpa = tracker->startKpa;
+  result->targetKpa = tracker->targetKpa;
+  result->peakOverKpa = tracker->peakOverKpa;
+  result->steadyStateErrorKpa = tracker->steadyStateErrorKpa;
+  result->integralAbsoluteError = tracker->integralAbsoluteError;
+}
+
+/* ======================================================================
+   FUNCTION: Turn a handed over event into its record
+   ====================================================================== */
+// Background only
+void convertBoostEvent(const BoostEventResult *result, BoostEventRecord *record) {
+  bool settled = result->lastOutsideBandTick <= boostEventWindowTicks - boostEventSteadyTicks;
+  record->sequence = result->sequence;
+  record->startMillis = result->startMillis;
+  record->gear = result->gear;
+  record->rpmBand = result->rpmBand;
+  record->settled = settled;
+  record->startKpa = ControlNumeric::toDouble(result->startKpa);
+  record->targetKpa = ControlNumeric::toDouble(result->targetKpa);
+  record->riseTimeMillis = (result->ninetyPercentTick > 0) ? (result->ninetyPercentTick - result->tenPercentTick) * boostEventMillisPerTick : -1.0f;
+  record->overshootKpa = ControlNumeric::toDouble(result->peakOverKpa);
+  record->settlingTimeMillis = settled ? result->lastOutsideBandTick * boostEventMillisPerTick : -1.0f;
+  record->steadyStateErrorKpa = ControlNumeric::toDouble(result->steadyStateErrorKpa);
+  record->integralAbsoluteError = ControlNumeric::toDouble(result->integralAbsoluteError);
+  record->pressureKp = result->pressureKp;
+  record->pressureKi = result->pressureKi;
+  record->pressureKd = result->pressureKd;
+}
+
+/* ======================================================================
+   FUNCTION: Follow the boost event in progress, returns true on the tick one completes
+   ====================================================================== */
+// Called every control tick with the requested target, the target the valve is actually being driven to and the
+// manifold pressure. Each metric is a running sum, peak or tick count, so the cost per tick is a few compares and two
+// multiplies, and the completed event is handed over without converting it.
+bool updateBoostEventTracker(BoostEventTracker *tracker, const ControlInputs *inputs, ControlValue requestedKpa, ControlValue controlTargetKpa,
+                             ControlValue actualKpa, BoostEventResult *result) {
+  ControlValue requestedChangeKpa = requestedKpa - tracker->previousRequestedKpa;
+  tracker->previousRequestedKpa = requestedKpa;
+  if (requestedChangeKpa >= boostEventStepKpa) {
+    startBoostEvent(tracker, inputs, controlTargetKpa, actualKpa); // Replaces any event still in progress
+    return false;
+  }
+  if (!tracker->active) {
+    return false;
+  }
+  if (requestedKpa == 0 || requestedChangeKpa <= -boostEventStepKpa) {
+    tracker->active = false; // Clutch in or lifted off, not a step response any more
+    return false;
+  }
+
+  tracker->ticks++;
+  ControlValue errorKpa = controlTargetKpa - actualKpa;
+  ControlValue absoluteErrorKpa = (errorKpa < 0) ? -errorKpa : errorKpa;
+  if (tracker->tenPercentTick == 0 && actualKpa >= tracker->tenPercentKpa) {
+    tracker->tenPercentTick = tracker->ticks;
+  }
+  if (tracker->ninetyPercentTick == 0 && actualKpa >= tracker->ninetyPercentKpa) {
+    tracker->ninetyPercentTick = tracker->ticks;
+  }
+  if (-errorKpa > tracker->peakOverKpa) {
+    tracker->peakOverKpa = -errorKpa;
+  }
+  if (absoluteErrorKpa > boostEventSettlingBandKpa) {
+    tracker->lastOutsideBandTick = tracker->ticks;
+  }
+  tracker->integralAbsoluteError += ControlNumeric::multiply(absoluteErrorKpa, boostEventTickSeconds);
+  if (tracker->ticks > boostEventWindowTicks - boostEventSteadyTicks) {
+    tracker->steadyStateErrorKpa += ControlNumeric::multiply(errorKpa, boostEventSteadyWeight);
+  }
+
+  if (tracker->ticks < boostEventWindowTicks) {
+    return false;
+  }
+  completeBoostEvent(tracker, result);
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Keep a completed event, overwriting the oldest once full
+   ====================================================================== */
+// Background only, called when the tick's outputs show a new event
+void recordBoostEvent(const BoostEventRecord *record) {
+  boostEvents[boostEventNextIndex] = *record;
+  boostEventNextIndex = (boostEventNextIndex + 1) % BOOST_EVENT_RECORDS;
+  if (boostEventStoredCount < BOOST_EVENT_RECORDS) {
+    boostEventStoredCount++;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Copy out the kept events, oldest first
+   ====================================================================== */
+int getBoostEvents(BoostEventRecord *records, int maxRecords) {
+  int count = min(boostEventStoredCount, maxRecords);
+  int startIndex = (boostEventNextIndex - count + BOOST_EVENT_RECORDS) % BOOST_EVENT_RECORDS;
+  for (int i = 0; i < count; i++) {
+    records[i] = boostEvents[(startIndex + i) % BOOST_EVENT_RECORDS];
+  }
+  return count;
+}
+
+/* ======================================================================
+   FUNCTION: Oldest kept event not yet published, returns false when there are none
+   ====================================================================== */
+// Events that complete while MQTT is down go out once it is back, as long as they are still in the ring
+bool takeUnpublishedBoostEvent(BoostEventRecord *record) {
+  int startIndex = (boostEventNextIndex - boostEventStoredCount + BOOST_EVENT_RECORDS) % BOOST_EVENT_RECORDS;
+  for (int i = 0; i < boostEventStoredCount; i++) {
+    const BoostEventRecord *stored = &boostEvents[(startIndex + i) % BOOST_EVENT_RECORDS];
+    if (stored->sequence > boostEventPublishedSequence) {
+      *record = *stored;
+      boostEventPublishedSequence = stored->sequence;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* ======================================================================
+   FUNCTION: Output the kept events as a table
+   ====================================================================== */
+void reportBoostEvents() {
+  static BoostEventRecord records[BOOST_EVENT_RECORDS];
+  int count = getBoostEvents(records, BOOST_EVENT_RECORDS);
+  Serial.println("\nBoost events (gear, rpm band, start -> target kPa, rise ms, overshoot kPa, settling ms, steady error kPa, IAE, kP kI kD):");
+  for (int i = 0; i < count; i++) {
+    const BoostEventRecord *record = &records[i];
+    Serial.print("  #");
+    Serial.print(record->sequence);
+    Serial.print(" ");
+    Serial.print(record->gear);
+    Serial.print(" ");
+    Serial.print(record->rpmBand * 1000);
+    Serial.print("rpm+ ");
+    Serial.print(record->startKpa, 1);
+    Serial.print(" -> ");
+    Serial.print(record->targetKpa, 1);
+    Serial.print(" ");
+    Serial.print(record->riseTimeMillis, 0);
+    Serial.print(" ");
+    Serial.print(record->overshootKpa, 2);
+    Serial.print(" ");
+    Serial.print(record->settlingTimeMillis, 0);
+    Serial.print(" ");
+    Serial.print(record->steadyStateErrorKpa, 2);
+    Serial.print(" ");
+    Serial.print(record->integralAbsoluteError, 2);
+    Serial.print(" ");
+    Serial.print(record->pressureKp, 2);
+    Serial.print(" ");
+    Serial.print(record->pressureKi, 2);
+    Serial.print(" ");
+    Serial.println(record->pressureKd, 2);
+  }
+  Serial.println();
+}
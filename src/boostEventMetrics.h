@@ -0,0 +1,83 @@
+#ifndef BOOSTEVENTMETRICS_H
+#define BOOSTEVENTMETRICS_H
+
+#include "controlNumeric.h"
+#include <Arduino.h>
+
+struct ControlInputs;
+
+/* ======================================================================
+   DEFINES: Boost events kept on the background side
+   ====================================================================== */
+#ifndef BOOST_EVENT_RECORDS
+#define BOOST_EVENT_RECORDS 32 // ~60 bytes each
+#endif
+
+/* ======================================================================
+   STRUCTURES: How the controller handled one step up in target
+   ====================================================================== */
+struct BoostEventRecord {
+  unsigned long sequence;      // Every completed event since power on, a gap means one was overwritten before it was read
+  unsigned long startMillis;   // When the target stepped
+  byte gear;
+  byte rpmBand;                // RPM / 1000 at the step
+  bool settled;                // Within the settling band for the whole of the last 500ms of the window
+  float startKpa;              // Manifold pressure at the step
+  float targetKpa;             // Target the valve was driven to at the step (after the pressure ratio limit)
+  float riseTimeMillis;        // 10% to 90% of the step, -1 if it never got to 90%
+  float overshootKpa;          // Peak over target, 0 if it never went over
+  float settlingTimeMillis;    // Step to the last time it was outside the settling band, -1 if it didn't settle
+  float steadyStateErrorKpa;   // Mean of target less actual over the last 500ms, positive is under target
+  float integralAbsoluteError; // kPa seconds over the whole window
+  float pressureKp;            // Gains at the step
+  float pressureKi;
+  float pressureKd;
+};
+
+/* ======================================================================
+   STRUCTURES: A completed event as the tick hands it over
+   ====================================================================== */
+// Kept in ControlNumeric and ticks so completing an event costs the tick no floating point, convertBoostEvent() turns
+// it into a BoostEventRecord on the background side.
+struct BoostEventResult {
+  unsigned long sequence;
+  unsigned long startMillis;
+  byte gear, rpmBand;
+  unsigned int tenPercentTick, ninetyPercentTick; // 0 if never reached
+  unsigned int lastOutsideBandTick;
+  double pressureKp, pressureKi, pressureKd;
+  ControlNumeric::Value startKpa, targetKpa, peakOverKpa, steadyStateErrorKpa, integralAbsoluteError;
+};
+
+/* ======================================================================
+   STRUCTURES: Tick side state for the event in progress
+   ====================================================================== */
+// One per boost channel, only touched from the control tick. All ControlNumeric, handed over as a BoostEventResult.
+struct BoostEventTracker {
+  bool active = false;
+  ControlNumeric::Value previousRequestedKpa = 0;
+  unsigned int ticks = 0;
+  unsigned long startMillis = 0;
+  byte gear = 0, rpmBand = 0;
+  double pressureKp = 0, pressureKi = 0, pressureKd = 0;
+  ControlNumeric::Value startKpa = 0, targetKpa = 0;
+  ControlNumeric::Value tenPercentKpa = 0, ninetyPercentKpa = 0;
+  unsigned int tenPercentTick = 0, ninetyPercentTick = 0; // 0 until reached
+  ControlNumeric::Value peakOverKpa = 0;
+  unsigned int lastOutsideBandTick = 0;
+  ControlNumeric::Value steadyStateErrorKpa = 0;
+  ControlNumeric::Value integralAbsoluteError = 0;
+  unsigned long completedCount = 0;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+bool updateBoostEventTracker(BoostEventTracker *, const ControlInputs *, ControlNumeric::Value, ControlNumeric::Value, ControlNumeric::Value, BoostEventResult *);
+void convertBoostEvent(const BoostEventResult *, BoostEventRecord *);
+void recordBoostEvent(const BoostEventRecord *);
+int getBoostEvents(BoostEventRecord *, int);
+bool takeUnpublishedBoostEvent(BoostEventRecord *);
+void reportBoostEvents();
+
+#endif
@@ -1,7 +1,5 @@
 #include "boostValveControl.h"
-#include "cytronMotorDriver.h"
 #include "globalHelpers.h"
-#include <PID_v1.h>
 
 /* ======================================================================
    VARIABLES: General use / functional
@@ -11,39 +9,43 @@ float boostValveOpenPercentage;
 /* ======================================================================
    FUNCTION: Determine current boost valve position percentage
    ====================================================================== */
+// Called every control tick, so it doesn't log. logBoostValveOpenPercentage() reports the result from the background.
 float getBoostValveOpenPercentage(int *positionReadingCurrent, int *positionReadingMinimum, int *positionReadingMaximum) {
   if (*positionReadingCurrent >= *positionReadingMaximum) {
-    DEBUG_VALVE("Valve open percentage hard set to 100\% as " + String(*positionReadingCurrent) + " >= " + String(*positionReadingMaximum));
     return 100.0;
   } else if (*positionReadingCurrent <= *positionReadingMinimum) {
-    DEBUG_VALVE("Valve open percentage hard set to 0\% as " + String(*positionReadingCurrent) + " <= " + String(*positionReadingMinimum));
     return 0.0;
   } else {
     float boostValveOpenPercentage = (static_cast<float>(*positionReadingCurrent - *positionReadingMinimum) / (*positionReadingMaximum - *positionReadingMinimum)) * 100.0;
-    DEBUG_VALVE("Valve open percentage calculated as " + String(boostValveOpenPercentage) + "%");
     return boostValveOpenPercentage;
   }
 }
 
 /* ======================================================================
-   FUNCTION: Drive valve to target boost by PID pressure feedback
+   FUNCTION: Determine current boost valve position percentage in Q16.16
    ====================================================================== */
-void driveBoostValveToTargetByPressurePid(PID *boostValvePressurePid, double *boostValveMotorSpeed,
-                                          int *boostValveMinimumRaw, int *boostValveMaximumRaw, int *currentBoostValvePositionReadingRaw) {
-  // Update the motor speed based on current position feedback
-  if (*currentBoostValvePositionReadingRaw >= *boostValveMaximumRaw || *currentBoostValvePositionReadingRaw <= *boostValveMinimumRaw) {
-    setCytronSpeedAndDirection(0.0);    // We are at the detected travel limit of the valve, no need to drive it into the stop
+// Same clamping as above for the fixed point control core. A 32 bit divide per tick, no floating point.
+int32_t getBoostValveOpenPercentageQ16(int positionReadingCurrent, int positionReadingMinimum, int positionReadingMaximum) {
+  if (positionReadingCurrent >= positionReadingMaximum) {
+    return 100L << 16;
+  } else if (positionReadingCurrent <= positionReadingMinimum) {
+    return 0;
   } else {
-    boostValvePressurePid->Compute();
-    setCytronSpeedAndDirection(*boostValveMotorSpeed);
+    int32_t fraction = (static_cast<int32_t>(positionReadingCurrent - positionReadingMinimum) << 16) / (positionReadingMaximum - positionReadingMinimum);
+    return fraction * 100;
   }
 }
 
 /* ======================================================================
-   FUNCTION: Drive valve to target open percentage by PID position feedback
+   FUNCTION: Log how the control tick's latest open percentage came about
    ====================================================================== */
-void driveBoostValveToTargetByOpenPercentagePid(PID *boostValvePositionPid, double *currentBoostValveOpenPercentage,
-                                                double *boostValveMotorSpeed, double *currentTargetBoostValveOpenPercentage) {
-  boostValvePositionPid->Compute();
-  setCytronSpeedAndDirection(*boostValveMotorSpeed);
+// Background only, from the tick's outputs at the debug rate rather than from every tick
+void logBoostValveOpenPercentage(int positionReadingCurrent, int positionReadingMinimum, int positionReadingMaximum, float openPercentage) {
+  if (positionReadingCurrent >= positionReadingMaximum) {
+    DEBUG_VALVE(LOG_VALVE_OPEN_CLAMPED_HIGH, positionReadingCurrent, positionReadingMaximum);
+  } else if (positionReadingCurrent <= positionReadingMinimum) {
+    DEBUG_VALVE(LOG_VALVE_OPEN_CLAMPED_LOW, positionReadingCurrent, positionReadingMinimum);
+  } else {
+    DEBUG_VALVE(LOG_VALVE_OPEN_CALCULATED, openPercentage);
+  }
 }
@@ -1,15 +1,52 @@
 #ifndef BOOSTVALVECONTROL_H
 #define BOOSTVALVECONTROL_H
 
-#include "PID_v1.h"
+#include "cytronMotorDriver.h"
 #include <Arduino.h>
 
+/* ======================================================================
+   ENUMS: Which way the control tick is driving the valve
+   ====================================================================== */
+enum ControlMode {
+  CONTROL_MODE_FAIL_SAFE,     // Critical alarm, motor off and the spring opens the valve
+  CONTROL_MODE_POSITION,      // Position PID to a target open percentage
+  CONTROL_MODE_PRESSURE,      // Pressure PID to a target boost
+  CONTROL_MODE_OVERBOOST_OPEN // Predicted overboost, valve driven fully open regardless of the PIDs
+};
+
 /* ======================================================================
    FUNCTION PROTOTYPES
    ====================================================================== */
 int getBoostValvePositionReadingRaw(const byte *);
 float getBoostValveOpenPercentage(int *, int *, int *);
-void driveBoostValveToTargetByPressurePid(PID *, double *, int *, int *, int *);
-void driveBoostValveToTargetByOpenPercentagePid(PID *, double *, double *, double *);
+int32_t getBoostValveOpenPercentageQ16(int, int, int);
+void logBoostValveOpenPercentage(int, int, int, float);
+
+/* ======================================================================
+   FUNCTION: Drive valve to target boost by PID pressure feedback
+   ====================================================================== */
+// Templated on the control numeric traits (controlNumeric.h) so the same code drives PID_v1 with doubles on the R4 and
+// FixedPointPid on the Mega
+template <typename Numeric>
+void driveBoostValveToTargetByPressurePid(const CytronMotor *motor, typename Numeric::Pid *boostValvePressurePid, typename Numeric::Value *boostValveMotorSpeed,
+                                          int *boostValveMinimumRaw, int *boostValveMaximumRaw, int *currentBoostValvePositionReadingRaw) {
+  // Update the motor speed based on current position feedback
+  if (*currentBoostValvePositionReadingRaw >= *boostValveMaximumRaw || *currentBoostValvePositionReadingRaw <= *boostValveMinimumRaw) {
+    Numeric::driveMotor(motor, 0); // We are at the detected travel limit of the valve, no need to drive it into the stop
+  } else {
+    boostValvePressurePid->Compute();
+    Numeric::driveMotor(motor, *boostValveMotorSpeed);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Drive valve to target open percentage by PID position feedback
+   ====================================================================== */
+template <typename Numeric>
+void driveBoostValveToTargetByOpenPercentagePid(const CytronMotor *motor, typename Numeric::Pid *boostValvePositionPid, typename Numeric::Value *currentBoostValveOpenPercentage,
+                                                typename Numeric::Value *boostValveMotorSpeed, typename Numeric::Value *currentTargetBoostValveOpenPercentage) {
+  boostValvePositionPid->Compute();
+  Numeric::driveMotor(motor, *boostValveMotorSpeed);
+}
 
 #endif
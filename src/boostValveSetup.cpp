@@ -1,5 +1,6 @@
 #include "boostValveSetup.h"
 #include "cytronMotorDriver.h"
+#include "hal.h"
 #include <ptScheduler.h>
 
 /* ======================================================================
@@ -30,7 +31,7 @@ void setBoostValveTravelLimits(int *positionReadingMinimum, int *positionReading
   setCytronSpeedAndDirection(-60.0f); // 60% speed backwards
   while (boostValveClosedPositionSet == false) {
     if (ptIncrementValvePosition.call()) {
-      int potentiometerValue = analogRead(boostValvePositionSignal1Pin);
+      int potentiometerValue = halAdcRead(boostValvePositionSignal1Pin);
       // Add current reading to the array
       readingsClosed[currentIndexClosed] = potentiometerValue;
       currentIndexClosed = (currentIndexClosed + 1) % windowSize;
@@ -55,7 +56,7 @@ void setBoostValveTravelLimits(int *positionReadingMinimum, int *positionReading
   setCytronSpeedAndDirection(40.0f); // 40% speed forwards
   while (boostValveOpenPositionSet == false) {
     if (ptIncrementValvePosition.call()) {
-      int potentiometerValue = analogRead(boostValvePositionSignal1Pin);
+      int potentiometerValue = halAdcRead(boostValvePositionSignal1Pin);
       // Add current reading to the array
       readingsOpen[currentIndexOpen] = potentiometerValue;
       currentIndexOpen = (currentIndexOpen + 1) % windowSize;
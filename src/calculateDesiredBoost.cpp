@@ -12,7 +12,7 @@ struct BoostByGear {
 /* ======================================================================
    VARIABLES: General use / functional
    ====================================================================== */
-const BoostByGear boostByGearData[] = {
+BoostByGear boostByGearData[] = {
     {0, 0}, // First value is gear, second is boost maximum in PSI. Gear 0 is neutral
     {1, 20},
     {2, 30},
@@ -21,23 +21,63 @@ const BoostByGear boostByGearData[] = {
     {5, 55},
     {6, 55}}; // 8psi
 
+// Master inputs older than this start pulling the target down, reaching 0kPa when they are as old as the comms timeout.
+// Speed and RPM followed along their trends (vehicleStateEstimator.cpp) are good for longer.
+const unsigned long masterInputFreshMillis = 250;
+const unsigned long estimatedInputFreshMillis = 500;
+const unsigned long masterInputStaleMillis = 1000;
+
 /* ======================================================================
    FUNCTION: Determine desired boost level
    ====================================================================== */
 float calculateDesiredBoostKpa(float speed, int rpm, int gear, bool clutchPressed) {
-  DEBUG_BOOST("Calculating boost based on speed " + String(speed) + "kmh, rpm " + String(rpm) + ", gear " + String(gear) + " and clutch " + String(clutchPressed));
+  DEBUG_BOOST(LOG_BOOST_CALCULATING, speed, rpm, gear, clutchPressed);
   if (speed <= 2 || gear == 0 || clutchPressed == true || rpm < 1000) {
-    DEBUG_BOOST("Boost target set to 0psi due to conditional match (gear, speed, clutch etc)");
+    DEBUG_BOOST(LOG_BOOST_ZERO_CONDITIONAL);
     return 0.0;
   } else {
     // Lookup boost by gear
     for (const auto &boostPair : boostByGearData) {
       if (boostPair.gear == gear) {
-        DEBUG_BOOST("Boost target determined as " + String(boostPair.kPa) + "kPa");
+        DEBUG_BOOST(LOG_BOOST_TARGET_DETERMINED, boostPair.kPa);
         return boostPair.kPa;
       }
     }
   }
+  DEBUG_BOOST(LOG_BOOST_ZERO_UNKNOWN_GEAR, gear);
   return 0.0;
-  DEBUG_BOOST("Boost target set to 0psi as out of range gear provided");
+}
+
+/* ======================================================================
+   FUNCTION: Change the boost target for a gear (neutral can't be changed)
+   ====================================================================== */
+bool setBoostTargetForGear(int gear, int kPa) {
+  for (auto &boostPair : boostByGearData) {
+    if (boostPair.gear == gear && gear != 0) {
+      boostPair.kPa = kPa;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* ======================================================================
+   FUNCTION: Scale a boost target down as the master inputs it came from age
+   ====================================================================== */
+// Gear and RPM that are a fraction of a second old are still a fair guess, beyond that the target fades out rather than
+// holding boost on data the car may have moved on from (a gear change or the clutch going in). estimated is set when the
+// target came from extrapolated speed and RPM rather than the last frame as it was.
+float discountBoostForInputAge(float targetKpa, unsigned long inputAgeMillis, bool estimated) {
+  unsigned long freshMillis = estimated ? estimatedInputFreshMillis : masterInputFreshMillis;
+  if (inputAgeMillis <= freshMillis) {
+    return targetKpa;
+  }
+  float discountedKpa = 0.0;
+  if (inputAgeMillis < masterInputStaleMillis) {
+    discountedKpa = targetKpa * (masterInputStaleMillis - inputAgeMillis) / (masterInputStaleMillis - freshMillis);
+  }
+  if (targetKpa > 0) {
+    DEBUG_BOOST(LOG_BOOST_STALE_INPUT_DISCOUNT, discountedKpa, inputAgeMillis);
+  }
+  return discountedKpa;
 }
@@ -7,5 +7,7 @@
    FUNCTION PROTOTYPES
    ====================================================================== */
 float calculateDesiredBoostKpa(float, int, int, bool);
+bool setBoostTargetForGear(int, int);
+float discountBoostForInputAge(float, unsigned long, bool);
 
 #endif
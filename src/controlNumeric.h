@@ -0,0 +1,69 @@
+#ifndef CONTROLNUMERIC_H
+#define CONTROLNUMERIC_H
+
+#include "boostValveControl.h"
+#include "fixedPointPid.h"
+#include "globalHelpers.h"
+#include "platformTraits.h"
+#include <PID_v1.h>
+
+/* ======================================================================
+   TRAITS: Number type, PID and conversions used by the control core
+   ====================================================================== */
+// boostController.cpp is written once against ControlNumeric and picks one of these at compile time. The background
+// converts the target and gains before handing them over, results come back as Values to be converted there, and the
+// motor and blackbox take them as they are, so the fixed point tick has no floating point left in it.
+struct FloatingPointTunings {
+  double kp, ki, kd;
+};
+
+struct FloatingPointControl {
+  typedef double Value;
+  typedef PID Pid;
+  typedef FloatingPointTunings Tunings;
+
+  static Value fromDouble(double value) { return value; }
+  static double toDouble(Value value) { return value; }
+  static Value fromInt(int value) { return value; }
+  static Value multiply(Value a, Value b) { return a * b; }
+  static Value divide(Value a, Value b) { return a / b; }
+  static Value kpaFromRaw(int gaugeRaw) { return calculateBosch3BarKpaFromRaw(gaugeRaw); }
+  static Value openPercentage(int *raw, int *minimum, int *maximum) { return getBoostValveOpenPercentage(raw, minimum, maximum); }
+  static int32_t toQ8(Value value) { return lround(value * 256); }
+  static void driveMotor(const CytronMotor *motor, Value speed) { setCytronSpeedAndDirection(motor, speed); }
+  static Tunings scaleTunings(double kp, double ki, double kd, int) { return {kp, ki, kd}; }
+  static void setTunings(Pid *pid, const Tunings *tunings) { pid->SetTunings(tunings->kp, tunings->ki, tunings->kd); }
+};
+
+// Q16.16 in an int32_t, enough range for kPa, percentages and motor speeds with ~0.00002 resolution
+struct FixedPointControl {
+  typedef fixed16_t Value;
+  typedef FixedPointPid Pid;
+  typedef FixedPointPidTunings Tunings;
+
+  static Value fromDouble(double value) { return fixed16FromDouble(value); }
+  static double toDouble(Value value) { return fixed16ToDouble(value); }
+  static Value fromInt(int value) { return fixed16FromInt(value); }
+  static Value multiply(Value a, Value b) { return fixed16Multiply(a, b); }
+  static Value divide(Value a, Value b) { return fixed16Divide(a, b); }
+  static Value kpaFromRaw(int gaugeRaw) { return calculateBosch3BarKpaQ16FromRaw(gaugeRaw); }
+  static Value openPercentage(int *raw, int *minimum, int *maximum) { return getBoostValveOpenPercentageQ16(*raw, *minimum, *maximum); }
+  static int32_t toQ8(Value value) { return (value + 128) >> 8; }
+  static void driveMotor(const CytronMotor *motor, Value speed) { setCytronSpeedAndDirectionQ16(motor, speed); }
+  static Tunings scaleTunings(double kp, double ki, double kd, int sampleTimeMillis) { return FixedPointPid::ScaleTunings(kp, ki, kd, sampleTimeMillis); }
+  static void setTunings(Pid *pid, const Tunings *tunings) { pid->SetTunings(tunings); }
+};
+
+// Whether something handed in from the background has changed, compared as bytes so the tick needs no floating point
+// compare to find out. Tunings that compare equal with different bits (0.0 and -0.0) are just set again.
+template <typename T> inline bool controlInputChanged(const T *value, const T *previous) {
+  return memcmp(value, previous, sizeof(T)) != 0;
+}
+
+#if CONTROL_FIXED_POINT
+typedef FixedPointControl ControlNumeric;
+#else
+typedef FloatingPointControl ControlNumeric;
+#endif
+
+#endif
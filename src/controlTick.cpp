@@ -0,0 +1,245 @@
+#include "controlTick.h"
+#include "hal.h"
+#include "platformTraits.h"
+#include "snapshotHandoff.h"
+#include "taskProfiler.h"
+
+#if !defined(ARDUINO_ARCH_AVR)
+#include <FspTimer.h>
+
+/* ======================================================================
+   OBJECT DECLARATIOS
+   ====================================================================== */
+FspTimer controlTickTimer;
+IRQn_Type controlTickIrq; // Whichever channel's overflow interrupt the core gave us
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+// Priority 12 is the core default. A lower number would let the tick preempt the USB and UART interrupts, but analogRead()
+// and the PWM driver are called from inside the tick so we keep it level with them.
+const uint8_t controlTickInterruptPriority = 12;
+#endif
+
+void (*controlTickFunction)() = nullptr;
+bool controlTickTimerStarted = false;
+unsigned long controlTickNominalPeriodUs;
+unsigned long controlTickPreviousStartUs = 0;
+volatile bool controlTickStatsResetRequested = true;
+
+ControlTickStats controlTickStatsWorking;                // Only ever touched inside the interrupt
+SnapshotFromIsr<ControlTickStats> controlTickStatsShared; // Handed to the background once per tick
+
+/* ======================================================================
+   FUNCTION: Timer interrupt, run the control function and time it
+   ====================================================================== */
+// Keeps totals and extremes only, reportControlTickJitter() works out the means so there is no divide in here
+void runControlTickAndTimeIt() {
+  unsigned long tickStartUs = halMicros();
+
+  // Resets are requested by the background but performed here so the interrupt remains the single writer
+  if (controlTickStatsResetRequested) {
+    controlTickStatsWorking = ControlTickStats();
+    controlTickStatsWorking.periodMinUs = 0xFFFFFFFF;
+    controlTickStatsResetRequested = false;
+  } else {
+    unsigned long periodUs = tickStartUs - controlTickPreviousStartUs;
+    unsigned long jitterUs = (periodUs > controlTickNominalPeriodUs) ? periodUs - controlTickNominalPeriodUs : controlTickNominalPeriodUs - periodUs;
+
+    controlTickStatsWorking.tickCount++;
+    controlTickStatsWorking.jitterTotalUs += jitterUs;
+    if (periodUs < controlTickStatsWorking.periodMinUs) {
+      controlTickStatsWorking.periodMinUs = periodUs;
+    }
+    if (periodUs > controlTickStatsWorking.periodMaxUs) {
+      controlTickStatsWorking.periodMaxUs = periodUs;
+    }
+    if (jitterUs > controlTickStatsWorking.jitterMaxUs) {
+      controlTickStatsWorking.jitterMaxUs = jitterUs;
+    }
+  }
+  controlTickPreviousStartUs = tickStartUs;
+
+  unsigned long tickStartCycles = profilerGetCycles();
+  halAdcStartSyncBudget(TargetPlatform::controlTickAdcSyncBudgetMicros);
+  controlTickFunction();
+  profilerRecord(PROFILED_CONTROL_TICK, tickStartCycles);
+
+  // The synchronised reads' busy waiting is part of the execution time below, this is how much of it there was
+  unsigned long adcSyncWaitUs = halAdcSyncWaitMicros();
+  controlTickStatsWorking.adcSyncWaitTotalUs += adcSyncWaitUs;
+  if (adcSyncWaitUs > controlTickStatsWorking.adcSyncWaitMaxUs) {
+    controlTickStatsWorking.adcSyncWaitMaxUs = adcSyncWaitUs;
+  }
+  if (TargetPlatform::controlTickAdcSyncBudgetMicros > 0 && adcSyncWaitUs >= TargetPlatform::controlTickAdcSyncBudgetMicros) {
+    controlTickStatsWorking.adcSyncBudgetSpentCount++;
+  }
+
+  unsigned long executionUs = halMicros() - tickStartUs;
+  if (executionUs > controlTickStatsWorking.executionMaxUs) {
+    controlTickStatsWorking.executionMaxUs = executionUs;
+  }
+  if (executionUs > controlTickNominalPeriodUs) {
+    controlTickStatsWorking.overrunCount++;
+  }
+
+  controlTickStatsShared.publish(controlTickStatsWorking);
+}
+
+#if defined(ARDUINO_ARCH_AVR)
+// ISR_NOBLOCK turns interrupts back on as soon as the tick is entered. The tick's ADC reads take ~1.1ms of the 2ms period,
+// and with interrupts off for all of that the master UART (500kbaud, a byte every 20us) would overrun and millis() would
+// lose Timer0 overflows. Now those interrupts preempt the tick instead. A tick due while the last one is still running
+// is skipped and counted rather than nested.
+volatile bool controlTickRunning = false;
+volatile unsigned long controlTickSkippedCount = 0;
+
+ISR(TIMER1_COMPA_vect, ISR_NOBLOCK) {
+  if (controlTickRunning) {
+    controlTickSkippedCount++;
+    return;
+  }
+  controlTickRunning = true;
+  runControlTickAndTimeIt();
+  controlTickRunning = false;
+}
+#else
+void controlTickTimerCallback(timer_callback_args_t *args) {
+  runControlTickAndTimeIt();
+}
+#endif
+
+/* ======================================================================
+   FUNCTION: Start the periodic hardware timer driving the control tick
+   ====================================================================== */
+bool startControlTickTimer(float frequencyHz, void (*tickFunction)()) {
+  controlTickFunction = tickFunction;
+  controlTickNominalPeriodUs = 1000000.0 / frequencyHz;
+
+  Serial.print("\nINFO: Starting control tick timer at ");
+  Serial.print(frequencyHz);
+  Serial.println("Hz ... ");
+
+#if defined(ARDUINO_ARCH_AVR)
+  // Timer1 in CTC mode with a /64 prescaler, 4us per count so anything down to ~4Hz fits in its 16 bits
+  unsigned long compareCounts = lroundf(F_CPU / 64.0 / frequencyHz);
+  if (compareCounts < 2 || compareCounts > 65536) {
+    Serial.println("\tFATAL - Control tick frequency out of range for Timer1");
+    return false;
+  }
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11) | _BV(CS10);
+  TCNT1 = 0;
+  OCR1A = compareCounts - 1;
+  TIMSK1 |= _BV(OCIE1A);
+  interrupts();
+#else
+  // Prefer a GPT channel, the core will hand back an AGT channel if all of the GPT ones are already in use
+  uint8_t timerType = GPT_TIMER;
+  int8_t timerChannel = FspTimer::get_available_timer(timerType);
+  if (timerChannel < 0) {
+    Serial.println("\tFATAL - No hardware timer available for control tick");
+    return false;
+  }
+
+  if (!controlTickTimer.begin(TIMER_MODE_PERIODIC, timerType, timerChannel, frequencyHz, 0.0f, controlTickTimerCallback) ||
+      !controlTickTimer.setup_overflow_irq(controlTickInterruptPriority) ||
+      !controlTickTimer.open() ||
+      !controlTickTimer.start()) {
+    Serial.println("\tFATAL - Unable to configure control tick timer");
+    return false;
+  }
+  controlTickIrq = controlTickTimer.get_cfg()->cycle_end_irq;
+#endif
+
+  controlTickTimerStarted = true;
+  Serial.println("\tOK - Control tick running");
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Hold off the control tick, and only the control tick
+   ====================================================================== */
+// For the background's brief uses of something the tick shares, such as a mux conversion on the ADC. The UART, millis()
+// and the rest carry on. A tick that falls due meanwhile stays pending and runs as soon as it is unmasked, late rather
+// than lost. Keep what goes in between to tens of microseconds, the tick's jitter stats will show it.
+void maskControlTick() {
+  if (!controlTickTimerStarted) {
+    return;
+  }
+#if defined(ARDUINO_ARCH_AVR)
+  TIMSK1 &= ~_BV(OCIE1A);
+#else
+  NVIC_DisableIRQ(controlTickIrq); // Includes the barriers, so the tick can't start once this returns
+#endif
+}
+
+void unmaskControlTick() {
+  if (!controlTickTimerStarted) {
+    return;
+  }
+#if defined(ARDUINO_ARCH_AVR)
+  TIMSK1 |= _BV(OCIE1A);
+#else
+  NVIC_EnableIRQ(controlTickIrq);
+#endif
+}
+
+/* ======================================================================
+   FUNCTION: Get a consistent copy of the control tick stats
+   ====================================================================== */
+void getControlTickStats(ControlTickStats *stats) {
+  controlTickStatsShared.read(stats);
+#if defined(ARDUINO_ARCH_AVR)
+  noInterrupts(); // Four bytes, not a single read on the AVR
+  stats->skippedCount = controlTickSkippedCount;
+  interrupts();
+#else
+  stats->skippedCount = 0;
+#endif
+}
+
+/* ======================================================================
+   FUNCTION: Output control tick jitter stats and start a new interval
+   ====================================================================== */
+void reportControlTickJitter() {
+  ControlTickStats stats;
+  getControlTickStats(&stats);
+
+  Serial.print("\nControl tick count: ");
+  Serial.print(stats.tickCount);
+  Serial.print(" (nominal period ");
+  Serial.print(controlTickNominalPeriodUs);
+  Serial.println("us)");
+
+  Serial.print("Control tick period min / max (us): ");
+  Serial.print(stats.periodMinUs);
+  Serial.print(" / ");
+  Serial.println(stats.periodMaxUs);
+
+  Serial.print("Control tick jitter mean / max (us): ");
+  Serial.print((stats.tickCount > 0) ? static_cast<float>(stats.jitterTotalUs) / stats.tickCount : 0.0f);
+  Serial.print(" / ");
+  Serial.println(stats.jitterMaxUs);
+
+  Serial.print("Control tick execution max (us): ");
+  Serial.print(stats.executionMaxUs);
+  Serial.print(" with ");
+  Serial.print(stats.overrunCount);
+  Serial.print(" overruns and ");
+  Serial.print(stats.skippedCount);
+  Serial.println(" skipped ticks");
+
+  Serial.print("Control tick PWM sync wait mean / max (us): ");
+  Serial.print(static_cast<float>(stats.adcSyncWaitTotalUs) / (stats.tickCount + 1));
+  Serial.print(" / ");
+  Serial.print(stats.adcSyncWaitMaxUs);
+  Serial.print(" of ");
+  Serial.print(TargetPlatform::controlTickAdcSyncBudgetMicros);
+  Serial.print(", budget used up on ");
+  Serial.print(stats.adcSyncBudgetSpentCount);
+  Serial.println(" ticks\n");
+
+  controlTickStatsResetRequested = true;
+}
@@ -0,0 +1,32 @@
+#ifndef CONTROLTICK_H
+#define CONTROLTICK_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: Control tick timing statistics
+   ====================================================================== */
+struct ControlTickStats {
+  unsigned long tickCount;               // Ticks since the stats were last reset
+  unsigned long periodMinUs;             // Shortest time between tick starts
+  unsigned long periodMaxUs;             // Longest time between tick starts
+  unsigned long jitterMaxUs;             // Largest deviation of a period from nominal
+  unsigned long jitterTotalUs;           // Sum of the absolute deviations, the reporter divides it down to a mean
+  unsigned long executionMaxUs;          // Longest time spent inside the tick function
+  unsigned long overrunCount;            // Ticks where the tick function took longer than the period
+  unsigned long skippedCount;            // Ticks not run because the last one was still running (AVR only), since boot
+  unsigned long adcSyncWaitMaxUs;        // Longest a tick spent waiting for the motor PWM's quiet point
+  unsigned long adcSyncWaitTotalUs;      // Sum of the same over every tick run, including the one that reset the stats
+  unsigned long adcSyncBudgetSpentCount; // Ticks that used the whole wait budget, later reads were taken unsynchronised
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+bool startControlTickTimer(float, void (*)());
+void getControlTickStats(ControlTickStats *);
+void reportControlTickJitter();
+void maskControlTick();
+void unmaskControlTick();
+
+#endif
@@ -1,18 +1,17 @@
 #include "cytronMotorDriver.h"
-#include "pwm.h"
-
-/* ======================================================================
-   OBJECT DECLARATIOS
-   ====================================================================== */
-PwmOut cytronPwm(MOTOR_PWM_PIN);
+#include "hal.h"
 
 /* ======================================================================
    FUNCTION: Initialise the motor driver
    ====================================================================== */
 void initCytronMotorDriver() {
+  initCytronMotorDriver(&primaryCytronMotor);
+}
+
+void initCytronMotorDriver(const CytronMotor *motor) {
   Serial.println("\nINFO: Initialising Cytron motor driver board ...\n");
-  pinMode(MOTOR_DIR_PIN, OUTPUT);
-  cytronPwm.begin(25000.0f, 0.0f); // 25kHz PWM frequency and 0% duty
+  halPinMode(motor->dirPin, OUTPUT);
+  halPwmBegin(motor->pwmPin, 25000.0f); // 25kHz PWM frequency and 0% duty
 }
 
 /* ======================================================================
@@ -28,16 +27,16 @@ void setCytronSpeedAndDirection(float *speedAndDirection) {
 
   // Set the output as needed
   if (*speedAndDirection > 0) {
-    digitalWrite(MOTOR_DIR_PIN, HIGH); // Forward
-    cytronPwm.pulse_perc(abs(*speedAndDirection));
+    halDigitalWrite(MOTOR_DIR_PIN, HIGH); // Forward
+    halPwmWrite(MOTOR_PWM_PIN, abs(*speedAndDirection));
     return;
   }
   if (*speedAndDirection < 0) {
-    digitalWrite(MOTOR_DIR_PIN, LOW); // Backwards
-    cytronPwm.pulse_perc(abs(*speedAndDirection));
+    halDigitalWrite(MOTOR_DIR_PIN, LOW); // Backwards
+    halPwmWrite(MOTOR_PWM_PIN, abs(*speedAndDirection));
     return;
   } else {
-    cytronPwm.pulse_perc(0.0f);
+    halPwmWrite(MOTOR_PWM_PIN, 0.0f);
     return;
   }
 }
@@ -46,6 +45,18 @@ void setCytronSpeedAndDirection(float *speedAndDirection) {
    FUNCTION: Set the motor speed and direction (raw value)
    ====================================================================== */
 void setCytronSpeedAndDirection(double speedAndDirection) {
+  setCytronSpeedAndDirection(&primaryCytronMotor, speedAndDirection);
+}
+
+/* ======================================================================
+   FUNCTION: Set the speed and direction of one motor channel
+   ====================================================================== */
+// A null motor drives nothing, for a boost channel that only works out its output (benchmarks)
+void setCytronSpeedAndDirection(const CytronMotor *motor, double speedAndDirection) {
+  if (motor == nullptr) {
+    return;
+  }
+
   // Sanity check the values
   if (speedAndDirection >= 100.0) {
     speedAndDirection = 100.0;
@@ -55,16 +66,40 @@ void setCytronSpeedAndDirection(double speedAndDirection) {
 
   // Set the output as needed
   if (speedAndDirection > 0) {
-    digitalWrite(MOTOR_DIR_PIN, HIGH); // Forward
-    cytronPwm.pulse_perc(abs(speedAndDirection));
+    halDigitalWrite(motor->dirPin, HIGH); // Forward
+    halPwmWrite(motor->pwmPin, abs(speedAndDirection));
     return;
   }
   if (speedAndDirection < 0) {
-    digitalWrite(MOTOR_DIR_PIN, LOW); // Backwards
-    cytronPwm.pulse_perc(abs(speedAndDirection));
+    halDigitalWrite(motor->dirPin, LOW); // Backwards
+    halPwmWrite(motor->pwmPin, abs(speedAndDirection));
     return;
   } else {
-    cytronPwm.pulse_perc(0.0f);
+    halPwmWrite(motor->pwmPin, 0.0f);
     return;
   }
 }
+
+/* ======================================================================
+   FUNCTION: Set the speed and direction of one motor channel (Q16.16 percent)
+   ====================================================================== */
+// The fixed point control core's output, integer only all the way to the PWM register
+void setCytronSpeedAndDirectionQ16(const CytronMotor *motor, int32_t speedAndDirection) {
+  if (motor == nullptr) {
+    return;
+  }
+
+  // Sanity check the values
+  speedAndDirection = constrain(speedAndDirection, -(100L << 16), 100L << 16);
+
+  // Set the output as needed
+  if (speedAndDirection > 0) {
+    halDigitalWrite(motor->dirPin, HIGH); // Forward
+    halPwmWriteQ16(motor->pwmPin, speedAndDirection);
+  } else if (speedAndDirection < 0) {
+    halDigitalWrite(motor->dirPin, LOW); // Backwards
+    halPwmWriteQ16(motor->pwmPin, -speedAndDirection);
+  } else {
+    halPwmWriteQ16(motor->pwmPin, 0);
+  }
+}
@@ -9,11 +9,24 @@
 const int MOTOR_PWM_PIN = 9; // PWM pin for motor speed control
 const int MOTOR_DIR_PIN = 8; // Direction pin for motor control
 
+/* ======================================================================
+   STRUCTURES: One Cytron channel's pins
+   ====================================================================== */
+struct CytronMotor {
+  byte pwmPin;
+  byte dirPin;
+};
+
+const CytronMotor primaryCytronMotor = {MOTOR_PWM_PIN, MOTOR_DIR_PIN};
+
 /* ======================================================================
    FUNCTION PROTOTYPES
    ====================================================================== */
 void initCytronMotorDriver();
+void initCytronMotorDriver(const CytronMotor *);
 void setCytronSpeedAndDirection(float *);
 void setCytronSpeedAndDirection(double);
+void setCytronSpeedAndDirection(const CytronMotor *, double);
+void setCytronSpeedAndDirectionQ16(const CytronMotor *, int32_t);
 
 #endif
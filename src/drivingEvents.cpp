@@ -0,0 +1,51 @@
+#include "drivingEvents.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const float tipInRpmPerSecond = 1500.0;      // RPM trend above this with the clutch out is the throttle going down
+const float tipInRearmRpmPerSecond = 500.0;  // And it has to drop back under this before another one counts
+
+bool drivingEventsPrimed = false; // Nothing to compare the first frame with
+int drivingPreviousGear = 0;
+bool drivingPreviousClutchPressed = true;
+bool tipInArmed = true;
+DrivingEventCounts drivingEventCounts;
+
+/* ======================================================================
+   FUNCTION: Compare a command ID 1 frame with the last, returns DrivingEvent bits
+   ====================================================================== */
+// rpmPerSecond is the trend from vehicleStateEstimator.cpp, a frame to frame difference is too noisy to trigger on
+byte detectDrivingEvents(int gear, bool clutchPressed, float rpmPerSecond) {
+  byte events = 0;
+  if (drivingEventsPrimed) {
+    if (drivingPreviousClutchPressed && !clutchPressed) {
+      events |= DRIVING_EVENT_CLUTCH_RELEASE;
+      drivingEventCounts.clutchReleases++;
+    }
+    if (gear != drivingPreviousGear && gear != 0) {
+      events |= DRIVING_EVENT_GEAR_CHANGE;
+      drivingEventCounts.gearChanges++;
+    }
+    if (tipInArmed && !clutchPressed && gear != 0 && rpmPerSecond > tipInRpmPerSecond) {
+      events |= DRIVING_EVENT_TIP_IN;
+      drivingEventCounts.tipIns++;
+      tipInArmed = false;
+    }
+  }
+  if (rpmPerSecond < tipInRearmRpmPerSecond) {
+    tipInArmed = true;
+  }
+
+  drivingEventsPrimed = true;
+  drivingPreviousGear = gear;
+  drivingPreviousClutchPressed = clutchPressed;
+  return events;
+}
+
+/* ======================================================================
+   FUNCTION: Event counts for reporting
+   ====================================================================== */
+void getDrivingEventCounts(DrivingEventCounts *counts) {
+  *counts = drivingEventCounts;
+}
@@ -0,0 +1,30 @@
+#ifndef DRIVINGEVENTS_H
+#define DRIVINGEVENTS_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   ENUMS: Edges picked out of the command ID 1 stream, as bits
+   ====================================================================== */
+enum DrivingEvent {
+  DRIVING_EVENT_CLUTCH_RELEASE = 1 << 0,
+  DRIVING_EVENT_GEAR_CHANGE = 1 << 1, // Into a gear, not into neutral
+  DRIVING_EVENT_TIP_IN = 1 << 2       // RPM suddenly climbing with the clutch out, the master doesn't send throttle position
+};
+
+/* ======================================================================
+   STRUCTURES: Event counts since boot
+   ====================================================================== */
+struct DrivingEventCounts {
+  unsigned long clutchReleases;
+  unsigned long gearChanges;
+  unsigned long tipIns;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+byte detectDrivingEvents(int, bool, float);
+void getDrivingEventCounts(DrivingEventCounts *);
+
+#endif
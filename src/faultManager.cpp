@@ -0,0 +1,162 @@
+#include "faultManager.h"
+#include "globalHelpers.h"
+#include "hal.h"
+
+/* ======================================================================
+   VARIABLES: Fault definitions, indexed by FaultCode
+   ====================================================================== */
+const FaultDefinition faultDefinitions[FAULT_CODE_COUNT] = {
+    // Name, severity, debounce ms, latching, recovery ms
+    {"commsTimeout", FAULT_SEVERITY_CRITICAL, 0, false, 2000},        // Timeout itself is in checkAndSetFaultConditions
+    {"serialQuality", FAULT_SEVERITY_CRITICAL, 0, false, 10000},      // Two stats periods of good comms
+    {"overboost", FAULT_SEVERITY_CRITICAL, 0, true, 0},               // Dwell is per target band in the control tick. Never trust the valve again until looked at
+    {"controlTickFailed", FAULT_SEVERITY_CRITICAL, 0, true, 0},       // Nothing is driving the valve
+    {"controlTickOverrun", FAULT_SEVERITY_WARNING, 0, false, 5000},
+    {"intakeSensor", FAULT_SEVERITY_WARNING, 1000, false, 5000},
+    {"heapAllocation", FAULT_SEVERITY_WARNING, 0, true, 0}};          // One is enough to start fragmenting on a long drive
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+struct FaultState {
+  bool conditionPresent;
+  bool active;
+  unsigned long conditionChangedMillis;
+};
+
+FaultState faultStates[FAULT_CODE_COUNT];
+volatile unsigned long activeFaultBitmask = 0;
+volatile unsigned long activeCriticalFaultBitmask = 0;
+
+const int faultHistorySize = 16;
+FaultEvent faultHistory[faultHistorySize];
+int faultHistoryNextIndex = 0;
+int faultHistoryCount = 0;
+
+/* ======================================================================
+   FUNCTION: Raise or clear a fault and record it in the history ring
+   ====================================================================== */
+void setFaultActive(FaultCode code, bool active, unsigned long nowMillis) {
+  unsigned long faultBit = 1UL << code;
+
+  // Faults may be updated from both the control tick and the background, so keep the bitmasks and ring consistent
+  noInterrupts();
+  faultStates[code].active = active;
+  if (active) {
+    activeFaultBitmask |= faultBit;
+    if (faultDefinitions[code].severity == FAULT_SEVERITY_CRITICAL) {
+      activeCriticalFaultBitmask |= faultBit;
+    }
+  } else {
+    activeFaultBitmask &= ~faultBit;
+    activeCriticalFaultBitmask &= ~faultBit;
+  }
+  globalAlarmCritical = (activeCriticalFaultBitmask != 0);
+
+  faultHistory[faultHistoryNextIndex] = {nowMillis, static_cast<byte>(code), active};
+  faultHistoryNextIndex = (faultHistoryNextIndex + 1) % faultHistorySize;
+  if (faultHistoryCount < faultHistorySize) {
+    faultHistoryCount++;
+  }
+  interrupts();
+  if (active) {
+    LOG_WARN(true, LOG_FAULT_RAISED, code);
+  } else {
+    LOG_INFO(true, LOG_FAULT_CLEARED, code);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Feed the latest state of a fault condition (constant time)
+   ====================================================================== */
+// Call every time the condition is checked. Debounce, latching and recovery are all applied here against the fault's definition.
+// Each fault code must only ever be updated from one context (the control tick or the background, not both).
+void updateFaultCondition(FaultCode code, bool conditionPresent) {
+  unsigned long nowMillis = halMillis();
+  const FaultDefinition *definition = &faultDefinitions[code];
+  FaultState *state = &faultStates[code];
+
+  if (conditionPresent != state->conditionPresent) {
+    state->conditionPresent = conditionPresent;
+    state->conditionChangedMillis = nowMillis;
+  }
+
+  if (conditionPresent && !state->active && (nowMillis - state->conditionChangedMillis) >= definition->debounceMillis) {
+    setFaultActive(code, true, nowMillis);
+  } else if (!conditionPresent && state->active && !definition->latching && (nowMillis - state->conditionChangedMillis) >= definition->recoveryMillis) {
+    setFaultActive(code, false, nowMillis);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Fault status queries
+   ====================================================================== */
+bool isFaultActive(FaultCode code) {
+  return (activeFaultBitmask & (1UL << code)) != 0;
+}
+
+bool isCriticalFaultActive() {
+  return activeCriticalFaultBitmask != 0;
+}
+
+unsigned long getFaultBitmask() {
+  return activeFaultBitmask;
+}
+
+unsigned long getCriticalFaultBitmask() {
+  return activeCriticalFaultBitmask;
+}
+
+/* ======================================================================
+   FUNCTION: Clear latched faults whose condition has gone away
+   ====================================================================== */
+void clearLatchedFaults() {
+  unsigned long nowMillis = halMillis();
+  for (int code = 0; code < FAULT_CODE_COUNT; code++) {
+    if (faultStates[code].active && faultDefinitions[code].latching && !faultStates[code].conditionPresent) {
+      setFaultActive(static_cast<FaultCode>(code), false, nowMillis);
+    }
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Copy out the fault history, oldest first
+   ====================================================================== */
+int getFaultHistory(FaultEvent *events, int maxEvents) {
+  noInterrupts();
+  int count = min(faultHistoryCount, maxEvents);
+  int startIndex = (faultHistoryNextIndex - count + faultHistorySize) % faultHistorySize;
+  for (int i = 0; i < count; i++) {
+    events[i] = faultHistory[(startIndex + i) % faultHistorySize];
+  }
+  interrupts();
+  return count;
+}
+
+/* ======================================================================
+   FUNCTION: Output active faults and fault history
+   ====================================================================== */
+void reportFaultStatus() {
+  Serial.print("\nActive faults (bitmask ");
+  Serial.print(getFaultBitmask(), HEX);
+  Serial.println("):");
+  for (int code = 0; code < FAULT_CODE_COUNT; code++) {
+    if (isFaultActive(static_cast<FaultCode>(code))) {
+      Serial.print("  ");
+      Serial.print(faultDefinitions[code].name);
+      Serial.println(faultDefinitions[code].severity == FAULT_SEVERITY_CRITICAL ? " (critical)" : " (warning)");
+    }
+  }
+
+  FaultEvent events[faultHistorySize];
+  int eventCount = getFaultHistory(events, faultHistorySize);
+  Serial.println("Fault history:");
+  for (int i = 0; i < eventCount; i++) {
+    Serial.print("  ");
+    Serial.print(events[i].timestampMillis);
+    Serial.print("ms ");
+    Serial.print(faultDefinitions[events[i].code].name);
+    Serial.println(events[i].raised ? " raised" : " cleared");
+  }
+  Serial.println();
+}
@@ -0,0 +1,54 @@
+#ifndef FAULTMANAGER_H
+#define FAULTMANAGER_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   ENUMS: Fault codes (bit position in the fault bitmask) and severities
+   ====================================================================== */
+enum FaultCode {
+  FAULT_COMMS_TIMEOUT,       // No command ID 1 from the master recently
+  FAULT_SERIAL_QUALITY,      // Too many partial, corrupt or bad checksum messages from the master
+  FAULT_OVERBOOST,           // Manifold pressure over the allowance above target for too long
+  FAULT_CONTROL_TICK_FAILED, // Hardware timer for the control tick could not be started
+  FAULT_CONTROL_TICK_OVERRUN, // Control tick took longer than its period
+  FAULT_INTAKE_SENSOR,        // Intake pressure outside anything the intake can see, pressure ratio uses boot atmospheric
+  FAULT_HEAP_ALLOCATION,      // Something allocated from the heap after setup() (HEAP_GUARD builds only)
+  FAULT_CODE_COUNT
+};
+
+enum FaultSeverity {
+  FAULT_SEVERITY_WARNING, // Reported only
+  FAULT_SEVERITY_CRITICAL // Sets globalAlarmCritical, target boost goes to 0 and the valve is left to the return spring
+};
+
+/* ======================================================================
+   STRUCTURES: Fault definitions and history
+   ====================================================================== */
+struct FaultDefinition {
+  const char *name;
+  FaultSeverity severity;
+  unsigned long debounceMillis; // Condition must be present this long before the fault is raised
+  bool latching;                // Once raised, stays raised until clearLatchedFaults() (command/faults) or a power cycle
+  unsigned long recoveryMillis; // Condition must be absent this long before a non latching fault clears
+};
+
+struct FaultEvent {
+  unsigned long timestampMillis;
+  byte code;
+  bool raised; // True when raised, false when cleared
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void updateFaultCondition(FaultCode, bool);
+bool isFaultActive(FaultCode);
+bool isCriticalFaultActive();
+unsigned long getFaultBitmask();
+unsigned long getCriticalFaultBitmask();
+void clearLatchedFaults();
+int getFaultHistory(FaultEvent *, int);
+void reportFaultStatus();
+
+#endif
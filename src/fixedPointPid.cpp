@@ -0,0 +1,117 @@
+#include "fixedPointPid.h"
+#include "hal.h"
+#include <PID_v1.h>
+
+/* ======================================================================
+   FUNCTION: Constructor, defaults match PID_v1
+   ====================================================================== */
+FixedPointPid::FixedPointPid(fixed16_t *pidInput, fixed16_t *pidOutput, fixed16_t *pidSetpoint, double pidKp, double pidKi, double pidKd, int pidDirection)
+    : input(pidInput), output(pidOutput), setpoint(pidSetpoint), direction(pidDirection), sampleTimeMillis(100), automatic(false) {
+  SetOutputLimits(0, 255);
+  SetTunings(pidKp, pidKi, pidKd);
+  lastTime = halMillis() - sampleTimeMillis;
+}
+
+/* ======================================================================
+   FUNCTION: Run the PID if SampleTime has passed, true if it did
+   ====================================================================== */
+bool FixedPointPid::Compute() {
+  if (!automatic) {
+    return false;
+  }
+  unsigned long now = halMillis();
+  if (now - lastTime < sampleTimeMillis) {
+    return false;
+  }
+
+  fixed16_t currentInput = *input;
+  fixed16_t error = *setpoint - currentInput;
+  fixed16_t inputChange = currentInput - lastInput;
+
+  // Sums in 64 bits so a saturated term can't wrap before it is clamped to the output limits
+  int64_t newOutputSum = static_cast<int64_t>(outputSum) + fixed16Multiply(ki, error);
+  outputSum = constrain(newOutputSum, static_cast<int64_t>(outputMinimum), static_cast<int64_t>(outputMaximum));
+  int64_t newOutput = static_cast<int64_t>(fixed16Multiply(kp, error)) + outputSum - fixed16Multiply(kd, inputChange);
+  *output = constrain(newOutput, static_cast<int64_t>(outputMinimum), static_cast<int64_t>(outputMaximum));
+
+  lastInput = currentInput;
+  lastTime = now;
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Gains, limits, sample time and mode
+   ====================================================================== */
+FixedPointPidTunings FixedPointPid::ScaleTunings(double pidKp, double pidKi, double pidKd, int pidSampleTimeMillis) {
+  double sampleTimeSeconds = pidSampleTimeMillis / 1000.0;
+  FixedPointPidTunings tunings;
+  tunings.displayKp = pidKp;
+  tunings.displayKi = pidKi;
+  tunings.displayKd = pidKd;
+  tunings.kp = fixed16FromDouble(pidKp);
+  tunings.ki = fixed16FromDouble(pidKi * sampleTimeSeconds);
+  tunings.kd = fixed16FromDouble(pidKd / sampleTimeSeconds);
+  return tunings;
+}
+
+void FixedPointPid::SetTunings(double pidKp, double pidKi, double pidKd) {
+  FixedPointPidTunings tunings = ScaleTunings(pidKp, pidKi, pidKd, sampleTimeMillis);
+  SetTunings(&tunings);
+}
+
+// Negative gains are ignored as PID_v1 does, and the tunings must have been scaled for this PID's sample time
+void FixedPointPid::SetTunings(const FixedPointPidTunings *tunings) {
+  if (tunings->kp < 0 || tunings->ki < 0 || tunings->kd < 0) {
+    return;
+  }
+  displayKp = tunings->displayKp;
+  displayKi = tunings->displayKi;
+  displayKd = tunings->displayKd;
+  kp = (direction == REVERSE) ? -tunings->kp : tunings->kp;
+  ki = (direction == REVERSE) ? -tunings->ki : tunings->ki;
+  kd = (direction == REVERSE) ? -tunings->kd : tunings->kd;
+}
+
+void FixedPointPid::SetSampleTime(int newSampleTimeMillis) {
+  if (newSampleTimeMillis > 0) {
+    sampleTimeMillis = newSampleTimeMillis;
+    SetTunings(displayKp, displayKi, displayKd);
+  }
+}
+
+void FixedPointPid::SetOutputLimits(double minimum, double maximum) {
+  if (minimum >= maximum) {
+    return;
+  }
+  outputMinimum = fixed16FromDouble(minimum);
+  outputMaximum = fixed16FromDouble(maximum);
+  if (automatic) {
+    *output = constrain(*output, outputMinimum, outputMaximum);
+    outputSum = constrain(outputSum, outputMinimum, outputMaximum);
+  }
+}
+
+void FixedPointPid::SetMode(int mode) {
+  bool newAutomatic = (mode == AUTOMATIC);
+  if (newAutomatic && !automatic) {
+    Initialize(); // Bumpless transfer from manual
+  }
+  automatic = newAutomatic;
+}
+
+void FixedPointPid::Initialize() {
+  outputSum = constrain(*output, outputMinimum, outputMaximum);
+  lastInput = *input;
+}
+
+double FixedPointPid::GetKp() {
+  return displayKp;
+}
+
+double FixedPointPid::GetKi() {
+  return displayKi;
+}
+
+double FixedPointPid::GetKd() {
+  return displayKd;
+}
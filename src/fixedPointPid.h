@@ -0,0 +1,82 @@
+#ifndef FIXEDPOINTPID_H
+#define FIXEDPOINTPID_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   HELPERS: Q16.16 fixed point
+   ====================================================================== */
+typedef int32_t fixed16_t;
+
+const fixed16_t fixed16One = 65536L;
+
+inline fixed16_t fixed16FromDouble(double value) {
+  return static_cast<fixed16_t>(lround(value * fixed16One));
+}
+
+inline double fixed16ToDouble(fixed16_t value) {
+  return static_cast<double>(value) / fixed16One;
+}
+
+inline fixed16_t fixed16FromInt(int value) {
+  return static_cast<fixed16_t>(value) * fixed16One;
+}
+
+// Saturates rather than wrapping, so a silly gain times a large error pins the output instead of flipping its sign
+inline fixed16_t fixed16Multiply(fixed16_t a, fixed16_t b) {
+  int64_t product = (static_cast<int64_t>(a) * b) >> 16;
+  return static_cast<fixed16_t>(constrain(product, static_cast<int64_t>(INT32_MIN), static_cast<int64_t>(INT32_MAX)));
+}
+
+// Callers make sure b is not 0, saturates like fixed16Multiply
+inline fixed16_t fixed16Divide(fixed16_t a, fixed16_t b) {
+  int64_t quotient = (static_cast<int64_t>(a) << 16) / b;
+  return static_cast<fixed16_t>(constrain(quotient, static_cast<int64_t>(INT32_MIN), static_cast<int64_t>(INT32_MAX)));
+}
+
+/* ======================================================================
+   STRUCTURES: Gains already converted for a given sample time
+   ====================================================================== */
+// Made by FixedPointPid::ScaleTunings() on the background side, so setting them from the control tick is integer only
+struct FixedPointPidTunings {
+  double displayKp, displayKi, displayKd; // As given, what GetKp() and friends hand back
+  fixed16_t kp, ki, kd;                   // Ki and Kd scaled by the sample time, direction not applied yet
+};
+
+/* ======================================================================
+   CLASS: PID_v1 in Q16.16, same interface and behaviour
+   ====================================================================== */
+// Proportional on error, derivative on measurement, integral clamped to the output limits and nothing computed until
+// SampleTime has passed, exactly as PID_v1 does it. Gains can be set as doubles, or from FixedPointPidTunings scaled for
+// the PID's sample time where the doubles can't be converted on the spot.
+class FixedPointPid {
+public:
+  FixedPointPid(fixed16_t *, fixed16_t *, fixed16_t *, double, double, double, int);
+  static FixedPointPidTunings ScaleTunings(double, double, double, int);
+  bool Compute();
+  void SetMode(int);
+  void SetOutputLimits(double, double);
+  void SetTunings(double, double, double);
+  void SetTunings(const FixedPointPidTunings *);
+  void SetSampleTime(int);
+  double GetKp();
+  double GetKi();
+  double GetKd();
+
+private:
+  void Initialize();
+
+  fixed16_t *input;
+  fixed16_t *output;
+  fixed16_t *setpoint;
+  double displayKp, displayKi, displayKd;
+  fixed16_t kp, ki, kd; // Ki and Kd already scaled by the sample time, all negated for REVERSE
+  int direction;
+  unsigned long sampleTimeMillis;
+  unsigned long lastTime;
+  fixed16_t outputSum, lastInput;
+  fixed16_t outputMinimum, outputMaximum;
+  bool automatic;
+};
+
+#endif
@@ -1,4 +1,8 @@
 #include "globalHelpers.h"
+#include "controlTick.h"
+#include "faultManager.h"
+#include "hal.h"
+#include "timeSync.h"
 #include <light_CD74HC4067.h>
 
 /* ======================================================================
@@ -14,8 +18,7 @@ const byte muxSignalPin = A3;
 /* ======================================================================
    GLOBAL VARIABLES: Use throughout code
    ====================================================================== */
-bool globalAlarmCritical = false;
-unsigned long lastSuccessfulCommandId1Processed = millis();
+bool globalAlarmCritical = false; // Only written by the fault manager, true while any critical fault is active
 
 /* ======================================================================
    OBJECT DECLARATIOS
@@ -28,32 +31,27 @@ CD74HC4067 mux(muxS0Pin, muxS1Pin, muxS2Pin, muxS3Pin);
 const int millisWithoutSerialCommsBeforeFault = 1000; // How long is ms without serial comms from the master before we declare a critical alarm
 
 /* ======================================================================
-   FUNCTION: Check various fault conditions and set alarms if needed
+   FUNCTION: Check various fault conditions and update the fault manager
    ====================================================================== */
-const float overboostAllowancePressure = 1.1; // Allow some amount of wiggle to absorp transient readings
-const int overboostAllowanceTime = 8000;      // Time we must be in overboost before setting alarm condition TODO: Set back when not debugging !!!
-unsigned long overboostStartMillis;
-bool inOverboost = false;
-
-void checkAndSetFaultConditions(double *currentManifoldPressurekPa, double *currentTargetBoostkPa) {
-  // Messages from the master not received recently
-  if (millis() > 10000 && (millis() > lastSuccessfulCommandId1Processed + millisWithoutSerialCommsBeforeFault)) {
-    DEBUG_SERIAL_SEND("Setting critical alarm due to serial comms outage !!");
-    globalAlarmCritical = true;
+// Overboost itself is detected every control tick against a limit, hysteresis and dwell per target band, see
+// updateOverboostProtection() in boostController.cpp. Here it is only handed on to the fault manager.
+void checkAndSetFaultConditions(bool *overboostDetected, double *currentManifoldPressurekPa, double *overboostLimitkPa) {
+  // Nothing is trustworthy until the master and sensors have had time to settle after power on
+  if (halMillis() <= 10000) {
+    return;
   }
 
+  // Inputs from the master not refreshed recently, aged from when the master sampled them once time sync is running
+  bool commsTimedOut = (getOldestMasterInputAgeMillis() > millisWithoutSerialCommsBeforeFault);
+  if (commsTimedOut && !isFaultActive(FAULT_COMMS_TIMEOUT)) {
+    DEBUG_SERIAL_SEND(LOG_SERIAL_COMMS_OUTAGE);
+  }
+  updateFaultCondition(FAULT_COMMS_TIMEOUT, commsTimedOut);
+
   // Overboosting above allowance (in amount and in time) is detected
-  if (*currentManifoldPressurekPa > (*currentTargetBoostkPa * overboostAllowancePressure)) {
-    if (inOverboost == false) {
-      inOverboost = true;
-      overboostStartMillis = millis();
-    }
-    if ((millis() - overboostStartMillis) > overboostAllowanceTime && inOverboost == true && millis() > 10000) {
-      DEBUG_BOOST("Setting critical alarm due to over boosting !! " + String(*currentManifoldPressurekPa) + "kPa vs " + String(*currentTargetBoostkPa * overboostAllowancePressure) + "kPa");
-      globalAlarmCritical = true;
-    }
-  } else {
-    inOverboost = false;
+  updateFaultCondition(FAULT_OVERBOOST, *overboostDetected);
+  if (*overboostDetected && isFaultActive(FAULT_OVERBOOST)) {
+    DEBUG_BOOST(LOG_BOOST_OVERBOOST_ALARM, *currentManifoldPressurekPa, *overboostLimitkPa);
   }
 }
 
@@ -73,12 +71,20 @@ float calculateBosch3BarKpaFromRaw(float sensorReadingRaw) {
   return pressureKpa;
 }
 
+// Same straight line in Q16.16 for the fixed point control core, slope and intercept worked out once at startup
+const int32_t boschKpaPerRawQ16 = lround((5.0 / 1023) / (boschMagicNumber2 * sensorSupplyVoltage) * 65536.0);
+const int32_t boschKpaAtZeroRawQ16 = lround(-(boschMagicNumber1 * sensorSupplyVoltage) / (boschMagicNumber2 * sensorSupplyVoltage) * 65536.0);
+
+int32_t calculateBosch3BarKpaQ16FromRaw(int sensorReadingRaw) {
+  return static_cast<int32_t>(sensorReadingRaw) * boschKpaPerRawQ16 + boschKpaAtZeroRawQ16;
+}
+
 /* ======================================================================
    FUNCTION: Setup the multiplexer
    ====================================================================== */
 void setupMux() {
-  DEBUG_GENERAL("Configuring mux board ...");
-  pinMode(muxSignalPin, INPUT);
+  DEBUG_GENERAL(LOG_GENERAL_CONFIGURING_MUX);
+  halPinMode(muxSignalPin, INPUT);
 }
 
 /* ======================================================================
@@ -89,13 +95,28 @@ int getAveragedAnaloguePinReading(byte pin, int samples, int delayUs) {
 
   for (int i = 0; i < samples; i++) {
     if (delayUs != 0) {
-      delayMicroseconds(delayUs);
+      halDelayMicros(delayUs);
     }
-    totalReadings += analogRead(pin);
+    totalReadings += halAdcRead(pin);
   }
 
   // Calculate average of the readings
-  int averageReading = totalReadings / static_cast<float>(samples);
+  int averageReading = totalReadings / samples;
+  return averageReading;
+}
+
+/* ======================================================================
+   FUNCTION: Get average readings from analogue pin, each one taken at the quiet point of a PWM output's period
+   ====================================================================== */
+// For sensors picking up the motor's switching noise, see halAdcReadPwmSynced()
+int getPwmSyncedAnaloguePinReading(byte pin, byte pwmPin, int samples) {
+  int totalReadings = 0;
+
+  for (int i = 0; i < samples; i++) {
+    totalReadings += halAdcReadPwmSynced(pin, pwmPin);
+  }
+
+  int averageReading = totalReadings / samples;
   return averageReading;
 }
 
@@ -104,7 +125,20 @@ int getAveragedAnaloguePinReading(byte pin, int samples, int delayUs) {
    ====================================================================== */
 int getAveragedMuxAnalogueChannelReading(byte channel, int samples, int delayUs) {
   mux.channel(channel);
-  int averageReading = getAveragedAnaloguePinReading(muxSignalPin, samples, delayUs);
+  int totalReadings = 0;
+
+  // Only ever called from the background, and the control tick shares the ADC. Keep the tick (and only the tick) out for
+  // the duration of each individual conversion so it can't reconfigure the ADC underneath us.
+  for (int i = 0; i < samples; i++) {
+    if (delayUs != 0) {
+      halDelayMicros(delayUs);
+    }
+    maskControlTick();
+    totalReadings += halAdcRead(muxSignalPin);
+    unmaskControlTick();
+  }
+
+  int averageReading = totalReadings / samples;
   return averageReading;
 }
 
@@ -114,15 +148,20 @@ int getAveragedMuxAnalogueChannelReading(byte channel, int samples, int delayUs)
 unsigned long arduinoLoopExecutionPreviousExecutionMillis;
 
 void reportArduinoLoopRate(unsigned long *loopCount) {
-  float loopFrequencyHz = (*loopCount / ((millis() - arduinoLoopExecutionPreviousExecutionMillis) / 1000));
-  float loopExecutionMs = (millis() - arduinoLoopExecutionPreviousExecutionMillis) / *loopCount;
+  unsigned long elapsedMillis = halMillis() - arduinoLoopExecutionPreviousExecutionMillis;
+  if (*loopCount == 0 || elapsedMillis == 0) {
+    return;
+  }
+
+  float loopFrequencyHz = *loopCount / (elapsedMillis / 1000.0);
+  float loopExecutionMs = static_cast<float>(elapsedMillis) / *loopCount;
   Serial.print("Loop execution frequency (Hz): ");
   Serial.print(loopFrequencyHz);
   Serial.print(" or every ");
   Serial.print(loopExecutionMs);
   Serial.println("ms");
-  *loopCount = 1;
-  arduinoLoopExecutionPreviousExecutionMillis = millis();
+  *loopCount = 0;
+  arduinoLoopExecutionPreviousExecutionMillis = halMillis();
 }
 
 /* ======================================================================
@@ -1,6 +1,7 @@
 #ifndef GLOBALHELPERS_H
 #define GLOBALHELPERS_H
 
+#include "logBuffer.h"
 #include <Arduino.h>
 
 /* ======================================================================
@@ -17,72 +18,29 @@ extern bool debugPid;
    HELPERS: Variables to determine alarm status
    ====================================================================== */
 extern bool globalAlarmCritical;
-extern unsigned long lastSuccessfulCommandId1Processed;
 
 /* ======================================================================
    HELPERS: Debug output definitions
    ====================================================================== */
-// Define the DEBUG_SERIAL_RECEIVE macro
-#define DEBUG_SERIAL_RECEIVE(message)          \
-  do {                                         \
-    if (debugSerialReceive) {                  \
-      Serial.print("[DEBUG SERIAL RECEIVE] "); \
-      Serial.println(message);                 \
-    }                                          \
-  } while (0)
-
-// Define the DEBUG_SERIAL_SEND macro
-#define DEBUG_SERIAL_SEND(message)          \
-  do {                                      \
-    if (debugSerialSend) {                  \
-      Serial.print("[DEBUG SERIAL SEND] "); \
-      Serial.println(message);              \
-    }                                       \
-  } while (0)
-
-// Define the DEBUG_VALVE macro
-#define DEBUG_VALVE(message)          \
-  do {                                \
-    if (debugValveControl) {          \
-      Serial.print("[DEBUG VALVE] "); \
-      Serial.println(message);        \
-    }                                 \
-  } while (0)
-
-// Define the DEBUG_BOOST macro
-#define DEBUG_BOOST(message)          \
-  do {                                \
-    if (debugBoost) {                 \
-      Serial.print("[DEBUG BOOST] "); \
-      Serial.println(message);        \
-    }                                 \
-  } while (0)
-
-// Define the DEBUG_PID macro
-#define DEBUG_PID(message)          \
-  do {                              \
-    if (debugPid) {                 \
-      Serial.print("[DEBUG PID] "); \
-      Serial.println(message);      \
-    }                               \
-  } while (0)
-
-// Define the DEBUG_GENERAL macro
-#define DEBUG_GENERAL(message)          \
-  do {                                  \
-    if (debugGeneral) {                 \
-      Serial.print("[DEBUG GENERAL] "); \
-      Serial.println(message);          \
-    }                                   \
-  } while (0)
+// Usage is DEBUG_VALVE(LOG_MESSAGE_ID, args...) with the message text in logMessages.h. Each call only pushes a small
+// binary record into the log ring, formatting and printing happen in idle time from serviceLogOutput(). Safe to call
+// from the control tick, and compiled out entirely when LOG_COMPILE_LEVEL is below LOG_LEVEL_DEBUG.
+#define DEBUG_SERIAL_RECEIVE(...) LOG_DEBUG(debugSerialReceive, __VA_ARGS__)
+#define DEBUG_SERIAL_SEND(...) LOG_DEBUG(debugSerialSend, __VA_ARGS__)
+#define DEBUG_VALVE(...) LOG_DEBUG(debugValveControl, __VA_ARGS__)
+#define DEBUG_BOOST(...) LOG_DEBUG(debugBoost, __VA_ARGS__)
+#define DEBUG_PID(...) LOG_DEBUG(debugPid, __VA_ARGS__)
+#define DEBUG_GENERAL(...) LOG_DEBUG(debugGeneral, __VA_ARGS__)
 
 /* ======================================================================
    FUNCTION PROTOTYPES
    ====================================================================== */
 float calculateBosch3BarKpaFromRaw(float);
+int32_t calculateBosch3BarKpaQ16FromRaw(int);
 int getAveragedAnaloguePinReading(byte, int, int);
+int getPwmSyncedAnaloguePinReading(byte, byte, int);
 int getAveragedMuxAnalogueChannelReading(byte, int, int);
-void checkAndSetFaultConditions(double *, double *);
+void checkAndSetFaultConditions(bool *, double *, double *);
 void outputArduinoIdePlotterData(double *, double *, double *, double *, double *);
 void reportArduinoLoopRate(unsigned long *);
 void setupMux();
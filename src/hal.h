@@ -0,0 +1,57 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   HAL: The only hardware the portable modules touch
+   ====================================================================== */
+// halTarget.cpp maps these straight onto the UNO R4 core. halNative.cpp (built with -DHAL_NATIVE for [env:native])
+// backs them with simulated ADC inputs, captured outputs, an in memory UART and a clock that only moves when told to,
+// so the control, protocol and boost target logic can run on the host.
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: ADC
+   ====================================================================== */
+// halAdcReadPwmSynced() starts the conversion at the quiet point of the given PWM output's period, see halTarget.cpp.
+// Its waits share the budget last given to halAdcStartSyncBudget() (once per control tick), halAdcSyncWaitMicros() is how
+// much of it has been used.
+int halAdcRead(byte);
+int halAdcReadPwmSynced(byte, byte);
+void halAdcStartSyncBudget(unsigned long);
+unsigned long halAdcSyncWaitMicros();
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: GPIO and PWM
+   ====================================================================== */
+void halPinMode(byte, byte);
+void halDigitalWrite(byte, byte);
+// halPwmWriteQ16() takes the duty in Q16.16 percent, so the fixed point control core drives the motor without floats
+bool halPwmBegin(byte, float);
+void halPwmWrite(byte, float);
+void halPwmWriteQ16(byte, int32_t);
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: UART to the master
+   ====================================================================== */
+void halUartBegin(unsigned long);
+int halUartAvailable();
+int halUartPeek();
+int halUartRead();
+size_t halUartWrite(const char *, size_t);
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: Monotonic clock
+   ====================================================================== */
+unsigned long halMillis();
+unsigned long halMicros();
+void halDelayMicros(unsigned int);
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: Persistent storage
+   ====================================================================== */
+int halStorageSize();
+bool halStorageRead(int, void *, int);
+bool halStorageWrite(int, const void *, int);
+
+#endif
@@ -0,0 +1,407 @@
+#ifdef HAL_NATIVE
+
+#include "halNative.h"
+#include "controlTick.h"
+#include <WiFiS3.h>
+#include <chrono>
+#include <thread>
+
+/* ======================================================================
+   VARIABLES: Simulated hardware state
+   ====================================================================== */
+const int halNativePinCount = 32;
+const int halNativeUartBufferSize = 1024;
+const int halNativeStorageBytes = 8192; // Same as the R4 data flash
+
+int halNativeAdcValues[halNativePinCount];
+int (*halNativeAdcSource)(byte) = nullptr;
+byte halNativeDigitalValues[halNativePinCount];
+float halNativePwmDuty[halNativePinCount];
+float halNativePwmFrequencyHz[halNativePinCount];
+
+// Motor switching noise. Every PWM edge rings on the ADC inputs as a decaying oscillation, so what a read sees depends on
+// how long after an edge it was taken. A plain read lands anywhere in the period, a synchronised one at the quiet point.
+// Off unless a simulation turns it on, so replays and the plant model simulations read exactly what they were given.
+const float halNativeRingingDecayMicros = 2.0;
+const float halNativeRingingFrequencyMHz = 1.0;
+float halNativeRingingCounts = 0.0;
+float halNativeWhiteNoiseCounts = 0.0;
+uint32_t halNativeNoiseState = 1;
+
+// The wait for a quiet point is modelled rather than spent, so it counts against the budget without moving the clock
+unsigned long halNativeAdcSyncBudgetMicros = 0xFFFFFFFF;
+float halNativeAdcSyncWaitedMicros = 0.0f;
+
+char halNativeUartRx[halNativeUartBufferSize];
+int halNativeUartRxHead = 0;
+int halNativeUartRxTail = 0;
+char halNativeUartTx[halNativeUartBufferSize];
+int halNativeUartTxLength = 0;
+
+uint64_t halNativeClockMicros = 0;
+bool halNativeRealClock = false;
+const auto halNativeClockStart = std::chrono::steady_clock::now();
+
+uint8_t halNativeStorage[halNativeStorageBytes];
+
+HardwareSerial Serial(false);
+HardwareSerial Serial1(true);
+WiFiClient wifiClient; // Never connects, the MQTT tests swap in a fake broker with setMqttTransport()
+
+/* ======================================================================
+   FUNCTION: Host side controls
+   ====================================================================== */
+void halNativeSetAdc(byte pin, int value) {
+  if (pin < halNativePinCount) {
+    halNativeAdcValues[pin] = value;
+  }
+}
+
+void halNativeSetAdcSource(int (*source)(byte)) {
+  halNativeAdcSource = source;
+}
+
+void halNativeSetSwitchingNoise(float ringingCounts, float whiteNoiseCounts) {
+  halNativeRingingCounts = ringingCounts;
+  halNativeWhiteNoiseCounts = whiteNoiseCounts;
+  halNativeNoiseState = 1; // Same sequence every run
+}
+
+byte halNativeGetDigital(byte pin) {
+  return (pin < halNativePinCount) ? halNativeDigitalValues[pin] : LOW;
+}
+
+float halNativeGetPwm(byte pin) {
+  return (pin < halNativePinCount) ? halNativePwmDuty[pin] : 0.0f;
+}
+
+void halNativeUartInject(const char *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    int next = (halNativeUartRxHead + 1) % halNativeUartBufferSize;
+    if (next == halNativeUartRxTail) {
+      return; // Full, drop like a real UART overrun
+    }
+    halNativeUartRx[halNativeUartRxHead] = data[i];
+    halNativeUartRxHead = next;
+  }
+}
+
+size_t halNativeUartTakeOutput(char *buffer, size_t bufferSize) {
+  size_t length = min(static_cast<size_t>(halNativeUartTxLength), bufferSize - 1);
+  memcpy(buffer, halNativeUartTx, length);
+  buffer[length] = '\0';
+  halNativeUartTxLength = 0;
+  return length;
+}
+
+void halNativeAdvanceMicros(unsigned long us) {
+  halNativeClockMicros += us;
+}
+
+void halNativeUseRealClock(bool useRealClock) {
+  halNativeRealClock = useRealClock;
+}
+
+bool halNativeStorageLoad(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  size_t length = fread(halNativeStorage, 1, sizeof(halNativeStorage), file);
+  fclose(file);
+  return length == sizeof(halNativeStorage);
+}
+
+bool halNativeStorageSave(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  size_t length = fwrite(halNativeStorage, 1, sizeof(halNativeStorage), file);
+  fclose(file);
+  return length == sizeof(halNativeStorage);
+}
+
+/* ======================================================================
+   FUNCTION: Switching noise model
+   ====================================================================== */
+// Uniform in [0, 1)
+float halNativeNoiseUniform() {
+  halNativeNoiseState = halNativeNoiseState * 1664525u + 1013904223u;
+  return (halNativeNoiseState >> 8) / 16777216.0f;
+}
+
+// Zero mean, unit deviation
+float halNativeNoiseGaussian() {
+  float u1 = max(halNativeNoiseUniform(), 1e-7f);
+  return sqrtf(-2.0f * logf(u1)) * cosf(2.0f * PI * halNativeNoiseUniform());
+}
+
+// Rising edge at the start of the period and falling edge at the duty, ringing from whichever was last
+float halNativeRinging(byte pwmPin, float phase) {
+  float duty = halNativePwmDuty[pwmPin] / 100.0f;
+  if (duty <= 0.0f || duty >= 1.0f || halNativePwmFrequencyHz[pwmPin] <= 0.0f) {
+    return 0.0f;
+  }
+  float sinceEdgeMicros = ((phase >= duty) ? phase - duty : phase) * 1000000.0f / halNativePwmFrequencyHz[pwmPin];
+  return halNativeRingingCounts * expf(-sinceEdgeMicros / halNativeRingingDecayMicros) * cosf(2.0f * PI * halNativeRingingFrequencyMHz * sinceEdgeMicros);
+}
+
+// Same quiet point as halTarget.cpp, the middle of the longer of the on and off phases
+float halNativePwmQuietPhase(float dutyPercent) {
+  float duty = dutyPercent / 100.0f;
+  return (duty >= 0.5f) ? duty / 2.0f : (1.0f + duty) / 2.0f;
+}
+
+int halNativeAddNoise(int value, float ringing) {
+  float noisy = value + ringing + halNativeWhiteNoiseCounts * halNativeNoiseGaussian();
+  return constrain(static_cast<int>(lroundf(noisy)), 0, 1023);
+}
+
+/* ======================================================================
+   FUNCTION: ADC
+   ====================================================================== */
+int halNativeAdcValue(byte pin) {
+  if (halNativeAdcSource != nullptr) {
+    return halNativeAdcSource(pin);
+  }
+  return (pin < halNativePinCount) ? halNativeAdcValues[pin] : 0;
+}
+
+// Taken at an arbitrary point in every PWM period, so each running output's ringing adds in at its own random phase
+int halAdcRead(byte pin) {
+  int value = halNativeAdcValue(pin);
+  if (halNativeRingingCounts == 0.0f && halNativeWhiteNoiseCounts == 0.0f) {
+    return value;
+  }
+  float ringing = 0.0f;
+  for (int pwmPin = 0; pwmPin < halNativePinCount; pwmPin++) {
+    ringing += halNativeRinging(pwmPin, halNativeNoiseUniform());
+  }
+  return halNativeAddNoise(value, ringing);
+}
+
+void halAdcStartSyncBudget(unsigned long budgetMicros) {
+  halNativeAdcSyncBudgetMicros = budgetMicros;
+  halNativeAdcSyncWaitedMicros = 0.0f;
+}
+
+unsigned long halAdcSyncWaitMicros() {
+  return lroundf(halNativeAdcSyncWaitedMicros);
+}
+
+// The clock doesn't move for the wait, a replay sees the same tick timing either way. The read is called at an arbitrary
+// phase and waits until it is within the target's window of the quiet point, or the budget runs out and it reads there.
+int halAdcReadPwmSynced(byte pin, byte pwmPin) {
+  int value = halNativeAdcValue(pin);
+  if ((halNativeRingingCounts == 0.0f && halNativeWhiteNoiseCounts == 0.0f) || pwmPin >= halNativePinCount) {
+    return value;
+  }
+  float duty = halNativePwmDuty[pwmPin] / 100.0f;
+  if (duty <= 0.0f || duty >= 1.0f || halNativePwmFrequencyHz[pwmPin] <= 0.0f) {
+    return halNativeAddNoise(value, 0.0f);
+  }
+
+  const float quietWindowFraction = 0.1f; // halPwmQuietWindowFraction
+  float periodMicros = 1000000.0f / halNativePwmFrequencyHz[pwmPin];
+  float phase = halNativeNoiseUniform();
+  float quietPhase = halNativePwmQuietPhase(halNativePwmDuty[pwmPin]);
+  float toQuiet = fmodf(quietPhase - quietWindowFraction - phase + 2.0f, 1.0f);
+  float waitMicros = (toQuiet >= 1.0f - 2.0f * quietWindowFraction) ? 0.0f : toQuiet * periodMicros;
+  float budgetLeftMicros = max(0.0f, static_cast<float>(halNativeAdcSyncBudgetMicros) - halNativeAdcSyncWaitedMicros);
+  if (waitMicros > budgetLeftMicros) {
+    halNativeAdcSyncWaitedMicros += budgetLeftMicros;
+    return halNativeAddNoise(value, halNativeRinging(pwmPin, fmodf(phase + budgetLeftMicros / periodMicros, 1.0f)));
+  }
+  halNativeAdcSyncWaitedMicros += waitMicros;
+  return halNativeAddNoise(value, halNativeRinging(pwmPin, (waitMicros > 0.0f) ? quietPhase - quietWindowFraction : phase));
+}
+
+/* ======================================================================
+   FUNCTION: GPIO and PWM
+   ====================================================================== */
+void halPinMode(byte, byte) {
+}
+
+void halDigitalWrite(byte pin, byte value) {
+  if (pin < halNativePinCount) {
+    halNativeDigitalValues[pin] = value;
+  }
+}
+
+bool halPwmBegin(byte pin, float frequencyHz) {
+  halPwmWrite(pin, 0.0f);
+  if (pin < halNativePinCount) {
+    halNativePwmFrequencyHz[pin] = frequencyHz;
+  }
+  return pin < halNativePinCount;
+}
+
+void halPwmWrite(byte pin, float dutyPercent) {
+  if (pin < halNativePinCount) {
+    halNativePwmDuty[pin] = dutyPercent;
+  }
+}
+
+// Kept at full resolution like halPwmWrite(), so the float and fixed point replays drive the same simulated motor
+void halPwmWriteQ16(byte pin, int32_t dutyPercentQ16) {
+  halPwmWrite(pin, dutyPercentQ16 / 65536.0f);
+}
+
+/* ======================================================================
+   FUNCTION: UART to the master
+   ====================================================================== */
+void halUartBegin(unsigned long) {
+  halNativeUartRxHead = halNativeUartRxTail = 0;
+  halNativeUartTxLength = 0;
+}
+
+int halUartAvailable() {
+  return (halNativeUartRxHead - halNativeUartRxTail + halNativeUartBufferSize) % halNativeUartBufferSize;
+}
+
+int halUartPeek() {
+  return (halUartAvailable() > 0) ? static_cast<unsigned char>(halNativeUartRx[halNativeUartRxTail]) : -1;
+}
+
+int halUartRead() {
+  int value = halUartPeek();
+  if (value >= 0) {
+    halNativeUartRxTail = (halNativeUartRxTail + 1) % halNativeUartBufferSize;
+  }
+  return value;
+}
+
+size_t halUartWrite(const char *data, size_t length) {
+  length = min(length, static_cast<size_t>(halNativeUartBufferSize - halNativeUartTxLength));
+  memcpy(&halNativeUartTx[halNativeUartTxLength], data, length);
+  halNativeUartTxLength += length;
+  return length;
+}
+
+/* ======================================================================
+   FUNCTION: Monotonic clock, simulated unless switched to real time
+   ====================================================================== */
+unsigned long halMicros() {
+  if (halNativeRealClock) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - halNativeClockStart).count();
+  }
+  return static_cast<unsigned long>(halNativeClockMicros);
+}
+
+unsigned long halMillis() {
+  if (halNativeRealClock) {
+    return halMicros() / 1000;
+  }
+  return static_cast<unsigned long>(halNativeClockMicros / 1000);
+}
+
+void halDelayMicros(unsigned int us) {
+  if (halNativeRealClock) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+    return;
+  }
+  halNativeAdvanceMicros(us);
+}
+
+/* ======================================================================
+   FUNCTION: Persistent storage, in memory (load / save to a file from host code)
+   ====================================================================== */
+int halStorageSize() {
+  return halNativeStorageBytes;
+}
+
+bool halStorageRead(int address, void *data, int length) {
+  if (address < 0 || address + length > halStorageSize()) {
+    return false;
+  }
+  memcpy(data, &halNativeStorage[address], length);
+  return true;
+}
+
+bool halStorageWrite(int address, const void *data, int length) {
+  if (address < 0 || address + length > halStorageSize()) {
+    return false;
+  }
+  memcpy(&halNativeStorage[address], data, length);
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Arduino core functions for the host shim (native/Arduino.h)
+   ====================================================================== */
+int HardwareSerial::available() {
+  return masterUart ? halUartAvailable() : 0;
+}
+
+int HardwareSerial::peek() {
+  return masterUart ? halUartPeek() : -1;
+}
+
+int HardwareSerial::read() {
+  return masterUart ? halUartRead() : -1;
+}
+
+size_t HardwareSerial::write(uint8_t value) {
+  if (masterUart) {
+    return halUartWrite(reinterpret_cast<const char *>(&value), 1);
+  }
+  return fputc(value, stdout) == EOF ? 0 : 1;
+}
+
+unsigned long millis() {
+  return halMillis();
+}
+
+unsigned long micros() {
+  return halMicros();
+}
+
+void delay(unsigned long ms) {
+  if (halNativeRealClock) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    return;
+  }
+  halNativeAdvanceMicros(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  halDelayMicros(us);
+}
+
+int analogRead(uint8_t pin) {
+  return halAdcRead(pin);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  halPinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  halDigitalWrite(pin, value);
+}
+
+int digitalRead(uint8_t pin) {
+  return halNativeGetDigital(pin);
+}
+
+long map(long value, long fromLow, long fromHigh, long toLow, long toHigh) {
+  return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+void noInterrupts() {
+}
+
+void interrupts() {
+}
+
+/* ======================================================================
+   FUNCTION: Control tick masking (controlTick.cpp), there is no tick timer on the host
+   ====================================================================== */
+void maskControlTick() {
+}
+
+void unmaskControlTick() {
+}
+
+#endif
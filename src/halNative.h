@@ -0,0 +1,25 @@
+#ifndef HALNATIVE_H
+#define HALNATIVE_H
+
+#ifdef HAL_NATIVE
+
+#include "hal.h"
+
+/* ======================================================================
+   FUNCTION PROTOTYPES: Driving the simulated hardware from host code
+   ====================================================================== */
+void halNativeSetAdc(byte, int);
+void halNativeSetAdcSource(int (*)(byte)); // Called for every read when set, e.g. a plant model
+void halNativeSetSwitchingNoise(float, float); // Motor PWM ringing and white noise on every read in counts, both 0 by default
+byte halNativeGetDigital(byte);
+float halNativeGetPwm(byte);
+void halNativeUartInject(const char *, size_t);
+size_t halNativeUartTakeOutput(char *, size_t);
+void halNativeAdvanceMicros(unsigned long);
+void halNativeUseRealClock(bool);
+bool halNativeStorageLoad(const char *);
+bool halNativeStorageSave(const char *);
+
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef HAL_NATIVE
+
+#include "hal.h"
+#include <EEPROM.h>
+
+#if !defined(ARDUINO_ARCH_AVR)
+#include "pwm.h"
+#include <new>
+
+/* ======================================================================
+   VARIABLES: PWM outputs
+   ====================================================================== */
+// PwmOut needs its pin at construction, so outputs are built in place on first use rather than allocated
+const int halPwmMaxOutputs = 2;
+alignas(PwmOut) unsigned char halPwmStorage[halPwmMaxOutputs][sizeof(PwmOut)];
+PwmOut *halPwmOutputs[halPwmMaxOutputs] = {nullptr};
+byte halPwmPins[halPwmMaxOutputs];
+float halPwmDutyPercent[halPwmMaxOutputs];
+
+// A synchronised conversion starts within this fraction of a period either side of the quiet point. At 25kHz that is
+// +/-4us, leaving at least 6us to the nearest switching edge. If the quiet point doesn't come round in time (the timer
+// stopped, or a very long interrupt in between) the conversion goes ahead anyway.
+const float halPwmQuietWindowFraction = 0.1;
+const unsigned long halPwmSyncTimeoutMicros = 100;
+#endif
+
+// Total wait allowed since the budget was last started, and how much of it has gone. No limit until the first tick.
+unsigned long halAdcSyncBudgetMicros = 0xFFFFFFFF;
+unsigned long halAdcSyncWaitedMicros = 0;
+
+/* ======================================================================
+   FUNCTION: ADC
+   ====================================================================== */
+int halAdcRead(byte pin) {
+  return analogRead(pin);
+}
+
+/* ======================================================================
+   FUNCTION: GPIO and PWM
+   ====================================================================== */
+void halPinMode(byte pin, byte mode) {
+  pinMode(pin, mode);
+}
+
+void halDigitalWrite(byte pin, byte value) {
+  digitalWrite(pin, value);
+}
+
+#if defined(ARDUINO_ARCH_AVR)
+// The Mega has no per pin frequency control, so the frequency is fixed by the timer behind the pin. Pins 9 and 10 are
+// on Timer2, with no prescaler that runs phase correct PWM at 16MHz / 510 = 31.4kHz, close enough to the R4's 25kHz
+// and above hearing. Timer1 is left alone for the control tick.
+bool halPwmBegin(byte pin, float frequencyHz) {
+  if (pin != 9 && pin != 10) {
+    return false;
+  }
+  TCCR2B = (TCCR2B & 0xF8) | 0x01;
+  pinMode(pin, OUTPUT);
+  analogWrite(pin, 0); // Starts at 0% duty
+  return true;
+}
+
+void halPwmWrite(byte pin, float dutyPercent) {
+  analogWrite(pin, lroundf(constrain(dutyPercent, 0.0f, 100.0f) * 2.55f));
+}
+
+// 653 / 2^24 is 2.55 / 2^16 to within 0.03%, so 100% is 255 and the sum still fits 32 bits unsigned
+void halPwmWriteQ16(byte pin, int32_t dutyPercentQ16) {
+  uint32_t duty = constrain(dutyPercentQ16, 0L, 100L << 16);
+  analogWrite(pin, (duty * 653UL + (1UL << 23)) >> 24);
+}
+#else
+int findPwmOutputIndex(byte pin) {
+  for (int i = 0; i < halPwmMaxOutputs; i++) {
+    if (halPwmOutputs[i] != nullptr && halPwmPins[i] == pin) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+PwmOut *findPwmOutput(byte pin) {
+  int index = findPwmOutputIndex(pin);
+  return (index < 0) ? nullptr : halPwmOutputs[index];
+}
+
+bool halPwmBegin(byte pin, float frequencyHz) {
+  PwmOut *output = findPwmOutput(pin);
+  for (int i = 0; output == nullptr && i < halPwmMaxOutputs; i++) {
+    if (halPwmOutputs[i] == nullptr) {
+      halPwmPins[i] = pin;
+      halPwmDutyPercent[i] = 0.0f;
+      halPwmOutputs[i] = new (halPwmStorage[i]) PwmOut(pin);
+      output = halPwmOutputs[i];
+    }
+  }
+  return output != nullptr && output->begin(frequencyHz, 0.0f); // Starts at 0% duty
+}
+
+void halPwmWrite(byte pin, float dutyPercent) {
+  int index = findPwmOutputIndex(pin);
+  if (index >= 0) {
+    halPwmDutyPercent[index] = dutyPercent;
+    halPwmOutputs[index]->pulse_perc(dutyPercent);
+  }
+}
+
+void halPwmWriteQ16(byte pin, int32_t dutyPercentQ16) {
+  halPwmWrite(pin, dutyPercentQ16 / 65536.0f);
+}
+#endif
+
+/* ======================================================================
+   FUNCTION: Wait budget for synchronised conversions
+   ====================================================================== */
+void halAdcStartSyncBudget(unsigned long budgetMicros) {
+  halAdcSyncBudgetMicros = budgetMicros;
+  halAdcSyncWaitedMicros = 0;
+}
+
+unsigned long halAdcSyncWaitMicros() {
+  return halAdcSyncWaitedMicros;
+}
+
+/* ======================================================================
+   FUNCTION: ADC conversion synchronised to a PWM output
+   ====================================================================== */
+#if defined(ARDUINO_ARCH_AVR)
+// analogRead() takes ~112us on the Mega, three and a half periods of the 31.4kHz motor PWM, so there is no quiet point
+// to line it up with
+int halAdcReadPwmSynced(byte adcPin, byte) {
+  return analogRead(adcPin);
+}
+#else
+// The motor switches at the start of each PWM period (counter 0) and again at the duty. Each edge rings on the sensor
+// lines for a few us, so the conversion is started in the middle of the longer of the on and off phases, as far from
+// both edges as it can be. Without edges (0% or 100% duty, or no such output) it starts straight away, and so does it
+// once the budget has run out. This runs inside the control tick at the same priority as the UART, so the budget is what
+// keeps the tick's busy waiting bounded.
+int halAdcReadPwmSynced(byte adcPin, byte pwmPin) {
+  int index = findPwmOutputIndex(pwmPin);
+  if (index < 0 || halPwmDutyPercent[index] <= 0.0f || halPwmDutyPercent[index] >= 100.0f || halAdcSyncWaitedMicros >= halAdcSyncBudgetMicros) {
+    return analogRead(adcPin);
+  }
+  FspTimer *timer = halPwmOutputs[index]->get_timer();
+  float duty = halPwmDutyPercent[index] / 100.0f;
+  float period = timer->get_period_raw();
+  long quietCount = lroundf(period * ((duty >= 0.5f) ? duty / 2.0f : (1.0f + duty) / 2.0f));
+  long windowCounts = lroundf(period * halPwmQuietWindowFraction);
+  unsigned long timeoutMicros = min(halPwmSyncTimeoutMicros, halAdcSyncBudgetMicros - halAdcSyncWaitedMicros);
+  unsigned long startMicros = micros();
+  while (labs(static_cast<long>(timer->get_counter()) - quietCount) > windowCounts && micros() - startMicros < timeoutMicros) {
+  }
+  halAdcSyncWaitedMicros += micros() - startMicros;
+  return analogRead(adcPin);
+}
+#endif
+
+/* ======================================================================
+   FUNCTION: UART to the master
+   ====================================================================== */
+void halUartBegin(unsigned long baud) {
+  Serial1.begin(baud);
+}
+
+int halUartAvailable() {
+  return Serial1.available();
+}
+
+int halUartPeek() {
+  return Serial1.peek();
+}
+
+int halUartRead() {
+  return Serial1.read();
+}
+
+size_t halUartWrite(const char *data, size_t length) {
+  return Serial1.write(reinterpret_cast<const uint8_t *>(data), length);
+}
+
+/* ======================================================================
+   FUNCTION: Monotonic clock
+   ====================================================================== */
+unsigned long halMillis() {
+  return millis();
+}
+
+unsigned long halMicros() {
+  return micros();
+}
+
+void halDelayMicros(unsigned int us) {
+  delayMicroseconds(us);
+}
+
+/* ======================================================================
+   FUNCTION: Persistent storage (data flash, emulated EEPROM)
+   ====================================================================== */
+// EEPROM.update only erases and writes bytes that have changed
+int halStorageSize() {
+  return EEPROM.length();
+}
+
+bool halStorageRead(int address, void *data, int length) {
+  if (address < 0 || address + length > halStorageSize()) {
+    return false;
+  }
+  for (int i = 0; i < length; i++) {
+    static_cast<uint8_t *>(data)[i] = EEPROM.read(address + i);
+  }
+  return true;
+}
+
+bool halStorageWrite(int address, const void *data, int length) {
+  if (address < 0 || address + length > halStorageSize()) {
+    return false;
+  }
+  for (int i = 0; i < length; i++) {
+    EEPROM.update(address + i, static_cast<const uint8_t *>(data)[i]);
+  }
+  return true;
+}
+
+#endif
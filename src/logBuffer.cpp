@@ -0,0 +1,293 @@
+#include "logBuffer.h"
+#include "hal.h"
+
+/* ======================================================================
+   VARIABLES: Message table expanded for formatting on the board
+   ====================================================================== */
+struct LogMessageDefinition {
+  LogCategory category;
+  const char *text;
+};
+
+#define LOG_MESSAGE_DEFINITION(id, category, text) {category, text},
+const LogMessageDefinition logMessageDefinitions[LOG_MESSAGE_COUNT] = {LOG_MESSAGE_TABLE(LOG_MESSAGE_DEFINITION)};
+#undef LOG_MESSAGE_DEFINITION
+
+const char *logCategoryNames[] = {"SERIAL RECEIVE", "SERIAL SEND", "VALVE", "BOOST", "PID", "GENERAL", "FAULT", "NETWORK"};
+const char *logLevelNames[] = {"NONE", "ERROR", "WARN", "INFO", "DEBUG"};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int logServiceMaxRecords = 4; // Per call to serviceLogOutput, keeps the background loop responsive
+const int logOutputLineMaxLength = 160;
+
+// Fallback for cores whose Serial.availableForWrite() always returns 0 (the base Print version). Room is then handed out
+// at the debug port's line rate (115200 baud, 10 bits a byte) and capped at one burst, which has to fit the longest line
+// any writer sends (a 16 record blackbox line). A write that does block can't hold loop() up for more than ~30ms.
+const unsigned long serialFallbackBytesPerSecond = 11520;
+const int serialFallbackBurstBytes = 320;
+bool serialAvailableForWriteWorks = false;
+float serialFallbackRoom = serialFallbackBurstBytes;
+unsigned long serialFallbackRefilledMicros = 0;
+
+/* ======================================================================
+   VARIABLES: Lock free multi producer ring (bounded queue with per slot sequence numbers)
+   ====================================================================== */
+// Producers (the control tick and the background) claim a slot with a compare and swap, fill it, then publish it by
+// bumping its sequence. Nothing ever waits on anything else, a full ring just drops the record and counts it.
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64 // 16 on the Mega, see platformio.ini
+#endif
+
+const uint32_t logRingSize = LOG_RING_SIZE; // Must be a power of 2
+const uint32_t logRingMask = logRingSize - 1;
+
+struct LogSlot {
+  uint32_t sequence;
+  LogRecord record;
+};
+
+LogSlot logRing[logRingSize];
+uint32_t logEnqueuePosition = 0;
+uint32_t logDequeuePosition = 0; // Only the background consumer touches this
+volatile unsigned long logDroppedCount = 0;
+unsigned long logDroppedCountReported = 0;
+bool logRingInitialised = false;
+
+/* ======================================================================
+   HELPER: 32 bit atomics on the ring positions and slot sequences
+   ====================================================================== */
+// The AVR has no atomic 32 bit instructions (and no __atomic library to fall back on), so there each one runs with
+// interrupts off. The only other producer is the control tick interrupt, so that is enough to keep them indivisible.
+#if defined(ARDUINO_ARCH_AVR)
+inline uint32_t logAtomicLoad(const uint32_t *value) {
+  uint8_t interruptState = SREG;
+  cli();
+  uint32_t result = *value;
+  SREG = interruptState;
+  return result;
+}
+
+inline void logAtomicStore(uint32_t *value, uint32_t newValue) {
+  uint8_t interruptState = SREG;
+  cli();
+  *value = newValue;
+  SREG = interruptState;
+}
+
+inline bool logAtomicCompareExchange(uint32_t *value, uint32_t *expected, uint32_t desired) {
+  uint8_t interruptState = SREG;
+  cli();
+  bool exchanged = (*value == *expected);
+  if (exchanged) {
+    *value = desired;
+  } else {
+    *expected = *value;
+  }
+  SREG = interruptState;
+  return exchanged;
+}
+#else
+inline uint32_t logAtomicLoad(const uint32_t *value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+inline void logAtomicStore(uint32_t *value, uint32_t newValue) {
+  __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+inline bool logAtomicCompareExchange(uint32_t *value, uint32_t *expected, uint32_t desired) {
+  return __atomic_compare_exchange_n(value, expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+#endif
+
+/* ======================================================================
+   FUNCTION: Initialise the ring, anything logged before this is dropped
+   ====================================================================== */
+void initLogBuffer() {
+  for (uint32_t i = 0; i < logRingSize; i++) {
+    logRing[i].sequence = i;
+  }
+  logRingInitialised = true;
+}
+
+/* ======================================================================
+   FUNCTION: Pack the arguments and push a record onto the ring
+   ====================================================================== */
+void logPushArguments(uint8_t level, uint16_t messageId, const LogArgument *arguments, int argumentCount) {
+  if (!logRingInitialised) {
+    return;
+  }
+
+  // Claim a slot
+  uint32_t position = logAtomicLoad(&logEnqueuePosition);
+  LogSlot *slot;
+  while (true) {
+    slot = &logRing[position & logRingMask];
+    int32_t difference = static_cast<int32_t>(logAtomicLoad(&slot->sequence) - position);
+    if (difference == 0) {
+      if (logAtomicCompareExchange(&logEnqueuePosition, &position, position + 1)) {
+        break;
+      }
+    } else if (difference < 0) {
+      logDroppedCount = logDroppedCount + 1;
+      return;
+    } else {
+      position = logAtomicLoad(&logEnqueuePosition);
+    }
+  }
+
+  // Fill it
+  LogRecord *record = &slot->record;
+  record->timestampMicros = halMicros();
+  record->messageId = messageId;
+  record->argumentTypes = 0;
+  record->level = level;
+
+  int payloadIndex = 0;
+  for (int i = 0; i < argumentCount && i < logMaxArguments; i++) {
+    record->argumentTypes |= arguments[i].type << (i * 2);
+    if (arguments[i].type == LOG_ARGUMENT_TEXT) {
+      int textLength = 0;
+      while (payloadIndex < logPayloadSize - 1 && arguments[i].text[textLength] != '\0') {
+        record->payload[payloadIndex++] = arguments[i].text[textLength++];
+      }
+      record->payload[payloadIndex++] = '\0';
+      break;
+    }
+    if (payloadIndex + 4 > logPayloadSize) {
+      break;
+    }
+    memcpy(&record->payload[payloadIndex], &arguments[i].number, 4);
+    payloadIndex += 4;
+  }
+
+  // Publish it
+  logAtomicStore(&slot->sequence, position + 1);
+}
+
+/* ======================================================================
+   FUNCTION: Pop the oldest complete record (background only)
+   ====================================================================== */
+bool logPop(LogRecord *record) {
+  LogSlot *slot = &logRing[logDequeuePosition & logRingMask];
+  if (logAtomicLoad(&slot->sequence) != logDequeuePosition + 1) {
+    return false; // Empty, or the producer of the oldest slot hasn't finished filling it yet
+  }
+
+  *record = slot->record;
+  logAtomicStore(&slot->sequence, logDequeuePosition + logRingSize);
+  logDequeuePosition++;
+  return true;
+}
+
+unsigned long getLogDroppedCount() {
+  return logDroppedCount;
+}
+
+/* ======================================================================
+   FUNCTION: Format a record as text (same rules as tools/logDecode.py)
+   ====================================================================== */
+int logFormatRecord(const LogRecord *record, char *buffer, int bufferSize) {
+  if (record->messageId >= LOG_MESSAGE_COUNT) {
+    return snprintf(buffer, bufferSize, "[LOG] Unknown message ID %u", record->messageId);
+  }
+
+  const LogMessageDefinition *definition = &logMessageDefinitions[record->messageId];
+  int length = snprintf(buffer, bufferSize, "[%s %s] ", logLevelNames[min(record->level, static_cast<uint8_t>(LOG_LEVEL_DEBUG))], logCategoryNames[definition->category]);
+  int argumentIndex = 0;
+  int payloadIndex = 0;
+
+  for (const char *text = definition->text; *text != '\0' && length < bufferSize - 1; text++) {
+    if (text[0] != '{' || text[1] != '}') {
+      buffer[length++] = *text;
+      continue;
+    }
+    text++;
+
+    LogArgumentType type = static_cast<LogArgumentType>((record->argumentTypes >> (argumentIndex * 2)) & 0x03);
+    argumentIndex++;
+    if (type == LOG_ARGUMENT_INT) {
+      int32_t value;
+      memcpy(&value, &record->payload[payloadIndex], 4);
+      payloadIndex += 4;
+      length += snprintf(&buffer[length], bufferSize - length, "%ld", static_cast<long>(value));
+    } else if (type == LOG_ARGUMENT_FLOAT) {
+      float value;
+      memcpy(&value, &record->payload[payloadIndex], 4);
+      payloadIndex += 4;
+      // Avoid dragging printf float support in, 2 decimal places like String(float) gave us
+      long scaled = lroundf(value * 100.0f);
+      length += snprintf(&buffer[length], bufferSize - length, "%s%ld.%02ld", (scaled < 0) ? "-" : "", labs(scaled) / 100, labs(scaled) % 100);
+    } else if (type == LOG_ARGUMENT_TEXT) {
+      length += snprintf(&buffer[length], bufferSize - length, "%s", reinterpret_cast<const char *>(&record->payload[payloadIndex]));
+    }
+  }
+
+  length = min(length, bufferSize - 1);
+  buffer[length] = '\0';
+  return length;
+}
+
+/* ======================================================================
+   FUNCTION: Bytes that can be written to Serial right now without blocking
+   ====================================================================== */
+// Once availableForWrite() has returned anything above 0 it is taken as implemented and trusted from then on, a 0 after
+// that means the transmit buffer really is full. Until then the room comes from the fallback budget above.
+int getSerialWriteRoom() {
+  int room = Serial.availableForWrite();
+  if (room > 0) {
+    serialAvailableForWriteWorks = true;
+  }
+  if (serialAvailableForWriteWorks) {
+    return room;
+  }
+
+  unsigned long nowMicros = halMicros();
+  serialFallbackRoom = min(static_cast<float>(serialFallbackBurstBytes),
+                           serialFallbackRoom + (nowMicros - serialFallbackRefilledMicros) * (serialFallbackBytesPerSecond / 1000000.0f));
+  serialFallbackRefilledMicros = nowMicros;
+  return static_cast<int>(serialFallbackRoom);
+}
+
+/* ======================================================================
+   FUNCTION: Take what was just written off the fallback budget
+   ====================================================================== */
+void spendSerialWriteRoom(int bytes) {
+  if (!serialAvailableForWriteWorks) {
+    serialFallbackRoom = max(0.0f, serialFallbackRoom - bytes);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Drain the ring to serial in idle time, never blocking
+   ====================================================================== */
+void serviceLogOutput() {
+  static char line[logOutputLineMaxLength];
+  LogRecord record;
+
+  // Only write what the serial transmit buffer can take right now, anything else waits for the next loop
+  for (int i = 0; i < logServiceMaxRecords && getSerialWriteRoom() >= logOutputLineMaxLength; i++) {
+    if (!logPop(&record)) {
+      break;
+    }
+
+    if (logOutputBinary) {
+      // #L followed by the 32 raw record bytes as hex, keeps the log2file capture readable alongside normal text
+      const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+      int length = snprintf(line, sizeof(line), "#L");
+      for (size_t b = 0; b < sizeof(record); b++) {
+        length += snprintf(&line[length], sizeof(line) - length, "%02X", bytes[b]);
+      }
+    } else {
+      logFormatRecord(&record, line, sizeof(line));
+    }
+    spendSerialWriteRoom(Serial.println(line));
+  }
+
+  if (logDroppedCount != logDroppedCountReported && getSerialWriteRoom() >= logOutputLineMaxLength) {
+    spendSerialWriteRoom(Serial.print("[LOG] Ring full, records dropped: ") + Serial.println(logDroppedCount - logDroppedCountReported));
+    logDroppedCountReported = logDroppedCount;
+  }
+}
@@ -0,0 +1,160 @@
+#ifndef LOGBUFFER_H
+#define LOGBUFFER_H
+
+#include "logMessages.h"
+#include <Arduino.h>
+
+/* ======================================================================
+   DEFINES: Log levels, anything above LOG_COMPILE_LEVEL is compiled out
+   ====================================================================== */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG // Override with -D LOG_COMPILE_LEVEL=... in build_flags
+#endif
+
+/* ======================================================================
+   VARIABLES: Output format toggle (set in main.cpp)
+   ====================================================================== */
+extern bool logOutputBinary; // Hex framed raw records for tools/logDecode.py instead of formatted text
+
+/* ======================================================================
+   STRUCTURES: Raw log record and its arguments
+   ====================================================================== */
+// 2 bits per argument in LogRecord::argumentTypes
+enum LogArgumentType {
+  LOG_ARGUMENT_NONE,
+  LOG_ARGUMENT_INT,
+  LOG_ARGUMENT_FLOAT,
+  LOG_ARGUMENT_TEXT // Copied into whatever payload is left, so must be the last argument
+};
+
+const int logMaxArguments = 4;
+const int logPayloadSize = 24;
+
+// Fixed 32 byte little endian layout, tools/logDecode.py unpacks this directly
+struct LogRecord {
+  uint32_t timestampMicros;
+  uint16_t messageId;
+  uint8_t argumentTypes;
+  uint8_t level;
+  uint8_t payload[logPayloadSize]; // 4 bytes per int / float argument, then any text
+};
+
+struct LogArgument {
+  LogArgument(int value) : type(LOG_ARGUMENT_INT) { number.i = value; }
+  LogArgument(unsigned int value) : type(LOG_ARGUMENT_INT) { number.i = value; }
+  LogArgument(long value) : type(LOG_ARGUMENT_INT) { number.i = value; }
+  LogArgument(unsigned long value) : type(LOG_ARGUMENT_INT) { number.i = value; }
+  LogArgument(bool value) : type(LOG_ARGUMENT_INT) { number.i = value; }
+  LogArgument(char value) : type(LOG_ARGUMENT_INT) { number.i = value; }
+  LogArgument(float value) : type(LOG_ARGUMENT_FLOAT) { number.f = value; }
+  LogArgument(double value) : type(LOG_ARGUMENT_FLOAT) { number.f = value; }
+  LogArgument(const char *value) : type(LOG_ARGUMENT_TEXT), text(value) {}
+
+  LogArgumentType type;
+  union {
+    int32_t i;
+    float f;
+  } number;
+  const char *text = nullptr;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void initLogBuffer();
+void logPushArguments(uint8_t, uint16_t, const LogArgument *, int);
+bool logPop(LogRecord *);
+int logFormatRecord(const LogRecord *, char *, int);
+void serviceLogOutput();
+int getSerialWriteRoom();
+void spendSerialWriteRoom(int);
+unsigned long getLogDroppedCount();
+
+/* ======================================================================
+   FUNCTION: Push a record (safe from the control tick, never blocks)
+   ====================================================================== */
+inline void logPush(uint8_t level, uint16_t messageId) {
+  logPushArguments(level, messageId, nullptr, 0);
+}
+
+inline void logPush(uint8_t level, uint16_t messageId, LogArgument a) {
+  logPushArguments(level, messageId, &a, 1);
+}
+
+inline void logPush(uint8_t level, uint16_t messageId, LogArgument a, LogArgument b) {
+  LogArgument arguments[] = {a, b};
+  logPushArguments(level, messageId, arguments, 2);
+}
+
+inline void logPush(uint8_t level, uint16_t messageId, LogArgument a, LogArgument b, LogArgument c) {
+  LogArgument arguments[] = {a, b, c};
+  logPushArguments(level, messageId, arguments, 3);
+}
+
+inline void logPush(uint8_t level, uint16_t messageId, LogArgument a, LogArgument b, LogArgument c, LogArgument d) {
+  LogArgument arguments[] = {a, b, c, d};
+  logPushArguments(level, messageId, arguments, 4);
+}
+
+/* ======================================================================
+   MACROS: Level gated logging. Arguments are not evaluated when disabled
+   ====================================================================== */
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(enabled, ...)              \
+  do {                                       \
+    if (enabled) {                           \
+      logPush(LOG_LEVEL_ERROR, __VA_ARGS__); \
+    }                                        \
+  } while (0)
+#else
+#define LOG_ERROR(enabled, ...) \
+  do {                          \
+  } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(enabled, ...)              \
+  do {                                      \
+    if (enabled) {                          \
+      logPush(LOG_LEVEL_WARN, __VA_ARGS__); \
+    }                                       \
+  } while (0)
+#else
+#define LOG_WARN(enabled, ...) \
+  do {                         \
+  } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(enabled, ...)              \
+  do {                                      \
+    if (enabled) {                          \
+      logPush(LOG_LEVEL_INFO, __VA_ARGS__); \
+    }                                       \
+  } while (0)
+#else
+#define LOG_INFO(enabled, ...) \
+  do {                         \
+  } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(enabled, ...)              \
+  do {                                       \
+    if (enabled) {                           \
+      logPush(LOG_LEVEL_DEBUG, __VA_ARGS__); \
+    }                                        \
+  } while (0)
+#else
+#define LOG_DEBUG(enabled, ...) \
+  do {                          \
+  } while (0)
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef LOGMESSAGES_H
+#define LOGMESSAGES_H
+
+/* ======================================================================
+   TABLE: Log message IDs, categories and text
+   ====================================================================== */
+// Each {} is replaced by the next argument when the record is formatted (on the board in idle time, or by tools/logDecode.py).
+// IDs are assigned in table order and the host decoder parses this file, so only ever add new messages to the end.
+#define LOG_MESSAGE_TABLE(X)                                                                                                                               \
+  X(LOG_VALVE_OPEN_CLAMPED_HIGH, LOG_CATEGORY_VALVE, "Valve open percentage hard set to 100% as {} >= {}")                                                 \
+  X(LOG_VALVE_OPEN_CLAMPED_LOW, LOG_CATEGORY_VALVE, "Valve open percentage hard set to 0% as {} <= {}")                                                    \
+  X(LOG_VALVE_OPEN_CALCULATED, LOG_CATEGORY_VALVE, "Valve open percentage calculated as {}%")                                                              \
+  X(LOG_BOOST_CALCULATING, LOG_CATEGORY_BOOST, "Calculating boost based on speed {}kmh, rpm {}, gear {} and clutch {}")                                    \
+  X(LOG_BOOST_ZERO_CONDITIONAL, LOG_CATEGORY_BOOST, "Boost target set to 0kPa due to conditional match (gear, speed, clutch etc)")                         \
+  X(LOG_BOOST_TARGET_DETERMINED, LOG_CATEGORY_BOOST, "Boost target determined as {}kPa")                                                                   \
+  X(LOG_BOOST_ZERO_UNKNOWN_GEAR, LOG_CATEGORY_BOOST, "Boost target set to 0kPa as out of range gear {} provided")                                          \
+  X(LOG_BOOST_OVERBOOST_ALARM, LOG_CATEGORY_BOOST, "Critical alarm set due to over boosting !! {}kPa vs {}kPa")                                            \
+  X(LOG_SERIAL_COMMS_OUTAGE, LOG_CATEGORY_SERIAL_SEND, "Setting critical alarm due to serial comms outage !!")                                             \
+  X(LOG_GENERAL_CONFIGURING_MUX, LOG_CATEGORY_GENERAL, "Configuring mux board ...")                                                                        \
+  X(LOG_PID_MODE_PRESSURE, LOG_CATEGORY_PID, "Switching control mode to PRESSURE")                                                                         \
+  X(LOG_PID_MODE_POSITIONAL, LOG_CATEGORY_PID, "Switching control mode to POSITIONAL")                                                                     \
+  X(LOG_PID_TARGET_AND_CURRENT, LOG_CATEGORY_PID, "Target boost is {}kPa and current is {}kPa")                                                            \
+  X(LOG_PID_TUNINGS, LOG_CATEGORY_PID, "Proportional value: {} Integral value: {} Derivative value: {}")                                                   \
+  X(LOG_PID_VALVE_OPEN_AND_TARGET, LOG_CATEGORY_PID, "Current open percentage: {} Target open percentage: {}")                                             \
+  X(LOG_SERIAL_SEND_COMMAND_0_RECEIVED, LOG_CATEGORY_SERIAL_SEND, "Received request from master for params update (command ID 0 request, ID 2 response)")  \
+  X(LOG_SERIAL_SEND_MESSAGE, LOG_CATEGORY_SERIAL_SEND, "Sending {}")                                                                                       \
+  X(LOG_SERIAL_RECEIVE_COMMAND_1_PROCESSED, LOG_CATEGORY_SERIAL_RECEIVE, "Successfully processed command ID 1 message (update pushed params from master)") \
+  X(LOG_SERIAL_RECEIVE_BAD_CHECKSUM, LOG_CATEGORY_SERIAL_RECEIVE, "BAD Checksum calculation. Received: {}, Calculated: {}")                                \
+  X(LOG_SERIAL_RECEIVE_PARTIAL_RETRIEVED, LOG_CATEGORY_SERIAL_RECEIVE, "Retrieving partial message: {}")                                                   \
+  X(LOG_SERIAL_RECEIVE_READ_CHARACTER, LOG_CATEGORY_SERIAL_RECEIVE, "Read in character code: {}")                                                          \
+  X(LOG_SERIAL_RECEIVE_BUFFER_FULL, LOG_CATEGORY_SERIAL_RECEIVE, "Buffer full, message truncated")                                                         \
+  X(LOG_SERIAL_RECEIVE_GOOD_MESSAGE, LOG_CATEGORY_SERIAL_RECEIVE, "GOOD message ready to process: {}")                                                     \
+  X(LOG_SERIAL_RECEIVE_CORRUPT_MESSAGE, LOG_CATEGORY_SERIAL_RECEIVE, "CORRUPT message: {}")                                                                \
+  X(LOG_SERIAL_RECEIVE_PARTIAL_STORED, LOG_CATEGORY_SERIAL_RECEIVE, "Storing partial message: {}")                                                         \
+  X(LOG_SERIAL_RECEIVE_COMMAND, LOG_CATEGORY_SERIAL_RECEIVE, "Got command ID {} message {}")                                                               \
+  X(LOG_SERIAL_RECEIVE_COMMAND_UNSUPPORTED, LOG_CATEGORY_SERIAL_RECEIVE, "Command ID {} not supported, unable to process {}")                              \
+  X(LOG_FAULT_RAISED, LOG_CATEGORY_FAULT, "Fault code {} raised")                                                                                          \
+  X(LOG_FAULT_CLEARED, LOG_CATEGORY_FAULT, "Fault code {} cleared")                                                                                        \
+  X(LOG_MQTT_CONNECTED, LOG_CATEGORY_NETWORK, "MQTT connected to broker after {} attempts")                                                                \
+  X(LOG_MQTT_CONNECT_FAILED, LOG_CATEGORY_NETWORK, "MQTT connect failed with state {}, retrying in {}ms")                                                  \
+  X(LOG_MQTT_CONNECTION_DROPPED, LOG_CATEGORY_NETWORK, "MQTT connection dropped with state {}")                                                            \
+  X(LOG_MQTT_COMMAND_APPLIED, LOG_CATEGORY_NETWORK, "MQTT command {} applied in {}us")                                                                     \
+  X(LOG_MQTT_COMMAND_REJECTED, LOG_CATEGORY_NETWORK, "MQTT command {} rejected, {}")                                                                       \
+  X(LOG_WIFI_CONNECTED, LOG_CATEGORY_NETWORK, "WiFi connected after {}ms")                                                                                 \
+  X(LOG_WIFI_ASSOCIATION_FAILED, LOG_CATEGORY_NETWORK, "WiFi association failed with status {}, retrying in {}ms")                                         \
+  X(LOG_WIFI_DROPPED, LOG_CATEGORY_NETWORK, "WiFi connection dropped with status {}, last RSSI {}dBm")                                                     \
+  X(LOG_WIFI_NO_MODULE, LOG_CATEGORY_NETWORK, "WiFi module not responding, retrying")                                                                      \
+  X(LOG_BOOST_PRESSURE_RATIO_LIMITED, LOG_CATEGORY_BOOST, "Target held to {}kPa by pressure ratio {} rising at {}/s")                                      \
+  X(LOG_BOOST_PRESSURE_RATIO_LIMIT_CLEARED, LOG_CATEGORY_BOOST, "Pressure ratio limit cleared at ratio {}")                                                \
+  X(LOG_SERIAL_TIME_SYNC_SAMPLE, LOG_CATEGORY_SERIAL_RECEIVE, "Time sync offset {}ms with {}ms round trip, drift {}ppm")                                   \
+  X(LOG_SERIAL_TIME_SYNC_RESTARTED, LOG_CATEGORY_SERIAL_RECEIVE, "Master clock stepped by {}ms, time sync restarted")                                      \
+  X(LOG_BOOST_STALE_INPUT_DISCOUNT, LOG_CATEGORY_BOOST, "Boost target discounted to {}kPa as master inputs are {}ms old")                                  \
+  X(LOG_BOOST_OVERBOOST_FAST_OPEN, LOG_CATEGORY_BOOST, "Overboost predicted at {}kPa rising {}kPa/s against a {}kPa limit, fast opening valve")            \
+  X(LOG_BOOST_OVERBOOST_FAST_OPEN_RELEASED, LOG_CATEGORY_BOOST, "Overboost fast open released, valve took {}ms to open")                                   \
+  X(LOG_BOOST_GEAR_MISMATCH, LOG_CATEGORY_BOOST, "Master says gear {} but RPM / speed ratio says gear {} at {}rpm {}km/h")                                 \
+  X(LOG_BOOST_GEAR_MISMATCH_CLEARED, LOG_CATEGORY_BOOST, "Gear from RPM / speed ratio agrees with master again")                                           \
+  X(LOG_BOOST_DRIVING_EVENT, LOG_CATEGORY_BOOST, "Driving event {} (1 clutch release, 2 gear change, 4 tip in) in gear {} at {}rpm, target recalculated")  \
+  X(LOG_BOOST_EVENT_METRICS, LOG_CATEGORY_BOOST, "Boost event in gear {}, rise {}ms, overshoot {}kPa, settled in {}ms (-1 not reached)")                   \
+  X(LOG_PID_SHADOW_VERDICT, LOG_CATEGORY_PID, "Shadow verdict {} (0 scoring, 1 wins, 2 loses, 3 model untrusted) after {} stretches, IAE {} vs live {}")   \
+  X(LOG_PID_SHADOW_PROMOTED, LOG_CATEGORY_PID, "Shadow gains promoted to live, Proportional value: {} Integral value: {} Derivative value: {}")            \
+  X(LOG_GENERAL_ATMOSPHERIC_BASELINE, LOG_CATEGORY_GENERAL, "Atmospheric re-baselined to {}kPa ({} raw manifold offset), {}kPa since boot, window {}")
+
+/* ======================================================================
+   ENUMS: Message IDs and categories
+   ====================================================================== */
+#define LOG_MESSAGE_ENUM(id, category, text) id,
+enum LogMessageId {
+  LOG_MESSAGE_TABLE(LOG_MESSAGE_ENUM)
+      LOG_MESSAGE_COUNT
+};
+#undef LOG_MESSAGE_ENUM
+
+enum LogCategory {
+  LOG_CATEGORY_SERIAL_RECEIVE,
+  LOG_CATEGORY_SERIAL_SEND,
+  LOG_CATEGORY_VALVE,
+  LOG_CATEGORY_BOOST,
+  LOG_CATEGORY_PID,
+  LOG_CATEGORY_GENERAL,
+  LOG_CATEGORY_FAULT,
+  LOG_CATEGORY_NETWORK
+};
+
+#endif
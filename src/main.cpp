@@ -1,29 +1,58 @@
 #include "PID_v1.h"
-#include "pwm.h"
 #include <Arduino.h>
 #include <Wire.h>
 #include <ptScheduler.h>
 
-#include "arduinoSecrets.h"
+#include "atmosphericBaseline.h"
+#include "blackboxRecorder.h"
+#include "boostEventMetrics.h"
+#include "boostController.h"
 #include "boostValveControl.h"
 #include "boostValveSetup.h"
 #include "calculateDesiredBoost.h"
+#include "controlTick.h"
 #include "cytronMotorDriver.h"
+#include "drivingEvents.h"
+#include "faultManager.h"
 #include "globalHelpers.h"
-#include "mqttPublish.h"
+#include "hal.h"
+#include "memoryMonitor.h"
 #include "pidPotentiometers.h"
+#include "platformTraits.h"
+#include "replayRecorder.h"
 #include "sensorsSendReceive.h"
 #include "serialCommunications.h"
 #include "serialMessageProcessing.h"
+#include "shadowController.h"
+#include "snapshotHandoff.h"
+#include "taskProfiler.h"
+#include "timeSync.h"
+#include "vehicleStateEstimator.h"
+
+#if PLATFORM_HAS_NETWORK
+#include "arduinoSecrets.h"
+#include "mqttCommands.h"
+#include "mqttPublish.h"
+#include "telemetryBatcher.h"
 #include "wifiHelpers.h"
+#endif
 
 /* ======================================================================
    VARIABLES: Major functional area toggles
    ====================================================================== */
+// The network ones have no effect on targets without WiFi (PLATFORM_HAS_NETWORK in platformTraits.h)
 bool enableWifi = true;
 bool enablePotPidTuning = true;
-bool enableMqttPublish = true;       // Output to MQTT for display via Grafana Live
-bool enablePidPlotterOutput = false; // Output for Arduino IDE's serial plotter
+bool enableMqttPublish = true;         // Output to MQTT for display via Grafana Live
+bool mqttPublishCombined = false;      // Pressures, compressor, valve open and PID gains as one telemetry message every 100ms
+bool enablePidPlotterOutput = false;   // Output for Arduino IDE's serial plotter
+bool enableTelemetryBatching = true;   // Every 2ms sample packed into one telemetry/batch message per 100ms
+bool blackboxDumpOverMqtt = false;     // Where the blackbox goes once frozen around a fault, serial otherwise
+bool enableReplayRecording = false;    // Stream control inputs over serial for the native_replay runner, see replayRecorder.cpp
+bool enableMasterTimeSync = true;      // Command ID 3 requests so master timestamps can be used, see timeSync.cpp
+bool enableDrivingEvents = true;       // Clutch release, gear change and tip in recalculate the target straight away, see drivingEvents.cpp
+bool enableShadowPromotion = false;    // Shadow candidate gains that beat the live ones become the live ones, see shadowController.cpp
+bool enableAtmosphericTracking = true; // Follow atmospheric pressure off boost rather than only taking it at boot, see atmosphericBaseline.cpp
 
 /* ======================================================================
    VARIABLES: Debug and stat output
@@ -34,33 +63,28 @@ bool debugValveControl = false;
 bool debugBoost = false;
 bool debugGeneral = true;
 bool debugPid = true;
+bool logOutputBinary = false; // Print debug output as raw records, decode on the laptop with tools/logDecode.py
 
 bool reportSerialMessageStats = false;
-bool reportArduinoLoopStats = false;
+bool reportArduinoLoopStats = false; // Stack high water and heap use are printed with it
+bool reportControlTickStats = false;
+bool reportFaultStats = false;
+bool reportBoostEventStats = false; // Step response of the last boost events (always published via MQTT when connected)
+bool reportMqttStats = false;
+bool reportTaskProfilerStats = false; // Per task cycle counts over serial (always published via MQTT when connected)
 
 /* ======================================================================
    VARIABLES: Pin constants
    ====================================================================== */
-const byte boostValvePositionSignalPin = A0;
-const byte manifoldTmapSensorPressureSignalPin = A1;
-const byte intakeTmapSensorPressureSignalPin = A2;
+// Valve position, manifold and intake pressure pins are in boostController.h with the rest of the control tick
 
 // Additional pins assigned in globalHelpers.cpp for multiplexer board
 // 4, 5, 6, 7, A3
 
 /* ======================================================================
-   VARIABLES: PID Tuning parameters for valve motor control
+   VARIABLES: Control tick (sensor sample -> PID -> motor output in a timer interrupt)
    ====================================================================== */
-double PressureKp = 9.0; // Proportional term
-double PressureKi = 3.3; // Integral term
-double PressureKd = 1.3; // Derivative term
-
-double PositionKp = 2.5; // Proportional term
-double PositionKi = 5.0; // Integral term
-double PositionKd = 0.0; // Derivative term
-
-const int maximumReverseMotorSpeed = -60; // This is also hard coded in the setBoostValveTravelLimits function. This is closing the valve against the spring.
-const int maximumForwardMotorSpeed = 40;  // This is also hard coded in the setBoostValveTravelLimits function This is opening the valve with the spring.
+const float controlTickFrequencyHz = TargetPlatform::controlTickFrequencyHz; // 1kHz on the R4, 500Hz on the Mega
 
 /* ======================================================================
    VARIABLES: General use / functional
@@ -68,50 +92,64 @@ const int maximumForwardMotorSpeed = 40;  // This is also hard coded in the setB
 // Related to Bosch TMAP sensor readings
 float manifoldPressureAtmosphericOffsetRaw, intakePressureAtmosphericOffsetRaw; // Absolute vs gauge pressures raw
 float manifoldPressureAtmosphericOffsetKpa, intakePressureAtmosphericOffsetKpa; // Absolute vs gauge pressures KpA
-float currentManifoldPressureAbsoluteRaw, currentIntakePressureAbsoluteRaw;     // Current absolute pressures raw
-double currentManifoldPressureGaugeKpa, currentIntakePressureGaugeKpa;          // Current gauge pressures kPa
+double currentIntakePressureGaugeKpa;                                           // Current gauge pressure kPa, from the control tick
 int currentManifoldTempRaw, currentIntakeTempRaw;                               // Current temperatures raw
 int currentManifoldTempCelcius, currentIntakeTempCelcius;                       // Current temperatures ccelcius
 
 // Related to boost control valve
-int currentBoostValvePositionReadingRaw, boostValvePositionReadingMinimumRaw, boostValvePositionReadingMaximumRaw;
-double currentBoostValveMotorSpeed = 0;
-double currentBoostValveOpenPercentage;
-double currentTargetBoostValveOpenPercentage = 100.0;
-const float valvePositionToPressureControlTransitionFactor = 0.8;
-bool usingPressureControl, usingPositionControl;
+int boostValvePositionReadingMinimumRaw, boostValvePositionReadingMaximumRaw;
 
 // Other variables
-double currentTargetBoostKpa;
-
 int currentVehicleGear = 0;    // Will be updated via serial comms from master
 float currentVehicleSpeed = 0; // Will be updated via serial comms from master
 int currentVehicleRpm = 0;     // Will be updated via serial comms from master
 bool clutchPressed = true;     // Will be updated via serial comms from master
 
 unsigned long arduinoLoopExecutionCount = 0;
+bool wifiIsConnected = false;
 bool mqttIsConnected = false; // Used to avoid trying to send when there is no connection to the broker
 
+#if PLATFORM_HAS_NETWORK
+MqttCommand mqttCommand; // Remote command waiting for the control tick to take it on
+bool mqttCommandAwaitingTick = false;
+const unsigned long mqttCommandApplyTimeoutUs = 100000; // Reply as failed if the tick hasn't picked it up by now
+#endif
+
 /* ======================================================================
-   OBJECTS: Configure the motor driver board and PID objects
+   VARIABLES: State handed between the control tick and the background loop (see boostController.h)
    ====================================================================== */
-PID boostValvePressurePID(&currentManifoldPressureGaugeKpa, &currentBoostValveMotorSpeed, &currentTargetBoostKpa, PressureKp, PressureKi, PressureKd, REVERSE);
-PID boostValvePositionPID(&currentBoostValveOpenPercentage, &currentBoostValveMotorSpeed, &currentTargetBoostValveOpenPercentage, PositionKp, PositionKi, PositionKd, DIRECT);
+ControlInputs controlInputs;     // Background working copy, published whenever it changes
+ControlOutputs controlOutputs;   // Background copy of the latest tick results, refreshed every loop
+ControlReadings controlReadings; // controlOutputs in engineering units, converted as it is refreshed
+ControlInputs tickInputs;        // Control tick copy of the latest published inputs
+ControlOutputs tickOutputs;      // Control tick working copy, published at the end of every tick
+bool previousUsingPressureControl = false;
+bool previousPressureRatioLimitActive = false;
+bool previousOverboostProtectionActive = false;
+bool previousGearMismatch = false;
+bool drivingEventPending = false; // Target to be recalculated this loop rather than at the next 200ms
+unsigned long previousControlTickOverrunCount = 0;
+unsigned long previousOverboostEventCount = 0;
+unsigned long previousBoostEventCount = 0;
+unsigned long previousShadowStretchCount = 0;
+ShadowVerdict previousShadowVerdict = SHADOW_VERDICT_SCORING;
+
+SnapshotToIsr<ControlInputs> controlInputsHandoff;
+SnapshotFromIsr<ControlOutputs> controlOutputsHandoff;
 
 /* ======================================================================
    OBJECTS: Pretty tiny scheduler objects / tasks
    ====================================================================== */
-// High frequency tasks
-ptScheduler ptCalculatePidAndDriveValve = ptScheduler(PT_TIME_2MS);
-ptScheduler ptGetBoostValveFeedbackPosition = ptScheduler(PT_TIME_2MS);
-ptScheduler ptGetManifoldPressure = ptScheduler(PT_TIME_10MS);
+// High frequency tasks (valve position, manifold pressure and PID all run in the control tick interrupt)
 ptScheduler ptSerialReadAndProcessMessage = ptScheduler(PT_TIME_10MS);
 
 // Medium frequency tasks
 ptScheduler ptMqttPublishMetricsToServer100Ms = ptScheduler(PT_TIME_100MS);
 ptScheduler ptOutputPidDataForLivePlotter = ptScheduler(PT_TIME_50MS);
+ptScheduler ptServiceBlackboxDump = ptScheduler(PT_TIME_50MS);
 ptScheduler ptCalculateDesiredBoostKpa = ptScheduler(PT_TIME_200MS);
 ptScheduler ptCheckFaultConditions = ptScheduler(PT_TIME_200MS);
+ptScheduler ptUpdateAtmosphericBaseline = ptScheduler(PT_TIME_200MS);
 
 // Low frequency tasks
 ptScheduler ptOutputTargetAndCurrentBoostDebug = ptScheduler(PT_TIME_500MS);
@@ -120,15 +158,74 @@ ptScheduler ptMqttPublishMetricsToServer1S = ptScheduler(PT_TIME_1S);
 ptScheduler ptSerialCalculateMessageQualityStats = ptScheduler(PT_TIME_5S);
 ptScheduler ptSerialReportMessageQualityStats = ptScheduler(PT_TIME_5S);
 ptScheduler ptReportArduinoLoopStats = ptScheduler(PT_TIME_5S);
+ptScheduler ptReportControlTickStats = ptScheduler(PT_TIME_5S);
+ptScheduler ptReportTaskProfiles = ptScheduler(PT_TIME_5S);
+ptScheduler ptReportFaultStatus = ptScheduler(PT_TIME_5S);
+ptScheduler ptReportBoostEvents = ptScheduler(PT_TIME_5S);
+ptScheduler ptReportMqttConnectionStats = ptScheduler(PT_TIME_5S);
+
+/* ======================================================================
+   FUNCTION: Control tick, called from the hardware timer interrupt
+   ====================================================================== */
+// Must not print, allocate or block. Anything the background needs to know about goes out via tickOutputs.
+void runBoostValveControlTick() {
+  controlInputsHandoff.read(&tickInputs);
+  runBoostController(&tickInputs, &tickOutputs);
+  controlOutputsHandoff.publish(tickOutputs);
+
+  if (enableReplayRecording) {
+    recordReplayAdcSample(tickOutputs.boostValvePositionReadingRaw, tickOutputs.manifoldPressureAbsoluteRaw, tickOutputs.intakePressureAbsoluteRaw);
+  }
+
+  // Record this tick in the blackbox, it freezes itself around any newly raised critical fault
+  BlackboxSample blackboxSample = {ControlNumeric::toQ8(tickOutputs.targetBoostKpa), ControlNumeric::toQ8(tickOutputs.manifoldPressureGaugeKpa), tickOutputs.boostValvePositionReadingRaw,
+                                   ControlNumeric::toQ8(tickOutputs.boostValveOpenPercentage), ControlNumeric::toQ8(tickOutputs.boostValveMotorSpeed), static_cast<byte>(tickOutputs.controlMode),
+                                   tickInputs.vehicleRpm, tickInputs.vehicleGear, tickInputs.clutchPressed, tickInputs.alarmCritical};
+  blackboxRecordSample(&blackboxSample, getCriticalFaultBitmask());
+#if PLATFORM_HAS_NETWORK
+  if (enableTelemetryBatching) {
+    telemetryRecordSample(&blackboxSample);
+  }
+#endif
+}
 
 /* ======================================================================
    SETUP
    ====================================================================== */
 void setup() {
+  paintStack(); // Before anything else has had a chance to use much of it
+
   Serial.begin(115200); // Hardware serial port for debugging
   while (!Serial) {
   }; // Wait for serial port to open for debug
-  Serial1.begin(500000); // Hardware serial port for comms to 'master'
+  halUartBegin(500000); // Hardware serial port for comms to 'master'
+
+  // Debug output is queued in the log ring from here on and printed from loop()
+  initLogBuffer();
+
+  // Start the cycle counter and give each profiled task its deadline (scheduler period)
+  initTaskProfiler();
+  registerProfiledTask(PROFILED_CONTROL_TICK, "controlTick", 1000000.0 / controlTickFrequencyHz);
+  registerProfiledTask(PROFILED_LOOP, "loop", PT_TIME_10MS); // Must get back round in time to service the master
+  registerProfiledTask(PROFILED_SERIAL_CALCULATE_STATS, "serialCalculateStats", PT_TIME_5S);
+  registerProfiledTask(PROFILED_SERIAL_REPORT_STATS, "serialReportStats", PT_TIME_5S);
+  registerProfiledTask(PROFILED_SERIAL_READ_AND_PROCESS, "serialReadAndProcess", PT_TIME_10MS);
+  registerProfiledTask(PROFILED_CHECK_FAULT_CONDITIONS, "checkFaultConditions", PT_TIME_200MS);
+  registerProfiledTask(PROFILED_CALCULATE_DESIRED_BOOST, "calculateDesiredBoost", PT_TIME_200MS);
+  registerProfiledTask(PROFILED_PLOTTER_OUTPUT, "plotterOutput", PT_TIME_50MS);
+  registerProfiledTask(PROFILED_BOOST_DEBUG_OUTPUT, "boostDebugOutput", PT_TIME_500MS);
+  registerProfiledTask(PROFILED_PID_POTS, "pidPots", PT_TIME_500MS);
+  registerProfiledTask(PROFILED_MQTT_PUBLISH_100MS, "mqttPublish100Ms", PT_TIME_100MS);
+  registerProfiledTask(PROFILED_MQTT_PUBLISH_1S, "mqttPublish1S", PT_TIME_1S);
+  registerProfiledTask(PROFILED_CONTROL_TICK_REPORT, "controlTickReport", PT_TIME_5S);
+  registerProfiledTask(PROFILED_LOG_OUTPUT, "logOutput", 0); // Runs every loop, no deadline of its own
+  registerProfiledTask(PROFILED_BLACKBOX_DUMP, "blackboxDump", PT_TIME_50MS);
+  registerProfiledTask(PROFILED_MQTT_SERIALIZE, "mqttSerialize", 0); // Cycles per metric payload, excludes the network
+  registerProfiledTask(PROFILED_WIFI_SERVICE, "wifiService", 0);
+  registerProfiledTask(PROFILED_MQTT_SERVICE, "mqttService", 0);
+  registerProfiledTask(PROFILED_TELEMETRY_BATCH, "telemetryBatch", 0);
+  registerProfiledTask(PROFILED_REPLAY_RECORDING, "replayRecording", 0);
+  registerProfiledTask(PROFILED_ATMOSPHERIC_BASELINE, "atmosphericBaseline", PT_TIME_200MS);
 
   // Get atmospheric reading from manifold and intake pressure sensors before engine starts
   manifoldPressureAtmosphericOffsetRaw = getAveragedAnaloguePinReading(manifoldTmapSensorPressureSignalPin, 20, 0);
@@ -136,6 +233,7 @@ void setup() {
 
   manifoldPressureAtmosphericOffsetKpa = calculateBosch3BarKpaFromRaw(manifoldPressureAtmosphericOffsetRaw);
   intakePressureAtmosphericOffsetKpa = calculateBosch3BarKpaFromRaw(intakePressureAtmosphericOffsetRaw);
+  initAtmosphericBaseline(manifoldPressureAtmosphericOffsetRaw, intakePressureAtmosphericOffsetRaw);
 
   // Output atmospheric readings
   Serial.println("\nINFO: Setting current atospheric pressure offsets ... ");
@@ -155,175 +253,456 @@ void setup() {
   // Calibrate travel limits of boost valve (drive against full open / closed and record readings)
   setBoostValveTravelLimits(&boostValvePositionReadingMinimumRaw, &boostValvePositionReadingMaximumRaw);
 
-  // Initialize the PID controller and set the motor speed limits
-  boostValvePressurePID.SetMode(AUTOMATIC);
-  boostValvePressurePID.SetOutputLimits(maximumReverseMotorSpeed, maximumForwardMotorSpeed);
+  // Hand the controller its calibration, set up both PIDs and take the starting gains
+  initBoostController(boostValvePositionReadingMinimumRaw, boostValvePositionReadingMaximumRaw, manifoldPressureAtmosphericOffsetRaw, &controlInputs);
+  if (enableReplayRecording) {
+    recordReplayCalibration(boostValvePositionReadingMinimumRaw, boostValvePositionReadingMaximumRaw, manifoldPressureAtmosphericOffsetRaw);
+  }
 
-  boostValvePositionPID.SetMode(AUTOMATIC);
-  boostValvePositionPID.SetOutputLimits(maximumReverseMotorSpeed, maximumForwardMotorSpeed);
+  // Hand the control tick its starting inputs then start it. From here on the valve is driven from the timer interrupt,
+  // so the WiFi and MQTT setup below can take as long as they like.
+  controlInputsHandoff.publish(controlInputs);
+  updateFaultCondition(FAULT_CONTROL_TICK_FAILED, !startControlTickTimer(controlTickFrequencyHz, runBoostValveControlTick));
 
-  // Setup our WiFi connectivity if needed
+#if PLATFORM_HAS_NETWORK
+  // Start WiFi association if needed, it completes (and reassociates after any drop) from loop()
   if (enableWifi) {
-    setupWiFi();
+    initWiFi();
   }
 
-  // Setup our MQTT connectivity if needed
+  // Setup our MQTT client if needed, it connects (and reconnects) from loop()
   if (enableWifi && enableMqttPublish) {
-    mqttIsConnected = connectMqttClientToBroker();
+    initMqttConnection();
+    initMqttCommands();
   }
+#endif
+
+  // Anything allocated from here on is counted and raises the heapAllocation fault, in a HEAP_GUARD build
+  armHeapGuard();
 }
 
 /* ======================================================================
    MAIN LOOP
    ====================================================================== */
 void loop() {
-  // Get the current boost valve blade position as a raw reading and update percentage
-  if (ptGetBoostValveFeedbackPosition.call()) {
-    currentBoostValvePositionReadingRaw = getAveragedAnaloguePinReading(boostValvePositionSignalPin, 20, 0);
-    currentBoostValveOpenPercentage = getBoostValveOpenPercentage(&currentBoostValvePositionReadingRaw, &boostValvePositionReadingMinimumRaw, &boostValvePositionReadingMaximumRaw);
+  ProfileScope loopProfile(PROFILED_LOOP);
+  bool controlInputsChanged = false;
+
+  // Pick up the latest results from the control tick
+  controlOutputsHandoff.read(&controlOutputs);
+  convertControlOutputs(&controlOutputs, &controlReadings);
+  if (controlOutputs.usingPressureControl != previousUsingPressureControl) {
+    DEBUG_PID(controlOutputs.usingPressureControl ? LOG_PID_MODE_PRESSURE : LOG_PID_MODE_POSITIONAL);
+    previousUsingPressureControl = controlOutputs.usingPressureControl;
   }
-
-  // Get the current manifold pressure as raw sensor reading (0-1023) and convert to kPa gauge
-  if (ptGetManifoldPressure.call()) {
-    currentManifoldPressureAbsoluteRaw = getAveragedAnaloguePinReading(manifoldTmapSensorPressureSignalPin, 20, 0);
-    currentManifoldPressureGaugeKpa = calculateBosch3BarKpaFromRaw(currentManifoldPressureAbsoluteRaw - manifoldPressureAtmosphericOffsetRaw);
+  if (controlOutputs.pressureRatioLimitActive != previousPressureRatioLimitActive) {
+    if (controlOutputs.pressureRatioLimitActive) {
+      DEBUG_BOOST(LOG_BOOST_PRESSURE_RATIO_LIMITED, controlReadings.controlTargetBoostKpa, controlReadings.pressureRatio, controlReadings.pressureRatioRatePerSecond);
+    } else {
+      DEBUG_BOOST(LOG_BOOST_PRESSURE_RATIO_LIMIT_CLEARED, controlReadings.pressureRatio);
+    }
+    previousPressureRatioLimitActive = controlOutputs.pressureRatioLimitActive;
+  }
+  if (controlOutputs.overboostProtectionActive != previousOverboostProtectionActive) {
+    if (controlOutputs.overboostProtectionActive) {
+      LOG_WARN(true, LOG_BOOST_OVERBOOST_FAST_OPEN, controlReadings.manifoldPressureGaugeKpa, controlReadings.manifoldPressureRatePerSecond, controlReadings.overboostLimitKpa);
+    } else {
+      LOG_INFO(true, LOG_BOOST_OVERBOOST_FAST_OPEN_RELEASED, controlReadings.overboostOpenLatencyMillis);
+    }
+    previousOverboostProtectionActive = controlOutputs.overboostProtectionActive;
+  }
+  if (controlOutputs.boostEventCount != previousBoostEventCount) {
+    BoostEventRecord boostEvent;
+    convertBoostEvent(&controlOutputs.lastBoostEvent, &boostEvent);
+    recordBoostEvent(&boostEvent);
+    DEBUG_BOOST(LOG_BOOST_EVENT_METRICS, boostEvent.gear, boostEvent.riseTimeMillis, boostEvent.overshootKpa, boostEvent.settlingTimeMillis);
+    previousBoostEventCount = controlOutputs.boostEventCount;
   }
+  if (controlOutputs.shadowStretchCount != previousShadowStretchCount) {
+    recordShadowStretch(&controlOutputs.lastShadowStretch);
+    previousShadowStretchCount = controlOutputs.shadowStretchCount;
+    ShadowScore shadowScore;
+    getShadowScore(&shadowScore);
+    if (shadowScore.verdict != previousShadowVerdict) {
+      DEBUG_PID(LOG_PID_SHADOW_VERDICT, static_cast<int>(shadowScore.verdict), shadowScore.stretches, shadowScore.candidateIae, shadowScore.liveGainsIae);
+      previousShadowVerdict = shadowScore.verdict;
+    }
+    if (shadowScore.verdict == SHADOW_VERDICT_CANDIDATE_WINS && enableShadowPromotion) {
+      // Candidate becomes the live gains and shadow mode switches off, there is nothing left to compare it against
+      controlInputs.pressureKp = controlInputs.shadowCandidate.pressureKp;
+      controlInputs.pressureKi = controlInputs.shadowCandidate.pressureKi;
+      controlInputs.pressureKd = controlInputs.shadowCandidate.pressureKd;
+      controlInputs.shadowCandidate.enabled = false;
+      enablePotPidTuning = false;
+      controlInputsChanged = true;
+      resetShadowScore();
+      previousShadowVerdict = SHADOW_VERDICT_SCORING;
+      LOG_INFO(true, LOG_PID_SHADOW_PROMOTED, controlInputs.pressureKp, controlInputs.pressureKi, controlInputs.pressureKd);
+    }
+  }
+  currentIntakePressureGaugeKpa = controlReadings.intakePressureAbsoluteKpa - intakePressureAtmosphericOffsetKpa;
 
   // Calculate serial message quality stats, and set alarm condition if they are bad
   if (ptSerialCalculateMessageQualityStats.call()) {
+    ProfileScope taskProfile(PROFILED_SERIAL_CALCULATE_STATS);
     serialCalculateMessageQualityStats();
+    controlInputsChanged = true;
   }
 
   // Output serial message quality stats
   if (ptSerialReportMessageQualityStats.call() && reportSerialMessageStats) {
+    ProfileScope taskProfile(PROFILED_SERIAL_REPORT_STATS);
     serialReportMessageQualityStats();
   }
 
   // Check to see if we have any serial messages waiting and if so, process them
   if (ptSerialReadAndProcessMessage.call()) {
+    ProfileScope taskProfile(PROFILED_SERIAL_READ_AND_PROCESS);
     const char *serialMessage = serialGetIncomingMessage();
     int commandIdProcessed = -1;
 
     // Process the serial message if something was received (detected by start marker <)
     if (serialMessage[0] == '<') {
+      if (enableReplayRecording) {
+        recordReplayMasterFrame(serialMessage); // Before processing, which tokenises the message in place
+      }
       commandIdProcessed = serialProcessMessage(serialMessage, &currentVehicleSpeed, &currentVehicleRpm, &currentVehicleGear, &clutchPressed);
     }
 
     if (commandIdProcessed == 0) { // Master has requested latest info from us
-      DEBUG_SERIAL_SEND("Received request from master for params upadte (command ID 0 request, ID 2 response)");
-      serialSendCommandId0Response(globalAlarmCritical, currentTargetBoostKpa, currentManifoldPressureGaugeKpa, currentManifoldTempCelcius,
-                                   currentIntakePressureGaugeKpa, currentIntakeTempCelcius, currentBoostValveOpenPercentage);
+      DEBUG_SERIAL_SEND(LOG_SERIAL_SEND_COMMAND_0_RECEIVED);
+      serialSendCommandId0Response(globalAlarmCritical, controlReadings.targetBoostKpa, controlReadings.manifoldPressureGaugeKpa, currentManifoldTempCelcius,
+                                   currentIntakePressureGaugeKpa, currentIntakeTempCelcius, controlReadings.boostValveOpenPercentage, getFaultBitmask());
     }
 
     if (commandIdProcessed == 1) { // Updated parameters from master
-      lastSuccessfulCommandId1Processed = millis();
-      DEBUG_SERIAL_RECEIVE("Successfully processed command ID 1 message (update pushed params from master)");
+      controlInputs.vehicleRpm = currentVehicleRpm;
+      controlInputs.vehicleGear = currentVehicleGear;
+      controlInputs.clutchPressed = clutchPressed;
+      controlInputsChanged = true;
+      updateVehicleStateEstimator(currentVehicleSpeed, currentVehicleRpm, currentVehicleGear, clutchPressed);
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_COMMAND_1_PROCESSED);
+
+      if (enableDrivingEvents) {
+        VehicleEstimate vehicle;
+        getVehicleEstimate(&vehicle);
+        byte drivingEvents = detectDrivingEvents(currentVehicleGear, clutchPressed, vehicle.rpmPerSecond);
+        if (drivingEvents != 0) {
+          DEBUG_BOOST(LOG_BOOST_DRIVING_EVENT, drivingEvents, currentVehicleGear, currentVehicleRpm);
+          drivingEventPending = true;
+        }
+      }
+    }
+
+    // Straight after reading so a reply is normally waiting by the next poll
+    if (enableMasterTimeSync && isTimeSyncRequestDue()) {
+      serialSendCommandId3Request();
     }
   }
 
   // Perform any checks specifically around critical alarm conditions and set flag if needed
   if (ptCheckFaultConditions.call()) {
-    checkAndSetFaultConditions(&currentManifoldPressureGaugeKpa, &currentTargetBoostKpa);
+    ProfileScope taskProfile(PROFILED_CHECK_FAULT_CONDITIONS);
+    // An event that came and went between checks still counts
+    bool overboostDetected = controlOutputs.overboostDetected || controlOutputs.overboostEventCount != previousOverboostEventCount;
+    previousOverboostEventCount = controlOutputs.overboostEventCount;
+    checkAndSetFaultConditions(&overboostDetected, &controlReadings.manifoldPressureGaugeKpa, &controlReadings.overboostLimitKpa);
+
+    ControlTickStats tickStats;
+    getControlTickStats(&tickStats);
+    updateFaultCondition(FAULT_CONTROL_TICK_OVERRUN, tickStats.overrunCount != previousControlTickOverrunCount);
+    previousControlTickOverrunCount = tickStats.overrunCount;
+    updateFaultCondition(FAULT_INTAKE_SENSOR, !controlOutputs.intakePressurePlausible);
+    updateFaultCondition(FAULT_HEAP_ALLOCATION, getAllocationsAfterSetup() > 0);
+    controlInputsChanged = true;
   }
 
   // Calculate the desired boost we should be running unless critical alarm is set
-  // Critical alarm state may be set in a number of ways else where in the code:
-  //   - Over boosting, unable to maintain the desired target
-  //   - Not getting valid data from the master for x time (also accounts for bad quality comms)
-  if (ptCalculateDesiredBoostKpa.call()) {
+  // Critical alarm state is set by the fault manager while any critical fault is active, see faultManager.cpp
+  // Speed, RPM and gear are the estimator's, the last frame as it was or carried forward along its trend if it's late.
+  // A driving event brings it forward and the new target goes to the tick with a pre-position request.
+  if (ptCalculateDesiredBoostKpa.call() || drivingEventPending) {
+    ProfileScope taskProfile(PROFILED_CALCULATE_DESIRED_BOOST);
+    if (drivingEventPending) {
+      controlInputs.prepositionSequence++;
+      drivingEventPending = false;
+    }
+    VehicleEstimate vehicle;
+    getVehicleEstimate(&vehicle);
     if (globalAlarmCritical == true) {
-      currentTargetBoostKpa = 0.0;
+      controlInputs.targetBoostKpa = 0.0;
     } else {
-      currentTargetBoostKpa = calculateDesiredBoostKpa(currentVehicleSpeed, currentVehicleRpm, currentVehicleGear, clutchPressed);
-    }
-  }
-
-  // Update PID valve control to drive to target boost or position as needed
-  // If critical alarm is set, stop the motor and let the return spring open the valve to 'fail safe'
-  if (ptCalculatePidAndDriveValve.call()) {
-    if (globalAlarmCritical) {
-      setCytronSpeedAndDirection(0.0);
-      return;
+      float desiredBoostKpa = calculateDesiredBoostKpa(vehicle.speed, vehicle.rpm, vehicle.gear, vehicle.clutchPressed);
+      controlInputs.targetBoostKpa = discountBoostForInputAge(desiredBoostKpa, getOldestMasterInputAgeMillis(), vehicle.extrapolated);
     }
-
-    if (currentTargetBoostKpa == 0) {
-      currentTargetBoostValveOpenPercentage = 100;
-      if (usingPressureControl) {
-        usingPositionControl = true;
-        usingPressureControl = false;
-        DEBUG_PID("Switching control mode to POSITIONAL");
+    if (vehicle.gearMismatch != previousGearMismatch) {
+      if (vehicle.gearMismatch) {
+        LOG_WARN(true, LOG_BOOST_GEAR_MISMATCH, currentVehicleGear, vehicle.inferredGear, currentVehicleRpm, currentVehicleSpeed);
+      } else {
+        LOG_INFO(true, LOG_BOOST_GEAR_MISMATCH_CLEARED);
       }
-      driveBoostValveToTargetByOpenPercentagePid(&boostValvePositionPID, &currentBoostValveOpenPercentage, &currentBoostValveMotorSpeed, &currentTargetBoostValveOpenPercentage);
-      return;
+      previousGearMismatch = vehicle.gearMismatch;
     }
+    controlInputsChanged = true;
+  }
 
-    if (currentTargetBoostKpa > 0) {
-      if (currentManifoldPressureGaugeKpa < (currentTargetBoostKpa * valvePositionToPressureControlTransitionFactor)) {
-        currentTargetBoostValveOpenPercentage = 0;
-        if (usingPressureControl) {
-          usingPositionControl = true;
-          usingPressureControl = false;
-          DEBUG_PID("Switching control mode to POSITIONAL");
-        }
-        driveBoostValveToTargetByOpenPercentagePid(&boostValvePositionPID, &currentBoostValveOpenPercentage, &currentBoostValveMotorSpeed, &currentTargetBoostValveOpenPercentage);
-        return;
-      } else {
-        if (usingPositionControl) {
-          usingPositionControl = false;
-          usingPressureControl = true;
-          DEBUG_PID("Switching control mode to PRESSURE");
-        }
-        driveBoostValveToTargetByPressurePid(&boostValvePressurePID, &currentBoostValveMotorSpeed, &boostValvePositionReadingMinimumRaw, &boostValvePositionReadingMaximumRaw, &currentBoostValvePositionReadingRaw);
+  // Follow atmospheric pressure while the car is off boost (engine off, idling, or clutch in with a 0kPa target), and
+  // hand the control tick a new manifold offset whenever it moves by a raw count
+  if (ptUpdateAtmosphericBaseline.call() && enableAtmosphericTracking) {
+    ProfileScope taskProfile(PROFILED_ATMOSPHERIC_BASELINE);
+    bool offsetChanged = updateAtmosphericBaseline(controlOutputs.manifoldPressureAbsoluteRaw, controlOutputs.intakePressureAbsoluteRaw,
+                                                   controlOutputs.intakePressurePlausible, currentVehicleRpm, clutchPressed, controlInputs.targetBoostKpa,
+                                                   getOldestMasterInputAgeMillis());
+    if (offsetChanged) {
+      AtmosphericBaseline atmospheric;
+      getAtmosphericBaseline(&atmospheric);
+      manifoldPressureAtmosphericOffsetRaw = atmospheric.manifoldOffsetRaw;
+      intakePressureAtmosphericOffsetRaw = atmospheric.intakeOffsetRaw;
+      manifoldPressureAtmosphericOffsetKpa = calculateBosch3BarKpaFromRaw(manifoldPressureAtmosphericOffsetRaw);
+      intakePressureAtmosphericOffsetKpa = atmospheric.atmosphericKpa;
+      controlInputs.manifoldAtmosphericOffsetRaw = lroundf(manifoldPressureAtmosphericOffsetRaw);
+      controlInputsChanged = true;
+      if (enableReplayRecording) {
+        recordReplayAtmospheric(controlInputs.manifoldAtmosphericOffsetRaw);
       }
+      DEBUG_GENERAL(LOG_GENERAL_ATMOSPHERIC_BASELINE, atmospheric.atmosphericKpa, controlInputs.manifoldAtmosphericOffsetRaw, atmospheric.driftKpa,
+                    static_cast<int>(atmospheric.window));
     }
   }
 
   // Output plotter friendly data for the Arduino IDE plotter
   if (ptOutputPidDataForLivePlotter.call() && enablePidPlotterOutput) {
-    outputArduinoIdePlotterData(&currentTargetBoostKpa, &currentManifoldPressureGaugeKpa, &PressureKp, &PressureKi, &PressureKd);
+    ProfileScope taskProfile(PROFILED_PLOTTER_OUTPUT);
+    outputArduinoIdePlotterData(&controlReadings.targetBoostKpa, &controlReadings.manifoldPressureGaugeKpa, &controlInputs.pressureKp, &controlInputs.pressureKi, &controlInputs.pressureKd);
   }
 
   // Some temporary debug that may remain in place
   if (ptOutputTargetAndCurrentBoostDebug.call()) {
-    DEBUG_PID("Target boost is " + String(currentTargetBoostKpa) + "kPa and current is " + String(currentManifoldPressureGaugeKpa) + "kPa");
+    ProfileScope taskProfile(PROFILED_BOOST_DEBUG_OUTPUT);
+    DEBUG_PID(LOG_PID_TARGET_AND_CURRENT, controlReadings.targetBoostKpa, controlReadings.manifoldPressureGaugeKpa);
     // THIS NEEDS TO BE CHANGED BACK TO DEBUG_BOOST
-    DEBUG_PID("Proportional value: " + String(PressureKp, 2) + " Integral value: " + String(PressureKi, 2) + " Derivative value: " + String(PressureKd, 2) + "\n");
-    // DEBUG_PID("Current open percentage: " + String(currentBoostValveOpenPercentage, 2) + " Target open percentage: " + String(currentTargetBoostValveOpenPercentage, 2) + "\n");
+    DEBUG_PID(LOG_PID_TUNINGS, controlInputs.pressureKp, controlInputs.pressureKi, controlInputs.pressureKd);
+    // DEBUG_PID(LOG_PID_VALVE_OPEN_AND_TARGET, controlReadings.boostValveOpenPercentage, controlReadings.targetBoostValveOpenPercentage);
+    logBoostValveOpenPercentage(controlOutputs.boostValvePositionReadingRaw, boostValvePositionReadingMinimumRaw, boostValvePositionReadingMaximumRaw,
+                                controlReadings.boostValveOpenPercentage);
   }
 
   // Used for tuning PID values using potentiometers to adjust P, I and D values
   if (ptReadPidPotsAndUpdateTuning.call() && enablePotPidTuning) {
-    readPidPotsAndUpdateTuning(&boostValvePressurePID, &PressureKp, &PressureKi, &PressureKd);
+    ProfileScope taskProfile(PROFILED_PID_POTS);
+    int pidPotsRaw[PID_POT_COUNT];
+    readPidPots(pidPotsRaw);
+    if (enableReplayRecording) {
+      recordReplayPots(pidPotsRaw);
+    }
+    setPidTuningFromPots(pidPotsRaw, &controlInputs.pressureKp, &controlInputs.pressureKi, &controlInputs.pressureKd);
+    controlInputsChanged = true;
+  }
+
+#if PLATFORM_HAS_NETWORK
+  // Keep WiFi and the MQTT connection alive, reassociating / reconnecting with backoff after a drop. Telemetry simply
+  // pauses while either is down, the control tick is unaffected.
+  {
+    ProfileScope taskProfile(PROFILED_WIFI_SERVICE);
+    wifiIsConnected = serviceWiFiConnection();
+  }
+  {
+    ProfileScope taskProfile(PROFILED_MQTT_SERVICE);
+    mqttIsConnected = serviceMqttConnection(wifiIsConnected);
+  }
+
+  // Remote tuning and mode commands. Each one is handed to the control tick with the next sequence number and
+  // acknowledged once the tick's outputs show it has been taken on.
+  if (mqttCommandAwaitingTick) {
+    if (controlOutputs.appliedCommandSequence == controlInputs.commandSequence) {
+      acknowledgeMqttCommand(&mqttCommand, true);
+      mqttCommandAwaitingTick = false;
+    } else if (halMicros() - mqttCommand.receivedMicros > mqttCommandApplyTimeoutUs) {
+      acknowledgeMqttCommand(&mqttCommand, false);
+      mqttCommandAwaitingTick = false;
+    }
+  } else if (takeMqttCommand(&mqttCommand)) {
+    applyMqttCommand(&mqttCommand, &controlInputs.pressureKp, &controlInputs.pressureKi, &controlInputs.pressureKd, &controlInputs.shadowCandidate);
+    if (mqttCommand.type == MQTT_COMMAND_PID || mqttCommand.type == MQTT_COMMAND_SHADOW) {
+      enablePotPidTuning = false; // Otherwise the pots overwrite the new gains within 500ms, or move the live ones under the shadow's scoring
+    }
+    if (mqttCommand.type == MQTT_COMMAND_SHADOW) {
+      previousShadowVerdict = SHADOW_VERDICT_SCORING;
+    }
+    controlInputs.commandSequence++;
+    controlInputsChanged = true;
+    mqttCommandAwaitingTick = true;
   }
 
   // Publish metrics via MQTT to server if needed
   if (ptMqttPublishMetricsToServer100Ms.call() && mqttIsConnected) {
-    // Publish pressure metrics
-    std::map<String, double> metricsPressures;
-    metricsPressures["Target"] = currentTargetBoostKpa;
-    metricsPressures["Actual"] = currentManifoldPressureGaugeKpa;
-    publishMqttMetrics("pressures", metricsPressures);
+    ProfileScope taskProfile(PROFILED_MQTT_PUBLISH_100MS);
+    float pressures[] = {static_cast<float>(controlReadings.targetBoostKpa), static_cast<float>(controlReadings.manifoldPressureGaugeKpa)};
+    float valveOpen[] = {static_cast<float>(controlReadings.boostValveOpenPercentage)};
+    float compressor[] = {static_cast<float>(controlReadings.intakePressureAbsoluteKpa), static_cast<float>(controlReadings.pressureRatio),
+                          static_cast<float>(controlReadings.pressureRatioRatePerSecond), static_cast<float>(controlOutputs.pressureRatioLimitActive)};
+
+    if (mqttPublishCombined) {
+      // Pressures, compressor, valve open and PID gains as one message
+      float pids[] = {static_cast<float>(controlInputs.pressureKp), static_cast<float>(controlInputs.pressureKi), static_cast<float>(controlInputs.pressureKd)};
+      MetricGroup groups[] = {metricGroup(pressuresMetricSchema, pressures), metricGroup(compressorMetricSchema, compressor), metricGroup(valveOpenMetricSchema, valveOpen),
+                              metricGroup(pidsMetricSchema, pids)};
+      publishMqttMetricGroups(combinedTelemetryTopic, groups, 4, true);
+    } else {
+      publishMqttMetrics(pressuresMetricSchema, pressures);
+      publishMqttMetrics(compressorMetricSchema, compressor);
+      publishMqttMetrics(valveOpenMetricSchema, valveOpen);
+    }
 
-    // Publish valve open metric if needed
-    std::map<String, double> metricsValveOpen;
-    metricsValveOpen["Percentage"] = currentBoostValveOpenPercentage;
-    publishMqttMetrics("valveopen", metricsValveOpen);
+    // Boost events one at a time as they complete, or catching up on any kept while disconnected
+    BoostEventRecord boostEvent;
+    if (takeUnpublishedBoostEvent(&boostEvent)) {
+      float boostEventValues[] = {static_cast<float>(boostEvent.sequence), static_cast<float>(boostEvent.gear), static_cast<float>(boostEvent.rpmBand),
+                                  boostEvent.startKpa, boostEvent.targetKpa, boostEvent.riseTimeMillis, boostEvent.overshootKpa, boostEvent.settlingTimeMillis,
+                                  boostEvent.steadyStateErrorKpa, boostEvent.integralAbsoluteError, boostEvent.pressureKp, boostEvent.pressureKi, boostEvent.pressureKd};
+      publishMqttMetrics(boostEventMetricSchema, boostEventValues);
+    }
   }
 
   if (ptMqttPublishMetricsToServer1S.call() && mqttIsConnected) {
-    // Publish PID control metrics if needed
-    std::map<String, double> metricsPids;
-    metricsPids["kP"] = PressureKp;
-    metricsPids["kI"] = PressureKi;
-    metricsPids["kD"] = PressureKd;
-    publishMqttMetrics("pids", metricsPids);
+    ProfileScope taskProfile(PROFILED_MQTT_PUBLISH_1S);
+    // Publish PID control metrics if they didn't already go out in the combined message
+    if (!mqttPublishCombined) {
+      float pids[] = {static_cast<float>(controlInputs.pressureKp), static_cast<float>(controlInputs.pressureKi), static_cast<float>(controlInputs.pressureKd)};
+      publishMqttMetrics(pidsMetricSchema, pids);
+    }
+
+    // Publish active fault bitmask
+    float faults[] = {static_cast<float>(getFaultBitmask())};
+    publishMqttMetrics(faultsMetricSchema, faults);
+
+    // Publish link quality
+    WifiConnectionStats wifiStats;
+    getWiFiConnectionStats(&wifiStats);
+    float wifi[] = {static_cast<float>(wifiStats.rssi), wifiStats.rssiAverage, static_cast<float>(wifiStats.drops)};
+    publishMqttMetrics(wifiMetricSchema, wifi);
+
+    // Publish overboost protection state, and how long the valve took to open the last time it fired
+    float overboost[] = {static_cast<float>(controlReadings.overboostLimitKpa), static_cast<float>(controlReadings.manifoldPressureRatePerSecond),
+                         static_cast<float>(controlOutputs.overboostProtectionActive), static_cast<float>(controlOutputs.overboostEventCount),
+                         static_cast<float>(controlReadings.overboostOpenLatencyMillis)};
+    publishMqttMetrics(overboostMetricSchema, overboost);
+
+    // Publish master clock sync and how old the master's inputs are
+    TimeSyncStatus timeSync;
+    getTimeSyncStatus(&timeSync);
+    float timeSyncValues[] = {static_cast<float>(timeSync.synchronised), static_cast<float>(timeSync.offsetMillis), timeSync.driftPpm,
+                              static_cast<float>(timeSync.roundTripMillis), static_cast<float>(getOldestMasterInputAgeMillis())};
+    publishMqttMetrics(timeSyncMetricSchema, timeSyncValues);
+
+    // Publish what the estimator makes of speed, RPM and gear
+    VehicleEstimate vehicle;
+    getVehicleEstimate(&vehicle);
+    float estimatorValues[] = {static_cast<float>(vehicle.inferredGear), static_cast<float>(vehicle.gearMismatch), static_cast<float>(vehicle.extrapolated),
+                               vehicle.rpmPerSecond, vehicle.speedPerSecond};
+    publishMqttMetrics(estimatorMetricSchema, estimatorValues);
+
+    // Publish the atmospheric reference gauge pressures are worked out from, and how long since it was last confirmed
+    AtmosphericBaseline atmospheric;
+    getAtmosphericBaseline(&atmospheric);
+    float atmosphereValues[] = {atmospheric.atmosphericKpa, atmospheric.driftKpa, atmospheric.manifoldOffsetRaw, static_cast<float>(atmospheric.ageMillis / 1000),
+                                static_cast<float>(atmospheric.updates), static_cast<float>(atmospheric.rejected), static_cast<float>(atmospheric.window)};
+    publishMqttMetrics(atmosphereMetricSchema, atmosphereValues);
+
+    // Publish how the shadow candidate gains are scoring against the live ones
+    if (controlInputs.shadowCandidate.enabled) {
+      ShadowScore shadowScore;
+      getShadowScore(&shadowScore);
+      float shadowValues[] = {static_cast<float>(shadowScore.stretches), static_cast<float>(shadowScore.verdict), static_cast<float>(shadowScore.candidateIae),
+                              static_cast<float>(shadowScore.liveGainsIae), static_cast<float>(shadowScore.liveIae), static_cast<float>(shadowScore.modelIae),
+                              static_cast<float>(controlInputs.shadowCandidate.pressureKp), static_cast<float>(controlInputs.shadowCandidate.pressureKi),
+                              static_cast<float>(controlInputs.shadowCandidate.pressureKd)};
+      publishMqttMetrics(shadowMetricSchema, shadowValues);
+    }
+  }
+
+  // Send the last 100ms of full rate control tick samples
+  if (enableTelemetryBatching) {
+    ProfileScope taskProfile(PROFILED_TELEMETRY_BATCH);
+    serviceTelemetryBatches(mqttIsConnected);
+  }
+#endif
+
+  // Output control tick jitter stats
+  if (ptReportControlTickStats.call() && reportControlTickStats) {
+    ProfileScope taskProfile(PROFILED_CONTROL_TICK_REPORT);
+    reportControlTickJitter();
+  }
+
+  // Stream out the blackbox once it has frozen around a fault, a line at a time
+  if (ptServiceBlackboxDump.call()) {
+    ProfileScope taskProfile(PROFILED_BLACKBOX_DUMP);
+    serviceBlackboxDump((blackboxDumpOverMqtt && mqttIsConnected) ? BLACKBOX_DUMP_MQTT : BLACKBOX_DUMP_SERIAL);
+  }
+
+#if PLATFORM_HAS_NETWORK
+  // Output WiFi and MQTT connection and publish counters
+  if (ptReportMqttConnectionStats.call() && reportMqttStats) {
+    reportWiFiConnectionStats();
+    reportMqttConnectionStats();
+  }
+#endif
+
+  // Output active faults and fault history
+  if (ptReportFaultStatus.call() && reportFaultStats) {
+    reportFaultStatus();
+  }
+
+  // Output the step response of the kept boost events
+  if (ptReportBoostEvents.call() && reportBoostEventStats) {
+    reportBoostEvents();
+  }
+
+  // Output and publish per task execution profiles, then start a new interval
+  if (ptReportTaskProfiles.call()) {
+    if (reportTaskProfilerStats) {
+      reportTaskProfiles();
+    }
+#if PLATFORM_HAS_NETWORK
+    if (mqttIsConnected) {
+      publishTaskProfiles();
+
+      // Publish stack and heap use with the loop's profile
+      MemoryStats memory;
+      getMemoryStats(&memory);
+      float memoryValues[] = {static_cast<float>(memory.stackHighWaterBytes), static_cast<float>(memory.stackSizeBytes), static_cast<float>(memory.heapInUseBytes),
+                              static_cast<float>(memory.allocationsAfterSetup)};
+      publishMqttMetrics(memoryMetricSchema, memoryValues);
+    }
+#endif
+    resetTaskProfiles();
+  }
+
+  // Stream recorded control inputs, again only as much as the serial transmit buffer can take
+  if (enableReplayRecording) {
+    ProfileScope taskProfile(PROFILED_REPLAY_RECORDING);
+    serviceReplayRecording();
+  }
+
+  // Format and print queued debug output, only as much as the serial transmit buffer can take without blocking
+  {
+    ProfileScope taskProfile(PROFILED_LOG_OUTPUT);
+    serviceLogOutput();
+  }
+
+  // Hand any changed targets, tunings or alarm state to the control tick, converted here so the tick doesn't have to
+  if (controlInputsChanged) {
+    controlInputs.alarmCritical = globalAlarmCritical;
+    convertControlInputs(&controlInputs);
+    controlInputsHandoff.publish(controlInputs);
   }
 
   // Increment loop counter if needed so we can report on stats
-  if (millis() > 10000 && reportArduinoLoopStats) {
+  if (halMillis() > 10000 && reportArduinoLoopStats) {
     arduinoLoopExecutionCount++;
     if (ptReportArduinoLoopStats.call()) {
       reportArduinoLoopRate(&arduinoLoopExecutionCount);
+      reportMemoryStats();
     }
   }
 }
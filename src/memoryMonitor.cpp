@@ -0,0 +1,197 @@
+#include "memoryMonitor.h"
+
+#if defined(ARDUINO_ARCH_AVR)
+// avr-libc's heap: where it starts, how far it has grown and its list of freed chunks
+struct __freelist {
+  size_t sz;
+  struct __freelist *nx;
+};
+extern "C" char __heap_start;
+extern "C" char *__brkval;
+extern "C" struct __freelist *__flp;
+#else
+#include <malloc.h>
+// Main stack section from the FSP linker script
+extern "C" char __StackLimit;
+extern "C" char __StackTop;
+#endif
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const byte stackPaintByte = 0xA5;
+const uintptr_t stackPaintMarginBytes = 64; // Left alone below paintStack()'s own frame
+
+bool stackPainted = false;
+bool heapGuardArmed = false;
+unsigned long heapAllocationsAfterSetup = 0;
+unsigned long heapLastAllocationBytes = 0;
+uintptr_t heapLastAllocationCaller = 0;
+
+/* ======================================================================
+   FUNCTION: Lowest and one past highest address the stack can use
+   ====================================================================== */
+// On the Mega the heap grows up into the same space the stack grows down into, so the bottom moves with it
+uintptr_t getStackBottom() {
+#if defined(ARDUINO_ARCH_AVR)
+  return reinterpret_cast<uintptr_t>(__brkval != nullptr ? __brkval : &__heap_start);
+#else
+  return reinterpret_cast<uintptr_t>(&__StackLimit);
+#endif
+}
+
+uintptr_t getStackTop() {
+#if defined(ARDUINO_ARCH_AVR)
+  return RAMEND + 1;
+#else
+  return reinterpret_cast<uintptr_t>(&__StackTop);
+#endif
+}
+
+/* ======================================================================
+   FUNCTION: Fill the unused stack with a known pattern
+   ====================================================================== */
+// Call first thing in setup(). Whatever is found overwritten later has been used by the stack at some point, interrupts
+// included, so the high water mark comes from scanning up from the bottom for the first byte that has changed.
+void __attribute__((noinline)) paintStack() {
+  byte marker;
+  uintptr_t end = reinterpret_cast<uintptr_t>(&marker) - stackPaintMarginBytes;
+  for (uintptr_t address = getStackBottom(); address < end; address++) {
+    *reinterpret_cast<volatile byte *>(address) = stackPaintByte;
+  }
+  stackPainted = true;
+}
+
+/* ======================================================================
+   FUNCTION: Deepest the stack has been since it was painted
+   ====================================================================== */
+unsigned long getStackHighWaterBytes() {
+  if (!stackPainted) {
+    return 0;
+  }
+  uintptr_t address = getStackBottom();
+  uintptr_t top = getStackTop();
+  while (address < top && *reinterpret_cast<volatile byte *>(address) == stackPaintByte) {
+    address++;
+  }
+  return top - address;
+}
+
+/* ======================================================================
+   FUNCTION: Bytes currently allocated from the heap
+   ====================================================================== */
+unsigned long getHeapInUseBytes() {
+#if defined(ARDUINO_ARCH_AVR)
+  if (__brkval == nullptr) {
+    return 0;
+  }
+  unsigned long inUse = __brkval - &__heap_start;
+  for (struct __freelist *chunk = __flp; chunk != nullptr; chunk = chunk->nx) {
+    inUse -= chunk->sz + sizeof(size_t);
+  }
+  return inUse;
+#else
+  return mallinfo().uordblks;
+#endif
+}
+
+/* ======================================================================
+   FUNCTION: Start counting heap allocations, call at the end of setup()
+   ====================================================================== */
+// Only does anything in a HEAP_GUARD build, where malloc and realloc are wrapped at link time (see platformio.ini)
+void armHeapGuard() {
+#ifdef HEAP_GUARD
+  heapGuardArmed = true;
+#endif
+}
+
+unsigned long getAllocationsAfterSetup() {
+  return heapAllocationsAfterSetup;
+}
+
+/* ======================================================================
+   FUNCTION: Heap allocation wrappers, linked in place of malloc and realloc
+   ====================================================================== */
+// Allocations only ever come from the background (the control tick must not allocate), so plain counters will do.
+// new, String and the WiFi library all end up here.
+#ifdef HEAP_GUARD
+void noteHeapAllocation(size_t size, void *caller) {
+  if (!heapGuardArmed) {
+    return;
+  }
+  heapAllocationsAfterSetup++;
+  heapLastAllocationBytes = size;
+  heapLastAllocationCaller = reinterpret_cast<uintptr_t>(caller);
+}
+
+extern "C" {
+#if defined(ARDUINO_ARCH_AVR)
+void *__real_malloc(size_t);
+void *__real_realloc(void *, size_t);
+
+void *__wrap_malloc(size_t size) {
+  noteHeapAllocation(size, __builtin_return_address(0));
+  return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  noteHeapAllocation(size, __builtin_return_address(0));
+  return __real_realloc(pointer, size);
+}
+#else
+// newlib's malloc and realloc are thin wrappers round the reentrant versions, which is what everything else calls too
+void *__real__malloc_r(struct _reent *, size_t);
+void *__real__realloc_r(struct _reent *, void *, size_t);
+
+void *__wrap__malloc_r(struct _reent *reent, size_t size) {
+  noteHeapAllocation(size, __builtin_return_address(0));
+  return __real__malloc_r(reent, size);
+}
+
+void *__wrap__realloc_r(struct _reent *reent, void *pointer, size_t size) {
+  noteHeapAllocation(size, __builtin_return_address(0));
+  return __real__realloc_r(reent, pointer, size);
+}
+#endif
+}
+#endif
+
+/* ======================================================================
+   FUNCTION: Current stack and heap usage
+   ====================================================================== */
+void getMemoryStats(MemoryStats *stats) {
+  stats->stackSizeBytes = getStackTop() - getStackBottom();
+  stats->stackHighWaterBytes = getStackHighWaterBytes();
+  stats->heapInUseBytes = getHeapInUseBytes();
+  stats->heapGuardArmed = heapGuardArmed;
+  stats->allocationsAfterSetup = heapAllocationsAfterSetup;
+  stats->lastAllocationBytes = heapLastAllocationBytes;
+  stats->lastAllocationCaller = heapLastAllocationCaller;
+}
+
+/* ======================================================================
+   FUNCTION: Print stack and heap usage, alongside the loop stats
+   ====================================================================== */
+void reportMemoryStats() {
+  MemoryStats stats;
+  getMemoryStats(&stats);
+  Serial.print("Stack high water (bytes): ");
+  Serial.print(stats.stackHighWaterBytes);
+  Serial.print(" of ");
+  Serial.print(stats.stackSizeBytes);
+  Serial.print(", heap in use (bytes): ");
+  Serial.println(stats.heapInUseBytes);
+
+  if (!stats.heapGuardArmed) {
+    return;
+  }
+  Serial.print("Heap allocations after setup: ");
+  Serial.print(stats.allocationsAfterSetup);
+  if (stats.allocationsAfterSetup > 0) {
+    Serial.print(", last ");
+    Serial.print(stats.lastAllocationBytes);
+    Serial.print(" bytes from 0x");
+    Serial.print(stats.lastAllocationCaller, HEX);
+  }
+  Serial.println();
+}
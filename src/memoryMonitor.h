@@ -0,0 +1,28 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: Stack and heap usage since boot
+   ====================================================================== */
+struct MemoryStats {
+  unsigned long stackSizeBytes;          // Room the stack has, down to its limit (R4) or the top of the heap (Mega)
+  unsigned long stackHighWaterBytes;     // Deepest the stack has been, control tick and other interrupts included
+  unsigned long heapInUseBytes;          // Allocated and not yet freed
+  bool heapGuardArmed;                   // Built with HEAP_GUARD and setup() has finished
+  unsigned long allocationsAfterSetup;   // Calls to malloc / realloc (new included) since the guard was armed
+  unsigned long lastAllocationBytes;     // Size asked for by the most recent of those
+  unsigned long lastAllocationCaller;    // Return address in the code that asked, look it up with addr2line
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void paintStack();
+void armHeapGuard();
+unsigned long getAllocationsAfterSetup();
+void getMemoryStats(MemoryStats *);
+void reportMemoryStats();
+
+#endif
@@ -0,0 +1,129 @@
+#include "mqttCommandParser.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const MqttCommandDefinition mqttCommandDefinitions[] = {
+    {"command/pid", MQTT_COMMAND_PID, 3, false, {{"kp", 0, 200, false}, {"ki", 0, 50, false}, {"kd", 0, 50, false}}},
+    {"command/boost", MQTT_COMMAND_BOOST_TARGET, 2, true, {{"gear", 1, 6, true}, {"kpa", 0, 100, true}}},
+    {"command/debug", MQTT_COMMAND_DEBUG, 6, false, {{"serialReceive", 0, 1, true}, {"serialSend", 0, 1, true}, {"valve", 0, 1, true}, {"boost", 0, 1, true}, {"pid", 0, 1, true}, {"general", 0, 1, true}}},
+    {"command/blackbox", MQTT_COMMAND_BLACKBOX, 0, false, {}},
+    {"command/shadow", MQTT_COMMAND_SHADOW, 4, false, {{"kp", 0, 200, false}, {"ki", 0, 50, false}, {"kd", 0, 50, false}, {"enable", 0, 1, true}}},
+    {"command/faults", MQTT_COMMAND_FAULTS, 0, false, {}}};
+const int mqttCommandDefinitionCount = sizeof(mqttCommandDefinitions) / sizeof(mqttCommandDefinitions[0]);
+
+/* ======================================================================
+   FUNCTION: Definition for a topic, nullptr if it isn't one of ours
+   ====================================================================== */
+const MqttCommandDefinition *findMqttCommandDefinition(const char *topic) {
+  for (int i = 0; i < mqttCommandDefinitionCount; i++) {
+    if (strcmp(topic, mqttCommandDefinitions[i].topic) == 0) {
+      return &mqttCommandDefinitions[i];
+    }
+  }
+  return nullptr;
+}
+
+/* ======================================================================
+   FUNCTION: Copy a received payload into a buffer for parsing
+   ====================================================================== */
+// Too long for the buffer returns the reason for rejecting it. The start is still copied so the id can be acknowledged,
+// but the command itself must not be acted on, it would be missing whatever was cut off.
+const char *copyMqttCommandPayload(char *buffer, int bufferSize, const byte *payload, unsigned int length) {
+  unsigned int copyLength = min(length, static_cast<unsigned int>(bufferSize - 1));
+  memcpy(buffer, payload, copyLength);
+  buffer[copyLength] = '\0';
+  return (copyLength < length) ? "payload too long" : nullptr;
+}
+
+/* ======================================================================
+   FUNCTION: Parse a number, the whole of the text must be used
+   ====================================================================== */
+// strtod() takes "nan" and "inf", and NaN would pass every range check below, so only finite values count as numbers
+bool parseCommandNumber(const char *text, double *value) {
+  char *end;
+  *value = strtod(text, &end);
+  return end != text && *end == '\0' && isfinite(*value);
+}
+
+/* ======================================================================
+   FUNCTION: Whether a value fits the id and t fields (whole, 0 to the largest 32 bit unsigned)
+   ====================================================================== */
+bool isCommandCounter(double value) {
+  return value >= 0 && value <= 4294967295.0 && value == floor(value);
+}
+
+/* ======================================================================
+   FUNCTION: Parse and validate the payload against its command definition
+   ====================================================================== */
+// Splits the payload in place, no allocation. Returns nullptr when valid, otherwise the reason for rejecting it. Fills in
+// everything but receivedMicros, so a rejection can still be acknowledged against the id if it was read.
+const char *parseMqttCommand(const MqttCommandDefinition *definition, char *payload, MqttCommand *command, char *reason, int reasonSize) {
+  command->type = definition->type;
+  command->id = 0;
+  command->hasSenderTime = false;
+  command->senderTime = 0;
+  command->receivedMicros = 0;
+  for (float &value : command->values) {
+    value = NAN;
+  }
+
+  bool hasId = false;
+  int fieldsGiven = 0;
+
+  for (char *token = payload; token != nullptr && *token != '\0';) {
+    char *next = strchr(token, ',');
+    if (next != nullptr) {
+      *next++ = '\0';
+    }
+    char *separator = strchr(token, '=');
+    if (separator == nullptr) {
+      return "expected key=value";
+    }
+    *separator = '\0';
+    double value;
+    if (!parseCommandNumber(separator + 1, &value)) {
+      snprintf(reason, reasonSize, "%s not a number", token);
+      return reason;
+    }
+
+    if ((strcmp(token, "id") == 0 || strcmp(token, "t") == 0) && !isCommandCounter(value)) {
+      snprintf(reason, reasonSize, "%s out of range", token);
+      return reason;
+    }
+    if (strcmp(token, "id") == 0) {
+      command->id = static_cast<unsigned long>(value);
+      hasId = true;
+    } else if (strcmp(token, "t") == 0) {
+      command->senderTime = static_cast<unsigned long>(value);
+      command->hasSenderTime = true;
+    } else {
+      int field = 0;
+      while (field < definition->fieldCount && strcmp(token, definition->fields[field].key) != 0) {
+        field++;
+      }
+      if (field == definition->fieldCount) {
+        snprintf(reason, reasonSize, "unknown field %s", token);
+        return reason;
+      }
+      const MqttCommandField *fieldDefinition = &definition->fields[field];
+      if (value < fieldDefinition->minimum || value > fieldDefinition->maximum || (fieldDefinition->wholeNumber && value != floor(value))) {
+        snprintf(reason, reasonSize, "%s out of range", token);
+        return reason;
+      }
+      if (isnan(command->values[field])) {
+        fieldsGiven++;
+      }
+      command->values[field] = value;
+    }
+    token = next;
+  }
+
+  if (!hasId) {
+    return "missing id";
+  }
+  if (definition->allFieldsRequired ? fieldsGiven != definition->fieldCount : (definition->fieldCount > 0 && fieldsGiven == 0)) {
+    return "missing fields";
+  }
+  return nullptr;
+}
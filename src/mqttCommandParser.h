@@ -0,0 +1,65 @@
+#ifndef MQTTCOMMANDPARSER_H
+#define MQTTCOMMANDPARSER_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   ENUMS: Supported commands, one topic each under command/
+   ====================================================================== */
+enum MqttCommandType {
+  MQTT_COMMAND_NONE,
+  MQTT_COMMAND_PID,          // command/pid       kp, ki, kd (any of)
+  MQTT_COMMAND_BOOST_TARGET, // command/boost     gear, kpa
+  MQTT_COMMAND_DEBUG,        // command/debug     serialReceive, serialSend, valve, boost, pid, general (0 or 1, any of)
+  MQTT_COMMAND_BLACKBOX,     // command/blackbox  no fields, freezes and dumps the blackbox
+  MQTT_COMMAND_SHADOW,       // command/shadow    kp, ki, kd, enable (0 or 1, any of), candidate gains for shadow mode
+  MQTT_COMMAND_FAULTS        // command/faults    no fields, clears latched faults whose condition has gone away
+};
+
+/* ======================================================================
+   STRUCTURES: A parsed and validated command
+   ====================================================================== */
+// Every payload is comma separated key=value pairs and must include id. An optional t (sender clock, any units) is echoed
+// back in the acknowledgement so the sender can work out the round trip time, e.g. "id=12,t=5531,kp=30,ki=2.5".
+struct MqttCommand {
+  MqttCommandType type;
+  unsigned long id;
+  bool hasSenderTime;
+  unsigned long senderTime;
+  unsigned long receivedMicros;
+  float values[6]; // Per command fields in the order listed above, NAN when not given
+};
+
+/* ======================================================================
+   STRUCTURES: What each command accepts
+   ====================================================================== */
+struct MqttCommandField {
+  const char *key;
+  float minimum;
+  float maximum;
+  bool wholeNumber;
+};
+
+struct MqttCommandDefinition {
+  const char *topic;
+  MqttCommandType type;
+  byte fieldCount;
+  bool allFieldsRequired; // Otherwise at least one field must be given
+  MqttCommandField fields[6];
+};
+
+/* ======================================================================
+   VARIABLES: One definition per topic
+   ====================================================================== */
+extern const MqttCommandDefinition mqttCommandDefinitions[];
+extern const int mqttCommandDefinitionCount;
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+// No network or hardware in here, so it builds for [env:native] and its tests
+const MqttCommandDefinition *findMqttCommandDefinition(const char *);
+const char *copyMqttCommandPayload(char *, int, const byte *, unsigned int);
+const char *parseMqttCommand(const MqttCommandDefinition *, char *, MqttCommand *, char *, int);
+
+#endif
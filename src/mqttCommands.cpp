@@ -0,0 +1,178 @@
+#include "mqttCommands.h"
+#include "blackboxRecorder.h"
+#include "calculateDesiredBoost.h"
+#include "faultManager.h"
+#include "globalHelpers.h"
+#include "hal.h"
+#include "mqttPublish.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const char *const mqttCommandTopics[] = {mqttCommandDefinitions[0].topic, mqttCommandDefinitions[1].topic, mqttCommandDefinitions[2].topic, mqttCommandDefinitions[3].topic,
+                                         mqttCommandDefinitions[4].topic, mqttCommandDefinitions[5].topic};
+const char *mqttCommandAckTopic = "command/ack";
+
+// The PubSubClient callback reuses the client's buffer, so the message is copied here and handled later from loop()
+const int mqttCommandPayloadMaxLength = 128;
+char mqttCommandPayload[mqttCommandPayloadMaxLength];
+const char *mqttCommandPayloadRejection = nullptr; // Set when the payload didn't fit, it is rejected whatever it parses as
+const MqttCommandDefinition *mqttCommandReceivedDefinition = nullptr;
+unsigned long mqttCommandReceivedMicros;
+bool mqttCommandWaiting = false;
+
+MqttCommandStats mqttCommandStats;
+char mqttCommandReply[96];
+
+/* ======================================================================
+   FUNCTION: MQTT message callback, runs inside mqttClient.loop()
+   ====================================================================== */
+// Must not publish, the client is part way through reading into the buffer the payload points at
+void handleMqttCommandMessage(char *topic, byte *payload, unsigned int length) {
+  mqttCommandStats.received++;
+  if (mqttCommandWaiting) {
+    mqttCommandStats.dropped++;
+    return;
+  }
+
+  const MqttCommandDefinition *definition = findMqttCommandDefinition(topic);
+  if (definition != nullptr) {
+    mqttCommandPayloadRejection = copyMqttCommandPayload(mqttCommandPayload, mqttCommandPayloadMaxLength, payload, length);
+    mqttCommandReceivedDefinition = definition;
+    mqttCommandReceivedMicros = halMicros();
+    mqttCommandWaiting = true;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Subscribe to the command topics (renewed on every reconnect)
+   ====================================================================== */
+void initMqttCommands() {
+  setMqttSubscriptions(mqttCommandTopics, mqttCommandDefinitionCount, handleMqttCommandMessage);
+}
+
+/* ======================================================================
+   FUNCTION: Publish an acknowledgement on the reply topic
+   ====================================================================== */
+void publishMqttCommandReply(const MqttCommand *command, const char *status, const char *reason) {
+  int length = snprintf(mqttCommandReply, sizeof(mqttCommandReply), "id=%lu,status=%s", command->id, status);
+  if (command->hasSenderTime) {
+    length += snprintf(mqttCommandReply + length, sizeof(mqttCommandReply) - length, ",t=%lu", command->senderTime);
+  }
+  if (reason != nullptr) {
+    snprintf(mqttCommandReply + length, sizeof(mqttCommandReply) - length, ",reason=%s", reason);
+  } else {
+    snprintf(mqttCommandReply + length, sizeof(mqttCommandReply) - length, ",applyUs=%lu", mqttCommandStats.lastApplyMicros);
+  }
+  publishMqttText(mqttCommandAckTopic, mqttCommandReply);
+}
+
+/* ======================================================================
+   FUNCTION: Get the next valid command, rejections are replied to here
+   ====================================================================== */
+bool takeMqttCommand(MqttCommand *command) {
+  if (!mqttCommandWaiting) {
+    return false;
+  }
+
+  char reasonBuffer[40];
+  const char *reason = parseMqttCommand(mqttCommandReceivedDefinition, mqttCommandPayload, command, reasonBuffer, sizeof(reasonBuffer));
+  if (mqttCommandPayloadRejection != nullptr) {
+    reason = mqttCommandPayloadRejection; // Parsed anyway for the id to acknowledge against
+  }
+  command->receivedMicros = mqttCommandReceivedMicros;
+  mqttCommandWaiting = false;
+  if (reason != nullptr) {
+    mqttCommandStats.rejected++;
+    LOG_WARN(true, LOG_MQTT_COMMAND_REJECTED, command->id, reason);
+    publishMqttCommandReply(command, "rejected", reason);
+    return false;
+  }
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Apply a command to the background copies, the control tick picks them up at its next boundary
+   ====================================================================== */
+// Either set of gains changing starts the shadow scoring again, the stretches so far compared different gains
+void applyMqttCommand(const MqttCommand *command, double *pressureKp, double *pressureKi, double *pressureKd, ShadowCandidate *shadowCandidate) {
+  switch (command->type) {
+    case MQTT_COMMAND_PID:
+      resetShadowScore();
+      if (!isnan(command->values[0])) {
+        *pressureKp = command->values[0];
+      }
+      if (!isnan(command->values[1])) {
+        *pressureKi = command->values[1];
+      }
+      if (!isnan(command->values[2])) {
+        *pressureKd = command->values[2];
+      }
+      break;
+
+    case MQTT_COMMAND_BOOST_TARGET:
+      setBoostTargetForGear(static_cast<int>(command->values[0]), static_cast<int>(command->values[1]));
+      break;
+
+    case MQTT_COMMAND_DEBUG: {
+      bool *flags[] = {&debugSerialReceive, &debugSerialSend, &debugValveControl, &debugBoost, &debugPid, &debugGeneral};
+      for (int i = 0; i < 6; i++) {
+        if (!isnan(command->values[i])) {
+          *flags[i] = command->values[i] != 0;
+        }
+      }
+      break;
+  }
+
+  case MQTT_COMMAND_BLACKBOX:
+    triggerBlackbox();
+    break;
+
+  case MQTT_COMMAND_SHADOW:
+    resetShadowScore();
+    if (!isnan(command->values[0])) {
+      shadowCandidate->pressureKp = command->values[0];
+    }
+    if (!isnan(command->values[1])) {
+      shadowCandidate->pressureKi = command->values[1];
+    }
+    if (!isnan(command->values[2])) {
+      shadowCandidate->pressureKd = command->values[2];
+    }
+    if (!isnan(command->values[3])) {
+      shadowCandidate->enabled = command->values[3] != 0;
+    }
+    break;
+
+  case MQTT_COMMAND_FAULTS:
+    clearLatchedFaults();
+    break;
+
+  case MQTT_COMMAND_NONE:
+    break;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Acknowledge a command once the control tick has taken it on
+   ====================================================================== */
+// Not applied means the tick never picked it up (e.g. the timer failed to start), the change may still take effect later
+void acknowledgeMqttCommand(const MqttCommand *command, bool applied) {
+  if (!applied) {
+    mqttCommandStats.rejected++;
+    publishMqttCommandReply(command, "failed", "control tick not responding");
+    return;
+  }
+  mqttCommandStats.applied++;
+  mqttCommandStats.lastApplyMicros = halMicros() - command->receivedMicros;
+  mqttCommandStats.maxApplyMicros = max(mqttCommandStats.maxApplyMicros, mqttCommandStats.lastApplyMicros);
+  LOG_INFO(true, LOG_MQTT_COMMAND_APPLIED, command->id, mqttCommandStats.lastApplyMicros);
+  publishMqttCommandReply(command, "ok", nullptr);
+}
+
+/* ======================================================================
+   FUNCTION: Command counters
+   ====================================================================== */
+void getMqttCommandStats(MqttCommandStats *stats) {
+  *stats = mqttCommandStats;
+}
@@ -0,0 +1,29 @@
+#ifndef MQTTCOMMANDS_H
+#define MQTTCOMMANDS_H
+
+#include "mqttCommandParser.h"
+#include "shadowController.h"
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: Command counters since boot
+   ====================================================================== */
+struct MqttCommandStats {
+  unsigned long received;
+  unsigned long applied;
+  unsigned long rejected;
+  unsigned long dropped; // Arrived while the previous command was still waiting to be handled
+  unsigned long lastApplyMicros;
+  unsigned long maxApplyMicros;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void initMqttCommands();
+bool takeMqttCommand(MqttCommand *);
+void applyMqttCommand(const MqttCommand *, double *, double *, double *, ShadowCandidate *);
+void acknowledgeMqttCommand(const MqttCommand *, bool);
+void getMqttCommandStats(MqttCommandStats *);
+
+#endif
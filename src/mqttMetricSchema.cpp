@@ -0,0 +1,27 @@
+#include "mqttMetricSchema.h"
+#include "textFormat.h"
+
+/* ======================================================================
+   FUNCTION: Serialise metric groups as JSON into a caller supplied buffer
+   ====================================================================== */
+// Flat {"Target":45.00,"Actual":44.12} for a single group, or {"pressures":{...},"valveopen":{...}} when nested
+int serializeMqttMetricGroups(char *buffer, int bufferSize, const MetricGroup *groups, int groupCount, bool nested) {
+  int length = appendText(buffer, bufferSize, 0, "{");
+  for (int group = 0; group < groupCount; group++) {
+    if (nested) {
+      length = appendText(buffer, bufferSize, length, (group == 0) ? "\"" : ",\"");
+      length = appendText(buffer, bufferSize, length, groups[group].name);
+      length = appendText(buffer, bufferSize, length, "\":{");
+    }
+    for (size_t field = 0; field < groups[group].fieldCount; field++) {
+      length = appendText(buffer, bufferSize, length, (field == 0) ? "\"" : ",\"");
+      length = appendText(buffer, bufferSize, length, groups[group].fields[field].name);
+      length = appendText(buffer, bufferSize, length, "\":");
+      length = appendFixedPoint(buffer, bufferSize, length, groups[group].values[field], groups[group].fields[field].precision);
+    }
+    if (nested) {
+      length = appendText(buffer, bufferSize, length, "}");
+    }
+  }
+  return appendText(buffer, bufferSize, length, "}");
+}
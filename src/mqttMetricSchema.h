@@ -0,0 +1,65 @@
+#ifndef MQTTMETRICSCHEMA_H
+#define MQTTMETRICSCHEMA_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: Fixed metric schema, everything known at build time
+   ====================================================================== */
+struct MetricField {
+  const char *name;
+  byte precision; // Decimal places, 0 to 4
+};
+
+// The field count is part of the type, so publishing the wrong number of values is a compile error
+template <size_t N>
+struct MetricSchema {
+  const char *topic;
+  MetricField fields[N];
+};
+
+/* ======================================================================
+   STRUCTURES: A schema and its values, ready to serialise
+   ====================================================================== */
+struct MetricGroup {
+  const char *name;
+  const MetricField *fields;
+  size_t fieldCount;
+  const float *values;
+};
+
+/* ======================================================================
+   FUNCTION: Pair a schema with its values (count checked at compile time)
+   ====================================================================== */
+template <size_t N>
+inline MetricGroup metricGroup(const MetricSchema<N> &schema, const float (&values)[N]) {
+  return {schema.topic, schema.fields, N, values};
+}
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+int serializeMqttMetricGroups(char *, int, const MetricGroup *, int, bool);
+
+/* ======================================================================
+   SCHEMAS: One per MQTT topic
+   ====================================================================== */
+constexpr MetricSchema<2> pressuresMetricSchema = {"pressures", {{"Target", 2}, {"Actual", 2}}};
+constexpr MetricSchema<4> compressorMetricSchema = {"compressor", {{"IntakeKpa", 2}, {"PressureRatio", 3}, {"RatioRate", 3}, {"RatioLimited", 0}}};
+constexpr MetricSchema<1> valveOpenMetricSchema = {"valveopen", {{"Percentage", 2}}};
+constexpr MetricSchema<3> pidsMetricSchema = {"pids", {{"kP", 2}, {"kI", 2}, {"kD", 2}}};
+constexpr MetricSchema<1> faultsMetricSchema = {"faults", {{"Active", 0}}};
+constexpr MetricSchema<3> wifiMetricSchema = {"wifi", {{"Rssi", 0}, {"RssiAverage", 1}, {"Drops", 0}}};
+constexpr MetricSchema<5> overboostMetricSchema = {"overboost", {{"LimitKpa", 1}, {"RateKpaPerSecond", 1}, {"Active", 0}, {"Events", 0}, {"OpenLatencyMs", 0}}};
+constexpr MetricSchema<5> timeSyncMetricSchema = {"timesync", {{"Synchronised", 0}, {"OffsetMs", 0}, {"DriftPpm", 1}, {"RoundTripMs", 0}, {"InputAgeMs", 0}}};
+constexpr MetricSchema<5> estimatorMetricSchema = {"estimator", {{"InferredGear", 0}, {"GearMismatch", 0}, {"Extrapolated", 0}, {"RpmPerSecond", 0}, {"SpeedPerSecond", 1}}};
+constexpr MetricSchema<13> boostEventMetricSchema = {"boostevent", {{"Sequence", 0}, {"Gear", 0}, {"RpmBand", 0}, {"StartKpa", 1}, {"TargetKpa", 1}, {"RiseMs", 0}, {"OvershootKpa", 2}, {"SettlingMs", 0}, {"SteadyErrorKpa", 2}, {"Iae", 2}, {"kP", 2}, {"kI", 2}, {"kD", 2}}};
+constexpr MetricSchema<9> shadowMetricSchema = {"shadow", {{"Stretches", 0}, {"Verdict", 0}, {"CandidateIae", 2}, {"LiveGainsIae", 2}, {"LiveIae", 2}, {"ModelIae", 2}, {"kP", 2}, {"kI", 2}, {"kD", 2}}};
+constexpr MetricSchema<7> atmosphereMetricSchema = {"atmosphere", {{"AtmosphericKpa", 2}, {"DriftKpa", 2}, {"ManifoldOffsetRaw", 1}, {"AgeS", 0}, {"Updates", 0}, {"Rejected", 0}, {"Window", 0}}};
+constexpr MetricSchema<4> memoryMetricSchema = {"memory", {{"StackHighWater", 0}, {"StackSize", 0}, {"HeapInUse", 0}, {"AllocationsAfterSetup", 0}}};
+constexpr MetricSchema<5> profilerMetricSchema = {"profiler", {{"Calls", 0}, {"MinUs", 1}, {"MeanUs", 1}, {"MaxUs", 1}, {"Overruns", 0}}};
+
+// Pressures, compressor, valve open and PID gains in one message, for when publish count matters more than topic layout
+const char *const combinedTelemetryTopic = "telemetry";
+
+#endif
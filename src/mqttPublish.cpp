@@ -1,48 +1,284 @@
 #include "mqttPublish.h"
 #include "Arduino.h"
+#include "hal.h"
 #include "wifiHelpers.h"
+#include "logBuffer.h"
+#include "taskProfiler.h"
 #include <PubSubClient.h>
-#include <map>
 
 /* ======================================================================
    VARIABLES & OBJECTS: General use
    ====================================================================== */
-bool mqttBrokerConnected = false;
+IPAddress mqttBrokerAddress(192, 168, 10, 249); // Mosquitto MQTT broker address on laptop VM
+uint16_t mqttBrokerPort = 1883;                 // Mosquitto MQTT broker port on laptop VM (port forwarded)
+Client *mqttTransport = &wifiClient;            // What the MQTT client talks over, WiFi unless a test swaps it
+PubSubClient mqttClient(wifiClient);            // Create MQTT client on WiFi
 
-IPAddress mqtt_server(192, 168, 10, 249); // Mosquitto MQTT broker address on laptop VM
-const int mqtt_port = 1883;               // Mosquitto MQTT broker port on laptop VM (port forwarded)
-PubSubClient mqttClient(wifiClient);      // Create MQTT client on WiFi
+const int mqttPayloadMaxLength = 384;
+char mqttPayload[mqttPayloadMaxLength]; // Every metric payload is built here, nothing is allocated per publish
 
 /* ======================================================================
-   FUNCTION: Connect MQTT client to the broker
+   VARIABLES: Connection state machine
    ====================================================================== */
-bool connectMqttClientToBroker() {
-  if (!mqttClient.connected()) {
-    Serial.println("\nINFO - Connecting to MQTT broker");
-    mqttClient.setServer(mqtt_server, mqtt_port);
-    mqttClient.setKeepAlive(5);
-    if (delay(1000); mqttClient.connect("arduino-client")) {
-      Serial.println("\tOK - MQTT Client connected");
-      mqttBrokerConnected = true;
-      return true;
-    } else {
-      Serial.println("\tFATAL - MQTT Client not connected");
-      mqttBrokerConnected = false;
-      return false;
+const unsigned long mqttBackoffInitialMs = 500;
+const unsigned long mqttBackoffMaximumMs = 30000;
+const unsigned long mqttServiceBudgetUs = 2000; // Most time one loop() will spend reading inbound packets
+const uint16_t mqttKeepAliveSeconds = 5;
+const uint16_t mqttSocketTimeoutSeconds = 1; // Bounds the wait for CONNACK and partial packets (library default is 15s)
+const int mqttTcpConnectTimeoutMs = 20;      // Bounds the TCP connect, a broker on the LAN answers in a few ms
+
+MqttConnectionState mqttConnectionState = MQTT_STATE_IDLE;
+MqttConnectionStats mqttConnectionStats;
+unsigned long mqttBackoffMs = mqttBackoffInitialMs;
+unsigned long mqttLastConnectAttemptMs = 0;
+unsigned long mqttAttemptsSinceConnected = 0;
+bool mqttNetworkWasUp = false;
+
+const char *const *mqttSubscriptionTopics = nullptr;
+int mqttSubscriptionTopicCount = 0;
+
+/* ======================================================================
+   FUNCTION: Point the client at a broker (a local Mosquitto, or a fake for testing)
+   ====================================================================== */
+void setMqttBroker(IPAddress address, uint16_t port) {
+  mqttBrokerAddress = address;
+  mqttBrokerPort = port;
+  mqttClient.setServer(mqttBrokerAddress, mqttBrokerPort);
+  if (mqttClient.connected()) {
+    mqttClient.disconnect(); // Reconnects to the new broker on the next service
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Swap the network transport underneath the MQTT client
+   ====================================================================== */
+// Any Arduino Client will do, which lets an in process fake broker stand in for WiFi when testing the state machine
+void setMqttTransport(Client *client) {
+  mqttTransport = client;
+  mqttClient.setClient(*client);
+}
+
+/* ======================================================================
+   FUNCTION: Set the topics to subscribe to on every connect, and the handler for their messages
+   ====================================================================== */
+void setMqttSubscriptions(const char *const *topics, int topicCount, void (*handler)(char *, uint8_t *, unsigned int)) {
+  mqttSubscriptionTopics = topics;
+  mqttSubscriptionTopicCount = topicCount;
+  mqttClient.setCallback(handler);
+  if (mqttConnectionState == MQTT_STATE_CONNECTED) {
+    for (int i = 0; i < mqttSubscriptionTopicCount; i++) {
+      mqttClient.subscribe(mqttSubscriptionTopics[i]);
     }
   }
 }
 
 /* ======================================================================
-   FUNCTION: Publish multiple numeric metrics via MQTT
+   FUNCTION: Configure the MQTT client, the first connect happens in serviceMqttConnection()
+   ====================================================================== */
+void initMqttConnection() {
+  mqttClient.setServer(mqttBrokerAddress, mqttBrokerPort);
+  mqttClient.setKeepAlive(mqttKeepAliveSeconds);
+  mqttClient.setSocketTimeout(mqttSocketTimeoutSeconds);
+  wifiClient.setConnectionTimeout(mqttTcpConnectTimeoutMs);
+  mqttClient.setBufferSize(768); // Default 256 is too small for a blackbox dump line or a worst case telemetry batch
+  mqttConnectionState = MQTT_STATE_DISCONNECTED;
+  mqttBackoffMs = mqttBackoffInitialMs;
+  mqttLastConnectAttemptMs = halMillis() - mqttBackoffMs; // First attempt straight away
+}
+
+/* ======================================================================
+   FUNCTION: Open the TCP connection to the broker, the MQTT session is set up on the next service
+   ====================================================================== */
+void openMqttTransport() {
+  mqttLastConnectAttemptMs = halMillis();
+  mqttConnectionStats.connectAttempts++;
+  mqttAttemptsSinceConnected++;
+
+  unsigned long connectStartUs = halMicros();
+  bool opened = mqttTransport->connect(mqttBrokerAddress, mqttBrokerPort);
+  mqttConnectionStats.connectMaxUs = max(mqttConnectionStats.connectMaxUs, halMicros() - connectStartUs);
+  if (opened) {
+    mqttConnectionState = MQTT_STATE_CONNECTING;
+    return;
+  }
+
+  LOG_WARN(true, LOG_MQTT_CONNECT_FAILED, MQTT_CONNECT_FAILED, mqttBackoffMs);
+  mqttConnectionState = MQTT_STATE_BACKOFF;
+}
+
+/* ======================================================================
+   FUNCTION: Start the MQTT session over the open transport and set up the next backoff if it fails
+   ====================================================================== */
+// The client finds the transport already connected, so this is just CONNECT and the wait for CONNACK
+void startMqttSession() {
+  unsigned long connectStartUs = halMicros();
+  bool connected = mqttClient.connect("arduino-client");
+  mqttConnectionStats.connectMaxUs = max(mqttConnectionStats.connectMaxUs, halMicros() - connectStartUs);
+  if (connected) {
+    LOG_INFO(true, LOG_MQTT_CONNECTED, mqttAttemptsSinceConnected);
+    mqttConnectionStats.connects++;
+    mqttAttemptsSinceConnected = 0;
+    mqttBackoffMs = mqttBackoffInitialMs;
+    mqttConnectionState = MQTT_STATE_CONNECTED;
+    // A new session starts with no subscriptions
+    for (int i = 0; i < mqttSubscriptionTopicCount; i++) {
+      mqttClient.subscribe(mqttSubscriptionTopics[i]);
+    }
+    return;
+  }
+
+  LOG_WARN(true, LOG_MQTT_CONNECT_FAILED, mqttClient.state(), mqttBackoffMs);
+  mqttTransport->stop();
+  mqttConnectionState = MQTT_STATE_BACKOFF;
+}
+
+/* ======================================================================
+   FUNCTION: Move the connection state machine on by one step
+   ====================================================================== */
+// Never waits out a backoff. A connect is spread over two calls, the TCP connect then CONNECT / CONNACK, so one call
+// only ever waits on one of them. Inbound packet handling is bounded too. Returns true when it is safe to publish.
+bool stepMqttConnection(bool networkUp) {
+  switch (mqttConnectionState) {
+    case MQTT_STATE_IDLE:
+      return false;
+
+    case MQTT_STATE_CONNECTED:
+      mqttNetworkWasUp = networkUp;
+      if (!networkUp || !mqttClient.connected()) {
+        LOG_WARN(true, LOG_MQTT_CONNECTION_DROPPED, mqttClient.state());
+        mqttConnectionStats.drops++;
+        mqttLastConnectAttemptMs = halMillis();
+        mqttConnectionState = MQTT_STATE_BACKOFF;
+        return false;
+      }
+      {
+        // Keepalive pings and any inbound packets, one per loop() call, until there is nothing waiting or the budget is used
+        unsigned long serviceStartUs = halMicros();
+        do {
+          mqttClient.loop();
+        } while (mqttTransport->available() > 0 && halMicros() - serviceStartUs < mqttServiceBudgetUs);
+      }
+      return mqttClient.connected();
+
+    case MQTT_STATE_CONNECTING:
+      mqttNetworkWasUp = networkUp;
+      if (!networkUp || !mqttTransport->connected()) {
+        LOG_WARN(true, LOG_MQTT_CONNECT_FAILED, MQTT_CONNECTION_LOST, mqttBackoffMs);
+        mqttTransport->stop();
+        mqttConnectionState = MQTT_STATE_BACKOFF;
+        return false;
+      }
+      startMqttSession();
+      return mqttConnectionState == MQTT_STATE_CONNECTED;
+
+    case MQTT_STATE_BACKOFF:
+      if (!networkUp) {
+        mqttNetworkWasUp = false;
+        return false; // Nothing to try until the network is back, so the backoff isn't used up meanwhile
+      }
+      // The backoff is for an unreachable broker, don't make telemetry wait it out once the network itself comes back
+      if (!mqttNetworkWasUp) {
+        mqttBackoffMs = mqttBackoffInitialMs;
+        mqttLastConnectAttemptMs = halMillis() - mqttBackoffMs;
+      }
+      mqttNetworkWasUp = true;
+      if (halMillis() - mqttLastConnectAttemptMs < mqttBackoffMs) {
+        return false;
+      }
+      mqttBackoffMs = min(mqttBackoffMs * 2, mqttBackoffMaximumMs);
+      mqttConnectionState = MQTT_STATE_DISCONNECTED;
+      // Fall through and try now
+
+    case MQTT_STATE_DISCONNECTED:
+      mqttNetworkWasUp = networkUp;
+      if (networkUp) {
+        openMqttTransport();
+      }
+      return false;
+  }
+  return false;
+}
+
+/* ======================================================================
+   FUNCTION: Service the MQTT connection, call every loop
    ====================================================================== */
-void publishMqttMetrics(String topic, std::map<String, double> metrics) {
-  String payload = "{";
-  for (auto const &[key, value] : metrics) {
-    payload += "\"" + key + "\":" + String(value) + ",";
+// Timed as a whole, so the stats show the longest loop() has been held up here whatever the cause (TCP connect,
+// CONNACK, subscribing, inbound packets)
+bool serviceMqttConnection(bool networkUp) {
+  unsigned long serviceStartUs = halMicros();
+  bool publishable = stepMqttConnection(networkUp);
+  mqttConnectionStats.serviceMaxUs = max(mqttConnectionStats.serviceMaxUs, halMicros() - serviceStartUs);
+  return publishable;
+}
+
+/* ======================================================================
+   FUNCTION: Connection state and counters
+   ====================================================================== */
+MqttConnectionState getMqttConnectionState() {
+  return mqttConnectionState;
+}
+
+void getMqttConnectionStats(MqttConnectionStats *stats) {
+  *stats = mqttConnectionStats;
+}
+
+/* ======================================================================
+   FUNCTION: Report MQTT connection stats
+   ====================================================================== */
+void reportMqttConnectionStats() {
+  static const char *stateNames[] = {"IDLE", "DISCONNECTED", "BACKOFF", "CONNECTING", "CONNECTED"};
+  Serial.print("INFO - MQTT ");
+  Serial.print(stateNames[mqttConnectionState]);
+  Serial.print(" attempts: ");
+  Serial.print(mqttConnectionStats.connectAttempts);
+  Serial.print(" connects: ");
+  Serial.print(mqttConnectionStats.connects);
+  Serial.print(" drops: ");
+  Serial.print(mqttConnectionStats.drops);
+  Serial.print(" published: ");
+  Serial.print(mqttConnectionStats.published);
+  Serial.print(" publish failed: ");
+  Serial.print(mqttConnectionStats.publishFailed);
+  Serial.print(" longest connect / service (us): ");
+  Serial.print(mqttConnectionStats.connectMaxUs);
+  Serial.print(" / ");
+  Serial.println(mqttConnectionStats.serviceMaxUs);
+}
+
+/* ======================================================================
+   FUNCTION: Publish a payload, counting the outcome
+   ====================================================================== */
+bool publishMqttPayload(const char *topic, const char *payload) {
+  return publishMqttBinary(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload));
+}
+
+bool publishMqttBinary(const char *topic, const uint8_t *payload, unsigned int length) {
+  if (mqttConnectionState != MQTT_STATE_CONNECTED) {
+    mqttConnectionStats.publishFailed++;
+    return false;
   }
-  // Remove the trailing comma
-  payload.remove(payload.length() - 1);
-  payload += "}";
-  mqttClient.publish(topic.c_str(), payload.c_str());
+  if (mqttClient.publish(topic, payload, length)) {
+    mqttConnectionStats.published++;
+    return true;
+  }
+  mqttConnectionStats.publishFailed++;
+  return false;
+}
+
+/* ======================================================================
+   FUNCTION: Publish metric groups via MQTT from the static payload buffer
+   ====================================================================== */
+bool publishMqttMetricGroups(const char *topic, const MetricGroup *groups, int groupCount, bool nested) {
+  {
+    ProfileScope serializeProfile(PROFILED_MQTT_SERIALIZE);
+    serializeMqttMetricGroups(mqttPayload, mqttPayloadMaxLength, groups, groupCount, nested);
+  }
+  return publishMqttPayload(topic, mqttPayload);
+}
+
+/* ======================================================================
+   FUNCTION: Publish a preformatted text payload via MQTT
+   ====================================================================== */
+bool publishMqttText(const char *topic, const char *payload) {
+  return publishMqttPayload(topic, payload);
 }
@@ -1,13 +1,63 @@
 #ifndef MQTTPUBLISH_H
 #define MQTTPUBLISH_H
 
+#include "mqttMetricSchema.h"
 #include <Arduino.h>
-#include <map>
+#include <WiFiS3.h>
+
+/* ======================================================================
+   ENUMS: Connection state
+   ====================================================================== */
+enum MqttConnectionState {
+  MQTT_STATE_IDLE,         // initMqttConnection() not called, MQTT disabled
+  MQTT_STATE_DISCONNECTED, // Will try to connect on the next service
+  MQTT_STATE_BACKOFF,      // Waiting out the delay before the next attempt
+  MQTT_STATE_CONNECTING,   // TCP connected, the MQTT CONNECT goes out on the next service
+  MQTT_STATE_CONNECTED
+};
+
+/* ======================================================================
+   STRUCTURES: Connection and publish counters since boot
+   ====================================================================== */
+struct MqttConnectionStats {
+  unsigned long connectAttempts;
+  unsigned long connects;
+  unsigned long drops; // Connections lost after being established
+  unsigned long published;
+  unsigned long publishFailed; // Includes publishes attempted while not connected
+  unsigned long connectMaxUs;  // Longest single connect step, either the TCP connect or CONNECT and CONNACK
+  unsigned long serviceMaxUs;  // Longest serviceMqttConnection() call, the worst loop() stall it has caused
+};
 
 /* ======================================================================
    FUNCTION PROTOTYPES
    ====================================================================== */
-bool connectMqttClientToBroker();
-void publishMqttMetrics(String topic, std::map<String, double> metrics);
+void initMqttConnection();
+void setMqttBroker(IPAddress, uint16_t);
+void setMqttTransport(Client *);
+void setMqttSubscriptions(const char *const *, int, void (*)(char *, uint8_t *, unsigned int));
+bool serviceMqttConnection(bool);
+MqttConnectionState getMqttConnectionState();
+void getMqttConnectionStats(MqttConnectionStats *);
+void reportMqttConnectionStats();
+bool publishMqttPayload(const char *, const char *);
+bool publishMqttBinary(const char *, const uint8_t *, unsigned int);
+bool publishMqttMetricGroups(const char *, const MetricGroup *, int, bool);
+bool publishMqttText(const char *, const char *);
+
+/* ======================================================================
+   FUNCTION: Publish one schema's values to its own topic, or a given one
+   ====================================================================== */
+template <size_t N>
+inline bool publishMqttMetrics(const MetricSchema<N> &schema, const float (&values)[N]) {
+  MetricGroup group = metricGroup(schema, values);
+  return publishMqttMetricGroups(schema.topic, &group, 1, false);
+}
+
+template <size_t N>
+inline bool publishMqttMetrics(const char *topic, const MetricSchema<N> &schema, const float (&values)[N]) {
+  MetricGroup group = metricGroup(schema, values);
+  return publishMqttMetricGroups(topic, &group, 1, false);
+}
 
 #endif
@@ -0,0 +1,77 @@
+#ifdef HAL_NATIVE
+
+#include "boostValveControl.h"
+#include "calculateDesiredBoost.h"
+#include "cytronMotorDriver.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "logBuffer.h"
+#include "serialCommunications.h"
+#include "serialMessageProcessing.h"
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+/* ======================================================================
+   FUNCTION: Frame a master message with its checksum, as the master does
+   ====================================================================== */
+void injectMasterMessage(const char *body) {
+  char checksum = 0;
+  for (const char *c = body; *c != '\0'; c++) {
+    checksum ^= *c;
+  }
+  char frame[128];
+  int length = snprintf(frame, sizeof(frame), "<%s,%d>", body, static_cast<unsigned char>(checksum));
+  halNativeUartInject(frame, length);
+}
+
+/* ======================================================================
+   MAIN: Host entry point for [env:native]
+   ====================================================================== */
+// Pushes a master frame through the protocol, boost target and valve output paths on the native HAL and prints what
+// came out the other side. Anything that goes wrong here goes wrong on the board too. pio test supplies its own main().
+#ifndef PIO_UNIT_TESTING
+int main() {
+  initLogBuffer();
+  halUartBegin(500000);
+  initCytronMotorDriver();
+
+  // Master pushes speed 60kmh, 3500rpm, 3rd gear, clutch out
+  injectMasterMessage("1,60.0,3500,3,0");
+  const char *message = serialGetIncomingMessage();
+  float speed = 0;
+  int rpm = 0, gear = 0;
+  bool clutchPressed = true;
+  int commandId = serialProcessMessage(message, &speed, &rpm, &gear, &clutchPressed);
+  float targetBoostKpa = calculateDesiredBoostKpa(speed, rpm, gear, clutchPressed);
+  printf("Command %d: speed %.1f rpm %d gear %d clutch %d -> target %.1fkPa\n", commandId, speed, rpm, gear, clutchPressed, targetBoostKpa);
+
+  // Valve position and motor output
+  int positionMinimum = 200, positionMaximum = 800, positionRaw = 650;
+  printf("Valve raw %d -> %.1f%% open\n", positionRaw, getBoostValveOpenPercentage(&positionRaw, &positionMinimum, &positionMaximum));
+  setCytronSpeedAndDirection(-45.0);
+  printf("Motor -45%% -> PWM %.1f%%, direction %d\n", halNativeGetPwm(MOTOR_PWM_PIN), halNativeGetDigital(MOTOR_DIR_PIN));
+
+  // Reply to a master request for our state
+  injectMasterMessage("0");
+  commandId = serialProcessMessage(serialGetIncomingMessage(), &speed, &rpm, &gear, &clutchPressed);
+  serialSendCommandId0Response(false, targetBoostKpa, 12.5, 35, -1.2, 30, 81.25, 0);
+  char reply[128];
+  halNativeUartTakeOutput(reply, sizeof(reply));
+  printf("Command %d reply: %s\n", commandId, reply);
+
+  halNativeAdvanceMicros(1000000);
+  serviceLogOutput();
+  return 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#ifdef HAL_NATIVE
+
+#include "boostController.h"
+#include "cytronMotorDriver.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "logBuffer.h"
+#include "plantModelNative.h"
+#include "platformTraits.h"
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+/* ======================================================================
+   STRUCTURES: One test scenario
+   ====================================================================== */
+struct SimScenario {
+  const char *name;
+  double targetKpa;
+  double startCapacityKpa;
+  double endCapacityKpa;
+  double stepAtSeconds;
+  double stepOverSeconds; // How quickly the capacity moves, a short time is a sharp RPM rise
+  double pressureKp;      // Pressure PID proportional gain, low to leave the PID too slow to catch the rise
+  bool shouldTrigger;
+  double allowanceKpa;    // The target's band in overboostBands (boostController.cpp), the peak may go this far over the limit
+  double dwellMillis;     // and stay over it this long
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const double simSeconds = 6.0;
+
+SimScenario simScenarios[] = {
+    {"steady", 30, 60, 60, 3.0, 0.1, 9.0, false, 8, 500},
+    {"rpmRise", 30, 60, 160, 3.0, 0.3, 9.0, true, 8, 500},
+    {"sharpRpmRise", 30, 60, 200, 3.0, 0.1, 9.0, true, 8, 500},
+    {"slowPid", 30, 60, 160, 3.0, 0.3, 1.0, true, 8, 500},
+    {"highTarget", 55, 90, 220, 3.0, 0.2, 9.0, true, 6, 250}};
+
+const char *traceScenario = nullptr; // Named on the command line, every 10ms of it goes to stderr as CSV
+
+/* ======================================================================
+   FUNCTION: Run one scenario, print what overboost protection did and return true if it kept within the band
+   ====================================================================== */
+// Detection is the first tick protection engages after the RPM rise starts, latency is from there to the valve being 25%
+// further open (the same measure the controller reports on the board). Peak and time over limit show how much got through,
+// against the pressure as the controller reads it. Protection has to fire when expected, hold the peak within the band's
+// allowance over the limit and the time over it within the dwell, and never raise an overboost event.
+bool runScenario(const SimScenario *scenario) {
+  resetPlant();
+
+  ControlInputs inputs;
+  ControlOutputs outputs = ControlOutputs();
+  ControlReadings readings;
+  initBoostController(simValveMinimumRaw, simValveMaximumRaw, getPlantAtmosphericRaw(), &inputs);
+  inputs.pressureKp = scenario->pressureKp;
+  inputs.targetBoostKpa = scenario->targetKpa;
+  convertControlInputs(&inputs);
+
+  double detectedAtSeconds = -1, detectedAtKpa = 0, openedAtFraction = 0, latencyMillis = -1, limitKpa = 0, peakKpa = 0, secondsOverLimit = 0;
+  unsigned long events = 0;
+  for (double time = 0; time < simSeconds; time += simTickSeconds) {
+    double progress = constrain((time - scenario->stepAtSeconds) / scenario->stepOverSeconds, 0.0, 1.0);
+    stepPlant(scenario->startCapacityKpa + progress * (scenario->endCapacityKpa - scenario->startCapacityKpa));
+
+    runBoostController(&inputs, &outputs);
+    convertControlOutputs(&outputs, &readings);
+    halNativeAdvanceMicros(lround(simTickSeconds * 1000000.0));
+
+    // Everything before the RPM rise is settling in
+    if (time >= scenario->stepAtSeconds) {
+      if (outputs.overboostProtectionActive && detectedAtSeconds < 0) {
+        detectedAtSeconds = time;
+        detectedAtKpa = getPlantManifoldReadingKpa();
+        openedAtFraction = min(plant.valveOpen + 0.25, 1.0);
+      }
+      if (detectedAtSeconds >= 0 && latencyMillis < 0 && plant.valveOpen >= openedAtFraction) {
+        latencyMillis = (time - detectedAtSeconds) * 1000;
+      }
+      peakKpa = max(peakKpa, getPlantManifoldReadingKpa());
+      if (getPlantManifoldReadingKpa() > readings.overboostLimitKpa) {
+        secondsOverLimit += simTickSeconds;
+      }
+    }
+    if (traceScenario != nullptr && strcmp(traceScenario, scenario->name) == 0 && (lround(time / simTickSeconds) % 10) == 0) {
+      fprintf(stderr, "%.3f,%.2f,%.2f,%.1f,%.3f,%.1f,%d\n", time, getPlantManifoldReadingKpa(), readings.overboostLimitKpa, readings.manifoldPressureRatePerSecond,
+              plant.valveOpen, readings.boostValveMotorSpeed, static_cast<int>(outputs.controlMode));
+    }
+    limitKpa = readings.overboostLimitKpa;
+    events = outputs.overboostEventCount;
+  }
+
+  if (detectedAtSeconds < 0) {
+    printf("%-14s limit %5.1fkPa  not triggered            peak %5.1fkPa  %4.0fms over limit, %lu events\n", scenario->name, limitKpa, peakKpa,
+           secondsOverLimit * 1000, events);
+  } else {
+    printf("%-14s limit %5.1fkPa  detected %6.3fs at %5.1fkPa  open latency %5.1fms  peak %5.1fkPa  %4.0fms over limit, %lu events\n", scenario->name,
+           limitKpa, detectedAtSeconds, detectedAtKpa, latencyMillis, peakKpa, secondsOverLimit * 1000, events);
+  }
+
+  bool passed = ((detectedAtSeconds >= 0) == scenario->shouldTrigger) && peakKpa <= limitKpa + scenario->allowanceKpa &&
+                secondsOverLimit * 1000 <= scenario->dwellMillis && events == 0;
+  if (!passed) {
+    printf("%-14s FAILED, expected %s, peak at most %.1fkPa, at most %.0fms over limit and no events\n", scenario->name,
+           scenario->shouldTrigger ? "to trigger" : "not to trigger", limitKpa + scenario->allowanceKpa, scenario->dwellMillis);
+  }
+  return passed;
+}
+
+/* ======================================================================
+   MAIN: Host entry point for [env:native_overboost_sim]
+   ====================================================================== */
+// Closes the loop around the control core with a plant model, on the simulated clock, so overboost protection can be
+// tuned and its detection to valve open latency checked without a car. Same code as the control tick, including the
+// fixed point core with -DCONTROL_FIXED_POINT=1. Exits non-zero if any scenario fails.
+int main(int argc, char **argv) {
+  traceScenario = (argc > 1) ? argv[1] : nullptr;
+  initLogBuffer();
+  initCytronMotorDriver();
+  initPlantModel();
+
+  printf("Overboost protection, %s core at %.0fHz\n", CONTROL_FIXED_POINT ? "fixed point" : "floating point", TargetPlatform::controlTickFrequencyHz);
+  int failures = 0;
+  for (const SimScenario &scenario : simScenarios) {
+    if (!runScenario(&scenario)) {
+      failures++;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
+
+#endif
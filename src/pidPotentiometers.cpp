@@ -1,5 +1,4 @@
 #include "pidPotentiometers.h"
-#include "PID_v1.h"
 #include "globalHelpers.h"
 #include <ptScheduler.h>
 
@@ -14,17 +13,25 @@ int pidRangeMaxProportional = 75;
 int pidRangeMaxIntegral = 20;
 int pidRangeMaxDerivative = 20;
 
-void readPidPotsAndUpdateTuning(PID *pidMotor, double *pidLiveValueProportional, double *pidLiveValueIntegral, double *pidLiveValueDerivative) {
-  int pidPotProportionalRaw = getAveragedMuxAnalogueChannelReading(pidChannelProportional, 10, 0);
-  int pidPotIntegralRaw = getAveragedMuxAnalogueChannelReading(pidChannelIntegral, 10, 0);
-  int pidPotDerivativeRaw = getAveragedMuxAnalogueChannelReading(pidChannelDerivative, 10, 0);
+/* ======================================================================
+   FUNCTION: Read the raw pot positions, P, I then D
+   ====================================================================== */
+void readPidPots(int *pidPotsRaw) {
+  pidPotsRaw[pidChannelProportional] = getAveragedMuxAnalogueChannelReading(pidChannelProportional, 10, 0);
+  pidPotsRaw[pidChannelIntegral] = getAveragedMuxAnalogueChannelReading(pidChannelIntegral, 10, 0);
+  pidPotsRaw[pidChannelDerivative] = getAveragedMuxAnalogueChannelReading(pidChannelDerivative, 10, 0);
+}
 
+/* ======================================================================
+   FUNCTION: Map raw pot positions onto PID gains
+   ====================================================================== */
+// Kept apart from the read so a replay can feed recorded pot positions straight in. Only updates the values, the control
+// tick applies them to the PID at its next tick boundary.
+void setPidTuningFromPots(const int *pidPotsRaw, double *pidLiveValueProportional, double *pidLiveValueIntegral, double *pidLiveValueDerivative) {
   // Adjust the mapping for higher precision
   double factor = 100.0;
 
-  *pidLiveValueProportional = map(pidPotProportionalRaw, 0, 1023, pidRangeMaxProportional, 0);
-  *pidLiveValueIntegral = map(pidPotIntegralRaw, 0, 1023, pidRangeMaxIntegral * factor, 0) / factor;
-  *pidLiveValueDerivative = map(pidPotDerivativeRaw, 0, 1023, pidRangeMaxDerivative * factor, 0) / factor;
-
-  pidMotor->SetTunings(*pidLiveValueProportional, *pidLiveValueIntegral, *pidLiveValueDerivative);
+  *pidLiveValueProportional = map(pidPotsRaw[pidChannelProportional], 0, 1023, pidRangeMaxProportional, 0);
+  *pidLiveValueIntegral = map(pidPotsRaw[pidChannelIntegral], 0, 1023, pidRangeMaxIntegral * factor, 0) / factor;
+  *pidLiveValueDerivative = map(pidPotsRaw[pidChannelDerivative], 0, 1023, pidRangeMaxDerivative * factor, 0) / factor;
 }
@@ -1,12 +1,17 @@
 #ifndef PIDPOTENTIOMETERS_H
 #define PIDPOTENTIOMETERS_H
 
-#include "PID_v1.h"
 #include <Arduino.h>
 
+/* ======================================================================
+   DEFINES: Pots in order P, I, D
+   ====================================================================== */
+#define PID_POT_COUNT 3
+
 /* ======================================================================
    FUNCTION PROTOTYPES
    ====================================================================== */
-void readPidPotsAndUpdateTuning(PID *, double *, double *, double *);
+void readPidPots(int *);
+void setPidTuningFromPots(const int *, double *, double *, double *);
 
 #endif
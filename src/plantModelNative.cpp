@@ -0,0 +1,90 @@
+#ifdef HAL_NATIVE
+
+#include "plantModelNative.h"
+#include "boostController.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "platformTraits.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int simValveMinimumRaw = 210;
+const int simValveMaximumRaw = 830;
+const double simAtmosphericKpa = 100.0;
+const double simValveTravelPerSecond = 3.0;  // Fraction of full travel per second at 100% motor
+const double simSpringTravelPerSecond = 0.5; // Spring alone, pulling it open
+const double simManifoldTimeConstantSeconds = 0.1;
+const int simAdcNoiseCounts = 1; // Either side, per read
+const double simTickSeconds = 1.0 / TargetPlatform::controlTickFrequencyHz;
+
+PlantState plant;
+double kpaPerRawCount, kpaAtRawZero; // Bosch 3 bar transfer function is linear, so two points invert it
+
+/* ======================================================================
+   FUNCTION: ADC source for the controller, raw readings from the plant
+   ====================================================================== */
+int readPlantAdc(byte pin) {
+  double raw = 0;
+  if (pin == boostValvePositionSignalPin) {
+    raw = simValveMinimumRaw + plant.valveOpen * (simValveMaximumRaw - simValveMinimumRaw);
+  } else if (pin == manifoldTmapSensorPressureSignalPin) {
+    raw = (plant.manifoldGaugeKpa + simAtmosphericKpa - kpaAtRawZero) / kpaPerRawCount;
+  } else if (pin == intakeTmapSensorPressureSignalPin) {
+    raw = (simAtmosphericKpa - kpaAtRawZero) / kpaPerRawCount;
+  }
+  plant.noiseSeed = plant.noiseSeed * 1103515245UL + 12345UL; // Same noise every run
+  int noise = static_cast<int>((plant.noiseSeed >> 16) % (2 * simAdcNoiseCounts + 1)) - simAdcNoiseCounts;
+  return constrain(static_cast<int>(lround(raw)) + noise, 0, 1023);
+}
+
+/* ======================================================================
+   FUNCTION: Hook the plant up to the simulated ADC
+   ====================================================================== */
+void initPlantModel() {
+  kpaAtRawZero = calculateBosch3BarKpaFromRaw(0);
+  kpaPerRawCount = calculateBosch3BarKpaFromRaw(1) - kpaAtRawZero;
+  halNativeSetAdcSource(readPlantAdc);
+}
+
+/* ======================================================================
+   FUNCTION: Valve on the open stop, no boost, same noise sequence
+   ====================================================================== */
+void resetPlant() {
+  plant = PlantState();
+  plant.valveOpen = 1.0;
+  plant.noiseSeed = 1;
+}
+
+/* ======================================================================
+   FUNCTION: Raw manifold reading at atmospheric, the controller's calibration
+   ====================================================================== */
+int getPlantAtmosphericRaw() {
+  return lround((simAtmosphericKpa - kpaAtRawZero) / kpaPerRawCount);
+}
+
+/* ======================================================================
+   FUNCTION: Manifold pressure as the controller reads it, to compare against its limits
+   ====================================================================== */
+// The controller's gauge conversion keeps the Bosch transfer function's value at 0 raw (about -6.4kPa), see
+// calculateBosch3BarKpaFromRaw(), so it reads that much under the plant's true gauge pressure
+double getPlantManifoldReadingKpa() {
+  return plant.manifoldGaugeKpa + kpaAtRawZero;
+}
+
+/* ======================================================================
+   FUNCTION: Move the plant on one tick from the motor output
+   ====================================================================== */
+void stepPlant(double capacityKpa) {
+  // The spring is always pulling it open, so holding the valve part closed takes some reverse motor
+  double motorPercentage = halNativeGetPwm(MOTOR_PWM_PIN);
+  double direction = halNativeGetDigital(MOTOR_DIR_PIN) == HIGH ? 1.0 : -1.0; // Forward opens, with the spring
+  plant.valveOpen += (direction * motorPercentage / 100.0 * simValveTravelPerSecond + simSpringTravelPerSecond) * simTickSeconds;
+  plant.valveOpen = constrain(plant.valveOpen, 0.0, 1.0);
+
+  plant.boostCapacityKpa = capacityKpa;
+  double steadyKpa = plant.boostCapacityKpa * (1.0 - plant.valveOpen);
+  plant.manifoldGaugeKpa += (steadyKpa - plant.manifoldGaugeKpa) * simTickSeconds / simManifoldTimeConstantSeconds;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef PLANTMODELNATIVE_H
+#define PLANTMODELNATIVE_H
+
+#ifdef HAL_NATIVE
+
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: Plant model state
+   ====================================================================== */
+// The valve is a motor driven blade against a return spring, the manifold a first order lag towards whatever the
+// supercharger can make with the bypass that far open. Crude, but it has the two delays that matter to the controller:
+// the valve's travel time and the manifold filling.
+struct PlantState {
+  double valveOpen;          // 0 closed (full boost) to 1 open (bypassed)
+  double manifoldGaugeKpa;
+  double boostCapacityKpa;   // What the supercharger makes with the valve shut, rises with RPM
+  unsigned long noiseSeed;
+};
+
+/* ======================================================================
+   VARIABLES: Shared with the simulations
+   ====================================================================== */
+extern PlantState plant;
+extern const int simValveMinimumRaw;
+extern const int simValveMaximumRaw;
+extern const double simAtmosphericKpa;
+extern const double simTickSeconds;
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void initPlantModel();
+void resetPlant();
+int getPlantAtmosphericRaw();
+double getPlantManifoldReadingKpa();
+void stepPlant(double);
+
+#endif
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef PLATFORMTRAITS_H
+#define PLATFORMTRAITS_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   DEFINES: What each target builds in
+   ====================================================================== */
+// The Mega has no WiFi, no FPU and 8kB of RAM. Network modules are left out of its build entirely (see build_src_filter in
+// [env:megaatmega2560]) and the control core runs in integer fixed point. Build any target with -DCONTROL_FIXED_POINT=1
+// to get the fixed point control core, e.g. [env:native_replay_fixed] to compare it against floating point on a drive.
+#if defined(ARDUINO_ARCH_AVR)
+#define PLATFORM_HAS_NETWORK 0
+#ifndef CONTROL_FIXED_POINT
+#define CONTROL_FIXED_POINT 1
+#endif
+#else
+#define PLATFORM_HAS_NETWORK 1
+#ifndef CONTROL_FIXED_POINT
+#define CONTROL_FIXED_POINT 0
+#endif
+#endif
+
+/* ======================================================================
+   TRAITS: Control tick timing per target
+   ====================================================================== */
+// Valve position and manifold pressure are read at the quiet point of the motor's PWM period, where even 2 samples have
+// less noise than 10 taken anywhere in it (pio run -e native_adc_sync_sim). 4 leaves margin for the white noise that
+// synchronising doesn't remove. The unsynchronised count is for a channel with no motor. Waiting for the quiet point
+// averages ~13us per sample at 25kHz, ~100us per tick. The tick's 8 synchronised samples share the wait budget, past it
+// they are taken wherever they land rather than hold up the UART (pio run -e native_adc_sync_sim reports the wait).
+struct UnoR4Platform {
+  static constexpr const char *name = "uno_r4_wifi";
+  static constexpr float controlTickFrequencyHz = 1000.0;
+  static constexpr int controlTickAnalogueSamples = 10; // Per sensor per tick, same ADC time per second for the valve as 20 samples every 2ms
+  static constexpr int controlTickPwmSyncedSamples = 4;
+  static constexpr int controlTickIntakeSamples = 4; // Intake pressure moves far less than the manifold
+  static constexpr unsigned long controlTickAdcSyncBudgetMicros = 160;
+};
+
+// analogRead() takes ~112us on the Mega, so 4 samples for the valve and manifold and 2 for the intake keep the ADC to
+// a little over half of the 2ms tick. That is longer than a PWM period, so the synchronised reads are plain ones here.
+struct Mega2560Platform {
+  static constexpr const char *name = "megaatmega2560";
+  static constexpr float controlTickFrequencyHz = 500.0;
+  static constexpr int controlTickAnalogueSamples = 4;
+  static constexpr int controlTickPwmSyncedSamples = 4;
+  static constexpr int controlTickIntakeSamples = 2;
+  static constexpr unsigned long controlTickAdcSyncBudgetMicros = 0; // Nothing waits
+};
+
+#if defined(ARDUINO_ARCH_AVR)
+typedef Mega2560Platform TargetPlatform;
+#else
+typedef UnoR4Platform TargetPlatform; // Also the native builds, so replays run at the R4's tick rate
+#endif
+
+#endif
@@ -0,0 +1,419 @@
+#ifdef HAL_NATIVE
+
+#include "boostController.h"
+#include "cytronMotorDriver.h"
+#include "calculateDesiredBoost.h"
+#include "drivingEvents.h"
+#include "faultManager.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "logBuffer.h"
+#include "pidPotentiometers.h"
+#include "platformTraits.h"
+#include "replayRecorder.h"
+#include "serialCommunications.h"
+#include "serialMessageProcessing.h"
+#include "timeSync.h"
+#include "varintEncoding.h"
+#include "vehicleStateEstimator.h"
+#include <algorithm>
+#include <ptScheduler.h>
+#include <string>
+#include <vector>
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+/* ======================================================================
+   STRUCTURES: One recorded input, in board time
+   ====================================================================== */
+struct ReplayEvent {
+  uint64_t micros; // Unwrapped, the board's micros() wraps every ~71 minutes
+  ReplayRecordType type;
+  int values[PID_POT_COUNT]; // Raw pots, or valve, manifold and intake raw for an ADC event
+  std::string frame;
+};
+
+struct ReplayCalibration {
+  bool found = false;
+  int valveMinimumRaw, valveMaximumRaw, manifoldAtmosphericOffsetRaw;
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const unsigned long replayTickPeriodUs = 1000000.0 / TargetPlatform::controlTickFrequencyHz; // Same tick as main.cpp
+const int replayDifferencesShown = 10;
+
+uint32_t replayLastRawMicros = 0;
+uint64_t replayLastMicros = 0;
+bool replayMicrosSeen = false;
+
+/* ======================================================================
+   FUNCTION: Unwrap a 32 bit board timestamp against the last one seen
+   ====================================================================== */
+// Records arrive roughly in time order (ADC records trail the background ones by up to a few tens of ms), so the
+// signed difference to the previous timestamp is always the true step even across a wrap.
+uint64_t unwrapReplayMicros(uint32_t rawMicros) {
+  if (!replayMicrosSeen) {
+    replayMicrosSeen = true;
+    replayLastMicros = rawMicros;
+  } else {
+    replayLastMicros += static_cast<int32_t>(rawMicros - replayLastRawMicros);
+  }
+  replayLastRawMicros = rawMicros;
+  return replayLastMicros;
+}
+
+/* ======================================================================
+   FUNCTION: Decode one #R line into events
+   ====================================================================== */
+bool decodeReplayLine(const char *hex, std::vector<ReplayEvent> *events, ReplayCalibration *calibration) {
+  byte data[REPLAY_RECORD_MAX_BYTES];
+  int length = 0;
+  for (; isxdigit(hex[0]) && isxdigit(hex[1]) && length < REPLAY_RECORD_MAX_BYTES; hex += 2) {
+    char pair[3] = {hex[0], hex[1], '\0'};
+    data[length++] = static_cast<byte>(strtoul(pair, nullptr, 16));
+  }
+  if (length < 5) {
+    return false;
+  }
+
+  uint32_t rawMicros = data[1] | (data[2] << 8) | (data[3] << 16) | (static_cast<uint32_t>(data[4]) << 24);
+  uint64_t micros = unwrapReplayMicros(rawMicros);
+  ReplayEvent event = {micros, static_cast<ReplayRecordType>(data[0]), {0, 0, 0}, ""};
+  int position = 5;
+
+  switch (event.type) {
+    case REPLAY_RECORD_CALIBRATION:
+      if (length < 12 || data[5] != REPLAY_FORMAT_VERSION) {
+        return false;
+      }
+      // The board repeats this every few seconds, the first one is what the controller was started with
+      if (!calibration->found) {
+        calibration->found = true;
+        calibration->valveMinimumRaw = data[6] | (data[7] << 8);
+        calibration->valveMaximumRaw = data[8] | (data[9] << 8);
+        calibration->manifoldAtmosphericOffsetRaw = data[10] | (data[11] << 8);
+      }
+      return true;
+
+    case REPLAY_RECORD_ADC: {
+      unsigned long periodUs, count, valveDelta, manifoldDelta, intakeDelta;
+      if (!readVarint(data, length, &position, &periodUs) || !readVarint(data, length, &position, &count)) {
+        return false;
+      }
+      int valveRaw = 0, manifoldRaw = 0, intakeRaw = 0;
+      for (unsigned long i = 0; i < count; i++) {
+        if (!readVarint(data, length, &position, &valveDelta) || !readVarint(data, length, &position, &manifoldDelta) ||
+            !readVarint(data, length, &position, &intakeDelta)) {
+          return false;
+        }
+        valveRaw += zigzagDecode(valveDelta);
+        manifoldRaw += zigzagDecode(manifoldDelta);
+        intakeRaw += zigzagDecode(intakeDelta);
+        events->push_back({micros + i * periodUs, REPLAY_RECORD_ADC, {valveRaw, manifoldRaw, intakeRaw}, ""});
+      }
+      return true;
+    }
+
+    case REPLAY_RECORD_MASTER_FRAME:
+      event.frame.assign(reinterpret_cast<const char *>(&data[position]), length - position);
+      events->push_back(event);
+      return true;
+
+    case REPLAY_RECORD_POTS:
+      if (length < position + 2 * PID_POT_COUNT) {
+        return false;
+      }
+      for (int i = 0; i < PID_POT_COUNT; i++) {
+        event.values[i] = data[position + 2 * i] | (data[position + 2 * i + 1] << 8);
+      }
+      events->push_back(event);
+      return true;
+
+    case REPLAY_RECORD_ATMOSPHERIC:
+      if (length < position + 2) {
+        return false;
+      }
+      event.values[0] = data[position] | (data[position + 1] << 8);
+      events->push_back(event);
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Load a capture, anything that isn't a #R line is ignored
+   ====================================================================== */
+bool loadReplayCapture(const char *path, std::vector<ReplayEvent> *events, ReplayCalibration *calibration) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    fprintf(stderr, "Can't open %s\n", path);
+    return false;
+  }
+
+  char line[512];
+  unsigned long corruptLines = 0;
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    const char *record = strstr(line, "#R");
+    if (record != nullptr && !decodeReplayLine(record + 2, events, calibration)) {
+      corruptLines++;
+    }
+  }
+  fclose(file);
+
+  if (corruptLines > 0) {
+    fprintf(stderr, "Skipped %lu corrupt or truncated #R lines\n", corruptLines);
+  }
+  std::stable_sort(events->begin(), events->end(), [](const ReplayEvent &a, const ReplayEvent &b) { return a.micros < b.micros; });
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Frame the outputs we diff, one line per tick
+   ====================================================================== */
+std::string formatReplayTick(unsigned long timeMs, const ControlOutputs *outputs, const ControlReadings *readings) {
+  // The motor command is what actually reached the driver, fail safe included, not the PID output variable
+  float motorCommand = halNativeGetPwm(MOTOR_PWM_PIN) * (halNativeGetDigital(MOTOR_DIR_PIN) == HIGH ? 1.0f : -1.0f);
+  char line[96];
+  snprintf(line, sizeof(line), "%lu,%.2f,%.2f,%.2f,%d,%.3f", timeMs, readings->targetBoostKpa, readings->manifoldPressureGaugeKpa, motorCommand + 0.0f,
+           static_cast<int>(outputs->controlMode), readings->pressureRatio);
+  return line;
+}
+
+/* ======================================================================
+   FUNCTION: Replay a capture through the controller, returns the output lines
+   ====================================================================== */
+// The background half mirrors the control relevant tasks in loop() at the same rates, the control tick runs once per
+// simulated ms. Nothing touches a real clock, so the same capture and code always give the same output. Boost events the
+// controller completed along the way are handed back too.
+std::vector<std::string> runReplay(const std::vector<ReplayEvent> &events, const ReplayCalibration *calibration, std::vector<BoostEventRecord> *boostEvents) {
+  std::vector<std::string> lines;
+  ptScheduler ptSerialReadAndProcessMessage = ptScheduler(PT_TIME_10MS);
+  ptScheduler ptCheckFaultConditions = ptScheduler(PT_TIME_200MS);
+  ptScheduler ptCalculateDesiredBoostKpa = ptScheduler(PT_TIME_200MS);
+  ptScheduler ptSerialCalculateMessageQualityStats = ptScheduler(PT_TIME_5S);
+
+  ControlInputs inputs;
+  ControlOutputs outputs = ControlOutputs();
+  ControlReadings readings = ControlReadings();
+  float vehicleSpeed = 0;
+  int vehicleRpm = 0, vehicleGear = 0;
+  bool clutchPressed = true;
+  bool drivingEventPending = false;
+
+  // Start the simulated clock at the first recorded event so fault timing matches the drive
+  uint64_t startMicros = events.front().micros;
+  halNativeAdvanceMicros(startMicros);
+  resetMasterInputAges();
+  initCytronMotorDriver();
+  initBoostController(calibration->valveMinimumRaw, calibration->valveMaximumRaw, calibration->manifoldAtmosphericOffsetRaw, &inputs);
+
+  unsigned long previousFaultBitmask = 0;
+  unsigned long previousOverboostEventCount = 0;
+  size_t next = 0;
+  for (uint64_t now = startMicros; next < events.size(); now += replayTickPeriodUs) {
+    // Everything recorded up to this tick
+    for (; next < events.size() && events[next].micros <= now; next++) {
+      const ReplayEvent &event = events[next];
+      if (event.type == REPLAY_RECORD_ADC) {
+        halNativeSetAdc(boostValvePositionSignalPin, event.values[0]);
+        halNativeSetAdc(manifoldTmapSensorPressureSignalPin, event.values[1]);
+        halNativeSetAdc(intakeTmapSensorPressureSignalPin, event.values[2]);
+      } else if (event.type == REPLAY_RECORD_MASTER_FRAME) {
+        halNativeUartInject(event.frame.c_str(), event.frame.size());
+      } else if (event.type == REPLAY_RECORD_POTS) {
+        setPidTuningFromPots(event.values, &inputs.pressureKp, &inputs.pressureKi, &inputs.pressureKd);
+      } else if (event.type == REPLAY_RECORD_ATMOSPHERIC) {
+        inputs.manifoldAtmosphericOffsetRaw = event.values[0];
+      }
+    }
+
+    if (ptSerialCalculateMessageQualityStats.call()) {
+      serialCalculateMessageQualityStats();
+    }
+
+    if (ptSerialReadAndProcessMessage.call()) {
+      const char *serialMessage = serialGetIncomingMessage();
+      if (serialMessage[0] == '<' && serialProcessMessage(serialMessage, &vehicleSpeed, &vehicleRpm, &vehicleGear, &clutchPressed) == 1) {
+        inputs.vehicleRpm = vehicleRpm;
+        inputs.vehicleGear = vehicleGear;
+        inputs.clutchPressed = clutchPressed;
+        updateVehicleStateEstimator(vehicleSpeed, vehicleRpm, vehicleGear, clutchPressed);
+        VehicleEstimate vehicle;
+        getVehicleEstimate(&vehicle);
+        drivingEventPending |= (detectDrivingEvents(vehicleGear, clutchPressed, vehicle.rpmPerSecond) != 0);
+      }
+    }
+
+    if (ptCheckFaultConditions.call()) {
+      bool overboostDetected = outputs.overboostDetected || outputs.overboostEventCount != previousOverboostEventCount;
+      previousOverboostEventCount = outputs.overboostEventCount;
+      checkAndSetFaultConditions(&overboostDetected, &readings.manifoldPressureGaugeKpa, &readings.overboostLimitKpa);
+      updateFaultCondition(FAULT_INTAKE_SENSOR, !outputs.intakePressurePlausible);
+    }
+
+    if (ptCalculateDesiredBoostKpa.call() || drivingEventPending) {
+      if (drivingEventPending) {
+        inputs.prepositionSequence++;
+        drivingEventPending = false;
+      }
+      VehicleEstimate vehicle;
+      getVehicleEstimate(&vehicle);
+      float desiredBoostKpa = calculateDesiredBoostKpa(vehicle.speed, vehicle.rpm, vehicle.gear, vehicle.clutchPressed);
+      inputs.targetBoostKpa = globalAlarmCritical ? 0.0 : discountBoostForInputAge(desiredBoostKpa, getOldestMasterInputAgeMillis(), vehicle.extrapolated);
+    }
+    inputs.alarmCritical = globalAlarmCritical;
+    convertControlInputs(&inputs);
+
+    runBoostController(&inputs, &outputs);
+    convertControlOutputs(&outputs, &readings);
+    if (outputs.boostEventCount != boostEvents->size()) {
+      BoostEventRecord boostEvent;
+      convertBoostEvent(&outputs.lastBoostEvent, &boostEvent);
+      boostEvents->push_back(boostEvent);
+    }
+    unsigned long timeMs = (now - startMicros) / 1000;
+    lines.push_back(formatReplayTick(timeMs, &outputs, &readings));
+
+    unsigned long faultBitmask = getFaultBitmask();
+    for (int code = 0; code < FAULT_CODE_COUNT; code++) {
+      unsigned long bit = 1UL << code;
+      if ((faultBitmask ^ previousFaultBitmask) & bit) {
+        lines.push_back(std::to_string(timeMs) + ",fault," + std::to_string(code) + ((faultBitmask & bit) ? ",raised" : ",cleared"));
+      }
+    }
+    previousFaultBitmask = faultBitmask;
+
+    halNativeAdvanceMicros(replayTickPeriodUs);
+  }
+  return lines;
+}
+
+/* ======================================================================
+   FUNCTION: Print the step response of each boost event in the drive
+   ====================================================================== */
+// The same capture replayed with different gains (pots or an edited default) gives directly comparable rows
+void printReplayBoostEvents(const std::vector<BoostEventRecord> &boostEvents) {
+  printf("%zu boost events\n", boostEvents.size());
+  if (boostEvents.empty()) {
+    return;
+  }
+  printf("%8s %4s %6s %13s %7s %9s %8s %9s %6s\n", "start ms", "gear", "rpm", "kPa", "rise ms", "overshoot", "settling", "ss error", "IAE");
+  for (const BoostEventRecord &event : boostEvents) {
+    printf("%8lu %4d %5d+ %5.1f->%5.1f %7.0f %9.2f %8.0f %9.2f %6.2f\n", event.startMillis, event.gear, event.rpmBand * 1000, event.startKpa,
+           event.targetKpa, event.riseTimeMillis, event.overshootKpa, event.settlingTimeMillis, event.steadyStateErrorKpa, event.integralAbsoluteError);
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Diff against a golden run, tick lines by position and fault events as a list
+   ====================================================================== */
+int compareReplayToGolden(const std::vector<std::string> &lines, const char *goldenPath) {
+  FILE *file = fopen(goldenPath, "r");
+  if (file == nullptr) {
+    fprintf(stderr, "Can't open %s\n", goldenPath);
+    return 2;
+  }
+  std::vector<std::string> goldenTicks, goldenFaults, ticks, faults;
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    line[strcspn(line, "\r\n")] = '\0';
+    (strstr(line, ",fault,") ? goldenFaults : goldenTicks).push_back(line);
+  }
+  fclose(file);
+  for (const std::string &output : lines) {
+    (output.find(",fault,") != std::string::npos ? faults : ticks).push_back(output);
+  }
+
+  unsigned long tickDifferences = 0;
+  size_t tickCount = std::max(ticks.size(), goldenTicks.size());
+  for (size_t i = 0; i < tickCount; i++) {
+    const std::string current = (i < ticks.size()) ? ticks[i] : "(none)";
+    const std::string golden = (i < goldenTicks.size()) ? goldenTicks[i] : "(none)";
+    if (current != golden && tickDifferences++ < replayDifferencesShown) {
+      printf("tick   golden %-40s now %s\n", golden.c_str(), current.c_str());
+    }
+  }
+
+  unsigned long faultDifferences = 0;
+  for (const std::string &fault : goldenFaults) {
+    if (std::find(faults.begin(), faults.end(), fault) == faults.end()) {
+      printf("fault  missing %s\n", fault.c_str());
+      faultDifferences++;
+    }
+  }
+  for (const std::string &fault : faults) {
+    if (std::find(goldenFaults.begin(), goldenFaults.end(), fault) == goldenFaults.end()) {
+      printf("fault  new     %s\n", fault.c_str());
+      faultDifferences++;
+    }
+  }
+
+  printf("%lu of %zu ticks differ, %lu fault event differences\n", tickDifferences, tickCount, faultDifferences);
+  return (tickDifferences == 0 && faultDifferences == 0) ? 0 : 1;
+}
+
+/* ======================================================================
+   MAIN: Host entry point for [env:native_replay]
+   ====================================================================== */
+// Usage: program <capture.log> [--write golden.csv] [--golden golden.csv]
+// Output lines are "timeMs,targetKpa,manifoldKpa,motorCommand,controlMode" per tick plus "timeMs,fault,code,raised|cleared".
+int main(int argc, char **argv) {
+  const char *capturePath = nullptr, *writePath = nullptr, *goldenPath = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--write") == 0 && i + 1 < argc) {
+      writePath = argv[++i];
+    } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+      goldenPath = argv[++i];
+    } else {
+      capturePath = argv[i];
+    }
+  }
+  if (capturePath == nullptr) {
+    fprintf(stderr, "Usage: %s <capture.log> [--write golden.csv] [--golden golden.csv]\n", argv[0]);
+    return 2;
+  }
+
+  initLogBuffer();
+  std::vector<ReplayEvent> events;
+  ReplayCalibration calibration;
+  if (!loadReplayCapture(capturePath, &events, &calibration)) {
+    return 2;
+  }
+  if (!calibration.found || events.empty()) {
+    fprintf(stderr, "%s has no calibration record or no inputs, was enableReplayRecording set?\n", capturePath);
+    return 2;
+  }
+
+  std::vector<BoostEventRecord> boostEvents;
+  std::vector<std::string> lines = runReplay(events, &calibration, &boostEvents);
+  printf("Replayed %zu events, %.1fs of driving\n", events.size(), (events.back().micros - events.front().micros) / 1e6);
+  printReplayBoostEvents(boostEvents);
+
+  if (writePath != nullptr) {
+    FILE *file = fopen(writePath, "w");
+    if (file == nullptr) {
+      fprintf(stderr, "Can't write %s\n", writePath);
+      return 2;
+    }
+    for (const std::string &line : lines) {
+      fprintf(file, "%s\n", line.c_str());
+    }
+    fclose(file);
+  }
+  return (goldenPath != nullptr) ? compareReplayToGolden(lines, goldenPath) : 0;
+}
+
+#endif
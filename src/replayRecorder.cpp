@@ -0,0 +1,252 @@
+#include "replayRecorder.h"
+#include "hal.h"
+#include "logBuffer.h"
+#include "pidPotentiometers.h"
+#include "varintEncoding.h"
+
+/* ======================================================================
+   STRUCTURES: Raw ADC sample from the control tick, and a queued background record
+   ====================================================================== */
+struct ReplayAdcSample {
+  unsigned long micros;
+  uint16_t valveRaw;
+  uint16_t manifoldRaw;
+  uint16_t intakeRaw;
+};
+
+struct ReplayRecord {
+  byte length;
+  byte data[REPLAY_RECORD_MAX_BYTES];
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const unsigned long replayCalibrationRepeatMillis = 5000; // So a capture started mid drive can still be replayed
+const int replayLineMaxLength = 2 + REPLAY_RECORD_MAX_BYTES * 2 + 1;
+
+// Control tick writes, background reads. Single producer single consumer, each index only written by one side.
+// On the AVR the indexes are a single byte so neither side can read half of an update, which caps the ring at 128.
+#if defined(ARDUINO_ARCH_AVR)
+typedef uint8_t ReplayAdcIndex;
+#ifndef REPLAY_ADC_RING_SIZE
+#define REPLAY_ADC_RING_SIZE 64
+#endif
+#else
+typedef uint16_t ReplayAdcIndex;
+#ifndef REPLAY_ADC_RING_SIZE
+#define REPLAY_ADC_RING_SIZE 256
+#endif
+#endif
+
+const ReplayAdcIndex replayAdcRingSize = REPLAY_ADC_RING_SIZE; // Must be a power of 2, 256ms of ticks on the R4
+ReplayAdcSample replayAdcRing[replayAdcRingSize];
+volatile ReplayAdcIndex replayAdcHead = 0;
+volatile ReplayAdcIndex replayAdcTail = 0;
+volatile unsigned long replayAdcDropped = 0;
+
+// Background records waiting for room in the serial transmit buffer
+const int replayRecordQueueSize = 8;
+ReplayRecord replayRecordQueue[replayRecordQueueSize];
+int replayRecordQueueHead = 0;
+int replayRecordQueueCount = 0;
+unsigned long replayRecordsDropped = 0;
+unsigned long replayDroppedReported = 0;
+
+ReplayRecord replayCalibrationRecord;
+bool replayCalibrationKnown = false;
+unsigned long replayCalibrationSentMillis = 0;
+
+/* ======================================================================
+   FUNCTION: Record header and fixed width fields
+   ====================================================================== */
+int startReplayRecord(byte *data, ReplayRecordType type, unsigned long micros) {
+  data[0] = type;
+  for (int i = 0; i < 4; i++) {
+    data[1 + i] = static_cast<byte>(micros >> (8 * i));
+  }
+  return 5;
+}
+
+int appendReplayUint16(byte *data, int length, int value) {
+  data[length++] = static_cast<byte>(value);
+  data[length++] = static_cast<byte>(value >> 8);
+  return length;
+}
+
+/* ======================================================================
+   FUNCTION: Queue a background record for serviceReplayRecording() to send
+   ====================================================================== */
+ReplayRecord *claimReplayRecord() {
+  if (replayRecordQueueCount == replayRecordQueueSize) {
+    replayRecordsDropped++;
+    return nullptr;
+  }
+  ReplayRecord *record = &replayRecordQueue[(replayRecordQueueHead + replayRecordQueueCount) % replayRecordQueueSize];
+  replayRecordQueueCount++;
+  return record;
+}
+
+/* ======================================================================
+   FUNCTION: Record the startup calibration the controller was given
+   ====================================================================== */
+void recordReplayCalibration(int valveMinimumRaw, int valveMaximumRaw, float manifoldAtmosphericOffsetRaw) {
+  int length = startReplayRecord(replayCalibrationRecord.data, REPLAY_RECORD_CALIBRATION, halMicros());
+  replayCalibrationRecord.data[length++] = REPLAY_FORMAT_VERSION;
+  length = appendReplayUint16(replayCalibrationRecord.data, length, valveMinimumRaw);
+  length = appendReplayUint16(replayCalibrationRecord.data, length, valveMaximumRaw);
+  length = appendReplayUint16(replayCalibrationRecord.data, length, lroundf(manifoldAtmosphericOffsetRaw));
+  replayCalibrationRecord.length = length;
+  replayCalibrationKnown = true;
+  replayCalibrationSentMillis = halMillis() - replayCalibrationRepeatMillis; // Send on the next service
+}
+
+/* ======================================================================
+   FUNCTION: Record one control tick's raw ADC readings (control tick only)
+   ====================================================================== */
+void recordReplayAdcSample(int valveRaw, int manifoldRaw, int intakeRaw) {
+  ReplayAdcIndex head = replayAdcHead;
+  if (static_cast<ReplayAdcIndex>(head - replayAdcTail) == replayAdcRingSize) {
+    replayAdcDropped = replayAdcDropped + 1; // The gap shows up as a break in the record timestamps
+    return;
+  }
+  ReplayAdcSample *sample = &replayAdcRing[head & (replayAdcRingSize - 1)];
+  sample->micros = halMicros();
+  sample->valveRaw = valveRaw;
+  sample->manifoldRaw = manifoldRaw;
+  sample->intakeRaw = intakeRaw;
+  __asm__ __volatile__("" ::: "memory");
+  replayAdcHead = head + 1;
+}
+
+/* ======================================================================
+   FUNCTION: Record a master frame as received, before it is tokenised
+   ====================================================================== */
+void recordReplayMasterFrame(const char *frame) {
+  ReplayRecord *record = claimReplayRecord();
+  if (record == nullptr) {
+    return;
+  }
+  int length = startReplayRecord(record->data, REPLAY_RECORD_MASTER_FRAME, halMicros());
+  for (; *frame != '\0' && length < REPLAY_RECORD_MAX_BYTES; frame++) {
+    record->data[length++] = *frame;
+  }
+  record->length = length;
+}
+
+/* ======================================================================
+   FUNCTION: Record raw PID pot readings
+   ====================================================================== */
+void recordReplayPots(const int *pidPotsRaw) {
+  ReplayRecord *record = claimReplayRecord();
+  if (record == nullptr) {
+    return;
+  }
+  int length = startReplayRecord(record->data, REPLAY_RECORD_POTS, halMicros());
+  for (int i = 0; i < PID_POT_COUNT; i++) {
+    length = appendReplayUint16(record->data, length, pidPotsRaw[i]);
+  }
+  record->length = length;
+}
+
+/* ======================================================================
+   FUNCTION: Record a new manifold atmospheric offset
+   ====================================================================== */
+void recordReplayAtmospheric(int manifoldAtmosphericOffsetRaw) {
+  ReplayRecord *record = claimReplayRecord();
+  if (record == nullptr) {
+    return;
+  }
+  int length = startReplayRecord(record->data, REPLAY_RECORD_ATMOSPHERIC, halMicros());
+  record->length = appendReplayUint16(record->data, length, manifoldAtmosphericOffsetRaw);
+}
+
+/* ======================================================================
+   FUNCTION: Delta encode queued ADC samples into a record, without taking them
+   ====================================================================== */
+// Stops early at a gap (dropped samples or a stalled tick) so every record covers evenly spaced ticks. Returns how many
+// samples went in, 0 when there aren't enough yet to be worth a record.
+int encodeReplayAdcRecord(ReplayRecord *record) {
+  ReplayAdcIndex tail = replayAdcTail;
+  int available = static_cast<ReplayAdcIndex>(replayAdcHead - tail);
+  if (available < REPLAY_ADC_SAMPLES_PER_RECORD) {
+    return 0;
+  }
+
+  const ReplayAdcSample *first = &replayAdcRing[tail & (replayAdcRingSize - 1)];
+  int count = 1;
+  for (; count < REPLAY_ADC_SAMPLES_PER_RECORD; count++) {
+    const ReplayAdcSample *previous = &replayAdcRing[(tail + count - 1) & (replayAdcRingSize - 1)];
+    const ReplayAdcSample *next = &replayAdcRing[(tail + count) & (replayAdcRingSize - 1)];
+    unsigned long spacing = next->micros - previous->micros;
+    unsigned long nominal = (count > 1) ? (previous->micros - first->micros) / (count - 1) : spacing;
+    if (spacing > nominal + nominal / 2) {
+      break;
+    }
+  }
+  const ReplayAdcSample *last = &replayAdcRing[(tail + count - 1) & (replayAdcRingSize - 1)];
+  unsigned long periodUs = (count > 1) ? (last->micros - first->micros + (count - 1) / 2) / (count - 1) : 0;
+
+  int length = startReplayRecord(record->data, REPLAY_RECORD_ADC, first->micros);
+  length = appendVarint(record->data, length, periodUs);
+  length = appendVarint(record->data, length, count);
+  int previousValve = 0, previousManifold = 0, previousIntake = 0;
+  for (int i = 0; i < count; i++) {
+    const ReplayAdcSample *sample = &replayAdcRing[(tail + i) & (replayAdcRingSize - 1)];
+    length = appendVarint(record->data, length, zigzagEncode(sample->valveRaw - previousValve));
+    length = appendVarint(record->data, length, zigzagEncode(sample->manifoldRaw - previousManifold));
+    length = appendVarint(record->data, length, zigzagEncode(sample->intakeRaw - previousIntake));
+    previousValve = sample->valveRaw;
+    previousManifold = sample->manifoldRaw;
+    previousIntake = sample->intakeRaw;
+  }
+  record->length = length;
+  return count;
+}
+
+/* ======================================================================
+   FUNCTION: Print one record as a #R hex line if the transmit buffer has room
+   ====================================================================== */
+bool printReplayRecord(const ReplayRecord *record) {
+  static char line[replayLineMaxLength];
+  int length = snprintf(line, sizeof(line), "#R");
+  for (int i = 0; i < record->length; i++) {
+    length += snprintf(&line[length], sizeof(line) - length, "%02X", record->data[i]);
+  }
+  if (getSerialWriteRoom() < length + 2) {
+    return false;
+  }
+  spendSerialWriteRoom(Serial.println(line));
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Send queued records in idle time, never blocking
+   ====================================================================== */
+// One ADC record (16 ticks) and one background record per call at most. Each is only taken off its queue once it has
+// actually gone out, so a busy serial port just delays the recording until the ADC ring fills.
+void serviceReplayRecording() {
+  static ReplayRecord adcRecord;
+
+  if (replayCalibrationKnown && halMillis() - replayCalibrationSentMillis >= replayCalibrationRepeatMillis) {
+    if (printReplayRecord(&replayCalibrationRecord)) {
+      replayCalibrationSentMillis = halMillis();
+    }
+  }
+
+  int adcSamples = encodeReplayAdcRecord(&adcRecord);
+  if (adcSamples > 0 && printReplayRecord(&adcRecord)) {
+    replayAdcTail = replayAdcTail + adcSamples;
+  }
+
+  if (replayRecordQueueCount > 0 && printReplayRecord(&replayRecordQueue[replayRecordQueueHead])) {
+    replayRecordQueueHead = (replayRecordQueueHead + 1) % replayRecordQueueSize;
+    replayRecordQueueCount--;
+  }
+
+  unsigned long dropped = replayAdcDropped + replayRecordsDropped;
+  if (dropped != replayDroppedReported && getSerialWriteRoom() >= 80) {
+    spendSerialWriteRoom(Serial.print("[REPLAY] Recording fell behind, samples and records dropped: ") + Serial.println(dropped - replayDroppedReported));
+    replayDroppedReported = dropped;
+  }
+}
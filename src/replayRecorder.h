@@ -0,0 +1,36 @@
+#ifndef REPLAYRECORDER_H
+#define REPLAYRECORDER_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   DEFINES: Recording format
+   ====================================================================== */
+// Each record goes out over serial as one "#R<hex>" line, so it can be picked out of a log2file capture alongside the
+// normal debug text. The first byte is the record type, then the record's board micros (4 bytes little endian).
+#define REPLAY_FORMAT_VERSION 2     // 2 added the intake pressure to ADC records
+#define REPLAY_RECORD_MAX_BYTES 112 // Fits a full ADC record, 16 ticks of three 2 byte deltas plus header
+#define REPLAY_ADC_SAMPLES_PER_RECORD 16
+
+/* ======================================================================
+   ENUMS: Record types
+   ====================================================================== */
+enum ReplayRecordType {
+  REPLAY_RECORD_CALIBRATION = 1, // Format version, valve travel minimum and maximum raw, manifold atmospheric offset raw (u16s)
+  REPLAY_RECORD_ADC = 2,         // Tick period us and sample count (varints), then valve, manifold and intake raw per tick as zigzag varint deltas
+  REPLAY_RECORD_MASTER_FRAME = 3, // Master frame text exactly as received, before it is tokenised
+  REPLAY_RECORD_POTS = 4,         // Raw P, I and D pot readings (u16s)
+  REPLAY_RECORD_ATMOSPHERIC = 5   // Manifold atmospheric offset raw (u16) the control tick was handed after re-baselining
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void recordReplayCalibration(int, int, float);
+void recordReplayAdcSample(int, int, int);
+void recordReplayMasterFrame(const char *);
+void recordReplayPots(const int *);
+void recordReplayAtmospheric(int);
+void serviceReplayRecording();
+
+#endif
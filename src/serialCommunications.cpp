@@ -1,6 +1,10 @@
 #include "serialCommunications.h"
+#include "faultManager.h"
 #include "globalHelpers.h"
+#include "hal.h"
 #include "serialMessageProcessing.h"
+#include "textFormat.h"
+#include "timeSync.h"
 
 /* ======================================================================
    VARIABLES
@@ -26,10 +30,8 @@ void serialCalculateMessageQualityStats() {
   messageStatBadchecksumPercentage = (static_cast<float>(messagesWithBadChecksum) / messagesReceived) * 100.0;
   messageStatCorruptPercentage = (static_cast<float>(corruptMessages) / messagesReceived) * 100.0;
 
-  // Set global critical alarm if stats are not good
-  if (messageStatPartialPercentage > 20 || messageStatBadchecksumPercentage > 5 || messageStatCorruptPercentage > 10) {
-    globalAlarmCritical = true;
-  }
+  // Raise a critical fault if stats are not good
+  updateFaultCondition(FAULT_SERIAL_QUALITY, messageStatPartialPercentage > 20 || messageStatBadchecksumPercentage > 5 || messageStatCorruptPercentage > 10);
 }
 
 /* ======================================================================
@@ -89,14 +91,11 @@ bool serialIsChecksumValid(const char *message) {
     }
   }
 
-  // Display the correct calculated checksum in debug
-  String calculatedChecksumString = String(static_cast<unsigned char>(calculatedChecksum));
-
   // If received checksum matches calculated checksum, return true, else return false
   if (atoi(receivedChecksum) == calculatedChecksum) {
     return true;
   } else {
-    DEBUG_SERIAL_RECEIVE("BAD Checksum calculation. Received: " + String(receivedChecksum) + ", Calculated: " + calculatedChecksumString);
+    DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_BAD_CHECKSUM, atoi(receivedChecksum), static_cast<unsigned char>(calculatedChecksum));
     return false;
   }
 }
@@ -149,22 +148,21 @@ const char *serialGetIncomingMessage() {
 
   // Throw away any characters until we get a message start or there is no more data, but only if we are not appending to a previous partial message
   if (partialMessagePresent == false) {
-    while (Serial1.peek() != '<' && Serial1.available() > 0) {
-      Serial1.read();
+    while (halUartPeek() != '<' && halUartAvailable() > 0) {
+      halUartRead();
     }
   } else if (partialMessagePresent == true) { // If we are appending to a previous partial message, load it in before we start reading new characters
     strcpy(message, partialMessage);
     messageSize = strlen(message);
-    DEBUG_SERIAL_RECEIVE("Retrieving partial message: " + String(partialMessage));
-    DEBUG_SERIAL_RECEIVE("Main message now contains: " + String(message));
+    DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_PARTIAL_RETRIEVED, partialMessage);
   }
 
   // Read characters from Serial until end marker '>' is received
-  while (Serial1.available() > 0) {
-    char incomingChar = Serial1.read();
+  while (halUartAvailable() > 0) {
+    char incomingChar = halUartRead();
 
     if (partialMessagePresent == true) {
-      DEBUG_SERIAL_RECEIVE("Read in character: " + String(incomingChar));
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_READ_CHARACTER, incomingChar);
     }
 
     // Add the character to the message and guard against buffer overflow
@@ -173,7 +171,7 @@ const char *serialGetIncomingMessage() {
       message[messageSize] = '\0'; // Null terminate after adding each character
     } else {
       // Handle buffer full condition, optionally print an error message
-      DEBUG_SERIAL_RECEIVE("Buffer full, message truncated");
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_BUFFER_FULL);
       break; // Exit the loop to avoid further processing
     }
 
@@ -192,7 +190,7 @@ const char *serialGetIncomingMessage() {
         // Ensure the checksum is valid, discard if it is not
         if (serialIsChecksumValid(message)) {
           // Process the valid message
-          DEBUG_SERIAL_RECEIVE("GOOD message ready to process: " + String(message));
+          DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_GOOD_MESSAGE, message);
           return message;
         } else {
           messagesWithBadChecksum++;
@@ -201,17 +199,17 @@ const char *serialGetIncomingMessage() {
         }
       } else {
         corruptMessages++;
-        DEBUG_SERIAL_RECEIVE("CORRUPT message: " + String(message));
+        DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_CORRUPT_MESSAGE, message);
         strcpy(returnMessage, "corrupt");
         partialMessagePresent = false; // Clear partial message after processing
         partialMessage[0] = '\0';
         return returnMessage;
       }
-    } else if (Serial1.available() == 0) { // There is no more content in the buffer, and end of message not received. Store message content for appending to later
+    } else if (halUartAvailable() == 0) { // There is no more content in the buffer, and end of message not received. Store message content for appending to later
       partialMessagePresent = true;
       partialMessagesReceived++;
       strcpy(partialMessage, message);
-      DEBUG_SERIAL_RECEIVE("Storing partial message: " + String(message) + " and last character is " + String(incomingChar));
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_PARTIAL_STORED, message);
       strcpy(returnMessage, "partial"); // We have stored a partially received message and will pick it up next function call
       return returnMessage;
     }
@@ -221,24 +219,56 @@ const char *serialGetIncomingMessage() {
 }
 
 /* ======================================================================
-   FUNCTION: Send response to command ID 0 from master (response message is command ID 2)
+   FUNCTION: Add checksum and start / end markers to a message and send it
    ====================================================================== */
-void serialSendCommandId0Response(bool alarmCritical, float targetBoostKpa, float manifoldPressureKpa, int manifoldTempCelcius,
-                                  float intakePressureKpa, int intakeTempCelcius, double valveOpenPercentage) {
-  // Create the message without the start and end markers
-  String message = "2," + String(alarmCritical ? "1" : "0") + "," + String(targetBoostKpa) + "," + String(manifoldPressureKpa) + "," +
-                   String(manifoldTempCelcius) + "," + String(intakePressureKpa) + "," + String(intakeTempCelcius) + "," + String(valveOpenPercentage);
-
+void serialSendMessage(const char *message) {
   // Calculate XOR checksum
   byte checksum = 0;
-  for (size_t i = 0; i < message.length(); i++) {
-    checksum ^= message.charAt(i);
+  for (int i = 0; message[i] != '\0'; i++) {
+    checksum ^= message[i];
   }
 
   // Create the final message with start and end markers, and checksum
-  String finalMessage = "<" + message + "," + String(checksum) + ">";
+  char finalMessage[maxMessageSize + 8];
+  int finalLength = snprintf(finalMessage, sizeof(finalMessage), "<%s,%u>", message, checksum);
 
   // Send the message
-  Serial1.print(finalMessage);
-  DEBUG_SERIAL_SEND("Sending " + String(finalMessage));
+  halUartWrite(finalMessage, finalLength);
+  DEBUG_SERIAL_SEND(LOG_SERIAL_SEND_MESSAGE, finalMessage);
+}
+
+/* ======================================================================
+   FUNCTION: Send response to command ID 0 from master (response message is command ID 2)
+   ====================================================================== */
+// Ends with our millis() and the same instant on the master's clock (0 until time sync has a reply), so the master can
+// line the readings up with its own log. A master that doesn't know about them can ignore anything after faultBitmask.
+void serialSendCommandId0Response(bool alarmCritical, float targetBoostKpa, float manifoldPressureKpa, int manifoldTempCelcius,
+                                  float intakePressureKpa, int intakeTempCelcius, double valveOpenPercentage, unsigned long faultBitmask) {
+  TimeSyncStatus timeSync;
+  getTimeSyncStatus(&timeSync);
+  unsigned long localMillis = halMillis();
+  unsigned long masterMillis = timeSync.synchronised ? localToMasterMillis(localMillis) : 0;
+
+  // Create the message without the start and end markers, numbers formatted as String() always has (2 decimal places)
+  char message[maxMessageSize];
+  int length = snprintf(message, sizeof(message), "2,%s,", alarmCritical ? "1" : "0");
+  length = appendFixedPoint(message, sizeof(message), length, targetBoostKpa, 2);
+  length = appendText(message, sizeof(message), length, ",");
+  length = appendFixedPoint(message, sizeof(message), length, manifoldPressureKpa, 2);
+  length += snprintf(&message[length], sizeof(message) - length, ",%d,", manifoldTempCelcius);
+  length = appendFixedPoint(message, sizeof(message), length, intakePressureKpa, 2);
+  length += snprintf(&message[length], sizeof(message) - length, ",%d,", intakeTempCelcius);
+  length = appendFixedPoint(message, sizeof(message), length, valveOpenPercentage, 2);
+  length += snprintf(&message[length], sizeof(message) - length, ",%lu,%lu,%lu", faultBitmask, localMillis, masterMillis);
+
+  serialSendMessage(message);
+}
+
+/* ======================================================================
+   FUNCTION: Ask the master for its clock (command ID 3, it replies with command ID 4)
+   ====================================================================== */
+void serialSendCommandId3Request() {
+  char message[16];
+  snprintf(message, sizeof(message), "3,%lu", startTimeSyncRequest());
+  serialSendMessage(message);
 }
@@ -6,9 +6,12 @@
 /* ======================================================================
    FUNCTION PROTOTYPES
    ====================================================================== */
+bool serialIsChecksumValid(const char *);
 const char *serialGetIncomingMessage();
 void serialReportMessageQualityStats();
 void serialCalculateMessageQualityStats();
-void serialSendCommandId0Response(bool, float, float, int, float, int, double);
+void serialSendMessage(const char *);
+void serialSendCommandId0Response(bool, float, float, int, float, int, double, unsigned long);
+void serialSendCommandId3Request();
 
 #endif
@@ -1,5 +1,7 @@
 #include "serialMessageProcessing.h"
 #include "globalHelpers.h"
+#include "hal.h"
+#include "timeSync.h"
 
 /* ======================================================================
    FUNCTION: Parse received message and take action based on command ID
@@ -12,18 +14,24 @@ int serialProcessMessage(const char *serialMessage, float *speed, int *rpm, int
   switch (CommandId) {
     case 0:
       // Master is requesting our current information to be sent over serial
-      DEBUG_SERIAL_RECEIVE("Got command ID " + String(CommandId) + " message " + String(serialMessage));
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_COMMAND, CommandId, serialMessage);
       return 0;
 
     case 1:
       // Master is pushing us the current state so we can update our local variables and make good decisions
-      DEBUG_SERIAL_RECEIVE("Got command ID " + String(CommandId) + " message " + String(serialMessage));
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_COMMAND, CommandId, serialMessage);
       serialProcessCommandId1(serialMessage, speed, rpm, gear, clutchPressed);
       return 1;
 
+    case 4:
+      // Master is replying to our time sync request (command ID 3)
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_COMMAND, CommandId, serialMessage);
+      serialProcessCommandId4(serialMessage);
+      return 4;
+
     default:
       // Unknown message type
-      DEBUG_SERIAL_RECEIVE("Command ID " + String(CommandId) + " not supported, unable to process " + String(serialMessage));
+      DEBUG_SERIAL_RECEIVE(LOG_SERIAL_RECEIVE_COMMAND_UNSUPPORTED, CommandId, serialMessage);
       return 255;
   }
 }
@@ -31,29 +39,55 @@ int serialProcessMessage(const char *serialMessage, float *speed, int *rpm, int
 /* ======================================================================
    FUNCTION: Process command ID 1 (update pushed status data from master)
    ====================================================================== */
+// The master's millis() when it sampled the values is an optional fifth field, older masters just don't send it
 void serialProcessCommandId1(const char *serialMessage, float *speed, int *rpm, int *gear, bool *clutchPressed) {
   // Create tokens from comma delimited message
   char *token = strtok(const_cast<char *>(serialMessage), ",");
   int positionCounter = 0;
+  byte presentMask = 0;
+  unsigned long masterMillis = 0;
 
-  // Extract the values we are interested in based on position
   while (token != NULL) {
+    // Extract the values we are interested in based on position
     switch (positionCounter) {
       case 1:
         *speed = atof(token);
+        presentMask |= 1 << MASTER_INPUT_SPEED;
         break;
       case 2:
         *rpm = atoi(token);
+        presentMask |= 1 << MASTER_INPUT_RPM;
         break;
       case 3:
         *gear = atoi(token);
+        presentMask |= 1 << MASTER_INPUT_GEAR;
         break;
       case 4:
         *clutchPressed = (strcmp(token, "1") == 0);
+        presentMask |= 1 << MASTER_INPUT_CLUTCH;
+        break;
+      case 5:
+        masterMillis = strtoul(token, NULL, 10); // Or the checksum, see below
         break;
     }
     // Get the next token
     token = strtok(NULL, ",");
     positionCounter++;
   }
+
+  // Command ID, four values and the checksum is six tokens, a seventh means position 5 was the timestamp
+  recordMasterInputs(presentMask, positionCounter >= 7, masterMillis);
+}
+
+/* ======================================================================
+   FUNCTION: Process command ID 4 (master's reply to a time sync request)
+   ====================================================================== */
+// Fields are our request timestamp echoed back, then the master's millis() when it received the request and when it sent
+// the reply. Our receive time is taken first so the serial poll interval is the only delay between arrival and timestamp.
+void serialProcessCommandId4(const char *serialMessage) {
+  unsigned long replyReceivedMillis = halMillis();
+  unsigned long requestMillis, masterReceivedMillis, masterSentMillis;
+  if (sscanf(serialMessage, "<4,%lu,%lu,%lu", &requestMillis, &masterReceivedMillis, &masterSentMillis) == 3) {
+    addTimeSyncSample(requestMillis, masterReceivedMillis, masterSentMillis, replyReceivedMillis);
+  }
 }
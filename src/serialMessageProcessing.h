@@ -7,6 +7,7 @@
    FUNCTION PROTOTYPES
    ====================================================================== */
 void serialProcessCommandId1(const char *, float *, int *, int *, bool *);
+void serialProcessCommandId4(const char *);
 int serialProcessMessage(const char *, float *, int *, int *, bool *);
 
 #endif
@@ -0,0 +1,203 @@
+#include "shadowController.h"
+#include "boostController.h"
+#include "platformTraits.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+typedef ControlNumeric::Value ControlValue;
+
+// Reduced order model of the valve and manifold, the same shape as the host plant model (plantModelNative.cpp). The motor
+// moves the valve 3% a second per 1% of motor (forward opens), the spring opens it at 50% a second, and the manifold
+// follows capacity times the closed fraction with a 100ms lag. Capacity is what changes with RPM, so it is learned from
+// the real manifold while the valve is closed enough for it to show.
+const ControlValue shadowValvePercentPerMotorPercent = ControlNumeric::fromDouble(3.0 / TargetPlatform::controlTickFrequencyHz); // Per tick
+const ControlValue shadowSpringPercent = ControlNumeric::fromDouble(50.0 / TargetPlatform::controlTickFrequencyHz);              // Per tick
+const ControlValue shadowManifoldFactor = ControlNumeric::fromDouble(1.0 / (0.1 * TargetPlatform::controlTickFrequencyHz));      // Tick over the lag
+const ControlValue shadowCapacityLearnFactor = ControlNumeric::fromDouble(2.0 / TargetPlatform::controlTickFrequencyHz);         // ~500ms to follow
+const ControlValue shadowCapacityLearnMaximumOpen = ControlNumeric::fromInt(80);
+const ControlValue shadowInitialCapacityKpa = ControlNumeric::fromInt(60);
+const ControlValue shadowPercentToFraction = ControlNumeric::fromDouble(0.01);
+const ControlValue shadowTickSeconds = ControlNumeric::fromDouble(1.0 / TargetPlatform::controlTickFrequencyHz);
+
+// Both copies of the model start each stretch from the real valve and manifold, so neither drifts for longer than this
+const unsigned int shadowStretchTicks = lround(1.0 * TargetPlatform::controlTickFrequencyHz);
+
+// Background scoring. The candidate has to beat the live gains on the model by the margin over enough stretches, and the
+// model has to follow the real manifold about as closely as the live loop follows its target, or the difference between
+// the two could just be model error.
+const unsigned long shadowMinimumStretches = 20;
+const double shadowWinMargin = 0.1;
+const double shadowMaximumModelErrorRatio = 1.5; // Model error over the live loop's own error
+
+ShadowScore shadowScore;
+
+/* ======================================================================
+   FUNCTION: Set up both PIDs against their own copies of the model
+   ====================================================================== */
+ShadowController::ShadowController()
+    : capacityKpa(shadowInitialCapacityKpa),
+      liveGainsPID(&liveGainsManifoldKpa, &liveGainsMotorSpeed, &targetKpa, 0.0, 0.0, 0.0, REVERSE),
+      candidatePID(&candidateManifoldKpa, &candidateMotorSpeed, &targetKpa, 0.0, 0.0, 0.0, REVERSE) {
+}
+
+/* ======================================================================
+   FUNCTION: Same output limits and sample time as the live pressure PID
+   ====================================================================== */
+void ShadowController::begin(double minimumMotorSpeed, double maximumMotorSpeed, int sampleTimeMillis) {
+  liveGainsPID.SetOutputLimits(minimumMotorSpeed, maximumMotorSpeed);
+  liveGainsPID.SetSampleTime(sampleTimeMillis);
+  liveGainsPID.SetMode(AUTOMATIC);
+  candidatePID.SetOutputLimits(minimumMotorSpeed, maximumMotorSpeed);
+  candidatePID.SetSampleTime(sampleTimeMillis);
+  candidatePID.SetMode(AUTOMATIC);
+  stretchActive = false;
+}
+
+/* ======================================================================
+   FUNCTION: Move one copy of the model on a tick
+   ====================================================================== */
+void ShadowController::stepModel(ControlValue *openPercentage, ControlValue *manifoldKpa, ControlValue motorSpeed) {
+  *openPercentage += ControlNumeric::multiply(motorSpeed, shadowValvePercentPerMotorPercent) + shadowSpringPercent;
+  *openPercentage = constrain(*openPercentage, ControlNumeric::fromInt(0), ControlNumeric::fromInt(100));
+  ControlValue closedFraction = ControlNumeric::multiply(ControlNumeric::fromInt(100) - *openPercentage, shadowPercentToFraction);
+  ControlValue steadyKpa = ControlNumeric::multiply(capacityKpa, closedFraction);
+  *manifoldKpa += ControlNumeric::multiply(steadyKpa - *manifoldKpa, shadowManifoldFactor);
+}
+
+/* ======================================================================
+   FUNCTION: One PID driving its copy of the model
+   ====================================================================== */
+// Like driveBoostValveToTargetByPressurePid(), the valve isn't driven into its stops
+void ShadowController::driveModel(ControlNumeric::Pid *pid, const ControlValue *motorSpeed, ControlValue *openPercentage, ControlValue *manifoldKpa) {
+  ControlValue appliedMotorSpeed = 0;
+  if (*openPercentage > 0 && *openPercentage < ControlNumeric::fromInt(100)) {
+    pid->Compute();
+    appliedMotorSpeed = *motorSpeed;
+  }
+  stepModel(openPercentage, manifoldKpa, appliedMotorSpeed);
+}
+
+/* ======================================================================
+   FUNCTION: Line every copy up with the real valve and hand both PIDs the live effort
+   ====================================================================== */
+// The PIDs restart from the live motor speed the same way the live one is preloaded (MANUAL then AUTOMATIC), so the
+// stretch measures how each set of gains carries on from here rather than how it would have got here
+void ShadowController::startStretch(ControlValue manifoldKpa, ControlValue valveOpenPercentage, ControlValue liveMotorSpeed) {
+  replicaOpenPercentage = liveGainsOpenPercentage = candidateOpenPercentage = valveOpenPercentage;
+  replicaManifoldKpa = liveGainsManifoldKpa = candidateManifoldKpa = manifoldKpa;
+  liveGainsMotorSpeed = candidateMotorSpeed = liveMotorSpeed;
+  liveGainsPID.SetMode(MANUAL);
+  liveGainsPID.SetMode(AUTOMATIC);
+  candidatePID.SetMode(MANUAL);
+  candidatePID.SetMode(AUTOMATIC);
+  candidateIae = liveGainsIae = liveIae = modelIae = 0;
+  stretchTicks = 0;
+  stretchActive = true;
+}
+
+/* ======================================================================
+   FUNCTION: One tick of the shadow, returns true on the tick a stretch completes
+   ====================================================================== */
+// Called from BoostChannel::step() after the live PIDs with the live loop's target, readings and motor speed. Off it costs a
+// compare. On it is a fixed handful of multiplies and two PID Compute() calls per tick whatever the model is doing, and
+// the stretch's totals handed over as they are when one completes (see the ShadowController::step benchmark).
+bool ShadowController::step(const ControlInputs *inputs, bool pressureControl, ControlValue controlTargetKpa, ControlValue manifoldKpa,
+                            ControlValue valveOpenPercentage, ControlValue liveMotorSpeed, ShadowStretch *stretch) {
+  const ShadowCandidate *candidate = &inputs->shadowCandidate;
+  if (!candidate->enabled) {
+    stretchActive = false;
+    return false;
+  }
+  if (controlInputChanged(&candidate->tunings, &candidateTunings)) {
+    candidateTunings = candidate->tunings;
+    ControlNumeric::setTunings(&candidatePID, &candidateTunings);
+    stretchActive = false; // Part scored on the old gains
+  }
+  if (controlInputChanged(&inputs->pressureTunings, &liveTunings)) {
+    liveTunings = inputs->pressureTunings;
+    ControlNumeric::setTunings(&liveGainsPID, &liveTunings);
+    stretchActive = false;
+  }
+
+  // Capacity follows whatever the replica gets wrong about the real manifold
+  if (valveOpenPercentage < shadowCapacityLearnMaximumOpen) {
+    capacityKpa += ControlNumeric::multiply(manifoldKpa - replicaManifoldKpa, shadowCapacityLearnFactor);
+    if (capacityKpa < 0) {
+      capacityKpa = 0;
+    }
+  }
+
+  // Between stretches the replica's valve is simply the real one, only the manifold is modelled
+  if (!pressureControl) {
+    stretchActive = false;
+    replicaOpenPercentage = valveOpenPercentage;
+    stepModel(&replicaOpenPercentage, &replicaManifoldKpa, 0);
+    return false;
+  }
+  if (!stretchActive) {
+    startStretch(manifoldKpa, valveOpenPercentage, liveMotorSpeed);
+  }
+
+  targetKpa = controlTargetKpa;
+  ControlValue candidateError = targetKpa - candidateManifoldKpa;
+  ControlValue liveGainsError = targetKpa - liveGainsManifoldKpa;
+  ControlValue liveError = targetKpa - manifoldKpa;
+  ControlValue modelError = manifoldKpa - replicaManifoldKpa;
+  candidateIae += ControlNumeric::multiply((candidateError < 0) ? -candidateError : candidateError, shadowTickSeconds);
+  liveGainsIae += ControlNumeric::multiply((liveGainsError < 0) ? -liveGainsError : liveGainsError, shadowTickSeconds);
+  liveIae += ControlNumeric::multiply((liveError < 0) ? -liveError : liveError, shadowTickSeconds);
+  modelIae += ControlNumeric::multiply((modelError < 0) ? -modelError : modelError, shadowTickSeconds);
+
+  driveModel(&candidatePID, &candidateMotorSpeed, &candidateOpenPercentage, &candidateManifoldKpa);
+  driveModel(&liveGainsPID, &liveGainsMotorSpeed, &liveGainsOpenPercentage, &liveGainsManifoldKpa);
+  bool replicaAtStop = (replicaOpenPercentage <= 0 || replicaOpenPercentage >= ControlNumeric::fromInt(100));
+  stepModel(&replicaOpenPercentage, &replicaManifoldKpa, replicaAtStop ? 0 : liveMotorSpeed);
+
+  if (++stretchTicks < shadowStretchTicks) {
+    return false;
+  }
+  stretchActive = false; // Next tick starts a new one from the real valve
+  completedStretches++;
+  stretch->candidateIae = candidateIae;
+  stretch->liveGainsIae = liveGainsIae;
+  stretch->liveIae = liveIae;
+  stretch->modelIae = modelIae;
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Add a completed stretch to the totals and work out the verdict
+   ====================================================================== */
+// Background only, called when the tick's outputs show a new stretch
+void recordShadowStretch(const ShadowStretch *stretch) {
+  shadowScore.stretches++;
+  shadowScore.candidateIae += ControlNumeric::toDouble(stretch->candidateIae);
+  shadowScore.liveGainsIae += ControlNumeric::toDouble(stretch->liveGainsIae);
+  shadowScore.liveIae += ControlNumeric::toDouble(stretch->liveIae);
+  shadowScore.modelIae += ControlNumeric::toDouble(stretch->modelIae);
+
+  if (shadowScore.stretches < shadowMinimumStretches) {
+    shadowScore.verdict = SHADOW_VERDICT_SCORING;
+  } else if (shadowScore.modelIae > shadowScore.liveIae * shadowMaximumModelErrorRatio) {
+    shadowScore.verdict = SHADOW_VERDICT_MODEL_UNTRUSTED;
+  } else if (shadowScore.candidateIae < shadowScore.liveGainsIae * (1.0 - shadowWinMargin)) {
+    shadowScore.verdict = SHADOW_VERDICT_CANDIDATE_WINS;
+  } else {
+    shadowScore.verdict = SHADOW_VERDICT_CANDIDATE_LOSES;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Totals and verdict so far
+   ====================================================================== */
+void getShadowScore(ShadowScore *score) {
+  *score = shadowScore;
+}
+
+/* ======================================================================
+   FUNCTION: Start scoring again, whenever either set of gains changes
+   ====================================================================== */
+void resetShadowScore() {
+  shadowScore = ShadowScore();
+}
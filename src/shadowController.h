@@ -0,0 +1,100 @@
+#ifndef SHADOWCONTROLLER_H
+#define SHADOWCONTROLLER_H
+
+#include "controlNumeric.h"
+#include <Arduino.h>
+
+struct ControlInputs;
+
+/* ======================================================================
+   STRUCTURES: Candidate pressure PID gains, set from the background
+   ====================================================================== */
+struct ShadowCandidate {
+  bool enabled = false;
+  double pressureKp = 0.0, pressureKi = 0.0, pressureKd = 0.0;
+  ControlNumeric::Tunings tunings = ControlNumeric::Tunings(); // Converted from the gains by convertControlInputs()
+};
+
+/* ======================================================================
+   STRUCTURES: Scores for one stretch of pressure control
+   ====================================================================== */
+// All kPa seconds over the stretch. The candidate and live gains each drive their own copy of the model from the same
+// starting point, so those two are what the candidate is judged on. The live and model figures say how far the model can
+// be trusted.
+struct ShadowStretch {
+  ControlNumeric::Value candidateIae; // Candidate gains driving the model, against target
+  ControlNumeric::Value liveGainsIae; // Live gains driving the model, against target
+  ControlNumeric::Value liveIae;      // Real manifold against target
+  ControlNumeric::Value modelIae;     // Live motor commands driving the model, against the real manifold
+};
+
+/* ======================================================================
+   ENUMS: What the stretches so far say about the candidate
+   ====================================================================== */
+enum ShadowVerdict {
+  SHADOW_VERDICT_SCORING,         // Not enough stretches yet
+  SHADOW_VERDICT_CANDIDATE_WINS,  // Less error than the live gains by the margin
+  SHADOW_VERDICT_CANDIDATE_LOSES, // Keeps scoring, can still turn around
+  SHADOW_VERDICT_MODEL_UNTRUSTED  // Model strays from the real manifold too far for the comparison to mean anything
+};
+
+/* ======================================================================
+   STRUCTURES: Totals kept on the background side
+   ====================================================================== */
+struct ShadowScore {
+  unsigned long stretches = 0;
+  double candidateIae = 0.0, liveGainsIae = 0.0, liveIae = 0.0, modelIae = 0.0;
+  ShadowVerdict verdict = SHADOW_VERDICT_SCORING;
+};
+
+/* ======================================================================
+   CLASS: Candidate pressure PID running against an on-board valve and manifold model
+   ====================================================================== */
+// One per boost channel, stepped from the control tick with the same target the live pressure PID has. Never drives the
+// motor. Like BoostChannel the PIDs point at its own members, so it can't be copied once constructed.
+class ShadowController {
+public:
+  ShadowController();
+  ShadowController(const ShadowController &) = delete;
+  ShadowController &operator=(const ShadowController &) = delete;
+  void begin(double, double, int);
+  bool step(const ControlInputs *, bool, ControlNumeric::Value, ControlNumeric::Value, ControlNumeric::Value, ControlNumeric::Value, ShadowStretch *);
+  unsigned long getCompletedStretches() const { return completedStretches; }
+
+private:
+  typedef ControlNumeric::Value Value;
+
+  void startStretch(Value, Value, Value);
+  void stepModel(Value *, Value *, Value);
+  void driveModel(ControlNumeric::Pid *, const Value *, Value *, Value *);
+
+  // Gains each PID has now, changed only at a tick boundary
+  ControlNumeric::Tunings candidateTunings = ControlNumeric::Tunings();
+  ControlNumeric::Tunings liveTunings = ControlNumeric::Tunings();
+
+  // Model, three copies sharing the capacity learned from the real manifold. The replica follows the live motor commands,
+  // the other two are driven by their own PIDs.
+  Value capacityKpa;
+  Value replicaOpenPercentage = 0, replicaManifoldKpa = 0;
+  Value liveGainsOpenPercentage = 0, liveGainsManifoldKpa = 0, liveGainsMotorSpeed = 0;
+  Value candidateOpenPercentage = 0, candidateManifoldKpa = 0, candidateMotorSpeed = 0;
+  Value targetKpa = 0;
+
+  // Stretch in progress
+  bool stretchActive = false;
+  unsigned int stretchTicks = 0;
+  Value candidateIae = 0, liveGainsIae = 0, liveIae = 0, modelIae = 0;
+  unsigned long completedStretches = 0;
+
+  ControlNumeric::Pid liveGainsPID;
+  ControlNumeric::Pid candidatePID;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void recordShadowStretch(const ShadowStretch *);
+void getShadowScore(ShadowScore *);
+void resetShadowScore();
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SNAPSHOTHANDOFF_H
+#define SNAPSHOTHANDOFF_H
+
+/* ======================================================================
+   HELPER: Compiler barrier so copies are not reordered around the flags
+   ====================================================================== */
+#define SNAPSHOT_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+/* ======================================================================
+   CLASS: Snapshot written by the control interrupt, read in the background
+   ====================================================================== */
+// Sequence lock. The interrupt is the only writer and can never be blocked by the reader, so the background just retries
+// the copy if a control tick landed part way through it.
+template <typename T>
+class SnapshotFromIsr {
+public:
+  void publish(const T &value) {
+    sequence = sequence + 1; // Odd while the write is in progress
+    SNAPSHOT_BARRIER();
+    data = value;
+    SNAPSHOT_BARRIER();
+    sequence = sequence + 1;
+  }
+
+  void read(T *value) const {
+    unsigned char sequenceBefore, sequenceAfter;
+    do {
+      sequenceBefore = sequence;
+      SNAPSHOT_BARRIER();
+      *value = data;
+      SNAPSHOT_BARRIER();
+      sequenceAfter = sequence;
+    } while (sequenceBefore != sequenceAfter || (sequenceBefore & 1));
+  }
+
+private:
+  volatile unsigned char sequence = 0; // One byte so reads and writes are single instructions on the AVR too
+  T data = T();
+};
+
+/* ======================================================================
+   CLASS: Snapshot written in the background, read by the control interrupt
+   ====================================================================== */
+// Double buffer. The background always fills the buffer the interrupt is not looking at and then flips the index, so the
+// interrupt (which can't be preempted by the background) always sees a complete copy without ever waiting.
+template <typename T>
+class SnapshotToIsr {
+public:
+  void publish(const T &value) {
+    unsigned char nextIndex = activeIndex ^ 1;
+    buffers[nextIndex] = value;
+    SNAPSHOT_BARRIER();
+    activeIndex = nextIndex;
+  }
+
+  void read(T *value) const {
+    *value = buffers[activeIndex];
+  }
+
+private:
+  volatile unsigned char activeIndex = 0;
+  T buffers[2] = {T(), T()};
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifdef HAL_NATIVE
+
+#include "boostController.h"
+#include "calculateDesiredBoost.h"
+#include "cytronMotorDriver.h"
+#include "drivingEvents.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "logBuffer.h"
+#include "plantModelNative.h"
+#include "platformTraits.h"
+#include "timeSync.h"
+#include "vehicleStateEstimator.h"
+
+/* ======================================================================
+   VARIABLES: Flags normally owned by main.cpp
+   ====================================================================== */
+bool debugSerialReceive = false;
+bool debugSerialSend = false;
+bool debugValveControl = false;
+bool debugBoost = false;
+bool debugGeneral = false;
+bool debugPid = false;
+bool logOutputBinary = false;
+
+/* ======================================================================
+   STRUCTURES: What the driver is doing at a point in the drive
+   ====================================================================== */
+struct DriveSegment {
+  unsigned long startMillis;
+  int gear;
+  bool clutchPressed;
+  int startRpm;
+  float rpmPerSecond;
+};
+
+struct SpoolUpResult {
+  double toTargetMillis; // Clutch release to the manifold reaching 90% of target, -1 if it never did
+  double overshootKpa;   // Peak over target in the second after reaching it
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+// Two pulls in 3rd, the first one is where the controller learns the effort that holds the target in that gear. The
+// second is the one measured.
+const DriveSegment driveSegments[] = {
+    {0, 3, true, 1500, 0},       // Rolling, clutch in
+    {1000, 3, false, 1500, 800}, // Pull in 3rd
+    {3500, 3, true, 2000, 0},    // Clutch in
+    {4500, 3, false, 2000, 800}, // Measured pull
+};
+const int driveSegmentCount = sizeof(driveSegments) / sizeof(driveSegments[0]);
+const unsigned long measuredReleaseMillis = 4500;
+const unsigned long driveMillis = 7000;
+const unsigned long masterFrameIntervalMillis = 20;
+const unsigned long calculateTargetIntervalMillis = 200; // ptCalculateDesiredBoostKpa
+const unsigned long schedulerPhaseStepMillis = 20;       // Each mode is run with the 200ms task at every one of these offsets
+const double capacityKpaPerRpm = 0.025;
+const double speedKphPerRpm = 1.0 / 45.0;
+const double reachedTargetFraction = 0.9;
+
+/* ======================================================================
+   FUNCTION: Drive one run, with or without driving events, and time the measured pull
+   ====================================================================== */
+SpoolUpResult runSpoolUp(bool drivingEventsEnabled, unsigned long schedulerPhaseMillis) {
+  resetPlant();
+  ControlInputs inputs;
+  ControlOutputs outputs = ControlOutputs();
+  initBoostController(simValveMinimumRaw, simValveMaximumRaw, getPlantAtmosphericRaw(), &inputs);
+  resetMasterInputAges();
+
+  SpoolUpResult result = {-1, 0};
+  double targetKpa = 0;
+  const unsigned long ticksPerMilli = lround(TargetPlatform::controlTickFrequencyHz / 1000.0);
+  for (unsigned long ms = 0; ms < driveMillis; ms++) {
+    const DriveSegment *segment = &driveSegments[0];
+    for (int i = 1; i < driveSegmentCount && driveSegments[i].startMillis <= ms; i++) {
+      segment = &driveSegments[i];
+    }
+    int rpm = segment->startRpm + lround(segment->rpmPerSecond * (ms - segment->startMillis) / 1000.0);
+    float speed = rpm * speedKphPerRpm;
+
+    // Frames from the master, and the background's target calculation on its 200ms schedule or brought forward
+    bool drivingEventPending = false;
+    if (ms % masterFrameIntervalMillis == 0) {
+      recordMasterInputs((1 << MASTER_INPUT_COUNT) - 1, false, 0);
+      updateVehicleStateEstimator(speed, rpm, segment->gear, segment->clutchPressed);
+      VehicleEstimate vehicle;
+      getVehicleEstimate(&vehicle);
+      drivingEventPending = drivingEventsEnabled && detectDrivingEvents(segment->gear, segment->clutchPressed, vehicle.rpmPerSecond) != 0;
+    }
+    if ((ms + calculateTargetIntervalMillis - schedulerPhaseMillis) % calculateTargetIntervalMillis == 0 || drivingEventPending) {
+      if (drivingEventPending) {
+        inputs.prepositionSequence++;
+      }
+      inputs.vehicleGear = segment->gear;
+      inputs.targetBoostKpa = calculateDesiredBoostKpa(speed, rpm, segment->gear, segment->clutchPressed);
+      targetKpa = inputs.targetBoostKpa;
+      convertControlInputs(&inputs);
+    }
+
+    for (unsigned long tick = 0; tick < ticksPerMilli; tick++) {
+      stepPlant(rpm * capacityKpaPerRpm);
+      runBoostController(&inputs, &outputs);
+      halNativeAdvanceMicros(lround(simTickSeconds * 1000000.0));
+    }
+
+    if (ms >= measuredReleaseMillis && targetKpa > 0) {
+      if (result.toTargetMillis < 0 && plant.manifoldGaugeKpa >= targetKpa * reachedTargetFraction) {
+        result.toTargetMillis = ms - measuredReleaseMillis;
+      }
+      if (result.toTargetMillis >= 0 && ms - measuredReleaseMillis <= result.toTargetMillis + 1000) {
+        result.overshootKpa = max(result.overshootKpa, plant.manifoldGaugeKpa - targetKpa);
+      }
+    }
+  }
+  return result;
+}
+
+/* ======================================================================
+   FUNCTION: Run one mode at every scheduler phase and print the spread
+   ====================================================================== */
+void reportSpoolUp(const char *name, bool drivingEventsEnabled) {
+  double total = 0, fastest = 1e9, slowest = 0, overshoot = 0;
+  int runs = 0;
+  for (unsigned long phase = 0; phase < calculateTargetIntervalMillis; phase += schedulerPhaseStepMillis) {
+    SpoolUpResult result = runSpoolUp(drivingEventsEnabled, phase);
+    if (result.toTargetMillis < 0) {
+      printf("%-16s never reached target with the 200ms task at +%lums\n", name, phase);
+      return;
+    }
+    total += result.toTargetMillis;
+    fastest = min(fastest, result.toTargetMillis);
+    slowest = max(slowest, result.toTargetMillis);
+    overshoot = max(overshoot, result.overshootKpa);
+    runs++;
+  }
+  printf("%-16s clutch release to 90%% of target  mean %5.0fms  fastest %5.0fms  slowest %5.0fms  worst overshoot %4.1fkPa\n", name,
+         total / runs, fastest, slowest, overshoot);
+}
+
+/* ======================================================================
+   MAIN: Host entry point for [env:native_spoolup_sim]
+   ====================================================================== */
+// Clutch release to target boost with the target only ever worked out by the 200ms task, against driving events bringing
+// it forward with valve pre-positioning and the pressure PID preload. Same plant model as the overboost simulation.
+int main() {
+  initLogBuffer();
+  initCytronMotorDriver();
+  initPlantModel();
+
+  printf("Spool up after clutch release, %s core at %.0fHz\n", CONTROL_FIXED_POINT ? "fixed point" : "floating point", TargetPlatform::controlTickFrequencyHz);
+  reportSpoolUp("200ms task only", false);
+  reportSpoolUp("driving events", true);
+  return 0;
+}
+
+#endif
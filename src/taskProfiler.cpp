@@ -0,0 +1,176 @@
+#include "taskProfiler.h"
+#include "platformTraits.h"
+
+#if PLATFORM_HAS_NETWORK
+#include "mqttPublish.h"
+#endif
+
+// The AVR has no cycle counter, so there cycles are derived from micros() (4us resolution at 16MHz). The host counts
+// simulated microseconds as cycles.
+#if defined(ARDUINO_ARCH_AVR)
+#define PROFILER_CORE_CLOCK_HZ F_CPU
+#elif defined(HAL_NATIVE)
+#define PROFILER_CORE_CLOCK_HZ 1000000UL
+#else
+#define PROFILER_CORE_CLOCK_HZ SystemCoreClock
+#endif
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+// Each entry has exactly one writer, the context the task runs in. Only the control tick entry is written from the interrupt.
+TaskProfile taskProfiles[PROFILED_TASK_COUNT];
+
+/* ======================================================================
+   FUNCTION: Enable the DWT cycle counter
+   ====================================================================== */
+void initTaskProfiler() {
+#if !defined(ARDUINO_ARCH_AVR) && !defined(HAL_NATIVE)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+  for (int i = 0; i < PROFILED_TASK_COUNT; i++) {
+    taskProfiles[i].name = "unregistered";
+    taskProfiles[i].resetRequested = true;
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Name a task and set its deadline (its scheduler period)
+   ====================================================================== */
+void registerProfiledTask(ProfiledTask task, const char *name, unsigned long periodUs) {
+  taskProfiles[task].name = name;
+  taskProfiles[task].periodCycles = periodUs * (PROFILER_CORE_CLOCK_HZ / 1000000);
+}
+
+/* ======================================================================
+   FUNCTION: Read the cycle counter (wraps every ~89s at 48MHz, deltas are still fine)
+   ====================================================================== */
+unsigned long profilerGetCycles() {
+#if defined(ARDUINO_ARCH_AVR)
+  return micros() * (F_CPU / 1000000);
+#elif defined(HAL_NATIVE)
+  return micros();
+#else
+  return DWT->CYCCNT;
+#endif
+}
+
+float profilerCyclesToMicros(unsigned long cycles) {
+  return static_cast<float>(cycles) / (PROFILER_CORE_CLOCK_HZ / 1000000);
+}
+
+/* ======================================================================
+   FUNCTION: Record one execution of a task
+   ====================================================================== */
+void profilerRecord(ProfiledTask task, unsigned long startCycles) {
+  unsigned long elapsedCycles = profilerGetCycles() - startCycles;
+  TaskProfile *profile = &taskProfiles[task];
+
+  if (profile->resetRequested) {
+    profile->calls = 0;
+    profile->minCycles = 0xFFFFFFFF;
+    profile->maxCycles = 0;
+    profile->totalCycles = 0;
+    profile->overruns = 0;
+    memset(profile->histogram, 0, sizeof(profile->histogram));
+    profile->resetRequested = false;
+  }
+
+  profile->calls++;
+  profile->totalCycles += elapsedCycles;
+  if (elapsedCycles < profile->minCycles) {
+    profile->minCycles = elapsedCycles;
+  }
+  if (elapsedCycles > profile->maxCycles) {
+    profile->maxCycles = elapsedCycles;
+  }
+  if (profile->periodCycles != 0 && elapsedCycles > profile->periodCycles) {
+    profile->overruns++;
+  }
+
+  // Log2 bucket of the cycle count, offset so the first bucket catches anything trivially short. unsigned long is 64 bits
+  // on the host builds, so the width comes from the type rather than assuming 32.
+  int bucket = 0;
+  if (elapsedCycles != 0) {
+    bucket = (static_cast<int>(sizeof(elapsedCycles) * 8) - 1 - __builtin_clzl(elapsedCycles)) - (profilerHistogramFirstBucketShift - 1);
+  }
+  profile->histogram[constrain(bucket, 0, profilerHistogramBuckets - 1)]++;
+}
+
+/* ======================================================================
+   FUNCTION: Get a consistent copy of a task profile
+   ====================================================================== */
+void getTaskProfile(ProfiledTask task, TaskProfile *profile) {
+  // The control tick entry is written from the interrupt, so keep it out for the (short) copy
+  noInterrupts();
+  *profile = taskProfiles[task];
+  interrupts();
+}
+
+/* ======================================================================
+   FUNCTION: Output task profiles over serial
+   ====================================================================== */
+void reportTaskProfiles() {
+  Serial.println("\nTask profiles (us): calls, min, mean, max, overruns, histogram (log2 buckets from 128 cycles)");
+  for (int i = 0; i < PROFILED_TASK_COUNT; i++) {
+    TaskProfile profile;
+    getTaskProfile(static_cast<ProfiledTask>(i), &profile);
+    if (profile.calls == 0) {
+      continue;
+    }
+
+    Serial.print("  ");
+    Serial.print(profile.name);
+    Serial.print(": ");
+    Serial.print(profile.calls);
+    Serial.print(", ");
+    Serial.print(profilerCyclesToMicros(profile.minCycles));
+    Serial.print(", ");
+    Serial.print(profilerCyclesToMicros(profile.totalCycles / profile.calls));
+    Serial.print(", ");
+    Serial.print(profilerCyclesToMicros(profile.maxCycles));
+    Serial.print(", ");
+    Serial.print(profile.overruns);
+    Serial.print(", [");
+    for (int bucket = 0; bucket < profilerHistogramBuckets; bucket++) {
+      if (bucket > 0) {
+        Serial.print(" ");
+      }
+      Serial.print(profile.histogram[bucket]);
+    }
+    Serial.println("]");
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Start a new profiling interval for every task
+   ====================================================================== */
+void resetTaskProfiles() {
+  for (int i = 0; i < PROFILED_TASK_COUNT; i++) {
+    taskProfiles[i].resetRequested = true;
+  }
+}
+
+#if PLATFORM_HAS_NETWORK
+/* ======================================================================
+   FUNCTION: Publish task profiles via MQTT (one topic per task)
+   ====================================================================== */
+void publishTaskProfiles() {
+  for (int i = 0; i < PROFILED_TASK_COUNT; i++) {
+    TaskProfile profile;
+    getTaskProfile(static_cast<ProfiledTask>(i), &profile);
+    if (profile.calls == 0) {
+      continue;
+    }
+
+    char topic[40];
+    snprintf(topic, sizeof(topic), "%s/%s", profilerMetricSchema.topic, profile.name);
+    float values[] = {static_cast<float>(profile.calls), profilerCyclesToMicros(profile.minCycles), profilerCyclesToMicros(profile.totalCycles / profile.calls),
+                      profilerCyclesToMicros(profile.maxCycles), static_cast<float>(profile.overruns)};
+    publishMqttMetrics(topic, profilerMetricSchema, values);
+  }
+}
+#endif
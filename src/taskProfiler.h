@@ -0,0 +1,83 @@
+#ifndef TASKPROFILER_H
+#define TASKPROFILER_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   ENUMS: Tasks we profile (one per ptScheduler task in loop, plus the control tick)
+   ====================================================================== */
+enum ProfiledTask {
+  PROFILED_CONTROL_TICK,
+  PROFILED_LOOP,
+  PROFILED_SERIAL_CALCULATE_STATS,
+  PROFILED_SERIAL_REPORT_STATS,
+  PROFILED_SERIAL_READ_AND_PROCESS,
+  PROFILED_CHECK_FAULT_CONDITIONS,
+  PROFILED_CALCULATE_DESIRED_BOOST,
+  PROFILED_PLOTTER_OUTPUT,
+  PROFILED_BOOST_DEBUG_OUTPUT,
+  PROFILED_PID_POTS,
+  PROFILED_MQTT_PUBLISH_100MS,
+  PROFILED_MQTT_PUBLISH_1S,
+  PROFILED_CONTROL_TICK_REPORT,
+  PROFILED_LOG_OUTPUT,
+  PROFILED_BLACKBOX_DUMP,
+  PROFILED_MQTT_SERIALIZE,
+  PROFILED_WIFI_SERVICE,
+  PROFILED_MQTT_SERVICE,
+  PROFILED_TELEMETRY_BATCH,
+  PROFILED_REPLAY_RECORDING,
+  PROFILED_ATMOSPHERIC_BASELINE,
+  PROFILED_TASK_COUNT
+};
+
+/* ======================================================================
+   STRUCTURES: Per task execution profile
+   ====================================================================== */
+// Fewer buckets on the Mega to save RAM, micros() based counts there are multiples of 64 cycles anyway
+#ifndef PROFILER_HISTOGRAM_BUCKETS
+#define PROFILER_HISTOGRAM_BUCKETS 16
+#endif
+
+const int profilerHistogramBuckets = PROFILER_HISTOGRAM_BUCKETS;
+const int profilerHistogramFirstBucketShift = 7; // Bucket 0 is < 128 cycles, each bucket after that doubles
+
+struct TaskProfile {
+  const char *name;
+  unsigned long periodCycles;     // Deadline, the task overran if it ran for longer than this
+  unsigned long calls;
+  unsigned long minCycles;
+  unsigned long maxCycles;
+  unsigned long long totalCycles; // For the mean
+  unsigned long overruns;
+  unsigned long histogram[profilerHistogramBuckets];
+  volatile bool resetRequested;   // Set by the reporter, actioned by whichever context owns the task
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void initTaskProfiler();
+void registerProfiledTask(ProfiledTask, const char *, unsigned long);
+unsigned long profilerGetCycles();
+void profilerRecord(ProfiledTask, unsigned long);
+void getTaskProfile(ProfiledTask, TaskProfile *);
+float profilerCyclesToMicros(unsigned long);
+void reportTaskProfiles();
+void resetTaskProfiles();
+void publishTaskProfiles();
+
+/* ======================================================================
+   CLASS: Scope guard that profiles everything up to the end of the block
+   ====================================================================== */
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfiledTask task) : task(task), startCycles(profilerGetCycles()) {}
+  ~ProfileScope() { profilerRecord(task, startCycles); }
+
+private:
+  ProfiledTask task;
+  unsigned long startCycles;
+};
+
+#endif
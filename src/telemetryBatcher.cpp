@@ -0,0 +1,133 @@
+#include "telemetryBatcher.h"
+#include "hal.h"
+#include "mqttPublish.h"
+#include "varintEncoding.h"
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int telemetrySampleEveryTicks = 2; // Every other 1kHz control tick, 500Hz
+const unsigned int telemetrySamplePeriodUs = 2000;
+const byte telemetryBatchFormatVersion = 1;
+const char *telemetryBatchTopic = "telemetry/batch";
+
+// Worst case is a 3 byte varint for every value, plus the header
+const int telemetryEncodedMaxLength = 16 + (TELEMETRY_CHANNEL_COUNT * TELEMETRY_BATCH_SAMPLES * 3);
+
+// Two batches. The control tick fills one while the background encodes and sends the other, and the tick never writes to
+// a batch that is waiting to be sent.
+int16_t telemetryBatches[2][TELEMETRY_CHANNEL_COUNT][TELEMETRY_BATCH_SAMPLES];
+unsigned long telemetryBatchStartMicros[2];
+uint16_t telemetryBatchSequenceNumbers[2];
+uint16_t telemetryBatchesCompleted = 0; // Includes dropped batches, so the decoder sees the gap
+int telemetryFillIndex = 0;
+int telemetrySampleCount = 0;
+int telemetryTickCount = 0;
+
+volatile bool telemetryBatchPending = false;
+volatile int telemetryPendingIndex = 0;
+volatile unsigned long telemetryBatchesDropped = 0;
+
+unsigned long telemetryBatchesPublished = 0;
+unsigned long telemetryBatchesUnsent = 0;
+unsigned long telemetryBytesPublished = 0;
+byte telemetryEncoded[telemetryEncodedMaxLength];
+
+/* ======================================================================
+   FUNCTION: Record a sample, called from the control tick every tick
+   ====================================================================== */
+void telemetryRecordSample(const BlackboxSample *sample) {
+  if (++telemetryTickCount < telemetrySampleEveryTicks) {
+    return;
+  }
+  telemetryTickCount = 0;
+
+  if (telemetrySampleCount == 0) {
+    telemetryBatchStartMicros[telemetryFillIndex] = halMicros();
+  }
+
+  int16_t(*batch)[TELEMETRY_BATCH_SAMPLES] = telemetryBatches[telemetryFillIndex];
+  batch[TELEMETRY_TARGET_KPA][telemetrySampleCount] = constrain((sample->targetKpaQ8 * 10 + 128) >> 8, -32768L, 32767L);
+  batch[TELEMETRY_ACTUAL_KPA][telemetrySampleCount] = constrain((sample->actualKpaQ8 * 10 + 128) >> 8, -32768L, 32767L);
+  batch[TELEMETRY_VALVE_OPEN][telemetrySampleCount] = constrain((sample->valveOpenPercentageQ8 * 10 + 128) >> 8, -32768L, 32767L);
+  batch[TELEMETRY_MOTOR_COMMAND][telemetrySampleCount] = constrain((sample->motorCommandQ8 + 128) >> 8, -32768L, 32767L);
+
+  if (++telemetrySampleCount < TELEMETRY_BATCH_SAMPLES) {
+    return;
+  }
+  telemetrySampleCount = 0;
+  telemetryBatchSequenceNumbers[telemetryFillIndex] = telemetryBatchesCompleted++;
+
+  // Previous batch still not sent (MQTT down or the loop stalled), overwrite this one rather than the one being sent
+  if (telemetryBatchPending) {
+    telemetryBatchesDropped = telemetryBatchesDropped + 1;
+    return;
+  }
+  telemetryPendingIndex = telemetryFillIndex;
+  telemetryFillIndex ^= 1;
+  telemetryBatchPending = true;
+}
+
+/* ======================================================================
+   FUNCTION: Delta and varint encode a batch (layout is decoded by tools/telemetryDecode.py)
+   ====================================================================== */
+// Header:   version, sequence (varint), start micros (4 bytes little endian), sample period us (varint), channels, samples
+// Channels: one after the other, the first value then the difference to each following value, all zigzag varints.
+// Channel major order keeps slow moving channels (target, valve) down to a byte per sample.
+int encodeTelemetryBatch(const int16_t (*batch)[TELEMETRY_BATCH_SAMPLES], unsigned int sequence, unsigned long startMicros, byte *buffer, int bufferSize) {
+  if (bufferSize < telemetryEncodedMaxLength) {
+    return 0;
+  }
+
+  int length = 0;
+  buffer[length++] = telemetryBatchFormatVersion;
+  length = appendVarint(buffer, length, sequence);
+  for (int shift = 0; shift < 32; shift += 8) {
+    buffer[length++] = static_cast<byte>(startMicros >> shift);
+  }
+  length = appendVarint(buffer, length, telemetrySamplePeriodUs);
+  buffer[length++] = TELEMETRY_CHANNEL_COUNT;
+  buffer[length++] = TELEMETRY_BATCH_SAMPLES;
+
+  for (int channel = 0; channel < TELEMETRY_CHANNEL_COUNT; channel++) {
+    long previous = 0;
+    for (int sample = 0; sample < TELEMETRY_BATCH_SAMPLES; sample++) {
+      length = appendVarint(buffer, length, zigzagEncode(batch[channel][sample] - previous));
+      previous = batch[channel][sample];
+    }
+  }
+  return length;
+}
+
+/* ======================================================================
+   FUNCTION: Encode and publish any completed batch, call from loop()
+   ====================================================================== */
+void serviceTelemetryBatches(bool mqttConnected) {
+  if (!telemetryBatchPending) {
+    return;
+  }
+
+  // Batches completed while WiFi or MQTT is down are discarded, the sequence gap shows where
+  int index = telemetryPendingIndex;
+  int length = 0;
+  if (mqttConnected) {
+    length = encodeTelemetryBatch(telemetryBatches[index], telemetryBatchSequenceNumbers[index], telemetryBatchStartMicros[index], telemetryEncoded, telemetryEncodedMaxLength);
+  }
+  if (length > 0 && publishMqttBinary(telemetryBatchTopic, telemetryEncoded, length)) {
+    telemetryBatchesPublished++;
+    telemetryBytesPublished += length;
+  } else {
+    telemetryBatchesUnsent++;
+  }
+  telemetryBatchPending = false;
+}
+
+/* ======================================================================
+   FUNCTION: Batcher counters
+   ====================================================================== */
+void getTelemetryBatchStats(TelemetryBatchStats *stats) {
+  stats->batchesPublished = telemetryBatchesPublished;
+  stats->batchesDropped = telemetryBatchesDropped;
+  stats->batchesUnsent = telemetryBatchesUnsent;
+  stats->bytesPublished = telemetryBytesPublished;
+}
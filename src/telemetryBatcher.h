@@ -0,0 +1,44 @@
+#ifndef TELEMETRYBATCHER_H
+#define TELEMETRYBATCHER_H
+
+#include "blackboxRecorder.h"
+#include <Arduino.h>
+
+/* ======================================================================
+   DEFINES: Batch size
+   ====================================================================== */
+#ifndef TELEMETRY_BATCH_SAMPLES
+#define TELEMETRY_BATCH_SAMPLES 50 // 100ms at 500Hz, one MQTT message per batch
+#endif
+
+/* ======================================================================
+   ENUMS: Channels carried in each batch, in encoded order
+   ====================================================================== */
+// Only ever add channels to the end, tools/telemetryDecode.py reads them in this order
+enum TelemetryChannel {
+  TELEMETRY_TARGET_KPA,    // 0.1kPa steps
+  TELEMETRY_ACTUAL_KPA,    // 0.1kPa steps
+  TELEMETRY_VALVE_OPEN,    // 0.1% steps
+  TELEMETRY_MOTOR_COMMAND, // Whole %
+  TELEMETRY_CHANNEL_COUNT
+};
+
+/* ======================================================================
+   STRUCTURES: Batcher counters since boot
+   ====================================================================== */
+struct TelemetryBatchStats {
+  unsigned long batchesPublished;
+  unsigned long batchesDropped; // Filled before the previous batch had been sent
+  unsigned long batchesUnsent;  // Not connected or the publish failed
+  unsigned long bytesPublished;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void telemetryRecordSample(const BlackboxSample *);
+int encodeTelemetryBatch(const int16_t (*)[TELEMETRY_BATCH_SAMPLES], unsigned int, unsigned long, byte *, int);
+void serviceTelemetryBatches(bool);
+void getTelemetryBatchStats(TelemetryBatchStats *);
+
+#endif
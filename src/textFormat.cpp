@@ -0,0 +1,49 @@
+#include "textFormat.h"
+
+/* ======================================================================
+   FUNCTION: Append text to a buffer, never overrunning it
+   ====================================================================== */
+int appendText(char *buffer, int bufferSize, int length, const char *text) {
+  while (*text != '\0' && length < bufferSize - 1) {
+    buffer[length++] = *text++;
+  }
+  buffer[length] = '\0';
+  return length;
+}
+
+/* ======================================================================
+   FUNCTION: Append a number with fixed decimal places (integer maths only, no String(double))
+   ====================================================================== */
+int appendFixedPoint(char *buffer, int bufferSize, int length, float value, byte precision) {
+  static const long scales[] = {1, 10, 100, 1000, 10000};
+  precision = min(precision, static_cast<byte>(4));
+
+  // JSON has no NaN or infinity, and anything that would overflow the scaled long isn't a sane metric
+  float scaledValue = value * scales[precision];
+  if (isnan(scaledValue) || scaledValue > 2.0e9f || scaledValue < -2.0e9f) {
+    return appendText(buffer, bufferSize, length, "null");
+  }
+
+  long scaled = lroundf(scaledValue);
+  unsigned long magnitude = (scaled < 0) ? -scaled : scaled;
+
+  // Digits come out least significant first, with enough leading zeros for "0.05" style values
+  char digits[12];
+  int digitCount = 0;
+  do {
+    digits[digitCount++] = '0' + (magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0 || digitCount <= precision);
+
+  if (scaled < 0 && length < bufferSize - 1) {
+    buffer[length++] = '-';
+  }
+  for (int i = digitCount - 1; i >= 0 && length < bufferSize - 1; i--) {
+    buffer[length++] = digits[i];
+    if (i == precision && precision > 0 && length < bufferSize - 1) {
+      buffer[length++] = '.';
+    }
+  }
+  buffer[length] = '\0';
+  return length;
+}
@@ -0,0 +1,13 @@
+#ifndef TEXTFORMAT_H
+#define TEXTFORMAT_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+// Both take the buffer, its size and the current length, and return the new length. Output is always null terminated.
+int appendText(char *, int, int, const char *);
+int appendFixedPoint(char *, int, int, float, byte);
+
+#endif
@@ -0,0 +1,221 @@
+#include "timeSync.h"
+#include "globalHelpers.h"
+#include "hal.h"
+
+/* ======================================================================
+   STRUCTURES: One request / reply exchange with the master
+   ====================================================================== */
+struct TimeSyncSample {
+  unsigned long localMillis;     // Our clock half way through the exchange
+  long offsetMillis;             // Master clock minus our clock
+  unsigned long roundTripMillis; // Time on the wire and in the two serial polls, less the master's turnaround
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int timeSyncWindowSamples = 8;                      // Exchanges kept for the offset and drift estimate
+const int timeSyncSamplesForSlowRate = 4;                 // Exchange once a second until we have this many
+const unsigned long timeSyncFastIntervalMillis = 1000;    // Interval until the window has a few samples
+const unsigned long timeSyncSlowIntervalMillis = 10000;   // Interval once the estimate has settled
+const unsigned long timeSyncMaxRoundTripMillis = 100;     // Slower than this and the reply has been sat in a buffer somewhere
+const unsigned long timeSyncRoundTripToleranceMillis = 4; // Samples this close to the best round trip are used for drift
+const unsigned long timeSyncMinDriftSpanMillis = 20000;   // Drift isn't worked out over less time than this
+const long timeSyncMaxStepMillis = 500;                   // Offset moving more than this means the master has restarted
+const float timeSyncMaxDrift = 0.001;                     // 1000ppm, far more than any crystal or resonator
+
+TimeSyncSample timeSyncSamples[timeSyncWindowSamples];
+int timeSyncSampleCount = 0;
+int timeSyncNextSample = 0;
+
+bool timeSyncRequestPending = false;
+unsigned long timeSyncPendingRequestMillis = 0;
+unsigned long timeSyncLastRequestMillis = 0;
+
+// The estimate, offset at anchorLocalMillis plus drift per ms since then
+bool timeSyncSynchronised = false;
+unsigned long timeSyncAnchorLocalMillis = 0;
+long timeSyncAnchorOffsetMillis = 0;
+unsigned long timeSyncAnchorRoundTripMillis = 0;
+float timeSyncDrift = 0.0;
+
+unsigned long masterInputLocalMillis[MASTER_INPUT_COUNT];
+
+/* ======================================================================
+   FUNCTION: Is it time to send the master another sync request
+   ====================================================================== */
+bool isTimeSyncRequestDue() {
+  unsigned long interval = (timeSyncSampleCount < timeSyncSamplesForSlowRate) ? timeSyncFastIntervalMillis : timeSyncSlowIntervalMillis;
+  return halMillis() - timeSyncLastRequestMillis >= interval;
+}
+
+/* ======================================================================
+   FUNCTION: Note a request going out, returns the timestamp to send
+   ====================================================================== */
+// Only the latest request is outstanding. A late reply to an older one is rejected by its echoed timestamp.
+unsigned long startTimeSyncRequest() {
+  timeSyncPendingRequestMillis = halMillis();
+  timeSyncLastRequestMillis = timeSyncPendingRequestMillis;
+  timeSyncRequestPending = true;
+  return timeSyncPendingRequestMillis;
+}
+
+/* ======================================================================
+   FUNCTION: Offset predicted by the current estimate at a local time
+   ====================================================================== */
+long predictedOffsetMillis(unsigned long localMillis) {
+  long sinceAnchor = static_cast<long>(localMillis - timeSyncAnchorLocalMillis);
+  return timeSyncAnchorOffsetMillis + lroundf(timeSyncDrift * sinceAnchor);
+}
+
+/* ======================================================================
+   FUNCTION: Work out the offset and drift from the sample window
+   ====================================================================== */
+// The exchange with the shortest round trip has the least room for asymmetric delay, so the offset is anchored to it. Drift
+// is a least squares fit of offset against time over the samples with a similar round trip, once they span long enough.
+void updateTimeSyncEstimate() {
+  int best = 0;
+  for (int i = 1; i < timeSyncSampleCount; i++) {
+    if (timeSyncSamples[i].roundTripMillis < timeSyncSamples[best].roundTripMillis) {
+      best = i;
+    }
+  }
+  timeSyncAnchorLocalMillis = timeSyncSamples[best].localMillis;
+  timeSyncAnchorOffsetMillis = timeSyncSamples[best].offsetMillis;
+  timeSyncAnchorRoundTripMillis = timeSyncSamples[best].roundTripMillis;
+
+  float sumTime = 0, sumOffset = 0, sumTimeTime = 0, sumTimeOffset = 0;
+  long earliest = 0, latest = 0;
+  int used = 0;
+  for (int i = 0; i < timeSyncSampleCount; i++) {
+    if (timeSyncSamples[i].roundTripMillis > timeSyncAnchorRoundTripMillis + timeSyncRoundTripToleranceMillis) {
+      continue;
+    }
+    // Relative to the anchor so the sums stay small enough for a float
+    long time = static_cast<long>(timeSyncSamples[i].localMillis - timeSyncAnchorLocalMillis);
+    long offset = timeSyncSamples[i].offsetMillis - timeSyncAnchorOffsetMillis;
+    sumTime += time;
+    sumOffset += offset;
+    sumTimeTime += static_cast<float>(time) * time;
+    sumTimeOffset += static_cast<float>(time) * offset;
+    earliest = min(earliest, time);
+    latest = max(latest, time);
+    used++;
+  }
+
+  float denominator = used * sumTimeTime - sumTime * sumTime;
+  if (used >= 3 && static_cast<unsigned long>(latest - earliest) >= timeSyncMinDriftSpanMillis && denominator > 0) {
+    timeSyncDrift = constrain((used * sumTimeOffset - sumTime * sumOffset) / denominator, -timeSyncMaxDrift, timeSyncMaxDrift);
+  }
+  timeSyncSynchronised = true;
+}
+
+/* ======================================================================
+   FUNCTION: Take the master's reply to a sync request (command ID 4)
+   ====================================================================== */
+// requestMillis and replyReceivedMillis are our clock, masterReceivedMillis and masterSentMillis the master's. Returns
+// false if the reply doesn't match the outstanding request or took too long to be worth using.
+bool addTimeSyncSample(unsigned long requestMillis, unsigned long masterReceivedMillis, unsigned long masterSentMillis, unsigned long replyReceivedMillis) {
+  if (!timeSyncRequestPending || requestMillis != timeSyncPendingRequestMillis) {
+    return false;
+  }
+  timeSyncRequestPending = false;
+
+  long masterTurnaround = static_cast<long>(masterSentMillis - masterReceivedMillis);
+  long roundTrip = static_cast<long>(replyReceivedMillis - requestMillis) - masterTurnaround;
+  if (roundTrip < 0 || roundTrip > static_cast<long>(timeSyncMaxRoundTripMillis)) {
+    return false;
+  }
+
+  TimeSyncSample sample;
+  sample.localMillis = requestMillis + (replyReceivedMillis - requestMillis) / 2;
+  sample.offsetMillis = (static_cast<long>(masterReceivedMillis - requestMillis) + static_cast<long>(masterSentMillis - replyReceivedMillis)) / 2;
+  sample.roundTripMillis = roundTrip;
+
+  // A big step means the master has restarted (or we have), everything in the window is about a clock that's gone
+  long step = sample.offsetMillis - predictedOffsetMillis(sample.localMillis);
+  if (timeSyncSynchronised && abs(step) > timeSyncMaxStepMillis) {
+    DEBUG_SERIAL_RECEIVE(LOG_SERIAL_TIME_SYNC_RESTARTED, step);
+    timeSyncSampleCount = 0;
+    timeSyncNextSample = 0;
+    timeSyncDrift = 0.0;
+  }
+
+  timeSyncSamples[timeSyncNextSample] = sample;
+  timeSyncNextSample = (timeSyncNextSample + 1) % timeSyncWindowSamples;
+  if (timeSyncSampleCount < timeSyncWindowSamples) {
+    timeSyncSampleCount++;
+  }
+  updateTimeSyncEstimate();
+  DEBUG_SERIAL_RECEIVE(LOG_SERIAL_TIME_SYNC_SAMPLE, sample.offsetMillis, sample.roundTripMillis, timeSyncDrift * 1000000.0);
+  return true;
+}
+
+/* ======================================================================
+   FUNCTION: Convert between the master's clock and ours
+   ====================================================================== */
+unsigned long masterToLocalMillis(unsigned long masterMillis) {
+  // The offset is predicted at the master time less the anchor offset, which is out from our time by well under a ms
+  return masterMillis - predictedOffsetMillis(masterMillis - timeSyncAnchorOffsetMillis);
+}
+
+unsigned long localToMasterMillis(unsigned long localMillis) {
+  return localMillis + predictedOffsetMillis(localMillis);
+}
+
+/* ======================================================================
+   FUNCTION: Current sync state for reporting
+   ====================================================================== */
+void getTimeSyncStatus(TimeSyncStatus *status) {
+  status->synchronised = timeSyncSynchronised;
+  status->offsetMillis = predictedOffsetMillis(halMillis());
+  status->driftPpm = timeSyncDrift * 1000000.0;
+  status->roundTripMillis = timeSyncAnchorRoundTripMillis;
+  status->samples = timeSyncSampleCount;
+}
+
+/* ======================================================================
+   FUNCTION: Note when the inputs in a command ID 1 were valid
+   ====================================================================== */
+// presentMask has bit n set for each MasterInput the frame carried. With a master timestamp and a synchronised clock the
+// inputs are aged from when the master sampled them, otherwise from when we processed the frame.
+void recordMasterInputs(byte presentMask, bool hasMasterTimestamp, unsigned long masterMillis) {
+  unsigned long now = halMillis();
+  unsigned long validFromMillis = now;
+  if (hasMasterTimestamp && timeSyncSynchronised) {
+    unsigned long sampledMillis = masterToLocalMillis(masterMillis);
+    if (static_cast<long>(now - sampledMillis) > 0) { // Never in the future, whatever the estimate says
+      validFromMillis = sampledMillis;
+    }
+  }
+
+  for (int input = 0; input < MASTER_INPUT_COUNT; input++) {
+    if (presentMask & (1 << input)) {
+      masterInputLocalMillis[input] = validFromMillis;
+    }
+  }
+}
+
+/* ======================================================================
+   FUNCTION: Start every input's age from now (power on, or a replay starting)
+   ====================================================================== */
+void resetMasterInputAges() {
+  for (int input = 0; input < MASTER_INPUT_COUNT; input++) {
+    masterInputLocalMillis[input] = halMillis();
+  }
+}
+
+/* ======================================================================
+   FUNCTION: How old a master supplied input is
+   ====================================================================== */
+unsigned long getMasterInputAgeMillis(MasterInput input) {
+  return halMillis() - masterInputLocalMillis[input];
+}
+
+unsigned long getOldestMasterInputAgeMillis() {
+  unsigned long oldest = 0;
+  for (int input = 0; input < MASTER_INPUT_COUNT; input++) {
+    oldest = max(oldest, getMasterInputAgeMillis(static_cast<MasterInput>(input)));
+  }
+  return oldest;
+}
@@ -0,0 +1,42 @@
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   ENUMS: Inputs supplied by the master in command ID 1
+   ====================================================================== */
+enum MasterInput {
+  MASTER_INPUT_SPEED,
+  MASTER_INPUT_RPM,
+  MASTER_INPUT_GEAR,
+  MASTER_INPUT_CLUTCH,
+  MASTER_INPUT_COUNT
+};
+
+/* ======================================================================
+   STRUCTURES: Clock synchronisation state
+   ====================================================================== */
+struct TimeSyncStatus {
+  bool synchronised;             // At least one good exchange since boot (or since the master clock last jumped)
+  long offsetMillis;             // Master clock minus our clock, now
+  float driftPpm;                // How fast the offset is changing, positive when the master clock runs fast
+  unsigned long roundTripMillis; // Round trip of the exchange the offset is anchored to
+  int samples;                   // Exchanges in the estimation window
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+bool isTimeSyncRequestDue();
+unsigned long startTimeSyncRequest();
+bool addTimeSyncSample(unsigned long, unsigned long, unsigned long, unsigned long);
+unsigned long masterToLocalMillis(unsigned long);
+unsigned long localToMasterMillis(unsigned long);
+void getTimeSyncStatus(TimeSyncStatus *);
+void recordMasterInputs(byte, bool, unsigned long);
+void resetMasterInputAges();
+unsigned long getMasterInputAgeMillis(MasterInput);
+unsigned long getOldestMasterInputAgeMillis();
+
+#endif
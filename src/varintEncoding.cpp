@@ -0,0 +1,39 @@
+#include "varintEncoding.h"
+
+/* ======================================================================
+   FUNCTION: Append an unsigned LEB128 varint
+   ====================================================================== */
+int appendVarint(byte *buffer, int length, unsigned long value) {
+  while (value >= 0x80) {
+    buffer[length++] = static_cast<byte>(value | 0x80);
+    value >>= 7;
+  }
+  buffer[length++] = static_cast<byte>(value);
+  return length;
+}
+
+/* ======================================================================
+   FUNCTION: Read an unsigned LEB128 varint, false if it runs off the end
+   ====================================================================== */
+bool readVarint(const byte *buffer, int length, int *position, unsigned long *value) {
+  *value = 0;
+  for (int shift = 0; *position < length && shift < 32; shift += 7) {
+    byte next = buffer[(*position)++];
+    *value |= static_cast<unsigned long>(next & 0x7F) << shift;
+    if (next < 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* ======================================================================
+   FUNCTION: Zigzag map a signed value so small negatives stay small
+   ====================================================================== */
+unsigned long zigzagEncode(long value) {
+  return (static_cast<unsigned long>(value) << 1) ^ static_cast<unsigned long>(value >> 31);
+}
+
+long zigzagDecode(unsigned long value) {
+  return static_cast<long>(value >> 1) ^ -static_cast<long>(value & 1);
+}
@@ -0,0 +1,15 @@
+#ifndef VARINTENCODING_H
+#define VARINTENCODING_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+// Unsigned LEB128 varints, with zigzag mapping for signed values so small negatives stay small
+int appendVarint(byte *, int, unsigned long);
+bool readVarint(const byte *, int, int *, unsigned long *);
+unsigned long zigzagEncode(long);
+long zigzagDecode(unsigned long);
+
+#endif
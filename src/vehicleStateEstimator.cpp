@@ -0,0 +1,193 @@
+#include "vehicleStateEstimator.h"
+#include "globalHelpers.h"
+#include "hal.h"
+#include "timeSync.h"
+
+/* ======================================================================
+   STRUCTURES: Speed and RPM from one command ID 1 frame
+   ====================================================================== */
+struct VehicleSample {
+  unsigned long localMillis; // When the master sampled them, on our clock (see timeSync.cpp)
+  float speed;
+  int rpm;
+};
+
+/* ======================================================================
+   VARIABLES: General use / functional
+   ====================================================================== */
+const int vehicleWindowSamples = 6;                     // Frames kept for the trends
+const unsigned long vehicleTrendWindowMillis = 300;     // Only frames this close to the latest are fitted
+const unsigned long vehicleMinTrendSpanMillis = 40;     // Less than this and the trend is left at 0
+const unsigned long vehicleExtrapolateAfterMillis = 60; // A frame younger than this is used as it is
+const unsigned long vehicleMaxExtrapolateMillis = 500;  // Trends are followed this far past the last frame then held
+const float vehicleMaxRpmPerSecond = 10000.0;           // Beyond anything the engine can do, the trend is noise
+const float vehicleMaxSpeedPerSecond = 40.0;            // km/h per second, a bit over 1g
+const int vehicleMaxRpm = 8000;
+const int vehicleGearCount = 6;
+
+// Learning the RPM / speed ratio of each gear, only while the clutch is out and the car is properly moving
+const float gearLearnMinSpeed = 15.0;
+const int gearLearnMinRpm = 1200;
+const float gearLearnRate = 0.05;             // Smoothing of each new ratio into the table
+const int gearLearnSamplesToTrust = 20;       // Frames in a gear before its ratio is used for inference
+const int gearLearnMaxSamples = 1000;         // Count stops here, it only needs to pass the trust threshold
+const float gearMatchTolerance = 0.06;        // Ratio within 6% of a learned one is that gear, gears are 15%+ apart
+const float gearLearnRejectTolerance = 0.2;   // Further out than this from a trusted ratio (wheelspin, clutch slip) isn't learned
+const unsigned long gearMismatchMillis = 500; // Disagreement has to last this long to be flagged, a gear change doesn't
+
+VehicleSample vehicleSamples[vehicleWindowSamples];
+int vehicleSampleCount = 0;
+int vehicleNextSample = 0;
+int vehicleMasterGear = 0;
+bool vehicleClutchPressed = true;
+float vehicleRpmPerSecond = 0.0;
+float vehicleSpeedPerSecond = 0.0;
+
+float learnedRpmPerKph[vehicleGearCount + 1]; // Indexed by gear, neutral unused
+int learnedRatioSamples[vehicleGearCount + 1];
+int vehicleInferredGear = 0;
+bool gearDisagreeing = false;
+unsigned long gearDisagreeingSinceMillis = 0;
+bool vehicleGearMismatch = false;
+
+/* ======================================================================
+   FUNCTION: Gear whose learned ratio matches a speed and RPM, 0 if none
+   ====================================================================== */
+int inferGearFromRatio(float speed, int rpm) {
+  if (speed < gearLearnMinSpeed || rpm < gearLearnMinRpm) {
+    return 0;
+  }
+  float rpmPerKph = rpm / speed;
+  int bestGear = 0;
+  float bestError = gearMatchTolerance;
+  for (int gear = 1; gear <= vehicleGearCount; gear++) {
+    if (learnedRatioSamples[gear] < gearLearnSamplesToTrust) {
+      continue;
+    }
+    float error = fabs(rpmPerKph / learnedRpmPerKph[gear] - 1.0);
+    if (error <= bestError) {
+      bestGear = gear;
+      bestError = error;
+    }
+  }
+  return bestGear;
+}
+
+/* ======================================================================
+   FUNCTION: Fold one frame's ratio into the table for the master's gear
+   ====================================================================== */
+void learnGearRatio(float speed, int rpm, int gear, bool clutchPressed) {
+  if (gear < 1 || gear > vehicleGearCount || clutchPressed || speed < gearLearnMinSpeed || rpm < gearLearnMinRpm) {
+    return;
+  }
+  float rpmPerKph = rpm / speed;
+  if (learnedRatioSamples[gear] == 0) {
+    learnedRpmPerKph[gear] = rpmPerKph;
+  } else if (learnedRatioSamples[gear] >= gearLearnSamplesToTrust && fabs(rpmPerKph / learnedRpmPerKph[gear] - 1.0) > gearLearnRejectTolerance) {
+    return;
+  } else {
+    learnedRpmPerKph[gear] += (rpmPerKph - learnedRpmPerKph[gear]) * gearLearnRate;
+  }
+  learnedRatioSamples[gear] = min(learnedRatioSamples[gear] + 1, gearLearnMaxSamples);
+}
+
+/* ======================================================================
+   FUNCTION: Fit the speed and RPM trends to the recent frames
+   ====================================================================== */
+// Least squares slope against time, relative to the latest frame so the sums stay small
+void updateVehicleTrends(unsigned long latestMillis) {
+  float sumTime = 0, sumRpm = 0, sumSpeed = 0, sumTimeTime = 0, sumTimeRpm = 0, sumTimeSpeed = 0;
+  long earliest = 0;
+  int used = 0;
+  for (int i = 0; i < vehicleSampleCount; i++) {
+    long time = static_cast<long>(vehicleSamples[i].localMillis - latestMillis);
+    if (-time > static_cast<long>(vehicleTrendWindowMillis)) {
+      continue;
+    }
+    sumTime += time;
+    sumRpm += vehicleSamples[i].rpm;
+    sumSpeed += vehicleSamples[i].speed;
+    sumTimeTime += static_cast<float>(time) * time;
+    sumTimeRpm += static_cast<float>(time) * vehicleSamples[i].rpm;
+    sumTimeSpeed += static_cast<float>(time) * vehicleSamples[i].speed;
+    earliest = min(earliest, time);
+    used++;
+  }
+
+  float denominator = used * sumTimeTime - sumTime * sumTime;
+  if (used < 2 || static_cast<unsigned long>(-earliest) < vehicleMinTrendSpanMillis || denominator <= 0) {
+    vehicleRpmPerSecond = 0.0;
+    vehicleSpeedPerSecond = 0.0;
+    return;
+  }
+  vehicleRpmPerSecond = constrain((used * sumTimeRpm - sumTime * sumRpm) / denominator * 1000.0, -vehicleMaxRpmPerSecond, vehicleMaxRpmPerSecond);
+  vehicleSpeedPerSecond = constrain((used * sumTimeSpeed - sumTime * sumSpeed) / denominator * 1000.0, -vehicleMaxSpeedPerSecond, vehicleMaxSpeedPerSecond);
+}
+
+/* ======================================================================
+   FUNCTION: Take the values from a command ID 1 frame
+   ====================================================================== */
+// Call after serialProcessMessage() has handled the frame, so the RPM's age says when the master sampled it
+void updateVehicleStateEstimator(float speed, int rpm, int gear, bool clutchPressed) {
+  unsigned long sampledMillis = halMillis() - getMasterInputAgeMillis(MASTER_INPUT_RPM);
+  vehicleSamples[vehicleNextSample] = {sampledMillis, speed, rpm};
+  vehicleNextSample = (vehicleNextSample + 1) % vehicleWindowSamples;
+  if (vehicleSampleCount < vehicleWindowSamples) {
+    vehicleSampleCount++;
+  }
+  vehicleMasterGear = gear;
+  vehicleClutchPressed = clutchPressed;
+  updateVehicleTrends(sampledMillis);
+
+  // Checked before this frame is learned, so it can't pull the table towards agreeing with itself
+  vehicleInferredGear = inferGearFromRatio(speed, rpm);
+  bool disagreeing = !clutchPressed && vehicleInferredGear != 0 && vehicleInferredGear != gear;
+  if (disagreeing && !gearDisagreeing) {
+    gearDisagreeingSinceMillis = sampledMillis;
+  }
+  gearDisagreeing = disagreeing;
+  vehicleGearMismatch = disagreeing && (sampledMillis - gearDisagreeingSinceMillis >= gearMismatchMillis);
+
+  learnGearRatio(speed, rpm, gear, clutchPressed);
+}
+
+/* ======================================================================
+   FUNCTION: Best guess at speed, RPM and gear right now
+   ====================================================================== */
+// While frames are arriving this is just the latest one. Once it is old enough speed and RPM follow their trends for up
+// to 500ms, and the gear comes from the ratio of the two if it matches a learned one. Clutch can't be guessed at.
+void getVehicleEstimate(VehicleEstimate *estimate) {
+  const VehicleSample *latest = &vehicleSamples[(vehicleNextSample + vehicleWindowSamples - 1) % vehicleWindowSamples];
+  estimate->speed = latest->speed;
+  estimate->rpm = latest->rpm;
+  estimate->gear = vehicleMasterGear;
+  estimate->clutchPressed = vehicleClutchPressed;
+  estimate->inferredGear = vehicleInferredGear;
+  estimate->gearMismatch = vehicleGearMismatch;
+  estimate->extrapolated = false;
+  estimate->rpmPerSecond = vehicleRpmPerSecond;
+  estimate->speedPerSecond = vehicleSpeedPerSecond;
+
+  unsigned long ageMillis = halMillis() - latest->localMillis;
+  if (vehicleSampleCount == 0 || ageMillis <= vehicleExtrapolateAfterMillis) {
+    return;
+  }
+  float seconds = min(ageMillis, vehicleMaxExtrapolateMillis) / 1000.0;
+  estimate->speed = max(latest->speed + vehicleSpeedPerSecond * seconds, 0.0f);
+  estimate->rpm = constrain(static_cast<int>(lroundf(latest->rpm + vehicleRpmPerSecond * seconds)), 0, vehicleMaxRpm);
+  estimate->inferredGear = inferGearFromRatio(estimate->speed, estimate->rpm);
+  if (estimate->inferredGear != 0 && !vehicleClutchPressed) {
+    estimate->gear = estimate->inferredGear;
+  }
+  estimate->extrapolated = true;
+}
+
+/* ======================================================================
+   FUNCTION: Learned RPM per km/h for a gear, 0 until it can be trusted
+   ====================================================================== */
+float getLearnedRpmPerKph(int gear) {
+  if (gear < 1 || gear > vehicleGearCount || learnedRatioSamples[gear] < gearLearnSamplesToTrust) {
+    return 0.0;
+  }
+  return learnedRpmPerKph[gear];
+}
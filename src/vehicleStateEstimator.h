@@ -0,0 +1,28 @@
+#ifndef VEHICLESTATEESTIMATOR_H
+#define VEHICLESTATEESTIMATOR_H
+
+#include <Arduino.h>
+
+/* ======================================================================
+   STRUCTURES: Vehicle state carried forward between command ID 1 frames
+   ====================================================================== */
+struct VehicleEstimate {
+  float speed;             // km/h, extrapolated along its trend once the last frame is old enough
+  int rpm;                 // Likewise
+  int gear;                // The master's, or the one the RPM / speed ratio points to while the master's is stale
+  bool clutchPressed;      // As last sent, there is no trend to follow
+  int inferredGear;        // Gear whose learned RPM / speed ratio matches, 0 when none is close enough
+  bool gearMismatch;       // Inferred gear has disagreed with the master's for a while with the clutch out
+  bool extrapolated;       // Speed and RPM have been moved on from the last frame
+  float rpmPerSecond;      // Trends from the recent frames
+  float speedPerSecond;
+};
+
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void updateVehicleStateEstimator(float, int, int, bool);
+void getVehicleEstimate(VehicleEstimate *);
+float getLearnedRpmPerKph(int);
+
+#endif
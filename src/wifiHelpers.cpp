@@ -1,5 +1,7 @@
 #include "wifiHelpers.h"
 #include "arduinoSecrets.h"
+#include "hal.h"
+#include "logBuffer.h"
 #include <WiFiS3.h>
 
 /* ======================================================================
@@ -10,18 +12,65 @@ WiFiClient wifiClient;
 /* ======================================================================
    VARIABLES: General use
    ====================================================================== */
-char ssid[] = SECRET_SSID;   // your network SSID (name)
-char pass[] = SECRET_PASS;   // your network password (use for WPA, or use as key for WEP)
-int status = WL_IDLE_STATUS; // the WiFi radio's status
+char ssid[] = SECRET_SSID; // your network SSID (name)
+char pass[] = SECRET_PASS; // your network password (use for WPA, or use as key for WEP)
 
 /* ======================================================================
-   FUNCTION: Setup the WiFi connection
+   VARIABLES: Connection state machine
    ====================================================================== */
-void setupWiFi() {
+// Every WiFi.* call is an AT command to the ESP32 module, so the link is only polled every wifiPollIntervalMs and each
+// service makes at most one module call.
+const unsigned long wifiPollIntervalMs = 250;
+const unsigned long wifiRssiIntervalMs = 2000;
+const unsigned long wifiAssociateTimeoutMs = 15000; // Give up on an association attempt and back off after this
+const unsigned long wifiBeginTimeoutMs = 100;       // How long WiFi.begin() itself waits, association carries on after
+const unsigned long wifiBackoffInitialMs = 1000;
+const unsigned long wifiBackoffMaximumMs = 60000;
+const unsigned long wifiNoModuleRetryMs = 30000;
+
+WifiConnectionState wifiConnectionState = WIFI_STATE_IDLE;
+WifiConnectionStats wifiConnectionStats;
+unsigned long wifiStateStartMs = 0;
+unsigned long wifiLastPollMs = 0;
+unsigned long wifiLastRssiMs = 0;
+unsigned long wifiBackoffMs = wifiBackoffInitialMs;
+bool wifiRssiAverageValid = false;
+
+/* ======================================================================
+   FUNCTION: Change state and note when it happened
+   ====================================================================== */
+void setWiFiConnectionState(WifiConnectionState state) {
+  wifiConnectionState = state;
+  wifiStateStartMs = halMillis();
+}
+
+/* ======================================================================
+   FUNCTION: Start associating with the access point
+   ====================================================================== */
+void beginWiFiAssociation() {
+  wifiConnectionStats.associationAttempts++;
+  WiFi.begin(ssid, pass); // Returns after wifiBeginTimeoutMs, the module keeps trying and serviceWiFiConnection() polls
+  setWiFiConnectionState(WIFI_STATE_ASSOCIATING);
+}
+
+/* ======================================================================
+   FUNCTION: Start associating with a module that has just answered
+   ====================================================================== */
+void startWiFiAssociation() {
+  WiFi.setTimeout(wifiBeginTimeoutMs);
+  wifiBackoffMs = wifiBackoffInitialMs;
+  beginWiFiAssociation();
+}
+
+/* ======================================================================
+   FUNCTION: Check the module and start the first association, the rest happens in serviceWiFiConnection()
+   ====================================================================== */
+// Only from setup(). WiFi.firmwareVersion() returns a String, so a module that only answers later isn't version checked.
+void initWiFi() {
   if (WiFi.status() == WL_NO_MODULE) {
     Serial.println("Communication with WiFi module failed!");
-    while (true)
-      ;
+    setWiFiConnectionState(WIFI_STATE_NO_MODULE);
+    return;
   }
 
   String fv = WiFi.firmwareVersion();
@@ -29,16 +78,122 @@ void setupWiFi() {
     Serial.println("Please upgrade the firmware");
   }
 
-  while (status != WL_CONNECTED) {
-    Serial.print("Attempting to connect to WPA SSID: ");
-    Serial.println(ssid);
-    status = WiFi.begin(ssid, pass);
-    delay(1000);
+  startWiFiAssociation();
+}
+
+/* ======================================================================
+   FUNCTION: Sample the link quality, smoothed as well as the latest reading
+   ====================================================================== */
+void sampleWiFiRssi() {
+  wifiLastRssiMs = halMillis();
+  long rssi = WiFi.RSSI();
+  if (rssi == 0) {
+    return; // Module reports 0 when it has no reading
   }
+  wifiConnectionStats.rssi = rssi;
+  wifiConnectionStats.rssiMinimum = wifiRssiAverageValid ? min(wifiConnectionStats.rssiMinimum, rssi) : rssi;
+  wifiConnectionStats.rssiAverage = wifiRssiAverageValid ? (wifiConnectionStats.rssiAverage * 0.8f) + (rssi * 0.2f) : rssi;
+  wifiRssiAverageValid = true;
+}
 
-  Serial.print("You're connected to the network");
-  // printCurrentNet();
-  // printWifiData();
+/* ======================================================================
+   FUNCTION: Service the WiFi connection, call every loop
+   ====================================================================== */
+// Associates, notices drops and reassociates with backoff without ever waiting. Returns true while the link is up.
+bool serviceWiFiConnection() {
+  unsigned long now = halMillis();
+  if (wifiConnectionState == WIFI_STATE_IDLE || now - wifiLastPollMs < wifiPollIntervalMs) {
+    return wifiConnectionState == WIFI_STATE_CONNECTED;
+  }
+  wifiLastPollMs = now;
+
+  switch (wifiConnectionState) {
+    case WIFI_STATE_IDLE:
+      break;
+
+    case WIFI_STATE_NO_MODULE:
+      if (now - wifiStateStartMs >= wifiNoModuleRetryMs) {
+        LOG_ERROR(true, LOG_WIFI_NO_MODULE);
+        if (WiFi.status() == WL_NO_MODULE) {
+          setWiFiConnectionState(WIFI_STATE_NO_MODULE);
+        } else {
+          startWiFiAssociation();
+        }
+      }
+      break;
+
+    case WIFI_STATE_ASSOCIATING: {
+      int status = WiFi.status();
+      if (status == WL_CONNECTED) {
+        wifiConnectionStats.associations++;
+        wifiBackoffMs = wifiBackoffInitialMs;
+        wifiRssiAverageValid = false;
+        setWiFiConnectionState(WIFI_STATE_CONNECTED);
+        LOG_INFO(true, LOG_WIFI_CONNECTED, now - wifiStateStartMs);
+      } else if (now - wifiStateStartMs >= wifiAssociateTimeoutMs) {
+        LOG_WARN(true, LOG_WIFI_ASSOCIATION_FAILED, status, wifiBackoffMs);
+        WiFi.disconnect();
+        setWiFiConnectionState(WIFI_STATE_BACKOFF);
+      }
+      break;
+  }
+
+  case WIFI_STATE_CONNECTED:
+    // Alternate between the link check and an RSSI sample so no service makes more than one module call
+    if (now - wifiLastRssiMs >= wifiRssiIntervalMs) {
+      sampleWiFiRssi();
+      break;
+    }
+    {
+      int status = WiFi.status();
+      if (status != WL_CONNECTED) {
+        LOG_WARN(true, LOG_WIFI_DROPPED, status, wifiConnectionStats.rssi);
+        wifiConnectionStats.drops++;
+        setWiFiConnectionState(WIFI_STATE_BACKOFF);
+      }
+    }
+    break;
+
+  case WIFI_STATE_BACKOFF:
+    if (now - wifiStateStartMs >= wifiBackoffMs) {
+      wifiBackoffMs = min(wifiBackoffMs * 2, wifiBackoffMaximumMs);
+      beginWiFiAssociation();
+    }
+    break;
+  }
+  return wifiConnectionState == WIFI_STATE_CONNECTED;
+}
+
+/* ======================================================================
+   FUNCTION: Connection state and counters
+   ====================================================================== */
+WifiConnectionState getWiFiConnectionState() {
+  return wifiConnectionState;
+}
+
+void getWiFiConnectionStats(WifiConnectionStats *stats) {
+  *stats = wifiConnectionStats;
+}
+
+/* ======================================================================
+   FUNCTION: Report WiFi connection stats
+   ====================================================================== */
+void reportWiFiConnectionStats() {
+  static const char *stateNames[] = {"IDLE", "NO MODULE", "ASSOCIATING", "CONNECTED", "BACKOFF"};
+  Serial.print("INFO - WiFi ");
+  Serial.print(stateNames[wifiConnectionState]);
+  Serial.print(" RSSI: ");
+  Serial.print(wifiConnectionStats.rssi);
+  Serial.print("dBm average: ");
+  Serial.print(wifiConnectionStats.rssiAverage, 1);
+  Serial.print("dBm minimum: ");
+  Serial.print(wifiConnectionStats.rssiMinimum);
+  Serial.print("dBm attempts: ");
+  Serial.print(wifiConnectionStats.associationAttempts);
+  Serial.print(" associations: ");
+  Serial.print(wifiConnectionStats.associations);
+  Serial.print(" drops: ");
+  Serial.println(wifiConnectionStats.drops);
 }
 
 /* ======================================================================
@@ -3,9 +3,39 @@
 
 #include <WiFiS3.h>
 
+/* ======================================================================
+   ENUMS: Connection state
+   ====================================================================== */
+enum WifiConnectionState {
+  WIFI_STATE_IDLE,        // initWiFi() not called, WiFi disabled
+  WIFI_STATE_NO_MODULE,   // ESP32 module not answering, checked again every 30s
+  WIFI_STATE_ASSOCIATING, // WiFi.begin() sent, polling for the link
+  WIFI_STATE_CONNECTED,   // Link up, polled for drops and sampled for RSSI
+  WIFI_STATE_BACKOFF      // Waiting out the delay before the next association attempt
+};
+
+/* ======================================================================
+   STRUCTURES: Link quality and counters since boot
+   ====================================================================== */
+struct WifiConnectionStats {
+  unsigned long associationAttempts;
+  unsigned long associations;
+  unsigned long drops;
+  long rssi;         // Latest sample, dBm
+  long rssiMinimum;  // Weakest since the link came up
+  float rssiAverage; // Smoothed over roughly the last 10s
+};
+
 extern WiFiClient wifiClient;
 
-void setupWiFi();
+/* ======================================================================
+   FUNCTION PROTOTYPES
+   ====================================================================== */
+void initWiFi();
+bool serviceWiFiConnection();
+WifiConnectionState getWiFiConnectionState();
+void getWiFiConnectionStats(WifiConnectionStats *);
+void reportWiFiConnectionStats();
 void printWifiData();
 void printCurrentNet();
 void printMacAddress(byte mac[]);
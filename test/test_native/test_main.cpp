@@ -0,0 +1,642 @@
+#include "faultManager.h"
+#include "fixedPointPid.h"
+#include "globalHelpers.h"
+#include "halNative.h"
+#include "logBuffer.h"
+#include "mqttCommandParser.h"
+#include "mqttMetricSchema.h"
+#include "mqttPublish.h"
+#include "serialMessageProcessing.h"
+#include "timeSync.h"
+#include "varintEncoding.h"
+#include <PID_v1.h>
+#include <unity.h>
+
+/* ======================================================================
+   HELPERS: Shared by the tests below
+   ====================================================================== */
+// Copied and parsed the way takeMqttCommand() does it, into a buffer the size of the firmware's
+const char *parseCommand(const char *topic, const char *payload, MqttCommand *command) {
+  static char payloadCopy[128];
+  static char reason[40];
+  const char *copyRejection = copyMqttCommandPayload(payloadCopy, sizeof(payloadCopy), reinterpret_cast<const byte *>(payload), strlen(payload));
+  const MqttCommandDefinition *definition = findMqttCommandDefinition(topic);
+  TEST_ASSERT_NOT_NULL(definition);
+  const char *parseRejection = parseMqttCommand(definition, payloadCopy, command, reason, sizeof(reason));
+  return (copyRejection != nullptr) ? copyRejection : parseRejection;
+}
+
+// Command ID 1 as serialGetIncomingMessage() hands it over, start and end markers included
+void processCommandId1(const char *frame) {
+  char message[64];
+  strncpy(message, frame, sizeof(message) - 1);
+  message[sizeof(message) - 1] = '\0';
+  float speed;
+  int rpm, gear;
+  bool clutchPressed;
+  serialProcessCommandId1(message, &speed, &rpm, &gear, &clutchPressed);
+}
+
+// One request / reply exchange, the master's clock is ours plus offsetMillis and the link takes 2ms each way
+bool exchangeTimeSync(long offsetMillis) {
+  unsigned long requestMillis = startTimeSyncRequest();
+  unsigned long masterReceivedMillis = requestMillis + 2 + offsetMillis;
+  halNativeAdvanceMicros(5000);
+  return addTimeSyncSample(requestMillis, masterReceivedMillis, masterReceivedMillis + 1, halMillis());
+}
+
+// An in process MQTT broker behind the Client interface. Packets written to it are answered straight away: CONNECT
+// with a CONNACK, SUBSCRIBE with a SUBACK and PINGREQ with a PINGRESP.
+class FakeMqttBroker : public Client {
+public:
+  bool reachable = false;      // Whether a TCP connect succeeds
+  uint8_t connackReturnCode = 0; // 0 accepts the session
+  int tcpConnects = 0;
+  int sessions = 0;
+  int published = 0;
+  char subscribedTopics[8][32];
+  int subscribeCount = 0;
+
+  void drop() { open = false; }
+
+  int connect(IPAddress, uint16_t) override {
+    tcpConnects++;
+    open = reachable;
+    inboundLength = replyHead = replyLength = 0;
+    return open ? 1 : 0;
+  }
+  int connect(const char *, uint16_t) override { return 0; }
+  size_t write(uint8_t value) override { return write(&value, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override {
+    if (!open || inboundLength + size > sizeof(inbound)) {
+      return 0;
+    }
+    memcpy(inbound + inboundLength, buffer, size);
+    inboundLength += size;
+    handleInboundPackets();
+    return size;
+  }
+  int available() override { return open ? replyLength - replyHead : 0; }
+  int read() override { return available() > 0 ? reply[replyHead++] : -1; }
+  int read(uint8_t *buffer, size_t size) override {
+    int count = 0;
+    while (count < static_cast<int>(size) && available() > 0) {
+      buffer[count++] = reply[replyHead++];
+    }
+    return count;
+  }
+  int peek() override { return available() > 0 ? reply[replyHead] : -1; }
+  void flush() override {}
+  void stop() override { open = false; }
+  uint8_t connected() override { return open; }
+  operator bool() override { return open; }
+
+private:
+  bool open = false;
+  uint8_t inbound[1024];
+  size_t inboundLength = 0;
+  uint8_t reply[64];
+  int replyHead = 0;
+  int replyLength = 0;
+
+  void queueReply(const uint8_t *packet, int length) {
+    memcpy(reply + replyLength, packet, length);
+    replyLength += length;
+  }
+
+  // Whole packets only, a packet split across writes waits for the rest
+  void handleInboundPackets() {
+    while (inboundLength >= 2) {
+      size_t remainingLength = 0, headerLength = 1;
+      int shift = 0;
+      uint8_t digit;
+      do {
+        if (headerLength >= inboundLength) {
+          return;
+        }
+        digit = inbound[headerLength++];
+        remainingLength |= static_cast<size_t>(digit & 0x7F) << shift;
+        shift += 7;
+      } while (digit & 0x80);
+      size_t packetLength = headerLength + remainingLength;
+      if (packetLength > inboundLength) {
+        return;
+      }
+
+      const uint8_t *body = inbound + headerLength;
+      switch (inbound[0] >> 4) {
+        case 1: { // CONNECT
+          const uint8_t connack[] = {0x20, 0x02, 0x00, connackReturnCode};
+          queueReply(connack, sizeof(connack));
+          sessions += (connackReturnCode == 0);
+          break;
+        }
+        case 3: // PUBLISH
+          published++;
+          break;
+        case 8: { // SUBSCRIBE: packet ID, then one length prefixed topic and its QoS
+          int topicLength = (body[2] << 8) | body[3];
+          if (subscribeCount < 8 && topicLength < 32) {
+            memcpy(subscribedTopics[subscribeCount], body + 4, topicLength);
+            subscribedTopics[subscribeCount++][topicLength] = '\0';
+          }
+          const uint8_t suback[] = {0x90, 0x03, body[0], body[1], 0x00};
+          queueReply(suback, sizeof(suback));
+          break;
+        }
+        case 12: { // PINGREQ
+          const uint8_t pingresp[] = {0xD0, 0x00};
+          queueReply(pingresp, sizeof(pingresp));
+          break;
+        }
+        case 14: // DISCONNECT
+          open = false;
+          break;
+      }
+      memmove(inbound, inbound + packetLength, inboundLength - packetLength);
+      inboundLength -= packetLength;
+    }
+  }
+};
+
+void ignoreMqttMessage(char *, uint8_t *, unsigned int) {
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+/* ======================================================================
+   TESTS: MQTT command parser
+   ====================================================================== */
+void test_command_parser_accepts_partial_pid_with_sender_time() {
+  MqttCommand command;
+  TEST_ASSERT_NULL(parseCommand("command/pid", "id=12,t=5531,kp=30,ki=2.5", &command));
+  TEST_ASSERT_EQUAL(MQTT_COMMAND_PID, command.type);
+  TEST_ASSERT_EQUAL_UINT32(12, command.id);
+  TEST_ASSERT_TRUE(command.hasSenderTime);
+  TEST_ASSERT_EQUAL_UINT32(5531, command.senderTime);
+  TEST_ASSERT_EQUAL_FLOAT(30.0, command.values[0]);
+  TEST_ASSERT_EQUAL_FLOAT(2.5, command.values[1]);
+  TEST_ASSERT_TRUE(isnan(command.values[2]));
+}
+
+void test_command_parser_accepts_fieldless_commands() {
+  MqttCommand command;
+  TEST_ASSERT_NULL(parseCommand("command/blackbox", "id=1", &command));
+  TEST_ASSERT_FALSE(command.hasSenderTime);
+  TEST_ASSERT_NULL(parseCommand("command/faults", "id=4294967295", &command));
+  TEST_ASSERT_EQUAL_UINT32(4294967295UL, command.id);
+  TEST_ASSERT_NULL(findMqttCommandDefinition("command/ack"));
+}
+
+void test_command_parser_rejects_malformed_payloads() {
+  MqttCommand command;
+  TEST_ASSERT_EQUAL_STRING("missing id", parseCommand("command/pid", "kp=30", &command));
+  TEST_ASSERT_EQUAL_STRING("missing fields", parseCommand("command/pid", "id=1", &command));
+  TEST_ASSERT_EQUAL_STRING("missing fields", parseCommand("command/boost", "id=1,gear=3", &command));
+  TEST_ASSERT_EQUAL_STRING("expected key=value", parseCommand("command/pid", "id=1,kp", &command));
+  TEST_ASSERT_EQUAL_STRING("unknown field kx", parseCommand("command/pid", "id=1,kx=3", &command));
+  TEST_ASSERT_EQUAL_STRING("kp not a number", parseCommand("command/pid", "id=1,kp=3x", &command));
+  TEST_ASSERT_EQUAL_STRING("kp not a number", parseCommand("command/pid", "id=1,kp=nan", &command));
+  TEST_ASSERT_EQUAL_STRING("kp not a number", parseCommand("command/pid", "id=1,kp=inf", &command));
+
+  // 127 characters fit the buffer, one more would have been cut off and is rejected even though the start parses
+  char payload[160] = "id=9,kp=30,ki=2.5,kd=0";
+  memset(payload + strlen(payload), '0', 127 - strlen(payload));
+  payload[127] = '\0';
+  TEST_ASSERT_NULL(parseCommand("command/pid", payload, &command));
+  strcat(payload, "5");
+  TEST_ASSERT_EQUAL_STRING("payload too long", parseCommand("command/pid", payload, &command));
+  TEST_ASSERT_EQUAL_UINT32(9, command.id);
+}
+
+void test_command_parser_rejects_out_of_range_values() {
+  MqttCommand command;
+  TEST_ASSERT_EQUAL_STRING("gear out of range", parseCommand("command/boost", "id=1,gear=7,kpa=20", &command));
+  TEST_ASSERT_EQUAL_STRING("gear out of range", parseCommand("command/boost", "id=1,gear=2.5,kpa=20", &command));
+  TEST_ASSERT_EQUAL_STRING("kp out of range", parseCommand("command/pid", "id=1,kp=-1", &command));
+  TEST_ASSERT_EQUAL_STRING("id out of range", parseCommand("command/pid", "id=-1,kp=1", &command));
+  TEST_ASSERT_EQUAL_STRING("id out of range", parseCommand("command/pid", "id=4294967296,kp=1", &command));
+  TEST_ASSERT_EQUAL_STRING("t out of range", parseCommand("command/pid", "id=1,t=0.5,kp=1", &command));
+  TEST_ASSERT_EQUAL_UINT32(1, command.id); // Read before the rejection, so it can still be acknowledged
+}
+
+/* ======================================================================
+   TESTS: Varint and zigzag encoding
+   ====================================================================== */
+void test_varint_round_trip() {
+  const unsigned long values[] = {0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 4294967295UL};
+  const int expectedLengths[] = {1, 1, 1, 2, 2, 3, 3, 4, 5};
+  const int count = sizeof(values) / sizeof(values[0]);
+  byte buffer[64];
+  int length = 0;
+  for (int i = 0; i < count; i++) {
+    int before = length;
+    length = appendVarint(buffer, length, values[i]);
+    TEST_ASSERT_EQUAL_INT(expectedLengths[i], length - before);
+  }
+
+  int position = 0;
+  for (int i = 0; i < count; i++) {
+    unsigned long value;
+    TEST_ASSERT_TRUE(readVarint(buffer, length, &position, &value));
+    TEST_ASSERT_EQUAL_UINT32(values[i], value);
+  }
+  TEST_ASSERT_EQUAL_INT(length, position);
+}
+
+void test_varint_read_stops_at_the_end_of_the_buffer() {
+  byte buffer[8];
+  int length = appendVarint(buffer, 0, 300);
+  int position = 0;
+  unsigned long value;
+  TEST_ASSERT_FALSE(readVarint(buffer, length - 1, &position, &value));
+}
+
+void test_zigzag_round_trip() {
+  TEST_ASSERT_EQUAL_UINT32(0, zigzagEncode(0));
+  TEST_ASSERT_EQUAL_UINT32(1, zigzagEncode(-1));
+  TEST_ASSERT_EQUAL_UINT32(2, zigzagEncode(1));
+  TEST_ASSERT_EQUAL_UINT32(3, zigzagEncode(-2));
+
+  const long values[] = {0, 1, -1, 63, -64, 64, -65, 100000, -100000, INT32_MAX, INT32_MIN};
+  for (long value : values) {
+    unsigned long encoded = zigzagEncode(value);
+    TEST_ASSERT_TRUE(encoded <= 0xFFFFFFFFUL);
+    TEST_ASSERT_EQUAL_INT32(value, zigzagDecode(encoded));
+  }
+}
+
+/* ======================================================================
+   TESTS: Clock synchronisation and command ID 1 timestamps
+   ====================================================================== */
+// Run in this order, the estimator is one set of globals. Until the first exchange there is nothing to age from.
+void test_command_id1_timestamp_ignored_until_synchronised() {
+  halNativeAdvanceMicros(10000000);
+  processCommandId1("<1,60.0,3500,3,0,1234,77>");
+  halNativeAdvanceMicros(20000);
+  TEST_ASSERT_EQUAL_UINT32(20, getMasterInputAgeMillis(MASTER_INPUT_RPM));
+}
+
+void test_time_sync_offset_from_one_exchange() {
+  TEST_ASSERT_TRUE(exchangeTimeSync(5000));
+  TimeSyncStatus status;
+  getTimeSyncStatus(&status);
+  TEST_ASSERT_TRUE(status.synchronised);
+  TEST_ASSERT_EQUAL_INT32(5000, status.offsetMillis);
+  TEST_ASSERT_EQUAL_UINT32(4, status.roundTripMillis); // 5ms less the master's 1ms turnaround
+  TEST_ASSERT_EQUAL_INT(1, status.samples);
+}
+
+void test_time_sync_rejects_stale_and_slow_replies() {
+  unsigned long requestMillis = startTimeSyncRequest();
+  halNativeAdvanceMicros(5000);
+  TEST_ASSERT_FALSE(addTimeSyncSample(requestMillis - 1, requestMillis + 5002, requestMillis + 5003, halMillis()));
+
+  requestMillis = startTimeSyncRequest();
+  halNativeAdvanceMicros(150000);
+  TEST_ASSERT_FALSE(addTimeSyncSample(requestMillis, requestMillis + 5075, requestMillis + 5076, halMillis()));
+
+  TimeSyncStatus status;
+  getTimeSyncStatus(&status);
+  TEST_ASSERT_EQUAL_INT(1, status.samples);
+}
+
+void test_time_sync_restart_then_drift() {
+  // The master restarting moves the offset by far more than the step limit, the window starts again
+  TEST_ASSERT_TRUE(exchangeTimeSync(-20000));
+  TimeSyncStatus status;
+  getTimeSyncStatus(&status);
+  TEST_ASSERT_EQUAL_INT(1, status.samples);
+  TEST_ASSERT_EQUAL_INT32(-20000, status.offsetMillis);
+
+  // Master clock 500ppm fast, an exchange every 10s fills the window over 70s
+  unsigned long startMillis = halMillis();
+  for (int i = 1; i < 8; i++) {
+    halNativeAdvanceMicros(10000000 - 5000);
+    TEST_ASSERT_TRUE(exchangeTimeSync(-20000 + lround(0.0005 * (halMillis() - startMillis))));
+  }
+  getTimeSyncStatus(&status);
+  TEST_ASSERT_EQUAL_INT(8, status.samples);
+  TEST_ASSERT_FLOAT_WITHIN(50.0, 500.0, status.driftPpm);
+
+  unsigned long now = halMillis();
+  TEST_ASSERT_INT32_WITHIN(1, -20000 + 35, localToMasterMillis(now) - now);
+  TEST_ASSERT_INT32_WITHIN(1, now, masterToLocalMillis(localToMasterMillis(now)));
+}
+
+void test_command_id1_optional_timestamp() {
+  // Command ID, four values and the checksum, the last field is not a timestamp
+  processCommandId1("<1,60.0,3500,3,0,77>");
+  TEST_ASSERT_EQUAL_UINT32(0, getMasterInputAgeMillis(MASTER_INPUT_RPM));
+
+  // A seventh field means the sixth is the master's millis() when it sampled the values, here 30ms ago
+  char frame[64];
+  snprintf(frame, sizeof(frame), "<1,60.0,3500,3,0,%lu,77>", localToMasterMillis(halMillis()) - 30);
+  processCommandId1(frame);
+  TEST_ASSERT_UINT32_WITHIN(1, 30, getMasterInputAgeMillis(MASTER_INPUT_RPM));
+  TEST_ASSERT_UINT32_WITHIN(1, 30, getOldestMasterInputAgeMillis());
+
+  // Never younger than when the frame arrived, whatever the master claims
+  snprintf(frame, sizeof(frame), "<1,60.0,3500,3,0,%lu,77>", localToMasterMillis(halMillis()) + 1000);
+  processCommandId1(frame);
+  TEST_ASSERT_EQUAL_UINT32(0, getMasterInputAgeMillis(MASTER_INPUT_GEAR));
+}
+
+/* ======================================================================
+   TESTS: Q16.16 saturation
+   ====================================================================== */
+void test_fixed16_multiply_and_divide_saturate() {
+  TEST_ASSERT_EQUAL_INT32(fixed16FromInt(-10), fixed16Multiply(fixed16FromDouble(2.5), fixed16FromInt(-4)));
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, fixed16Multiply(fixed16FromInt(30000), fixed16FromInt(200)));
+  TEST_ASSERT_EQUAL_INT32(INT32_MIN, fixed16Multiply(fixed16FromInt(-30000), fixed16FromInt(200)));
+  TEST_ASSERT_EQUAL_INT32(INT32_MIN, fixed16Multiply(fixed16FromInt(30000), fixed16FromInt(-200)));
+
+  TEST_ASSERT_EQUAL_INT32(fixed16FromDouble(-7.5), fixed16Divide(fixed16FromInt(30), fixed16FromInt(-4)));
+  TEST_ASSERT_EQUAL_INT32(INT32_MAX, fixed16Divide(fixed16FromInt(30000), fixed16FromDouble(0.001)));
+  TEST_ASSERT_EQUAL_INT32(INT32_MIN, fixed16Divide(fixed16FromInt(-30000), fixed16FromDouble(0.001)));
+}
+
+void test_fixed_point_pid_pins_instead_of_wrapping() {
+  fixed16_t input = 0, output = 0, setpoint = fixed16FromInt(30000);
+  FixedPointPid pid(&input, &output, &setpoint, 200, 50, 0, DIRECT);
+  pid.SetOutputLimits(-60, 40);
+  pid.SetMode(AUTOMATIC);
+  TEST_ASSERT_TRUE(pid.Compute());
+  TEST_ASSERT_EQUAL_INT32(fixed16FromInt(40), output);
+
+  setpoint = fixed16FromInt(-30000);
+  halNativeAdvanceMicros(100000);
+  TEST_ASSERT_TRUE(pid.Compute());
+  TEST_ASSERT_EQUAL_INT32(fixed16FromInt(-60), output);
+}
+
+/* ======================================================================
+   TESTS: Fixed schema metric serialisation
+   ====================================================================== */
+void test_metric_schema_serializes_flat_and_nested() {
+  char buffer[160];
+  const float pressures[] = {45.0f, 44.123f};
+  MetricGroup group = metricGroup(pressuresMetricSchema, pressures);
+  const char *flat = "{\"Target\":45.00,\"Actual\":44.12}";
+  TEST_ASSERT_EQUAL(strlen(flat), serializeMqttMetricGroups(buffer, sizeof(buffer), &group, 1, false));
+  TEST_ASSERT_EQUAL_STRING(flat, buffer);
+
+  // Per field decimal places, small and negative values, a tiny negative doesn't become "-0.00", NaN is null
+  const float compressor[] = {-0.05f, 1.5f, NAN, 1.0f};
+  const float valveOpen[] = {-0.004f};
+  MetricGroup groups[] = {metricGroup(compressorMetricSchema, compressor), metricGroup(valveOpenMetricSchema, valveOpen)};
+  serializeMqttMetricGroups(buffer, sizeof(buffer), groups, 2, true);
+  TEST_ASSERT_EQUAL_STRING("{\"compressor\":{\"IntakeKpa\":-0.05,\"PressureRatio\":1.500,\"RatioRate\":null,\"RatioLimited\":1},"
+                           "\"valveopen\":{\"Percentage\":0.00}}",
+                           buffer);
+}
+
+void test_metric_schema_truncates_within_the_buffer() {
+  char full[64];
+  const float pressures[] = {45.0f, 44.123f};
+  MetricGroup group = metricGroup(pressuresMetricSchema, pressures);
+  serializeMqttMetricGroups(full, sizeof(full), &group, 1, false);
+
+  // Cut off at the buffer's end, still terminated, and nothing written past it
+  char buffer[24];
+  memset(buffer, 'x', sizeof(buffer));
+  TEST_ASSERT_EQUAL(15, serializeMqttMetricGroups(buffer, 16, &group, 1, false));
+  TEST_ASSERT_EQUAL('\0', buffer[15]);
+  TEST_ASSERT_EQUAL(0, strncmp(full, buffer, 15));
+  for (int i = 16; i < static_cast<int>(sizeof(buffer)); i++) {
+    TEST_ASSERT_EQUAL('x', buffer[i]);
+  }
+
+  // Even mid number
+  memset(buffer, 'x', sizeof(buffer));
+  TEST_ASSERT_EQUAL(12, serializeMqttMetricGroups(buffer, 13, &group, 1, false));
+  TEST_ASSERT_EQUAL_STRING("{\"Target\":45", buffer);
+  TEST_ASSERT_EQUAL('x', buffer[13]);
+}
+
+/* ======================================================================
+   TESTS: Fault debounce, latching, recovery and history
+   ====================================================================== */
+void test_fault_debounce_and_recovery() {
+  // intakeSensor: warning, 1s debounce, 5s recovery
+  updateFaultCondition(FAULT_INTAKE_SENSOR, true);
+  halNativeAdvanceMicros(999000);
+  updateFaultCondition(FAULT_INTAKE_SENSOR, true);
+  TEST_ASSERT_FALSE(isFaultActive(FAULT_INTAKE_SENSOR));
+  halNativeAdvanceMicros(1000);
+  updateFaultCondition(FAULT_INTAKE_SENSOR, true);
+  TEST_ASSERT_TRUE(isFaultActive(FAULT_INTAKE_SENSOR));
+  TEST_ASSERT_FALSE(isCriticalFaultActive());
+  TEST_ASSERT_EQUAL_HEX32(0, getCriticalFaultBitmask());
+
+  // A condition that comes back inside the recovery time starts it again
+  updateFaultCondition(FAULT_INTAKE_SENSOR, false);
+  halNativeAdvanceMicros(4000000);
+  updateFaultCondition(FAULT_INTAKE_SENSOR, true);
+  updateFaultCondition(FAULT_INTAKE_SENSOR, false);
+  halNativeAdvanceMicros(4999000);
+  updateFaultCondition(FAULT_INTAKE_SENSOR, false);
+  TEST_ASSERT_TRUE(isFaultActive(FAULT_INTAKE_SENSOR));
+  halNativeAdvanceMicros(1000);
+  updateFaultCondition(FAULT_INTAKE_SENSOR, false);
+  TEST_ASSERT_FALSE(isFaultActive(FAULT_INTAKE_SENSOR));
+}
+
+void test_fault_latching_until_cleared() {
+  // overboost: critical and latching
+  updateFaultCondition(FAULT_OVERBOOST, true);
+  TEST_ASSERT_TRUE(isCriticalFaultActive());
+  TEST_ASSERT_TRUE(globalAlarmCritical);
+  TEST_ASSERT_EQUAL_HEX32(1UL << FAULT_OVERBOOST, getCriticalFaultBitmask());
+
+  // Not cleared while the condition is still there, and not by the condition going away on its own
+  clearLatchedFaults();
+  TEST_ASSERT_TRUE(isFaultActive(FAULT_OVERBOOST));
+  updateFaultCondition(FAULT_OVERBOOST, false);
+  halNativeAdvanceMicros(60000000);
+  updateFaultCondition(FAULT_OVERBOOST, false);
+  TEST_ASSERT_TRUE(isFaultActive(FAULT_OVERBOOST));
+
+  clearLatchedFaults();
+  TEST_ASSERT_FALSE(isFaultActive(FAULT_OVERBOOST));
+  TEST_ASSERT_FALSE(globalAlarmCritical);
+}
+
+void test_fault_history_keeps_the_latest_oldest_first() {
+  // commsTimeout: no debounce, 2s recovery. 10 raise / clear pairs is more than the 16 entry ring holds.
+  for (int i = 0; i < 10; i++) {
+    updateFaultCondition(FAULT_COMMS_TIMEOUT, true);
+    updateFaultCondition(FAULT_COMMS_TIMEOUT, false);
+    halNativeAdvanceMicros(2000000);
+    updateFaultCondition(FAULT_COMMS_TIMEOUT, false);
+  }
+  unsigned long lastClearedMillis = halMillis();
+
+  FaultEvent events[20];
+  TEST_ASSERT_EQUAL(16, getFaultHistory(events, 20));
+  for (int i = 0; i < 16; i++) {
+    TEST_ASSERT_EQUAL(FAULT_COMMS_TIMEOUT, events[i].code);
+    TEST_ASSERT_EQUAL(i % 2 == 0, events[i].raised);
+    if (i > 0) {
+      TEST_ASSERT_EQUAL_UINT32(events[i - 1].timestampMillis + 2000 * (i % 2), events[i].timestampMillis);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(lastClearedMillis, events[15].timestampMillis);
+
+  // Fewer asked for gives the most recent ones
+  TEST_ASSERT_EQUAL(2, getFaultHistory(events, 2));
+  TEST_ASSERT_TRUE(events[0].raised);
+  TEST_ASSERT_EQUAL_UINT32(lastClearedMillis, events[1].timestampMillis);
+}
+
+/* ======================================================================
+   TESTS: Log ring overflow
+   ====================================================================== */
+void test_log_ring_keeps_the_oldest_and_counts_drops() {
+  LogRecord record;
+  while (logPop(&record)) {
+  }
+  unsigned long droppedBefore = getLogDroppedCount();
+
+  // Fill it until the first drop, that is the ring size
+  int capacity = 0;
+  while (getLogDroppedCount() == droppedBefore) {
+    logPush(LOG_LEVEL_INFO, LOG_MQTT_CONNECTED, capacity++);
+  }
+  capacity--;
+  TEST_ASSERT_TRUE(capacity >= 16 && (capacity & (capacity - 1)) == 0);
+  logPush(LOG_LEVEL_INFO, LOG_MQTT_CONNECTED, capacity + 1);
+  logPush(LOG_LEVEL_INFO, LOG_MQTT_CONNECTED, capacity + 2);
+  TEST_ASSERT_EQUAL_UINT32(droppedBefore + 3, getLogDroppedCount());
+
+  // What was already queued comes out in order, the records pushed while it was full are the ones lost
+  for (int i = 0; i < capacity; i++) {
+    TEST_ASSERT_TRUE(logPop(&record));
+    int32_t value;
+    memcpy(&value, record.payload, sizeof(value));
+    TEST_ASSERT_EQUAL_INT32(i, value);
+  }
+  char text[64], expected[64];
+  snprintf(expected, sizeof(expected), "[INFO NETWORK] MQTT connected to broker after %d attempts", capacity - 1);
+  logFormatRecord(&record, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING(expected, text);
+  TEST_ASSERT_FALSE(logPop(&record));
+
+  // Room again once drained
+  logPush(LOG_LEVEL_WARN, LOG_MQTT_CONNECTED, 7);
+  TEST_ASSERT_TRUE(logPop(&record));
+  TEST_ASSERT_EQUAL(LOG_LEVEL_WARN, record.level);
+  TEST_ASSERT_EQUAL_UINT32(droppedBefore + 3, getLogDroppedCount());
+}
+
+/* ======================================================================
+   TESTS: MQTT connection state machine against a fake broker
+   ====================================================================== */
+void test_mqtt_connection_backs_off_reconnects_and_resubscribes() {
+  static FakeMqttBroker broker;
+  static const char *const topics[] = {"command/pid"};
+  MqttConnectionStats stats;
+  initMqttConnection();
+  setMqttTransport(&broker);
+  setMqttBroker(IPAddress(127, 0, 0, 1), 1883);
+  setMqttSubscriptions(topics, 1, ignoreMqttMessage);
+
+  // Broker down: one attempt, then nothing until the backoff is up, and the backoff doubles
+  TEST_ASSERT_FALSE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(MQTT_STATE_BACKOFF, getMqttConnectionState());
+  TEST_ASSERT_EQUAL(1, broker.tcpConnects);
+  halNativeAdvanceMicros(499000);
+  serviceMqttConnection(true);
+  TEST_ASSERT_EQUAL(1, broker.tcpConnects);
+  halNativeAdvanceMicros(1000);
+  serviceMqttConnection(true);
+  TEST_ASSERT_EQUAL(2, broker.tcpConnects);
+  halNativeAdvanceMicros(999000);
+  serviceMqttConnection(true);
+  TEST_ASSERT_EQUAL(2, broker.tcpConnects);
+  halNativeAdvanceMicros(1000);
+  serviceMqttConnection(true);
+  TEST_ASSERT_EQUAL(3, broker.tcpConnects);
+
+  // No attempts at all while the network is down
+  halNativeAdvanceMicros(5000000);
+  serviceMqttConnection(false);
+  TEST_ASSERT_EQUAL(3, broker.tcpConnects);
+
+  // The network coming back means an attempt straight away. A rejected session backs off like an unreachable broker.
+  broker.reachable = true;
+  broker.connackReturnCode = 5; // Not authorised
+  TEST_ASSERT_FALSE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(MQTT_STATE_CONNECTING, getMqttConnectionState());
+  TEST_ASSERT_FALSE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(MQTT_STATE_BACKOFF, getMqttConnectionState());
+  TEST_ASSERT_FALSE(broker.connected());
+
+  // The TCP connect and the MQTT session are set up on separate calls, then the subscriptions follow
+  broker.connackReturnCode = 0;
+  halNativeAdvanceMicros(1000000);
+  TEST_ASSERT_FALSE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(MQTT_STATE_CONNECTING, getMqttConnectionState());
+  TEST_ASSERT_EQUAL(0, broker.sessions);
+  TEST_ASSERT_TRUE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(MQTT_STATE_CONNECTED, getMqttConnectionState());
+  TEST_ASSERT_EQUAL(1, broker.sessions);
+  TEST_ASSERT_EQUAL(1, broker.subscribeCount);
+  TEST_ASSERT_EQUAL_STRING("command/pid", broker.subscribedTopics[0]);
+  TEST_ASSERT_TRUE(serviceMqttConnection(true)); // Takes the SUBACK
+  TEST_ASSERT_TRUE(publishMqttPayload("test", "1"));
+  TEST_ASSERT_EQUAL(1, broker.published);
+
+  // Dropped by the broker: counted, backed off from 500ms again, and the new session subscribes again
+  broker.drop();
+  TEST_ASSERT_FALSE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(MQTT_STATE_BACKOFF, getMqttConnectionState());
+  TEST_ASSERT_FALSE(publishMqttPayload("test", "2"));
+  halNativeAdvanceMicros(500000);
+  serviceMqttConnection(true);
+  TEST_ASSERT_TRUE(serviceMqttConnection(true));
+  TEST_ASSERT_EQUAL(2, broker.sessions);
+  TEST_ASSERT_EQUAL(2, broker.subscribeCount);
+  TEST_ASSERT_EQUAL_STRING("command/pid", broker.subscribedTopics[1]);
+
+  getMqttConnectionStats(&stats);
+  TEST_ASSERT_EQUAL_UINT32(6, stats.connectAttempts);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.connects);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.drops);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.published);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.publishFailed);
+}
+
+/* ======================================================================
+   MAIN: Unity runner for pio test -e native
+   ====================================================================== */
+int main() {
+  initLogBuffer();
+  UNITY_BEGIN();
+  RUN_TEST(test_command_parser_accepts_partial_pid_with_sender_time);
+  RUN_TEST(test_command_parser_accepts_fieldless_commands);
+  RUN_TEST(test_command_parser_rejects_malformed_payloads);
+  RUN_TEST(test_command_parser_rejects_out_of_range_values);
+  RUN_TEST(test_varint_round_trip);
+  RUN_TEST(test_varint_read_stops_at_the_end_of_the_buffer);
+  RUN_TEST(test_zigzag_round_trip);
+  RUN_TEST(test_command_id1_timestamp_ignored_until_synchronised);
+  RUN_TEST(test_time_sync_offset_from_one_exchange);
+  RUN_TEST(test_time_sync_rejects_stale_and_slow_replies);
+  RUN_TEST(test_time_sync_restart_then_drift);
+  RUN_TEST(test_command_id1_optional_timestamp);
+  RUN_TEST(test_fixed16_multiply_and_divide_saturate);
+  RUN_TEST(test_fixed_point_pid_pins_instead_of_wrapping);
+  RUN_TEST(test_metric_schema_serializes_flat_and_nested);
+  RUN_TEST(test_metric_schema_truncates_within_the_buffer);
+  RUN_TEST(test_fault_debounce_and_recovery);
+  RUN_TEST(test_fault_latching_until_cleared);
+  RUN_TEST(test_fault_history_keeps_the_latest_oldest_first);
+  RUN_TEST(test_log_ring_keeps_the_oldest_and_counts_drops);
+  RUN_TEST(test_mqtt_connection_backs_off_reconnects_and_resubscribes);
+  return UNITY_END();
+}
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Compare microbenchmark results (src/benchmarks.cpp) against a saved baseline.
+
+Both files are the JSON printed by the native_bench or uno_r4_wifi_bench environment, anything printed before the
+opening brace (log lines, monitor banners) is skipped. Fails when a benchmark's median is more than --threshold percent
+slower than the baseline, or when the per tick cost of the control path no longer fits in the control tick (budgetUs,
+1ms on the R4 and 2ms on the Mega). Also prints what each boost channel past the first adds to the tick.
+
+Usage: pio run -e native_bench -t exec > results.json
+       python3 tools/benchmarkCompare.py baseline.json results.json [--threshold 10]
+       python3 tools/benchmarkCompare.py results.json                 (budget check only)
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_results(path):
+    with open(path) as handle:
+        text = handle.read()
+    start = text.find("{")
+    if start < 0:
+        raise ValueError("%s: no benchmark JSON found" % path)
+    report, _ = json.JSONDecoder().raw_decode(text[start:])
+    return report
+
+
+def to_microseconds(report, value):
+    return value * 1e6 / report["counterHz"]
+
+
+def tick_cost_microseconds(report):
+    return sum(to_microseconds(report, result["median"]) * result["perTick"] for result in report["results"])
+
+
+def channel_cost_microseconds(report):
+    """Cost of each boost channel past the first, from the runBoostChannels x1 and x4 entries, None if either is missing"""
+    by_name = {result["name"]: result for result in report["results"]}
+    one, four = by_name.get("runBoostChannels x1"), by_name.get("runBoostChannels x4")
+    if one is None or four is None:
+        return None
+    return to_microseconds(report, four["median"] - one["median"]) / 3
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("files", nargs="+", help="[baseline] results")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed median regression in percent")
+    args = parser.parse_args()
+    if len(args.files) > 2:
+        parser.error("expected at most a baseline and a results file")
+
+    current = load_results(args.files[-1])
+    baseline = load_results(args.files[0]) if len(args.files) == 2 else None
+    if baseline is not None and baseline["platform"] != current["platform"]:
+        print("warning: comparing %s against a %s baseline" % (current["platform"], baseline["platform"]), file=sys.stderr)
+    baseline_by_name = {result["name"]: result for result in baseline["results"]} if baseline else {}
+
+    failed = False
+    print("%-32s %12s %12s %8s" % ("benchmark", "median " + current["unit"], "baseline", "change"))
+    for result in current["results"]:
+        previous = baseline_by_name.get(result["name"])
+        if previous is None:
+            print("%-32s %12.1f %12s %8s" % (result["name"], result["median"], "-", "-"))
+            continue
+        change = (result["median"] - previous["median"]) * 100.0 / previous["median"] if previous["median"] > 0 else 0.0
+        regressed = change > args.threshold
+        failed |= regressed
+        print("%-32s %12.1f %12.1f %+7.1f%%%s" % (result["name"], result["median"], previous["median"], change,
+                                                 "  REGRESSED" if regressed else ""))
+
+    tick_cost_us = tick_cost_microseconds(current)
+    budget_us = current["budgetUs"]
+    print("\nControl tick estimate: %.2fus of %dus (%.1f%%)" % (tick_cost_us, budget_us, tick_cost_us * 100.0 / budget_us))
+    if tick_cost_us > budget_us:
+        print("Control tick estimate exceeds the tick budget")
+        failed = True
+    channel_us = channel_cost_microseconds(current)
+    if channel_us is not None:
+        print("Each extra boost channel: %.2fus (%.1f%% of the tick)" % (channel_us, channel_us * 100.0 / budget_us))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Decode a blackbox dump (#BH / #B / #BE lines) from a serial capture or MQTT subscription into CSV.
+
+The board dumps the blackbox automatically once it has frozen around a fault. Capture it with the PlatformIO monitor
+(log2file) or with mosquitto_sub -t blackbox, then:
+
+Usage: python3 tools/blackboxDecode.py capture.log > blackbox.csv   (reads stdin when no file is given)
+"""
+
+import sys
+
+CONTROL_MODES = ["failSafe", "position", "pressure", "overboostOpen"]
+COLUMNS = ["dump", "timeMs", "targetKpa", "actualKpa", "valveRaw", "valveOpenPercentage", "motorCommand", "controlMode",
+           "rpm", "gear", "clutchPressed", "alarmCritical"]
+
+
+def signed(value, bits):
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+
+def unpack_record(packed):
+    """Inverse of packBlackboxSample() in blackboxRecorder.cpp"""
+    return {
+        "targetKpa": (packed & 0xFF) / 2.0,
+        "actualKpa": signed((packed >> 8) & 0xFFF, 12) / 8.0,
+        "valveRaw": (packed >> 20) & 0x3FF,
+        "valveOpenPercentage": ((packed >> 30) & 0xFF) / 2.0,
+        "motorCommand": signed((packed >> 38) & 0xFF, 8),
+        "controlMode": CONTROL_MODES[(packed >> 46) & 0x03],
+        "rpm": ((packed >> 48) & 0x3FF) * 8,
+        "gear": (packed >> 58) & 0x07,
+        "clutchPressed": (packed >> 61) & 0x01,
+        "alarmCritical": (packed >> 62) & 0x01,
+    }
+
+
+def main():
+    capture = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    print(",".join(COLUMNS))
+
+    dump_number = 0
+    header = None
+    records = []
+    for line in capture:
+        line = line.strip()
+        start = line.find("#B")
+        if start < 0:
+            continue
+        line = line[start:]
+
+        if line.startswith("#BH,"):
+            trigger_millis, trigger_code, period_us, record_count, post_trigger = (int(field) for field in line[4:].split(","))
+            header = (trigger_millis, trigger_code, period_us, record_count, post_trigger)
+            records = []
+            sys.stderr.write("Dump %d: trigger code %d at %dms, %d records\n" % (dump_number, trigger_code, trigger_millis, record_count))
+        elif line == "#BE" and header is not None:
+            _, _, period_us, record_count, post_trigger = header
+            trigger_index = len(records) - post_trigger
+            for index, packed in enumerate(records):
+                row = unpack_record(packed)
+                row["dump"] = dump_number
+                row["timeMs"] = (index - trigger_index) * period_us / 1000.0
+                print(",".join(str(row[column]) for column in COLUMNS))
+            if len(records) != record_count:
+                sys.stderr.write("Dump %d: expected %d records, got %d\n" % (dump_number, record_count, len(records)))
+            dump_number += 1
+            header = None
+        elif header is not None:
+            data = line[2:]
+            records.extend(int(data[i:i + 16], 16) for i in range(0, len(data) - 15, 16))
+
+
+if __name__ == "__main__":
+    main()
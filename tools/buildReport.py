@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Build each board and report flash, RAM and the estimated control tick cost side by side.
+
+Flash and RAM come from the size summary PlatformIO prints at the end of each build. The control tick estimate needs
+the JSON from that board's bench environment (see tools/benchmarkCompare.py), pass it with --bench env=results.json.
+
+Usage: python3 tools/buildReport.py
+       python3 tools/buildReport.py --bench megaatmega2560=mega.json --bench uno_r4_wifi=r4.json
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from benchmarkCompare import load_results, tick_cost_microseconds  # noqa: E402
+
+DEFAULT_ENVIRONMENTS = ["uno_r4_wifi", "megaatmega2560"]
+SIZE_PATTERN = re.compile(r"^(RAM|Flash):.*?([\d.]+)% \(used (\d+) bytes from (\d+) bytes\)", re.MULTILINE)
+
+
+def build_sizes(environment):
+    process = subprocess.run(["pio", "run", "-e", environment], stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    if process.returncode != 0:
+        sys.stdout.write(process.stdout)
+        raise RuntimeError("%s: build failed" % environment)
+    sizes = {}
+    for match in SIZE_PATTERN.finditer(process.stdout):
+        sizes[match.group(1)] = (int(match.group(3)), int(match.group(4)))
+    return sizes
+
+
+def format_size(size):
+    if size is None:
+        return "-"
+    used, total = size
+    return "%d / %d (%.1f%%)" % (used, total, used * 100.0 / total)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("environments", nargs="*", default=DEFAULT_ENVIRONMENTS, help="PlatformIO environments to build")
+    parser.add_argument("--bench", action="append", default=[], metavar="ENV=FILE", help="benchmark JSON for an environment")
+    args = parser.parse_args()
+
+    bench_files = {}
+    for item in args.bench:
+        environment, _, path = item.partition("=")
+        if not path:
+            parser.error("--bench expects ENV=FILE")
+        bench_files[environment] = path
+
+    print("%-18s %26s %26s %22s" % ("environment", "flash", "ram", "control tick"))
+    for environment in args.environments:
+        sizes = build_sizes(environment)
+        tick = "-"
+        if environment in bench_files:
+            report = load_results(bench_files[environment])
+            cost_us = tick_cost_microseconds(report)
+            tick = "%.1f / %dus (%.1f%%)" % (cost_us, report["budgetUs"], cost_us * 100.0 / report["budgetUs"])
+        print("%-18s %26s %26s %22s" % (environment, format_size(sizes.get("Flash")), format_size(sizes.get("RAM")), tick))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Decode binary log records (#L lines) from a serial capture.
+
+Set logOutputBinary = true in main.cpp and the board prints each log record as #L followed by the 32 raw record
+bytes in hex. Everything else in the capture (stats reports, plotter output etc) is passed through untouched.
+
+Usage: python3 tools/logDecode.py [capture.log]   (reads stdin when no file is given)
+"""
+
+import os
+import re
+import struct
+import sys
+
+LOG_MESSAGES_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "logMessages.h")
+RECORD_FORMAT = "<IHBB24s"  # Must match LogRecord in logBuffer.h
+LEVEL_NAMES = ["NONE", "ERROR", "WARN", "INFO", "DEBUG"]
+CATEGORY_NAMES = {
+    "LOG_CATEGORY_SERIAL_RECEIVE": "SERIAL RECEIVE",
+    "LOG_CATEGORY_SERIAL_SEND": "SERIAL SEND",
+    "LOG_CATEGORY_VALVE": "VALVE",
+    "LOG_CATEGORY_BOOST": "BOOST",
+    "LOG_CATEGORY_PID": "PID",
+    "LOG_CATEGORY_GENERAL": "GENERAL",
+    "LOG_CATEGORY_FAULT": "FAULT",
+    "LOG_CATEGORY_NETWORK": "NETWORK",
+}
+ARGUMENT_NONE, ARGUMENT_INT, ARGUMENT_FLOAT, ARGUMENT_TEXT = range(4)
+
+
+def load_message_table(path):
+    """Message IDs are assigned in table order, same as the LogMessageId enum."""
+    with open(path) as header:
+        return re.findall(r'X\((\w+), (\w+), "((?:[^"\\]|\\.)*)"\)', header.read())
+
+
+def format_record(messages, record_bytes):
+    timestamp_micros, message_id, argument_types, level, payload = struct.unpack(RECORD_FORMAT, record_bytes)
+    if message_id >= len(messages):
+        return "%10.3fms [LOG] Unknown message ID %d" % (timestamp_micros / 1000.0, message_id)
+
+    _, category, text = messages[message_id]
+    arguments = []
+    payload_index = 0
+    for i in range(4):
+        argument_type = (argument_types >> (i * 2)) & 0x03
+        if argument_type == ARGUMENT_INT:
+            arguments.append(str(struct.unpack_from("<i", payload, payload_index)[0]))
+            payload_index += 4
+        elif argument_type == ARGUMENT_FLOAT:
+            arguments.append("%.2f" % struct.unpack_from("<f", payload, payload_index)[0])
+            payload_index += 4
+        elif argument_type == ARGUMENT_TEXT:
+            arguments.append(payload[payload_index:].split(b"\0")[0].decode("ascii", "replace"))
+            break
+
+    pieces = text.split("{}")
+    line = pieces[0]
+    for i, piece in enumerate(pieces[1:]):
+        line += (arguments[i] if i < len(arguments) else "?") + piece
+
+    level_name = LEVEL_NAMES[level] if level < len(LEVEL_NAMES) else "?"
+    return "%10.3fms [%s %s] %s" % (timestamp_micros / 1000.0, level_name, CATEGORY_NAMES.get(category, category), line)
+
+
+def main():
+    messages = load_message_table(LOG_MESSAGES_HEADER)
+    capture = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    record_size = struct.calcsize(RECORD_FORMAT)
+
+    for line in capture:
+        line = line.rstrip("\r\n")
+        match = re.search(r"#L([0-9A-Fa-f]{%d})" % (record_size * 2), line)
+        if match:
+            print(format_record(messages, bytes.fromhex(match.group(1))))
+        else:
+            print(line)
+
+
+if __name__ == "__main__":
+    main()
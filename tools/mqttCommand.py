@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+"""Send a command to the board over MQTT, wait for its acknowledgement and print the round trip time.
+
+Uses the mosquitto_pub / mosquitto_sub clients. The id and t fields are filled in automatically.
+
+Usage: python3 tools/mqttCommand.py <broker> <command> [key=value ...]
+       python3 tools/mqttCommand.py 192.168.10.249 pid kp=30 ki=2.5
+       python3 tools/mqttCommand.py 192.168.10.249 boost gear=3 kpa=35
+       python3 tools/mqttCommand.py 192.168.10.249 debug pid=1 boost=0
+       python3 tools/mqttCommand.py 192.168.10.249 blackbox
+       python3 tools/mqttCommand.py 192.168.10.249 shadow kp=12 ki=3 enable=1
+       python3 tools/mqttCommand.py 192.168.10.249 faults
+"""
+
+import subprocess
+import sys
+import time
+
+ACK_TOPIC = "command/ack"
+TIMEOUT_SECONDS = 5
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    broker, command, fields = sys.argv[1], sys.argv[2], sys.argv[3:]
+
+    command_id = int(time.time() * 1000) % 1000000
+    sent_millis = int(time.monotonic() * 1000) % 1000000000
+    payload = ",".join(["id=%d" % command_id, "t=%d" % sent_millis] + fields)
+
+    # Subscribe before publishing so the reply can't be missed
+    subscriber = subprocess.Popen(["mosquitto_sub", "-h", broker, "-t", ACK_TOPIC, "-W", str(TIMEOUT_SECONDS)],
+                                  stdout=subprocess.PIPE, text=True)
+    time.sleep(0.2)
+    subprocess.run(["mosquitto_pub", "-h", broker, "-t", "command/" + command, "-m", payload], check=True)
+
+    for line in subscriber.stdout:
+        reply = dict(field.split("=", 1) for field in line.strip().split(",") if "=" in field)
+        if reply.get("id") != str(command_id):
+            continue
+        round_trip = int(time.monotonic() * 1000) % 1000000000 - int(reply.get("t", sent_millis))
+        print("%s: %s, round trip %dms, board receive to apply %sus" % (payload, reply.get("status"), round_trip, reply.get("applyUs", "-")))
+        if "reason" in reply:
+            print("reason: %s" % reply["reason"])
+        subscriber.terminate()
+        return
+    sys.exit("No acknowledgement within %ds" % TIMEOUT_SECONDS)
+
+
+if __name__ == "__main__":
+    main()
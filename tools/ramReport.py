@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Static RAM per module from a build's linker map file, largest first.
+
+Each of our modules is one row, and library code is grouped by archive. .data counts against both flash and RAM, .bss
+and .noinit are RAM only. The main stack and heap reservations (R4) are listed as their own rows. Builds write the map
+to .pio/build/<env>/firmware.map (see build_flags in platformio.ini); the stack high water mark from stack painting is
+printed by the firmware alongside the loop stats.
+
+Usage: python3 tools/ramReport.py                  (uno_r4_wifi)
+       python3 tools/ramReport.py megaatmega2560
+       python3 tools/ramReport.py path/to/firmware.map --csv > ram.csv
+"""
+
+import argparse
+import os
+import re
+import sys
+
+DATA_SECTIONS = (".data",)
+BSS_SECTIONS = (".bss", ".noinit")
+RESERVED_SECTIONS = {".stack_dummy": "(stack)", ".heap": "(heap)"}
+
+OUTPUT_SECTION = re.compile(r"^(\.\S+)")
+INPUT_SECTION = re.compile(r"^ (\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*))?$")
+CONTINUATION = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+ARCHIVE_MEMBER = re.compile(r"^(.*\.a)\((.*)\)$")
+
+
+def module_name(path):
+    """src/main.cpp.o -> main, .../libFrameworkArduino.a(WString.cpp.o) -> libFrameworkArduino.a"""
+    path = path.strip()
+    member = ARCHIVE_MEMBER.match(path)
+    if member:
+        return os.path.basename(member.group(1))
+    name = os.path.basename(path)
+    for suffix in (".o", ".cpp", ".c", ".S"):
+        if name.endswith(suffix):
+            name = name[: -len(suffix)]
+    return name
+
+
+def section_kind(output_section):
+    if output_section in RESERVED_SECTIONS:
+        return "reserved"
+    if output_section.startswith(DATA_SECTIONS):
+        return "data"
+    if output_section.startswith(BSS_SECTIONS):
+        return "bss"
+    return None
+
+
+def parse_map(path):
+    """Returns {module: {"data": bytes, "bss": bytes}}"""
+    modules = {}
+    with open(path) as handle:
+        lines = handle.read().splitlines()
+    try:
+        start = lines.index("Linker script and memory map")
+    except ValueError:
+        raise RuntimeError("%s: no memory map, is this a GNU ld map file?" % path)
+
+    kind = None
+    reserved_name = None
+    pending = False  # Input section name on its own line, address and size on the next
+    for line in lines[start + 1:]:
+        output = OUTPUT_SECTION.match(line)
+        if output:
+            kind = section_kind(output.group(1))
+            reserved_name = RESERVED_SECTIONS.get(output.group(1))
+            pending = False
+            continue
+        if kind is None:
+            continue
+
+        size = None
+        source = None
+        continuation = CONTINUATION.match(line) if pending else None
+        pending = False
+        if continuation:
+            size, source = int(continuation.group(2), 16), continuation.group(3)
+        else:
+            section = INPUT_SECTION.match(line)
+            if section and not section.group(1).startswith("*"):  # *fill* padding and *(...) script patterns
+                if section.group(2) is None:
+                    pending = True
+                else:
+                    size, source = int(section.group(3), 16), section.group(4)
+        if not size:
+            continue
+
+        if kind == "reserved":
+            name, counted = reserved_name, "bss"
+        else:
+            name, counted = module_name(source), kind
+        sizes = modules.setdefault(name, {"data": 0, "bss": 0})
+        sizes[counted] += size
+    return modules
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("target", nargs="?", default="uno_r4_wifi", help="PlatformIO environment or map file")
+    parser.add_argument("--csv", action="store_true", help="print CSV instead of a table")
+    parser.add_argument("--top", type=int, default=0, help="only the largest N modules")
+    args = parser.parse_args()
+
+    path = args.target if os.path.isfile(args.target) else os.path.join(".pio", "build", args.target, "firmware.map")
+    if not os.path.isfile(path):
+        sys.exit("%s not found, build the environment first" % path)
+    modules = parse_map(path)
+
+    rows = sorted(modules.items(), key=lambda item: item[1]["data"] + item[1]["bss"], reverse=True)
+    if args.top:
+        rows = rows[: args.top]
+    if args.csv:
+        print("module,data,bss,total")
+        for name, sizes in rows:
+            print("%s,%d,%d,%d" % (name, sizes["data"], sizes["bss"], sizes["data"] + sizes["bss"]))
+        return
+
+    print("%-32s %8s %8s %8s" % ("module", "data", "bss", "total"))
+    total_data = total_bss = 0
+    for name, sizes in rows:
+        print("%-32s %8d %8d %8d" % (name, sizes["data"], sizes["bss"], sizes["data"] + sizes["bss"]))
+        total_data += sizes["data"]
+        total_bss += sizes["bss"]
+    print("%-32s %8d %8d %8d" % ("total", total_data, total_bss, total_data + total_bss))
+
+
+if __name__ == "__main__":
+    main()
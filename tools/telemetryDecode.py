@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Decode full rate telemetry batches (telemetry/batch MQTT topic) into CSV.
+
+Each message carries 100ms of control tick samples, delta and varint encoded by encodeTelemetryBatch() in
+telemetryBatcher.cpp. Subscribe with hex output so every message lands on one line, then:
+
+Usage: mosquitto_sub -h <broker> -t telemetry/batch -F %x | python3 tools/telemetryDecode.py > telemetry.csv
+       python3 tools/telemetryDecode.py capture.hex > telemetry.csv   (reads stdin when no file is given)
+"""
+
+import sys
+
+FORMAT_VERSION = 1
+# Channel order and scaling, must match enum TelemetryChannel in telemetryBatcher.h
+CHANNELS = [("targetKpa", 10.0), ("actualKpa", 10.0), ("valveOpenPercentage", 10.0), ("motorCommand", 1.0)]
+COLUMNS = ["sequence", "timeUs"] + [name for name, _ in CHANNELS]
+
+
+def read_varint(data, position):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[position]
+        position += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, position
+        shift += 7
+
+
+def zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_batch(data):
+    """Returns (sequence, start micros, period us, list of per sample channel value lists)"""
+    if data[0] != FORMAT_VERSION:
+        raise ValueError("unsupported format version %d" % data[0])
+    sequence, position = read_varint(data, 1)
+    start_micros = int.from_bytes(data[position:position + 4], "little")
+    position += 4
+    period_us, position = read_varint(data, position)
+    channel_count = data[position]
+    sample_count = data[position + 1]
+    position += 2
+
+    channels = []
+    for _ in range(channel_count):
+        values = []
+        previous = 0
+        for _ in range(sample_count):
+            delta, position = read_varint(data, position)
+            previous += zigzag_decode(delta)
+            values.append(previous)
+        channels.append(values)
+    return sequence, start_micros, period_us, list(zip(*channels))
+
+
+def main():
+    capture = open(sys.argv[1], errors="replace") if len(sys.argv) > 1 else sys.stdin
+    print(",".join(COLUMNS))
+    expected_sequence = None
+    for line in capture:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            sequence, start_micros, period_us, samples = decode_batch(bytes.fromhex(line))
+        except (ValueError, IndexError) as error:
+            sys.stderr.write("Skipping bad batch: %s\n" % error)
+            continue
+
+        if expected_sequence is not None and sequence != expected_sequence:
+            sys.stderr.write("Gap before batch %d, %d batches missing\n" % (sequence, (sequence - expected_sequence) & 0xFFFF))
+        expected_sequence = (sequence + 1) & 0xFFFF
+
+        for index, sample in enumerate(samples):
+            # Channels beyond the ones known here (newer firmware) are ignored
+            row = [sequence, (start_micros + index * period_us) & 0xFFFFFFFF]
+            row += [value / scale for value, (_, scale) in zip(sample, CHANNELS)]
+            print(",".join(str(value) for value in row))
+
+
+if __name__ == "__main__":
+    main()